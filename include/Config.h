@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 /**
  * Configuration constants for MicroPanel
@@ -52,6 +53,109 @@ namespace Config {
     constexpr int STARTUP_DELAY = 1000000;         // 1s delay at startup
     constexpr int CMD_BUFFER_FLUSH_INTERVAL = 50;  // 50ms between buffer flushes
 
+    // Fast boot
+    constexpr const char* MENU_CACHE_SUFFIX = "_menu.cache"; // Last-known main menu, painted at boot
+    constexpr const char* CONFIG_CACHE_SUFFIX = "_config.cache"; // Compiled screens config
+    constexpr int CONFIG_RELOAD_SETTLE_MS = 300;   // Quiet time after a config edit before reloading
+
+    // Dependency verification
+    constexpr int DEPENDENCY_VERIFY_THREADS = 4;   // Parallel path checks at startup
+    constexpr int DEPENDENCY_MONITOR_POLL_MS = 500; // Poll timeout of the dependency watcher thread
+
+    // Asynchronous logging
+    constexpr size_t LOG_RING_CAPACITY = 1024;     // Queued messages before new ones are dropped (power of two)
+    constexpr int LOG_FLUSH_INTERVAL_MS = 20;      // Writer gathers a burst this long after being woken
+    constexpr size_t LOG_FORMAT_RESERVE = 255;     // Bytes logf formats into before a second pass
+    constexpr int LOG_FULL_WAIT_MS = 50;           // Longest a warning or error waits for room in a full ring
+
+    // Event tracing
+    constexpr size_t TRACE_EVENTS_PER_THREAD = 4096; // Ring size per recording thread (power of two)
+    constexpr size_t TRACE_DETAIL_LENGTH = 40;     // Bytes of detail text kept per event
+    constexpr size_t TRACE_MAX_THREAD_BUFFERS = 16; // Threads recording at once; events of further ones are dropped
+    constexpr const char* TRACE_EXPORT_PATH = "/tmp/micropanel_trace.json"; // Written on SIGUSR1
+
+    // ICMP echo
+    constexpr int PING_INTERVAL_MS = 1000;         // Between probes of a multi-probe ping
+    constexpr int PING_MIN_INTERVAL_MS = 10;       // Lower bound for the probe interval
+    constexpr int PING_TIMEOUT_MS = 2000;          // Wait for each reply
+    constexpr int PING_PAYLOAD_SIZE = 56;          // Echo data bytes, as ping's default
+    constexpr int PING_MAX_PAYLOAD_SIZE = 1472;    // Largest echo data that fits a 1500 byte MTU
+    constexpr int PING_LOOP_SLICE_MS = 40;         // Time update() gives a continuous ping
+    constexpr int PING_LOOP_INPUT_WAIT_MS = 10;    // Input wait while a continuous ping runs
+    constexpr int PING_LOOP_REDRAW_MS = 250;       // Statistics refresh of a continuous ping
+
+    // Subnet sweep
+    constexpr int SWEEP_RATE_PER_SEC = 1000;       // Probes sent per second, echoes and connects alike
+    constexpr int SWEEP_TIMEOUT_MS = 750;          // Wait for each probe
+    constexpr int SWEEP_ATTEMPTS = 2;              // Echoes per host before giving up on it
+    constexpr int SWEEP_MAX_HOSTS_IN_FLIGHT = 256; // Hosts being probed at once
+    constexpr int SWEEP_MAX_CONNECTS = 256;        // TCP connects in flight, each holds a socket
+    constexpr int SWEEP_MAX_TCP_PORTS = 4;         // Ports tried per host
+    constexpr int SWEEP_MAX_HOSTS = 4096;          // Largest range one sweep covers
+    constexpr int SWEEP_SLICE_MS = 40;             // Time update() gives a running sweep
+    constexpr int SWEEP_INPUT_WAIT_MS = 10;        // Input wait while a sweep runs
+
+    // Internet reachability test
+    constexpr const char* REACH_ICMP_HOSTS = "8.8.8.8,1.1.1.1,9.9.9.9"; // Echo anchors
+    constexpr const char* REACH_TCP_HOSTS = "1.1.1.1:443,8.8.8.8:443,9.9.9.9:443"; // Connect targets
+    constexpr const char* REACH_HTTP_URL = "http://connectivitycheck.gstatic.com/generate_204"; // HEAD target, its host is looked up
+    constexpr const char* REACH_DNS_NAME = "example.com"; // Looked up when the HTTP host is an address
+    constexpr int REACH_TIMEOUT_MS = 3000;         // A layer without an answer by then has failed
+    constexpr int REACH_RETRY_MS = 1000;           // Echoes and the DNS query go out once more after this
+    constexpr int REACH_SLICE_MS = 40;             // Time update() gives a running test
+    constexpr int REACH_INPUT_WAIT_MS = 10;        // Input wait while a test runs
+
+    // Traffic monitor
+    constexpr const char* TRAFFIC_STATS_PATH = "/proc/net/dev"; // Counters of every interface in one read
+    constexpr int TRAFFIC_SAMPLE_MS = 1000;        // Default sampling interval
+    constexpr int TRAFFIC_MIN_SAMPLE_MS = 100;     // Lower bound for a configured interval
+    constexpr int TRAFFIC_HISTORY = 16;            // Rates kept per interface, one sparkline character each
+    constexpr size_t TRAFFIC_READ_BUFFER = 8192;   // Initial read size, grows for long interface lists
+
+    // Throughput test
+    constexpr int THROUGHPUT_INTERVAL_MS = 1000;   // Reporting interval
+    constexpr int THROUGHPUT_CONNECT_TIMEOUT_MS = 5000; // Control and data connections
+    constexpr int THROUGHPUT_CONTROL_TIMEOUT_MS = 10000; // Wait for the peer's next step
+    constexpr int THROUGHPUT_END_GRACE_SEC = 10;   // A server gives up on a client this long after the test should have ended
+    constexpr int THROUGHPUT_PACING_US = 1000;     // Rate check interval of a limited sender, as iperf3's pacing timer
+    constexpr int THROUGHPUT_TCP_BLOCK = 131072;   // Bytes per TCP write, iperf3's default
+    constexpr int THROUGHPUT_UDP_BLOCK = 1460;     // Bytes per datagram, fits a 1500 byte MTU
+    constexpr int THROUGHPUT_MAX_BLOCK = 1048576;  // Largest block a peer may ask for
+    constexpr uint64_t THROUGHPUT_UDP_BITRATE = 1000000; // UDP rate when none is given, as iperf3
+    constexpr int THROUGHPUT_UDP_BUFFER = 1048576; // SO_SNDBUF/SO_RCVBUF of UDP streams
+    constexpr int THROUGHPUT_UDP_BATCH = 64;       // Datagrams per sendmmsg/recvmmsg
+    constexpr int THROUGHPUT_MAX_STREAMS = 128;    // Parallel streams a peer may ask for
+    constexpr int THROUGHPUT_MAX_DURATION_SEC = 86400; // Longest test a peer may ask for
+    constexpr size_t THROUGHPUT_MAX_QUEUED_INTERVALS = 60; // Undrained intervals kept for poll(), the oldest are dropped
+
+    // Multicast DNS
+    constexpr const char* MDNS_IPERF3_SERVICE = "_iperf3._tcp"; // Announced and browsed unless configured otherwise
+    constexpr int MDNS_BROWSE_MS = 3000;           // How long a discovery listens
+    constexpr int MDNS_QUERY_INTERVAL_MS = 1000;   // First repeat of a browse query, later ones double
+    constexpr int MDNS_ANNOUNCEMENTS = 3;          // Unsolicited responses when a service starts or a link appears
+    constexpr int MDNS_ANNOUNCE_INTERVAL_MS = 1000; // Before the second announcement, later ones double
+    constexpr int MDNS_LINK_CHECK_MS = 1000;       // Longest wait before new interfaces are joined
+    constexpr uint32_t MDNS_HOST_TTL = 120;        // SRV and A records, as RFC 6762 recommends
+    constexpr uint32_t MDNS_SERVICE_TTL = 4500;    // PTR and TXT records
+
+    // Child processes
+    constexpr int SUBPROCESS_KILL_GRACE_MS = 1000; // Wait after SIGTERM before SIGKILL
+    constexpr int SUBPROCESS_REAP_POLL_MS = 50;    // Exit check interval without pidfd support
+    constexpr int SCRIPT_HELPER_POLL_MS = 100;     // Timeout check interval while a helper request runs
+    constexpr int SCRIPT_HELPER_START_TIMEOUT_MS = 2000; // Restart a helper that doesn't pick up a request
+    constexpr int SCRIPT_HELPER_RETRY_SEC = 30;    // Run commands directly this long after the helper failed
+    constexpr int STREAM_MAX_LINE_BYTES = 4096;    // Longer output lines are truncated
+
+    // Persistent storage write-back
+    constexpr int STORAGE_SAVE_DEBOUNCE_MS = 2000;     // Save after this long without further changes
+    constexpr int STORAGE_SAVE_MAX_LATENCY_MS = 10000; // But never hold a change longer than this
+    constexpr const char* STORAGE_JOURNAL_SUFFIX = ".journal";  // Journal next to the storage file
+    constexpr size_t STORAGE_JOURNAL_COMPACT_BYTES = 16384;     // Rewrite the file once the journal exceeds this
+    constexpr const char* STORAGE_JSON_EXPORT_PATH = "/tmp/micropanel_storage.json"; // Written on SIGUSR1
+    constexpr const char* STORAGE_IOSTATS_SUFFIX = ".iostats";  // Write history next to the storage file
+    constexpr int STORAGE_IOSTATS_SAVE_INTERVAL_SEC = 3600;     // Persist the history with a save at most this often
+    constexpr const char* STORAGE_IOSTATS_EXPORT_PATH = "/tmp/micropanel_storage_io.json"; // Written on SIGUSR1
+
     // Power save constants
     constexpr int POWER_SAVE_TIMEOUT_SEC = 10;     // Default timeout in seconds for power save
 
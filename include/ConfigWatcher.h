@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+
+/**
+ * Watches a configuration file for changes using inotify
+ * The parent directory is watched so editors that replace the file
+ * through a rename are detected as well
+ */
+class ConfigWatcher {
+public:
+    explicit ConfigWatcher(const std::string& filePath);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    bool start();
+    void stop();
+
+    // Non-blocking; true once the file changed and has been quiet for the settle time
+    bool checkForChanges();
+
+    int getFd() const { return m_fd; }
+
+private:
+    std::string m_directory;
+    std::string m_fileName;
+    int m_fd = -1;
+    int m_wd = -1;
+    bool m_changePending = false;
+    std::chrono::steady_clock::time_point m_lastChange;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <netinet/in.h>
+#include "Config.h"
+#include "IcmpPinger.h"
+
+/**
+ * Host discovery over an address range: every host gets an ICMP echo and,
+ * optionally, TCP connects to a few ports, with hundreds of probes in flight
+ * on one epoll loop. A token bucket caps the probe rate. A connect that is
+ * accepted or refused both prove the host is up. Nothing blocks beyond the
+ * budget given to poll(), so a screen can drive it from update().
+ */
+class HostSweeper {
+public:
+    struct Host {
+        struct in_addr address {};
+        long rttUs = 0;
+        int port = 0;               // 0 when the host answered ICMP, else the TCP port
+    };
+
+    using HostHandler = std::function<void(const Host& host)>;
+
+    struct Options {
+        std::vector<int> tcpPorts;                          // Also try connects to these ports
+        int ratePerSec = Config::SWEEP_RATE_PER_SEC;        // Probes (echoes and connects) per second
+        int timeoutMs = Config::SWEEP_TIMEOUT_MS;           // Wait for each probe
+        int attempts = Config::SWEEP_ATTEMPTS;              // Echoes per host
+        int maxHosts = Config::SWEEP_MAX_HOSTS_IN_FLIGHT;   // Hosts being probed at once
+        const char* traceName = "sweep";                    // Async trace span name, must be a string literal
+        HostHandler hostHandler;                            // Called once for each host found up
+    };
+
+    HostSweeper() = default;
+    ~HostSweeper();
+
+    HostSweeper(const HostSweeper&) = delete;
+    HostSweeper& operator=(const HostSweeper&) = delete;
+
+    // Addresses in host byte order, both inclusive; false if the range is
+    // empty or too large, or nothing can be probed
+    bool start(uint32_t first, uint32_t last);
+    bool start(uint32_t first, uint32_t last, const Options& options);
+
+    // Probe, receive and expire for up to budgetMs; returns true while the sweep runs
+    bool poll(int budgetMs = 0);
+
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    int getTotal() const { return static_cast<int>(m_hosts.size()); }
+    int getDone() const { return m_done; }          // Hosts found up or given up on
+    int getFound() const { return m_found; }
+
+private:
+    enum class HostState : uint8_t { WAITING, PROBING, UP, DOWN };
+
+    struct HostEntry {
+        HostState state = HostState::WAITING;
+        uint8_t echoesSent = 0;
+        bool echoPending = false;
+        uint16_t connectsPending = 0;
+        std::chrono::steady_clock::time_point echoSentAt;
+    };
+
+    struct Connect {
+        int fd = -1;
+        uint32_t host = 0;                          // Index into m_hosts
+        int port = 0;
+        std::chrono::steady_clock::time_point startedAt;
+    };
+
+    void refill(std::chrono::steady_clock::time_point now);
+    void launch(std::chrono::steady_clock::time_point now);
+    bool sendEcho(uint32_t index, std::chrono::steady_clock::time_point now);
+    bool startConnect(uint32_t index, int port, std::chrono::steady_clock::time_point now);
+    void finishConnect(size_t slot, std::chrono::steady_clock::time_point now);
+    void closeConnect(size_t slot);
+    void expire(std::chrono::steady_clock::time_point now);
+    void hostUp(uint32_t index, long rttUs, int port);
+    void settle(uint32_t index);
+    std::chrono::steady_clock::time_point nextDeadline(std::chrono::steady_clock::time_point now) const;
+
+    IcmpSocket m_socket;
+    int m_epollFd = -1;
+    Options m_options;
+    uint32_t m_first = 0;
+    std::vector<HostEntry> m_hosts;
+    std::vector<uint32_t> m_probing;                // Indices of hosts in PROBING
+    std::vector<Connect> m_connects;                // Slots; fd -1 when free
+    std::vector<size_t> m_freeConnects;
+    size_t m_nextHost = 0;
+    int m_done = 0;
+    int m_found = 0;
+    bool m_running = false;
+    double m_tokens = 0.0;
+    std::chrono::steady_clock::time_point m_refilledAt;
+    uint64_t m_traceId = 0;
+};
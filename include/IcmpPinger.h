@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <netinet/in.h>
+#include "Config.h"
+
+/**
+ * Non-blocking ICMP echo socket. Uses an unprivileged SOCK_DGRAM/IPPROTO_ICMP
+ * socket where net.ipv4.ping_group_range allows it, a raw socket otherwise.
+ * The monotonic send time travels in the echo payload and replies carry the
+ * kernel receive timestamp (SO_TIMESTAMPNS), so no per-probe bookkeeping is
+ * needed to measure a round trip and one socket can serve any number of targets.
+ */
+class IcmpSocket {
+public:
+    struct EchoReply {
+        struct in_addr from {};
+        uint16_t sequence = 0;
+        long rttUs = 0;             // Receive time minus the send time in the payload, both monotonic
+        int ttl = -1;               // -1 when not reported
+    };
+
+    // Bytes of echo data needed for the send timestamp
+    static constexpr size_t MIN_PAYLOAD = 16;
+
+    IcmpSocket() = default;
+    ~IcmpSocket();
+
+    IcmpSocket(const IcmpSocket&) = delete;
+    IcmpSocket& operator=(const IcmpSocket&) = delete;
+
+    bool open();
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+    bool isRaw() const { return m_raw; }
+    int getFd() const { return m_fd; }
+
+    // One sendto; payloadSize is raised to MIN_PAYLOAD
+    bool sendEcho(const struct sockaddr_in& to, uint16_t sequence, size_t payloadSize);
+
+    // Next echo reply for this socket, false once none is queued
+    bool receive(EchoReply& reply);
+
+    // Parse a dotted quad; octets are decimal even with leading zeros ("192.168.001.010")
+    static bool parseAddress(const std::string& text, struct sockaddr_in& address);
+
+private:
+    int m_fd = -1;
+    bool m_raw = false;
+    uint16_t m_identifier = 0;      // Echo id; the kernel assigns it on datagram sockets
+};
+
+/**
+ * ping in-process: probes one host with a configurable count, interval and
+ * payload size, and reports every reply or timeout. Nothing blocks; poll()
+ * sends due probes, collects replies and expires late ones, so a screen can
+ * drive it from update().
+ */
+class IcmpPinger {
+public:
+    struct Reply {
+        uint16_t sequence = 0;
+        bool received = false;      // False for a probe that timed out
+        long rttUs = -1;
+        int ttl = -1;
+    };
+
+    using ReplyHandler = std::function<void(const Reply& reply)>;
+
+    struct Options {
+        int count = 1;                                  // Probes to send, 0 until stop()
+        int intervalMs = Config::PING_INTERVAL_MS;      // Between probes
+        int payloadSize = Config::PING_PAYLOAD_SIZE;    // Echo data bytes, as ping -s
+        int timeoutMs = Config::PING_TIMEOUT_MS;        // Wait for each reply
+        const char* traceName = "ping";                 // Async trace span name, must be a string literal
+        ReplyHandler replyHandler;                      // Called for each reply or timeout
+    };
+
+    IcmpPinger() = default;
+    ~IcmpPinger();
+
+    IcmpPinger(const IcmpPinger&) = delete;
+    IcmpPinger& operator=(const IcmpPinger&) = delete;
+
+    // False if the address is invalid or no ICMP socket can be opened
+    bool start(const std::string& address);
+    bool start(const std::string& address, const Options& options);
+
+    // Send, receive and expire, waiting up to waitMs for something to happen;
+    // returns true while probes are still due or outstanding
+    bool poll(int waitMs = 0);
+
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    int getFd() const { return m_socket.getFd(); }
+    int getSent() const { return m_sent; }
+    int getReceived() const { return m_received; }
+    long getLastRttUs() const { return m_lastRttUs; }   // -1 until a reply arrived
+
+private:
+    struct Pending {
+        uint16_t sequence;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    void report(const Reply& reply);
+    void finishIfDone();
+
+    IcmpSocket m_socket;
+    Options m_options;
+    struct sockaddr_in m_target {};
+    bool m_running = false;
+    uint16_t m_nextSequence = 0;
+    int m_sent = 0;
+    int m_received = 0;
+    long m_lastRttUs = -1;
+    std::chrono::steady_clock::time_point m_nextSendAt;
+    std::deque<Pending> m_pending;      // Oldest first, bounded by timeoutMs / intervalMs
+    uint64_t m_traceId = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <sys/socket.h>
+
+struct nlmsghdr;
+
+/**
+ * Network interfaces and their addresses, kept current through rtnetlink:
+ * one RTM_GETLINK and one RTM_GETADDR dump on first use, then the link and
+ * IPv4/IPv6 address notifications the kernel multicasts. Readers get an
+ * immutable snapshot that is only rebuilt when something changed, so screens
+ * call poll() from update() and repaint when the generation moves.
+ */
+class InterfaceMonitor {
+public:
+    struct Address {
+        int family = AF_UNSPEC;
+        std::string address;            // Numeric form
+        int prefixLength = 0;
+        uint32_t flags = 0;             // IFA_F_* flags; leased addresses lack IFA_F_PERMANENT
+    };
+
+    struct Interface {
+        int index = 0;
+        std::string name;
+        unsigned flags = 0;             // IFF_* flags
+        int operState = 0;              // IF_OPER_* state
+        std::vector<uint8_t> hardwareAddress;
+        std::vector<Address> addresses;
+
+        bool isLoopback() const;
+        bool isUp() const;              // Administratively up and running
+        bool isLinkUp() const;          // Operational state up, as /sys/class/net/*/operstate
+        const Address* firstAddress(int family) const;
+        std::string formatHardwareAddress(const char* separator) const;
+    };
+
+    using Snapshot = std::shared_ptr<const std::vector<Interface>>;
+
+    static InterfaceMonitor& getInstance();
+
+    // Apply the notifications the kernel has queued, without blocking, and
+    // return the generation, which changes whenever the snapshot does
+    uint64_t poll();
+
+    // Interfaces ordered by index, as of the last poll()
+    Snapshot getSnapshot();
+
+    // "255.255.255.0" for 24
+    static std::string prefixToNetmask(int prefixLength);
+
+private:
+    InterfaceMonitor() = default;
+    ~InterfaceMonitor();
+
+    InterfaceMonitor(const InterfaceMonitor&) = delete;
+    InterfaceMonitor& operator=(const InterfaceMonitor&) = delete;
+
+    bool open();
+    bool resync();
+    bool dump(int type);
+    bool apply(const struct nlmsghdr* message);
+    void publish();
+
+    std::mutex m_mutex;
+    int m_fd = -1;                      // Subscribed to the multicast groups
+    bool m_synced = false;
+    std::map<int, Interface> m_interfaces;
+    Snapshot m_snapshot;
+    std::atomic<uint64_t> m_generation{0};
+    uint32_t m_dumpSequence = 0;
+};
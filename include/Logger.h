@@ -2,9 +2,18 @@
 
 #include <string>
 #include <iostream>
+#include <cstdint>
+
+// Lowest level compiled in: 0 = debug, 1 = info, 2 = warning, 3 = error
+// (set with -DSTRIP_DEBUG_LOGS=ON, see CMakeLists.txt)
+#ifndef MICROPANEL_MIN_LOG_LEVEL
+#define MICROPANEL_MIN_LOG_LEVEL 0
+#endif
 
 /**
  * Simple logging utility for MicroPanel
+ * Once started, messages are queued in a lock-free ring and written in
+ * batches by a background thread, so logging never blocks the caller
  */
 class Logger {
 public:
@@ -25,27 +34,33 @@ public:
         return m_verbose;
     }
     
+    // Start the background writer; until then messages are written directly
+    static void startAsync();
+    
+    // Write out everything queued and stop the background writer
+    static void stopAsync();
+    
+    // Number of messages lost because the ring was full
+    static uint64_t getDroppedCount();
+    
+    // True if a message of this level would be written
+    static bool isEnabled(Level level) {
+        return static_cast<int>(level) >= MICROPANEL_MIN_LOG_LEVEL &&
+               (level != Level::DEBUG || m_verbose);
+    }
+    
+    // printf-style logging, formatted only when the level is enabled; the text is
+    // formatted into a std::string that is moved into the ring, not into the slot itself
+    static void logf(Level level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    
     // Log with specified level
     static void log(Level level, const std::string& message) {
         // Skip debug messages in non-verbose mode
-        if (level == Level::DEBUG && !m_verbose) {
+        if (!isEnabled(level)) {
             return;
         }
         
-        switch (level) {
-            case Level::DEBUG:
-                std::cout << "[DEBUG] " << message << std::endl;
-                break;
-            case Level::INFO:
-                std::cout << message << std::endl;
-                break;
-            case Level::WARNING:
-                std::cerr << "[WARNING] " << message << std::endl;
-                break;
-            case Level::ERROR:
-                std::cerr << "[ERROR] " << message << std::endl;
-                break;
-        }
+        enqueue(level, message);
     }
     
     // Convenience methods
@@ -66,5 +81,38 @@ public:
     }
     
 private:
+    static void enqueue(Level level, std::string message);
+    static void writerThread();
+    
     static bool m_verbose;
 };
+
+/**
+ * Logging macros: the message expression is only evaluated when the level is
+ * enabled, and levels below MICROPANEL_MIN_LOG_LEVEL compile to nothing
+ *   LOG_DEBUG("Value: " + std::to_string(value));
+ *   LOG_DEBUGF("Speed: %.1f bytes/sec", speed);
+ */
+#define MICROPANEL_LOG(level, ...) \
+    do { \
+        if (static_cast<int>(level) >= MICROPANEL_MIN_LOG_LEVEL && Logger::isEnabled(level)) { \
+            Logger::log(level, (__VA_ARGS__)); \
+        } \
+    } while (0)
+
+#define MICROPANEL_LOGF(level, ...) \
+    do { \
+        if (static_cast<int>(level) >= MICROPANEL_MIN_LOG_LEVEL && Logger::isEnabled(level)) { \
+            Logger::logf(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...)    MICROPANEL_LOG(Logger::Level::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)     MICROPANEL_LOG(Logger::Level::INFO, __VA_ARGS__)
+#define LOG_WARNING(...)  MICROPANEL_LOG(Logger::Level::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...)    MICROPANEL_LOG(Logger::Level::ERROR, __VA_ARGS__)
+
+#define LOG_DEBUGF(...)   MICROPANEL_LOGF(Logger::Level::DEBUG, __VA_ARGS__)
+#define LOG_INFOF(...)    MICROPANEL_LOGF(Logger::Level::INFO, __VA_ARGS__)
+#define LOG_WARNINGF(...) MICROPANEL_LOGF(Logger::Level::WARNING, __VA_ARGS__)
+#define LOG_ERRORF(...)   MICROPANEL_LOGF(Logger::Level::ERROR, __VA_ARGS__)
@@ -52,6 +52,7 @@ private:
     bool m_exitToParent = false;
     bool m_exitToMainMenu = false;
     bool m_isTopLevelMenu = false;  // New flag to identify top level menu
+    unsigned m_dependencyGeneration = 0;  // Dependency state last rendered
 
     void buildSubmenu();
     void executeSubmenuAction(const std::string& moduleId);
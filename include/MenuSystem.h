@@ -33,12 +33,18 @@ public:
     }
     
     bool isEnabled() const {
-        return m_enabled;
+        return m_enabled && (!m_availabilityCheck || m_availabilityCheck());
+    }
+    
+    // Extra condition evaluated on every render, e.g. cached dependency state
+    void setAvailabilityCheck(std::function<bool()> check) {
+        m_availabilityCheck = check;
     }
     
 private:
     std::string m_label;
     bool m_enabled;
+    std::function<bool()> m_availabilityCheck;
 };
 
 /**
@@ -132,6 +138,8 @@ public:
     // Selection state
     int getCurrentSelection() const { return m_currentItem; }
     void setCurrentSelection(int selection);
+    // Select an item without drawing, takes effect on the next render
+    void selectWithoutRedraw(int selection);
     
     // Rendering
     void render();
@@ -148,11 +156,15 @@ public:
     
     // Set Menu title
     void setTitle(const std::string& title) { m_title = title; }
+    const std::string& getTitle() const { return m_title; }
     // Parent/child menu relationships
     void setParent(std::shared_ptr<Menu> parent) { m_parent = parent; }
     std::shared_ptr<Menu> getParent() const { return m_parent.lock(); }
     
 private:
+    // Line text for an item, with selection indicator; unavailable items are shown in parentheses
+    std::string formatItem(int index, bool selected) const;
+
     std::string m_title = "MAIN MENU";
     std::shared_ptr<Display> m_display;
     std::vector<std::shared_ptr<MenuItem>> m_items;
@@ -9,6 +9,7 @@
 #include <thread>
 #include <vector>
 #include <sys/time.h>
+#include "ScreenConfig.h"
 
 // Forward declarations
 class DisplayDevice;
@@ -18,6 +19,7 @@ class DeviceManager;
 class Menu;
 class MenuItem;
 class ScreenModule;
+class ConfigWatcher;
 
 /**
  * Main application class
@@ -42,19 +44,33 @@ private:
     // For auto-detect mode
     void detectAndRun();
     bool loadConfigFromJson();
+    void createConfiguredModule(const ScreenConfig::ModuleEntry& module);
+    void buildMainMenu(Menu& menu);
+    void reloadConfig();
     void registerModuleInMenu(const std::string& moduleName, const std::string& menuTitle);
+    void registerModuleInMenu(const std::string& moduleName, const std::string& menuTitle, Menu& menu);
     // New methods for persistence and dependencies
     bool initPersistentStorage();
     bool loadModuleDependencies();
+    // Startup sequence helpers (fast boot and cached main menu)
+    void showStartupSplash(const std::string& status);
+    void paintCachedMenu();
+    void renderInitialMenu();
+    std::vector<std::string> menuSnapshot(const Menu& menu) const;
+    std::vector<std::string> loadMenuCache() const;
+    void saveMenuCache(const std::vector<std::string>& menu) const;
 
     struct {
         std::string inputDevice;
         std::string serialDevice;
         std::string configFile;
         std::string persistentDataFile;  // Path to store persistent data
+        std::string menuCacheFile;       // Last-known main menu for fast boot
+        std::string configCacheFile;     // Compiled config cache
         bool verboseMode = false;
         bool autoDetect = false;
         bool powerSaveEnabled = false;
+        bool fastBoot = false;
     } m_config;
 
     std::shared_ptr<DisplayDevice> m_displayDevice;
@@ -62,10 +78,16 @@ private:
     std::shared_ptr<Display> m_display;
     std::shared_ptr<DeviceManager> m_deviceManager;
     std::shared_ptr<Menu> m_mainMenu;
+    std::shared_ptr<ScreenConfig> m_screenConfig;  // Null when no valid config was loaded
+    std::shared_ptr<ConfigWatcher> m_configWatcher;
 
     // Application state
     std::atomic<bool> m_running{false};
 
+    // Main menu as last written to the cache: title followed by item labels
+    std::vector<std::string> m_cachedMenu;
+    bool m_cachedMenuPainted = false;
+
     // Module registry
     std::map<std::string, std::shared_ptr<ScreenModule>> m_modules;
 
@@ -2,11 +2,20 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include <memory>
-#include <nlohmann/json.hpp>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+class ScreenConfig;
 
 /**
  * Manages dependencies for screen modules, such as scripts and config files
+ * File dependencies are verified once in the background and cached; inotify
+ * watches on their directories keep the cache current, so availability checks
+ * never touch the filesystem
  */
 class ModuleDependency {
 public:
@@ -17,8 +26,11 @@ public:
     ModuleDependency(const ModuleDependency&) = delete;
     ModuleDependency& operator=(const ModuleDependency&) = delete;
 
-    // Load dependencies from JSON configuration
-    bool loadDependencies(const nlohmann::json& config);
+    // Load dependencies from the compiled configuration
+    bool loadDependencies(const ScreenConfig& config);
+
+    // Replace the dependencies of a single module (an empty map removes them)
+    void setModuleDependencies(const std::string& moduleId, const std::map<std::string, std::string>& dependencies);
 
     // Get a dependency path for a module
     std::string getDependencyPath(const std::string& moduleId, const std::string& dependencyKey);
@@ -29,14 +41,41 @@ public:
     // Get all dependencies for a module
     const std::map<std::string, std::string>& getModuleDependencies(const std::string& moduleId);
 
-    // Check if all dependencies for a module are satisfied
+    // Check if all dependencies for a module are satisfied (cached, no filesystem access)
     bool checkDependencies(const std::string& moduleId);
     
     // Special flag to skip dependency checks for menus
     bool shouldSkipDependencyCheck(const std::string& moduleId);
+
+    // Incremented whenever the availability of any module changes
+    unsigned getStateGeneration() const { return m_generation; }
+
+    // Stop background verification and path monitoring
+    void stopMonitoring();
+
 private:
     // Private constructor for singleton
     ModuleDependency();
+    ~ModuleDependency();
+
+    // Verification state of one file dependency
+    struct PathState {
+        bool exists = true;      // Optimistic until verified
+        bool verified = false;
+        int watchDescriptor = -1;
+    };
+
+    // Expanded file path to verify, or empty for URLs and plain settings
+    static std::string resolveCheckPath(const std::string& value);
+    void indexModule(const std::string& moduleId);
+    void updateModuleStates();
+    void startVerification();
+    void verifyPaths(std::vector<std::string> paths);
+    static std::string parentDirectory(const std::string& path);
+    void watchPath(const std::string& path);
+    void releaseWatch(int wd);          // Caller holds m_stateMutex
+    void pruneStalePaths();             // Caller holds m_stateMutex
+    void monitorThread();
     
     // Module dependencies storage
     // moduleId -> (dependencyKey -> dependencyPath)
@@ -44,4 +83,18 @@ private:
     
     // Empty map for when a module has no dependencies
     std::map<std::string, std::string> m_emptyMap;
+
+    // Cached verification state, shared with the background threads
+    std::mutex m_stateMutex;
+    std::map<std::string, PathState> m_paths;                          // path -> state
+    std::map<std::string, std::vector<std::string>> m_modulePaths;     // moduleId -> file paths
+    std::map<std::string, bool> m_moduleAvailable;                     // moduleId -> all paths exist
+    std::map<int, std::string> m_watchedDirs;                          // watch descriptor -> directory or its nearest existing ancestor
+    std::atomic<unsigned> m_generation{0};
+
+    // Background verification and inotify monitoring
+    std::thread m_verifyThread;
+    std::thread m_monitorThread;
+    std::atomic<bool> m_monitorRunning{false};
+    int m_inotifyFd = -1;
 };
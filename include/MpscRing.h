@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Bounded lock-free queue for many producer threads and a single consumer
+ * Each slot carries a sequence number that tells producers and the consumer
+ * whose turn it is, so neither side ever blocks; a full ring rejects the push
+ */
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRing() {
+        for (size_t i = 0; i < Capacity; i++) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Safe to call from any thread; returns false if the ring is full
+    bool push(T&& value) {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = m_slots[pos & (Capacity - 1)];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                // Slot is free for this position, try to claim it
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // Consumer hasn't released this slot yet
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only; a push still in progress counts as empty
+    bool empty() const {
+        return m_slots[m_tail & (Capacity - 1)].sequence.load(std::memory_order_acquire) != m_tail + 1;
+    }
+
+    // Consumer thread only; returns false if the ring is empty
+    bool pop(T& value) {
+        Slot& slot = m_slots[m_tail & (Capacity - 1)];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        if (seq != m_tail + 1) {
+            return false;
+        }
+        value = std::move(slot.value);
+        slot.sequence.store(m_tail + Capacity, std::memory_order_release);
+        m_tail++;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Slot m_slots[Capacity];
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) size_t m_tail = 0;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "Config.h"
+
+/**
+ * Multicast DNS responder and DNS-SD browser (RFC 6762/6763) without
+ * avahi-publish or avahi-browse. One UDP socket on port 5353, joined to
+ * 224.0.0.251 on every multicast-capable IPv4 interface, is served by a
+ * worker thread's poll loop. It answers queries for the announced services,
+ * announces them when they start and says goodbye when they are withdrawn.
+ * It also sends browse queries and resolves the instances that answer. A
+ * running server outlives the screen that started it, so the responder
+ * can't depend on a screen's update() being called. Instances are queued
+ * for poll() as soon as they resolve, so a screen can list them while the
+ * browse still runs.
+ */
+class MulticastDns {
+public:
+    struct Service {
+        std::string instance;           // "MicroPanel iperf3 192.168.1.10", one label, dots allowed
+        std::string type;               // "_iperf3._tcp"
+        int port = 0;
+        std::vector<std::string> txt;   // "key=value" strings
+    };
+
+    struct Found {
+        std::string instance;
+        std::string type;
+        std::string host;               // SRV target, "panel.local"
+        std::string address;            // Dotted quad
+        int port = 0;
+        std::vector<std::string> txt;
+    };
+
+    static MulticastDns& getInstance();
+
+    // Answers for service until withdraw(), replacing an earlier announcement of the
+    // same instance; false if the type is malformed or the socket couldn't be set up
+    bool announce(const Service& service);
+    void withdraw(const std::string& instance, const std::string& type);
+
+    // Queries for instances of type for durationMs, dropping the results of an earlier browse
+    bool browse(const std::string& type, int durationMs = Config::MDNS_BROWSE_MS);
+    void stopBrowsing();
+
+    // Moves the instances resolved since the last call into found; false once the browse is over
+    bool poll(std::vector<Found>& found);
+
+    // Says goodbye for everything announced and stops the worker
+    void shutdown();
+
+private:
+    using Name = std::vector<std::string>;
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct Record;
+    struct Message;
+    class Writer;
+
+    struct Announced {
+        Service service;
+        Name typeName;                  // "_iperf3", "_tcp", "local"
+        Name instanceName;              // The instance label in front of typeName
+        int announcementsLeft = 0;
+        int announceIntervalMs = 0;     // Doubles after each announcement
+        TimePoint nextAnnouncement;
+    };
+
+    // Browse state of one instance
+    struct Resolving {
+        Found found;
+        Name instanceName;
+        std::string targetKey;          // Lower-cased SRV target, to find its A record
+        uint32_t sender = 0;            // Address the SRV record came from, network byte order
+        bool haveService = false;       // Its SRV record arrived
+        bool reported = false;
+        bool queried = false;           // SRV and TXT asked for directly
+    };
+
+    // Interface the socket has joined the group on
+    struct Link {
+        int index = 0;
+        uint32_t address = 0;           // Network byte order
+    };
+
+    MulticastDns() = default;
+    ~MulticastDns();
+
+    MulticastDns(const MulticastDns&) = delete;
+    MulticastDns& operator=(const MulticastDns&) = delete;
+
+    bool start();
+    void run();
+    void refreshLinks();
+    void receive();
+    void handlePacket(const char* data, size_t size, const struct sockaddr_in& from, int index, TimePoint now);
+    void answerQuery(const Message& query, const struct sockaddr_in& from, const Link& link, TimePoint now);
+    void readResponse(const Message& response, const struct sockaddr_in& from);
+    void sendDue(TimePoint now);
+    void sendAnnouncement(const Announced& announced, bool goodbye);
+    void sendBrowseQuery();
+    void serviceRecords(const Announced& announced, const Link& link, std::vector<Record>& records) const;
+    bool sendTo(const std::string& packet, const Link& link, const struct sockaddr_in& to);
+    bool sendMulticast(const std::string& packet, const Link& link);
+    int nextWaitMs(TimePoint now) const;
+    void wake();
+
+    static bool parse(const char* data, size_t size, Message& message);
+
+    std::thread m_worker;
+    std::atomic<bool> m_stopRequested{false};
+    int m_fd = -1;                      // Both set up before the worker starts and closed after it ended
+    int m_wakeFd = -1;                  // eventfd that cuts the worker's wait short
+
+    std::mutex m_mutex;                 // Guards everything below
+    std::string m_hostLabel;            // This host's name in .local
+    uint64_t m_linkGeneration = 0;      // InterfaceMonitor generation m_links was built from
+    std::vector<Link> m_links;
+    std::vector<Announced> m_services;
+    std::map<std::string, TimePoint> m_lastMulticast; // Per interface and record, for the one second spacing
+
+    bool m_browsing = false;
+    std::string m_browseTypeText;
+    Name m_browseType;
+    TimePoint m_browseEnds;
+    TimePoint m_nextQuery;
+    int m_queryIntervalMs = 0;          // Doubles after each query
+    std::map<std::string, Resolving> m_resolving;  // By lower-cased instance name
+    std::map<std::string, uint32_t> m_addresses;   // A records by lower-cased host name
+    std::vector<Found> m_found;
+    uint64_t m_traceId = 0;
+};
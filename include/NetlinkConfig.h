@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * IPv4 settings of one interface, read and changed over rtnetlink without
+ * "ip", "route" or distro scripts. applyStatic() runs as a transaction:
+ * every address and route change waits for the kernel's acknowledgement,
+ * and when one is refused the steps already taken are undone, leaving the
+ * addresses and default route as they were. Writing the distro's own
+ * configuration files is left to the caller.
+ */
+class NetlinkConfig {
+public:
+    struct Ipv4Settings {
+        std::string address;        // Dotted quad, empty when the interface has none
+        int prefixLength = 0;
+        std::string gateway;        // Default route through the interface, empty if there is none
+        bool leased = false;        // The address has a lifetime, as a DHCP client sets it up
+    };
+
+    // False if the interface doesn't exist or netlink couldn't be asked
+    static bool read(const std::string& interface, Ipv4Settings& settings);
+
+    // Make address/prefixLength the interface's only IPv4 address and route the default
+    // through gateway (none when empty); on failure error says which step was refused
+    static bool applyStatic(const std::string& interface, const std::string& address, int prefixLength,
+                            const std::string& gateway, std::string& error);
+
+    // 24 for "255.255.255.0", -1 for anything that isn't a contiguous mask
+    static int netmaskToPrefix(const std::string& netmask);
+
+private:
+    struct Route {
+        uint32_t gateway = 0;       // Network byte order
+        uint32_t priority = 0;
+        uint8_t protocol = 0;
+    };
+
+    struct Address {
+        uint32_t address = 0;       // Network byte order
+        int prefixLength = 0;
+    };
+
+    class Socket;
+
+    static bool readAddresses(int index, std::vector<Address>& addresses);
+    static bool readDefaultRoutes(Socket& socket, int index, std::vector<Route>& routes);
+};
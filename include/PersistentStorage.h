@@ -2,16 +2,89 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
 #include <nlohmann/json.hpp>
+#include "Config.h"
+
+template<typename T>
+class StorageKey;
 
 /**
  * Centralized persistent storage manager for screen modules
  * Handles reading/writing JSON data for all modules
+ * Changes are written back by a single flusher thread, coalescing bursts of
+ * updates into one save
  */
 class PersistentStorage {
 public:
+    // When the flusher writes pending changes to disk
+    struct FlushPolicy {
+        int debounceMs = Config::STORAGE_SAVE_DEBOUNCE_MS;      // Quiet time after the last change
+        int maxLatencyMs = Config::STORAGE_SAVE_MAX_LATENCY_MS; // Upper bound from the first unsaved change
+        bool flushOnShutdown = true;                            // Save pending changes in shutdown()
+    };
+
+    // How changes reach the storage file
+    enum class Backend {
+        SNAPSHOT,   // Rewrite the whole file on every save
+        JOURNAL     // Append changed values to a CRC-protected journal, compacted into the file when it grows
+    };
+
+    // Encoding of the storage file
+    enum class Format {
+        JSON,       // Indented JSON at the configured path
+        CBOR,       // Same path with a .cbor extension
+        MSGPACK     // Same path with a .msgpack extension
+    };
+
+    struct Options {
+        Backend backend = Backend::SNAPSHOT;
+        Format format = Format::JSON;
+
+        bool operator==(const Options& other) const { return backend == other.backend && format == other.format; }
+        bool operator!=(const Options& other) const { return !(*this == other); }
+    };
+
+    // Storage file writes, to keep track of flash wear
+    struct IoCounters {
+        uint64_t saves = 0;     // Snapshot rewrites and journal appends
+        uint64_t bytes = 0;     // Bytes written to storage files
+        uint64_t fsyncs = 0;    // fsync/fdatasync calls
+        uint64_t renames = 0;   // Temporary file renames
+
+        void add(const IoCounters& other) {
+            saves += other.saves;
+            bytes += other.bytes;
+            fsyncs += other.fsyncs;
+            renames += other.renames;
+        }
+    };
+
+    // Write accounting for this run and including previous runs of the same storage file.
+    // Per module, saves/fsyncs/renames count the writes that carried the module's changes
+    // and bytes its share of them; writes without changes are booked to "(storage)".
+    struct IoStats {
+        IoCounters session;
+        IoCounters lifetime;
+        std::map<std::string, IoCounters> sessionModules;
+        std::map<std::string, IoCounters> lifetimeModules;
+        uint64_t runs = 0;        // Runs of this storage file, including the current one
+        int64_t since = 0;        // Unix time of the first recorded run
+    };
+
+    // "journal" selects the journal backend, anything else the snapshot backend
+    static Backend parseBackend(const std::string& name);
+
+    // "cbor" or "msgpack" select a binary format, anything else JSON
+    static Format parseFormat(const std::string& name);
+
     // Singleton access
     static PersistentStorage& getInstance();
 
@@ -21,6 +94,7 @@ public:
 
     // Initialize with storage file path
     bool initialize(const std::string& filePath = "");
+    bool initialize(const std::string& filePath, const Options& options);
 
     // Set and get string values
     bool setValue(const std::string& moduleId, const std::string& key, const std::string& value);
@@ -41,34 +115,187 @@ public:
     // Check if a value exists
     bool hasValue(const std::string& moduleId, const std::string& key);
 
-    // Save data to file (can be called explicitly, but also called by setValue methods)
+    // Resolve a value once into a typed handle (int, bool, double or std::string)
+    template<typename T>
+    StorageKey<T> resolveKey(const std::string& moduleId, const std::string& key, T defaultValue = T());
+
+    // Save data to file now (changes are otherwise saved by the flusher thread)
     bool saveToFile();
 
+    // Configure write-back timing
+    void setFlushPolicy(const FlushPolicy& policy);
+
+    // Stop the flusher thread, saving pending changes if the policy says so
+    void shutdown();
+
     // Get the current storage file path
     std::string getStorageFilePath() const { return m_storageFilePath; }
 
+    // Write the current data as indented JSON, a readable view of binary storage
+    bool exportJson(const std::string& path);
+
+    // Write Config::STORAGE_JSON_EXPORT_PATH and Config::STORAGE_IOSTATS_EXPORT_PATH;
+    // run on the trace export thread when SIGUSR1 arrives
+    void exportSnapshots();
+
+    // Write accounting, as a copy or in the machine-readable export layout
+    IoStats getIoStats();
+    nlohmann::json getIoStatsJson();
+    bool exportIoStats(const std::string& path);
+
     // Check if storage is available
     bool isAvailable() const { return m_initialized; }
 
 private:
+    template<typename T>
+    friend class StorageKey;
+
+    // One resolved (moduleId, key); slots are never removed, so handles keep the pointer
+    struct KeySlot {
+        std::string moduleId;
+        std::string key;
+        std::atomic<uint64_t> version{1};   // Bumped whenever the stored value may have changed
+    };
+
     // Private constructor for singleton
     PersistentStorage();
     ~PersistentStorage();
 
-    // Load data from file
+    // Handle support: find or create a slot, read and write through it
+    KeySlot* resolveSlot(const std::string& moduleId, const std::string& key);
+    template<typename T>
+    bool readSlot(const KeySlot& slot, T& value);
+    bool writeSlot(const KeySlot& slot, nlohmann::json value);
+
+    // Stored JSON type expected for each handle type
+    static bool holdsType(const nlohmann::json& value, const int&) { return value.is_number_integer(); }
+    static bool holdsType(const nlohmann::json& value, const bool&) { return value.is_boolean(); }
+    static bool holdsType(const nlohmann::json& value, const double&) { return value.is_number(); }
+    static bool holdsType(const nlohmann::json& value, const std::string&) { return value.is_string(); }
+
+    // Load data from file, in the configured format or migrating from another one
     bool loadFromFile();
 
+    // Storage file for a format, derived from the configured path
+    static std::string formatPath(const std::string& basePath, Format format);
+    bool loadSnapshot(const std::string& filePath, Format format);
+
+    // Journal backend: apply records left by previous runs, append new ones
+    std::string getJournalPath() const { return m_storageFilePath + Config::STORAGE_JOURNAL_SUFFIX; }
+    size_t replayJournal();
+
+    // Write a complete file via temporary file, fsync and rename
+    bool writeSnapshot(const std::string& filePath, const std::string& content, IoCounters* io = nullptr);
+    bool appendJournal(const std::string& journalPath, const std::string& records, IoCounters& io);
+
+    // Write accounting: book a write to modules by byte share; caller holds m_mutex
+    void accountIo(const IoCounters& io, const std::map<std::string, uint64_t>& moduleBytes);
+    std::string getIoStatsPath() const { return m_storageFilePath + Config::STORAGE_IOSTATS_SUFFIX; }
+    void loadIoStats();
+    bool saveIoStats();
+
+    // Store a value and mark it for write-back; caller holds m_mutex
+    bool setJsonValue(const std::string& moduleId, const std::string& key, nlohmann::json value);
+
+    // Flusher thread body
+    void flushThread();
+
     // Internal data storage
     nlohmann::json m_data;
     std::string m_storageFilePath;
     bool m_initialized = false;
     bool m_isDirty = false;
+    Options m_options;
+    std::string m_legacyFilePath;   // File in a previous format, retired after the next full save
+    std::set<std::pair<std::string, std::string>> m_pendingChanges;   // (moduleId, key) not yet journaled
+    size_t m_journalBytes = 0;                                         // Guarded by m_saveMutex
     
-    // Thread safety
+    // Thread safety (m_saveMutex serializes file writes, taken before m_mutex)
     std::mutex m_mutex;
+    std::mutex m_saveMutex;
     
-    // Delay save mechanism
-    void scheduleSave();
-    void cancelScheduledSave();
-    bool m_savePending = false;
+    // Write-back state, guarded by m_mutex
+    FlushPolicy m_policy;
+    std::thread m_flusher;
+    std::condition_variable m_flushCondition;
+    bool m_stopFlusher = false;
+    std::chrono::steady_clock::time_point m_firstChangeTime;
+    std::chrono::steady_clock::time_point m_lastChangeTime;
+
+    // Write accounting, guarded by m_mutex; the history file is written by saveIoStats
+    IoStats m_ioStats;
+    bool m_ioStatsDirty = false;   // Writes booked since the history file was last written
+    std::chrono::steady_clock::time_point m_ioStatsSavedAt;
+
+    // Slots handed out to StorageKey handles, guarded by m_mutex
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<KeySlot>> m_slots;
+};
+
+/**
+ * Typed handle to one persistent value, obtained from PersistentStorage::resolveKey
+ * get() returns a cached copy and only goes back to the storage (and its mutex)
+ * when the value's version has moved, so per-frame reads stay off the lock.
+ * The cache belongs to the handle: give each thread its own copy.
+ */
+template<typename T>
+class StorageKey {
+public:
+    StorageKey() = default;
+
+    // Current value, or the default if it is missing or stored with another type
+    T get() const {
+        if (!m_slot) {
+            return m_default;
+        }
+        uint64_t version = m_slot->version.load(std::memory_order_acquire);
+        if (version != m_seenVersion) {
+            if (!PersistentStorage::getInstance().readSlot(*m_slot, m_cached)) {
+                m_cached = m_default;
+            }
+            m_seenVersion = version;
+        }
+        return m_cached;
+    }
+
+    // Store a new value, written back by the flusher like setValue()
+    bool set(const T& value) {
+        return m_slot && PersistentStorage::getInstance().writeSlot(*m_slot, value);
+    }
+
+    bool isValid() const { return m_slot != nullptr; }
+
+private:
+    friend class PersistentStorage;
+
+    StorageKey(const PersistentStorage::KeySlot* slot, T defaultValue)
+        : m_slot(slot), m_default(defaultValue), m_cached(defaultValue) {}
+
+    const PersistentStorage::KeySlot* m_slot = nullptr;
+    T m_default{};
+    mutable T m_cached{};
+    mutable uint64_t m_seenVersion = 0;
 };
+
+template<typename T>
+StorageKey<T> PersistentStorage::resolveKey(const std::string& moduleId, const std::string& key, T defaultValue) {
+    return StorageKey<T>(resolveSlot(moduleId, key), defaultValue);
+}
+
+template<typename T>
+bool PersistentStorage::readSlot(const KeySlot& slot, T& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_initialized) {
+        return false;
+    }
+
+    auto module = m_data.find(slot.moduleId);
+    if (module == m_data.end() || !module->is_object()) {
+        return false;
+    }
+    auto entry = module->find(slot.key);
+    if (entry == module->end() || !holdsType(*entry, value)) {
+        return false;
+    }
+    value = entry->template get<T>();
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Statistics of a ping series in constant memory, so a loop can run for
+ * hours: loss, min/avg/max, RFC 3550 interarrival jitter, and percentiles
+ * from a fixed histogram with four log-spaced buckets per octave (a
+ * percentile is the bucket's upper bound, within 19% of the true value).
+ */
+class PingStats {
+public:
+    // Below 10us, four buckets per octave up to ~10.5s, and everything above
+    static constexpr int BUCKET_COUNT = 82;
+
+    void reset();
+    void addReply(long rttUs);
+    void addLoss();
+
+    uint64_t getProbes() const { return m_received + m_lost; }     // Replies and timeouts
+    uint64_t getReceived() const { return m_received; }
+    uint64_t getLost() const { return m_lost; }
+    double getLossPercent() const;
+    long getMinUs() const { return m_received ? m_minUs : -1; }
+    long getMaxUs() const { return m_received ? m_maxUs : -1; }
+    long getLastUs() const { return m_lastUs; }                      // -1 until a reply arrived
+    double getAverageUs() const;
+    double getJitterUs() const { return m_jitterUs; }
+
+    // RTT below which the given percentage of replies fall, -1 without replies
+    long getPercentileUs(double percent) const;
+
+    uint32_t getBucket(int index) const { return m_buckets[index]; }
+    static long bucketUpperUs(int index);   // Exclusive; the last bucket has none (LONG_MAX)
+
+private:
+    static int bucketFor(long rttUs);
+
+    uint32_t m_buckets[BUCKET_COUNT] = {};
+    uint64_t m_received = 0;
+    uint64_t m_lost = 0;
+    long m_minUs = 0;
+    long m_maxUs = 0;
+    long m_lastUs = -1;
+    double m_sumUs = 0.0;
+    double m_jitterUs = 0.0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <netinet/in.h>
+#include "Config.h"
+#include "IcmpPinger.h"
+
+/**
+ * "Is the internet up?" answered by several probes at once: ICMP echoes to a
+ * few anchors, TCP connects to well known services, a DNS query to the system
+ * resolver and an HTTP HEAD to the host it resolves. Every layer records its
+ * first success, so a healthy network answers within about one round trip and
+ * one that drops ICMP doesn't hold the answer up. All probes share one epoll
+ * loop driven by poll(), so a screen can run it from update().
+ */
+class ReachabilityProbe {
+public:
+    enum class Layer { ICMP, TCP, DNS, HTTP };
+    static constexpr int LAYER_COUNT = 4;
+
+    enum class Status { PENDING, OK, FAILED };
+
+    struct LayerResult {
+        Status status = Status::PENDING;
+        long elapsedUs = -1;        // From start() to the layer's first success
+        std::string detail;         // What answered, or why the layer failed
+    };
+
+    struct Options {
+        std::vector<std::string> icmpHosts;             // Dotted quads
+        std::vector<std::string> tcpHosts;              // "address:port", port 443 when left out
+        std::string httpUrl;                            // http://host[:port]/path; a host name is what DNS looks up
+        std::string dnsName = Config::REACH_DNS_NAME;   // Looked up instead when the HTTP host is an address
+        int timeoutMs = Config::REACH_TIMEOUT_MS;       // Layers without an answer by then have failed
+        int retryMs = Config::REACH_RETRY_MS;           // Echoes and the DNS query are sent once more after this
+        const char* traceName = "reach";                // Async trace span name, must be a string literal
+    };
+
+    ReachabilityProbe() = default;
+    ~ReachabilityProbe();
+
+    ReachabilityProbe(const ReachabilityProbe&) = delete;
+    ReachabilityProbe& operator=(const ReachabilityProbe&) = delete;
+
+    // False if no probe at all could be started
+    bool start();
+    bool start(const Options& options);
+
+    // Send, receive and expire for up to budgetMs; returns true until every layer has an answer
+    bool poll(int budgetMs = 0);
+
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    bool isReachable() const { return m_firstSuccessUs >= 0; }
+    long getFirstSuccessUs() const { return m_firstSuccessUs; }     // -1 until some layer succeeded
+    const LayerResult& getResult(Layer layer) const { return m_results[static_cast<int>(layer)]; }
+
+    static const char* layerName(Layer layer);
+
+private:
+    struct TcpProbe {
+        int fd = -1;
+        struct sockaddr_in to {};
+        std::string name;
+    };
+
+    bool startIcmp();
+    void sendEchoes();
+    void receiveEchoes(std::chrono::steady_clock::time_point now);
+    bool startTcp();
+    void finishTcp(size_t index, std::chrono::steady_clock::time_point now);
+    bool startDns();
+    void sendDnsQuery();
+    void receiveDns(std::chrono::steady_clock::time_point now);
+    bool startHttp(const struct in_addr& address);
+    void handleHttp(uint32_t events, std::chrono::steady_clock::time_point now);
+    void closeHttp();
+    void succeed(Layer layer, std::chrono::steady_clock::time_point now, const std::string& detail);
+    void fail(Layer layer, const std::string& detail);
+    void closeLayer(Layer layer);
+    bool watch(int fd, uint32_t events, uint64_t tag, int operation);
+    std::chrono::steady_clock::time_point nextDeadline() const;
+
+    Options m_options;
+    bool m_running = false;
+    int m_epollFd = -1;
+    std::chrono::steady_clock::time_point m_startedAt;
+    LayerResult m_results[LAYER_COUNT];
+    long m_firstSuccessUs = -1;
+    bool m_retried = false;
+
+    IcmpSocket m_icmp;
+    std::vector<struct sockaddr_in> m_icmpTargets;
+
+    std::vector<TcpProbe> m_tcp;
+    int m_tcpPending = 0;
+    std::string m_tcpError;
+
+    int m_dnsFd = -1;
+    uint16_t m_dnsId = 0;
+    std::string m_dnsName;
+
+    int m_httpFd = -1;
+    std::string m_httpHost;
+    int m_httpPort = 80;
+    std::string m_httpPath;
+    bool m_httpSent = false;
+    bool m_httpNeedsDns = false;
+    std::string m_httpResponse;
+
+    uint64_t m_traceId = 0;
+};
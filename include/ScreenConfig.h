@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+/**
+ * Compiled form of a screens JSON configuration
+ * The JSON is parsed and validated once, and the resulting model is cached
+ * in a binary file next to the config so later boots skip JSON parsing
+ */
+class ScreenConfig {
+public:
+    struct SubmenuEntry {
+        std::string id;
+        std::string title;
+
+        bool operator==(const SubmenuEntry& other) const {
+            return id == other.id && title == other.title;
+        }
+    };
+
+    struct ModuleEntry {
+        std::string id;
+        std::string title;
+        std::string type;                             // "", "menu", "action" or "GenericList"
+        bool hasTitle = false;
+        bool enabled = false;
+        std::vector<SubmenuEntry> submenus;           // Only for "menu" modules
+        std::map<std::string, std::string> depends;   // Dependency key -> path
+        nlohmann::json listConfig;                    // Module object, only for "GenericList" modules
+
+        bool operator==(const ModuleEntry& other) const {
+            return id == other.id && title == other.title && type == other.type &&
+                   hasTitle == other.hasTitle && enabled == other.enabled &&
+                   submenus == other.submenus && depends == other.depends &&
+                   listConfig == other.listConfig;
+        }
+        bool operator!=(const ModuleEntry& other) const { return !(*this == other); }
+    };
+
+    // Load from the binary cache if it matches the config file, otherwise parse and recompile
+    bool load(const std::string& configPath, const std::string& cachePath = "");
+
+    // Compile an already parsed JSON configuration
+    bool compile(const nlohmann::json& config);
+
+    const std::vector<ModuleEntry>& getModules() const { return m_modules; }
+    const ModuleEntry* findModule(const std::string& id) const;
+    const std::string& getPersistentDataFile() const { return m_persistentDataFile; }
+    const std::string& getPersistentBackend() const { return m_persistentBackend; }   // "" or "journal"
+    const std::string& getPersistentFormat() const { return m_persistentFormat; }     // "", "cbor" or "msgpack"
+    bool hasInvertDisplayOption() const { return m_invertDisplayOption; }
+    const std::string& getInvertDisplayTitle() const { return m_invertDisplayTitle; }
+    bool isLoadedFromCache() const { return m_loadedFromCache; }
+
+private:
+    // Identifies the config file revision a cache was built from
+    struct SourceKey {
+        int64_t mtimeNs = 0;
+        uint64_t size = 0;
+        uint64_t hash = 0;
+    };
+
+    static uint64_t hashContent(const std::string& content);
+    // Matches on size and content hash; staleKey is set when the recorded mtime differs
+    bool loadCache(const std::string& cachePath, const SourceKey& current, bool& staleKey);
+    bool writeCache(const std::string& cachePath, const SourceKey& key) const;
+    void clear();
+
+    std::vector<ModuleEntry> m_modules;
+    std::string m_persistentDataFile;
+    std::string m_persistentBackend;
+    std::string m_persistentFormat;
+    bool m_invertDisplayOption = false;
+    std::string m_invertDisplayTitle;
+    bool m_loadedFromCache = false;
+};
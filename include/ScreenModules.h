@@ -9,6 +9,15 @@
 #include <chrono>
 #include <sys/time.h>
 #include "IPSelector.h"
+#include "PersistentStorage.h"
+#include "Subprocess.h"
+#include "IcmpPinger.h"
+#include "PingStats.h"
+#include "HostSweeper.h"
+#include "ReachabilityProbe.h"
+#include "TrafficSampler.h"
+#include "ThroughputEngine.h"
+#include "MulticastDns.h"
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
@@ -68,7 +77,10 @@ public:
     std::string getModuleId() const override { return "network"; }
 
 private:
+    void render();
     void getNetworkInfo(std::string& ip, std::string& mac, std::string& iface);
+
+    uint64_t m_generation = 0;      // Interface monitor generation on screen
 };
 
 /**
@@ -91,6 +103,58 @@ private:
     struct timeval m_lastUpdate = {0, 0};
 };
 
+/**
+ * Storage write statistics screen
+ * Rotation pages through this run, all runs and each module's share
+ */
+class StorageStatsScreen : public ScreenModule {
+public:
+    StorageStatsScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input);
+
+    void enter() override;
+    void update() override;
+    void exit() override;
+    bool handleInput() override;
+    std::string getModuleId() const override { return "storagestats"; }
+
+private:
+    void drawPage();
+    static std::string formatBytes(uint64_t bytes);
+
+    int m_page = 0;
+    struct timeval m_lastUpdate = {0, 0};
+};
+
+/**
+ * Traffic monitor screen
+ * Live rx/tx rates of one interface with sparklines of the recent past,
+ * rotation steps through the interfaces
+ */
+class TrafficMonitorScreen : public ScreenModule {
+public:
+    TrafficMonitorScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input);
+
+    void enter() override;
+    void update() override;
+    void exit() override;
+    bool handleInput() override;
+    std::string getModuleId() const override { return "traffic"; }
+
+private:
+    void render();
+    void drawRow(int row, const std::string& text);
+    static std::string formatRate(double bitsPerSec);
+    static std::string formatCount(double count);
+    static std::string sparkline(const TrafficSampler::History& history, float peak);
+
+    TrafficSampler m_sampler;
+    int m_intervalMs = Config::TRAFFIC_SAMPLE_MS;
+    int m_selected = 0;
+    std::string m_selectedName;         // Keeps the selection when interfaces come and go
+    std::chrono::steady_clock::time_point m_sampledAt;
+    std::string m_rows[8];
+};
+
 /**
  * Brightness control screen
  */
@@ -109,10 +173,13 @@ private:
     void setupScreen();
 
     int m_previousBrightness = 0;
+    StorageKey<int> m_savedLevel;   // brightness.level
 };
 
 /**
  * Internet connectivity test screen
+ * Probes ICMP, TCP, DNS and HTTP at once, shows the answer as soon as one
+ * of them gets through and which layers work as the others finish
  */
 class InternetTestScreen : public ScreenModule {
 public:
@@ -125,19 +192,18 @@ public:
     std::string getModuleId() const override { return "internet"; }
 
 private:
-    static int pingServer(const std::string& server, int timeoutSec);
     void startTest();
+    void checkTest();
+    void renderLayers();
 
-    std::thread m_testThread;
+    ReachabilityProbe m_probe;
     std::atomic<bool> m_testCompleted{false};
     std::atomic<int> m_testResult{-1};
-    std::atomic<int> m_progress{0};
     std::chrono::steady_clock::time_point m_startTime;
-    int64_t m_progressLastUpdated = 0;
-    int64_t m_animationLastUpdated = 0;
+    int64_t m_animationLastUpdated = -1;
     bool m_resultDisplayed = false;
-    const int m_timeoutSec = 5;
-    const std::string m_testServer = "8.8.8.8";
+    bool m_exitHintDisplayed = false;
+    std::string m_layerText[ReachabilityProbe::LAYER_COUNT];   // Breakdown rows as drawn
 };
 
 /**
@@ -206,11 +272,14 @@ private:
 enum class IPPingMenuState {
     MENU_STATE_IP,       // IP address edit
     MENU_STATE_PING,     // PING action
+    MENU_STATE_LOOP,     // Continuous ping
     MENU_STATE_EXIT      // Exit menu
 };
 
 /**
  * IP Ping Test screen
+ * A single ping, or a continuous one that keeps loss, RTT, jitter and
+ * percentile statistics and can show them as an RTT histogram
  */
 class IPPingScreen : public ScreenModule {
 public:
@@ -230,10 +299,16 @@ private:
     void renderMenu(bool fullRedraw);
     void updateStatusLine();
     void checkPingStatus();
+    void startLoop();
+    void stopLoop();
+    void renderLoop(bool fullRedraw);
+    void renderLoopStats();
+    void renderLoopHistogram();
+    void drawLoopRow(int row, const std::string& text);
 
     std::string m_targetIp;
     std::unique_ptr<IPSelector> m_ipSelector;
-    std::atomic<pid_t> m_pingPid{-1};
+    IcmpPinger m_ping;
     std::atomic<bool> m_pingInProgress{false};
     std::atomic<int> m_pingResult{-1};
     std::string m_statusMessage;
@@ -241,10 +316,71 @@ private:
     bool m_statusChanged = false;
     double m_pingTimeMs = 0.0;
 
+    // Continuous mode
+    bool m_looping = false;
+    bool m_showHistogram = false;                   // Histogram page instead of the numbers
+    int m_loopIntervalMs = Config::PING_INTERVAL_MS;
+    PingStats m_stats;
+    bool m_statsChanged = false;
+    std::chrono::steady_clock::time_point m_loopDrawnAt;
+    std::string m_loopRows[8];                      // Text on each display row, to redraw only changes
+    int m_loopBars[6] = {};                         // Histogram bar lengths, -1 when not drawn
+
     IPPingMenuState m_state{IPPingMenuState::MENU_STATE_IP};
     bool m_shouldExit{false};
 };
 
+// Menu states for the subnet sweep screen
+enum class SubnetSweepMenuState {
+    MENU_STATE_RANGE,    // Network to sweep
+    MENU_STATE_SWEEP,    // Start the sweep
+    MENU_STATE_EXIT      // Exit menu
+};
+
+/**
+ * Subnet sweep screen
+ * Finds the hosts that are up on a /24 (the local one by default) with
+ * concurrent ICMP echoes and optional TCP connects; hosts stream into a
+ * scrollable list with their round trip times
+ */
+class SubnetSweepScreen : public ScreenModule {
+public:
+    SubnetSweepScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input);
+
+    void enter() override;
+    void update() override;
+    void exit() override;
+    bool handleInput() override;
+    std::string getModuleId() const override { return "sweep"; }
+
+private:
+    struct FoundHost {
+        uint32_t address;       // Host byte order
+        long rttUs;
+        int port;               // 0 for an echo reply
+    };
+
+    void startSweep();
+    void renderMenu(bool fullRedraw);
+    void renderResults(bool fullRedraw);
+    void updateStatusLine();
+    static std::string localNetwork();
+    static std::string formatHost(const FoundHost& host);
+
+    std::unique_ptr<IPSelector> m_ipSelector;
+    HostSweeper m_sweeper;
+    std::vector<int> m_tcpPorts;
+    std::vector<FoundHost> m_hosts;     // Sorted by address
+    bool m_showResults = false;
+    bool m_listChanged = false;
+    int m_scroll = 0;
+    std::string m_lastStatusText;
+    std::chrono::steady_clock::time_point m_statusDrawnAt;
+
+    SubnetSweepMenuState m_state{SubnetSweepMenuState::MENU_STATE_RANGE};
+    bool m_shouldExit{false};
+};
+
 /**
  * Network interfaces screen
  * Shows a list of all network interfaces and details
@@ -352,20 +488,17 @@ private:
     void renderOptions();
     void startServer();
     void stopServer();
-    bool isServerRunning() const;
-    std::string getIperf3Path();
+    bool isServerRunning();
     void getLocalIpAddress();
     void refreshSettings();
-    inline bool isAvahiAvailable() const {
-        return (system("which avahi-publish > /dev/null 2>&1") == 0);
-    };
     std::vector<std::string> m_options = {"Start", "Stop", "Back"};
     int m_selectedOption = 0;
     int m_port = 5201;             // Default port
     std::string m_localIp;         // Local IP address
-    pid_t m_serverPid = -1;        // PID of the iperf3 server process
-    std::thread m_serverThread;    // Thread for server operation
-    pid_t m_avahiPid = -1;  // PID for the Avahi announcement process
+    ThroughputEngine m_server;     // Answers iperf3 clients
+    std::string m_serviceType = Config::MDNS_IPERF3_SERVICE; // Announced over mDNS
+    std::string m_announcedName;   // Instance announced while the server runs, empty when none
+    std::string m_announcedType;
 };
 // Add these enum declarations:
 
@@ -389,17 +522,7 @@ enum class ThroughputClientState {
     SUBMENU_STATE_SERVER_IP,
     SUBMENU_STATE_AUTO_DISCOVER
 };
-struct UDPTestResult {
-    double bandwidth_mbps = 0.0;
-    double jitter_ms = 0.0;
-    int lost_packets = 0;
-    double lost_percent = 0.0;
-    int total_packets = 0;
-    bool valid = false;  // To indicate whether parsing was successful
-};
 
-// Add the function declaration in header file
-UDPTestResult parseUDPTestResults(const std::string& output);
 // Forward declare the IPSelector class if not already included
 class IPSelector;
 
@@ -435,7 +558,14 @@ private:
 
     // Test execution
     bool m_testInProgress;
-    pid_t m_testPid;
+    ThroughputEngine m_engine;                         // Runs the test against an iperf3 server
+    double m_liveBandwidth = 0.0;                      // Latest interval rate, Mbps
+    std::vector<double> m_intervalRates;               // Recent interval rates in Mbps, oldest first, one graph column each
+    ThroughputEngine::Interval m_lastInterval;         // Latest interval report
+    int m_liveRetransmits = 0;                         // Totals over the intervals so far
+    int64_t m_liveLost = 0;
+    uint64_t m_livePackets = 0;                        // UDP datagrams sent, or received when this end receives
+    std::string m_testRows[8];                         // Testing screen as drawn, rows are only redrawn on change
     int m_testResult;
     std::string m_testOutput;
     double m_bandwidth_result = 0.0;
@@ -446,7 +576,7 @@ private:
 
     // Auto-discovery
     bool m_discoveryInProgress;
-    pid_t m_discoveryPid;
+    std::string m_serviceType = Config::MDNS_IPERF3_SERVICE;       // Browsed for over mDNS
     std::vector<std::pair<std::string, int>> m_discoveredServers;  // IP and port pairs
     std::vector<std::string> m_discoveredServerNames;              // Service names
 
@@ -471,6 +601,8 @@ private:
     void updateStatusLine();
     void renderResultsScreen();
     void renderTestingScreen();
+    void drawTestProgress();
+    void drawTestRow(int row, const std::string& text);
     void showResultsAndWait();//int durationMs);
 
     // Action methods
@@ -478,19 +610,15 @@ private:
     void checkTestStatus();
     void startDiscovery();
     void checkDiscoveryStatus();
-    void parseDiscoveryResults();
-    void parseTestResults();
+    void addDiscoveredServer(const MulticastDns::Found& server);
+    void finishTestResults();
     void selectServer(int index);
 
     // Helper methods
-    std::string getIperf3Path() const;
-    bool isIperf3Available() const;
-    bool isAvahiAvailable() const;
     void refreshSettings();
     std::string getBandwidthString(int value) const;
     std::string formatBandwidth(double value) const;
     std::string normalizeIp(const std::string& ip);
-    UDPTestResult parseUDPTestResults(const std::string& output);
     void showResultsScreen();
 };
 
@@ -563,6 +691,7 @@ private:
     std::string m_itemsSource;  // Script to generate list items
     std::string m_itemsPath;    // Path parameter for the items source
     std::string m_itemsAction;  // Action template for dynamic items
+    bool m_useHelper = false;   // Run commands through the shared ScriptHelper
 
     ScreenCallback* m_callback = nullptr;
     // Flag to track if callback should be called when exiting
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "Subprocess.h"
+
+/**
+ * Long-lived bash co-process that runs configured command lines without a fresh
+ * interpreter per request. Requests are framed over its stdin ("REQ <id> <mode>\n"
+ * followed by the NUL terminated command); each one runs in a forked subshell as
+ * its own process group, and its stdout is streamed back between "<id> BEGIN <pgid>"
+ * and "\n<id> END <status>" markers. Simple invocations of bash scripts are sourced
+ * into that subshell, which saves the exec and interpreter startup; #!/bin/sh
+ * scripts are still exec'd, as bash would not run them with POSIX sh semantics.
+ * Callers fall back to a one-shot Subprocess whenever the helper is unavailable
+ * or busy with another request.
+ */
+class ScriptHelper {
+public:
+    static ScriptHelper& getInstance();
+
+    // Same contract as Subprocess::runShell/run; stderr can only be merged or discarded
+    Subprocess::Result runShell(const std::string& command);
+    Subprocess::Result runShell(const std::string& command, const Subprocess::Options& options);
+    Subprocess::Result run(const std::vector<std::string>& argv);
+    Subprocess::Result run(const std::vector<std::string>& argv, const Subprocess::Options& options);
+
+    // Stop the helper; it is started again on the next request
+    void shutdown();
+
+    // Single-quote an argument for a shell command line
+    static std::string quote(const std::string& arg);
+
+private:
+    ScriptHelper();
+    ~ScriptHelper();
+
+    ScriptHelper(const ScriptHelper&) = delete;
+    ScriptHelper& operator=(const ScriptHelper&) = delete;
+
+    // Caller holds m_mutex
+    bool ensureRunning();
+    void stopHelper();
+    // False if the request never started, so the caller may run it another way
+    bool execute(const std::string& command, const Subprocess::Options& options, Subprocess::Result& result);
+
+    std::mutex m_mutex;
+    Subprocess m_helper;
+    std::string m_session;                  // Random id prefix, keeps markers out of reach of command output
+    uint64_t m_nextId = 1;
+    bool m_unavailable = false;             // No bash on this system
+    std::chrono::steady_clock::time_point m_retryAfter;
+};
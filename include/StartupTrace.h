@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/**
+ * Records timestamps of the startup phases (device detection, config load,
+ * module init, first render) so time-to-first-frame can be measured
+ */
+class StartupTrace {
+public:
+    // Record a named startup milestone
+    static void mark(const std::string& phase);
+
+    // Milliseconds elapsed since the process started
+    static long elapsedMs();
+
+    // Log all recorded milestones with their offsets
+    static void report();
+
+private:
+    struct Mark {
+        std::string phase;
+        long processMs;   // Offset from process start
+        long bootMs;      // Offset from kernel boot (CLOCK_BOOTTIME)
+    };
+
+    static long bootTimeMs();
+
+    static std::vector<Mark> s_marks;
+    static const std::chrono::steady_clock::time_point s_origin;
+};
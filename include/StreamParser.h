@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <cstddef>
+
+/**
+ * Splits a byte stream into lines as it arrives, so child output can be handled
+ * line by line while the child is still running. Only the unfinished line is kept;
+ * lines longer than Config::STREAM_MAX_LINE_BYTES are truncated.
+ */
+class LineStreamParser {
+public:
+    using LineHandler = std::function<void(const std::string& line)>;
+
+    explicit LineStreamParser(LineHandler onLine);
+
+    void feed(const char* data, size_t size);
+    void feed(const std::string& data) { feed(data.data(), data.size()); }
+
+    // Deliver a last line that had no newline
+    void finish();
+
+private:
+    LineHandler m_onLine;
+    std::string m_line;
+    bool m_truncated = false;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <sys/types.h>
+#include "Config.h"
+
+/**
+ * Child process launched with posix_spawn, stdin on /dev/null (or a pipe when asked)
+ * and stdout/stderr captured through pipes; no shell is involved unless asked for.
+ * Exit is observed through a pidfd (waitpid polling on kernels without pidfd_open),
+ * and a timeout escalates from SIGTERM to SIGKILL. poll() never blocks by default,
+ * so screens can drive a child from update(); run() covers one-shot commands.
+ */
+class Subprocess {
+public:
+    using OutputHandler = std::function<void(const char* data, size_t size)>;
+
+    struct Options {
+        bool captureStdout = true;          // Otherwise stdout goes to /dev/null
+        bool captureStderr = false;         // Otherwise stderr goes to /dev/null (or into stdout, see below)
+        bool mergeStderr = false;           // Send stderr into the stdout pipe
+        bool pipeStdin = false;             // Give the child a stdin pipe fed by writeInput()
+        int timeoutMs = 0;                  // Terminate the child after this long, 0 for no limit
+        int killGraceMs = Config::SUBPROCESS_KILL_GRACE_MS; // SIGTERM to SIGKILL escalation delay
+        const char* traceName = "subprocess"; // Async trace span name, must be a string literal
+        OutputHandler outputHandler;        // Gets stdout as it arrives, instead of collecting it
+    };
+
+    struct Result {
+        int exitCode = -1;                  // Exit status, -1 if the child didn't exit normally
+        bool timedOut = false;
+        std::string output;                 // Captured stdout
+        std::string errors;                 // Captured stderr
+    };
+
+    Subprocess() = default;
+    ~Subprocess();
+
+    Subprocess(const Subprocess&) = delete;
+    Subprocess& operator=(const Subprocess&) = delete;
+
+    // Launch argv[0] (searched in PATH when it has no '/'); false if the spawn failed
+    bool start(const std::vector<std::string>& argv);
+    bool start(const std::vector<std::string>& argv, const Options& options);
+
+    // Launch a command line through /bin/sh -c
+    bool startShell(const std::string& command);
+    bool startShell(const std::string& command, const Options& options);
+
+    // Collect output, apply the timeout and reap the child, waiting up to waitMs
+    // for something to happen; returns true while the child is still running
+    bool poll(int waitMs = 0);
+
+    // Block until the child has exited
+    void wait();
+
+    // SIGTERM the child's process group, SIGKILL after the grace period, and reap it;
+    // blocks for up to killGraceMs, the destructor instead leaves that to a reaper thread
+    void terminate();
+
+    bool isRunning() const { return m_pid > 0; }
+    pid_t getPid() const { return m_pid; }
+    int getExitCode() const { return m_exitCode; }
+    bool timedOut() const { return m_timedOut; }
+    const std::string& getOutput() const { return m_output; }
+    const std::string& getErrors() const { return m_errors; }
+
+    // Hand over the stdout collected so far, for long-lived children
+    std::string takeOutput();
+
+    // Write to the child's stdin pipe (pipeStdin); false once the child stopped reading
+    bool writeInput(const std::string& data);
+    void closeInput();
+
+    // Whether an executable of that name is found in PATH (no shell or "which" involved)
+    static bool isInPath(const std::string& name);
+
+    // Run to completion and return what the child produced
+    static Result run(const std::vector<std::string>& argv);
+    static Result run(const std::vector<std::string>& argv, const Options& options);
+    static Result runShell(const std::string& command);
+    static Result runShell(const std::string& command, const Options& options);
+
+private:
+    bool readPipe(int& fd, std::string& buffer, const OutputHandler* handler = nullptr);
+    void reap(int status);
+    void closeFds();
+    void signalGroup(int signal);
+
+    pid_t m_pid = -1;
+    int m_stdoutFd = -1;
+    int m_stderrFd = -1;
+    int m_stdinFd = -1;
+    int m_pidFd = -1;
+    Options m_options;
+    std::chrono::steady_clock::time_point m_startTime;
+    std::chrono::steady_clock::time_point m_termSentAt;
+    bool m_termSent = false;
+    bool m_killSent = false;
+    int m_exitCode = -1;
+    bool m_timedOut = false;
+    std::string m_output;
+    std::string m_errors;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <netinet/in.h>
+#include "Config.h"
+
+/**
+ * TCP and UDP throughput tests without the iperf3 binary. The engine speaks
+ * iperf3's control protocol, so the client runs against any stock "iperf3 -s"
+ * and the server answers stock iperf3 clients. A test runs on a worker thread
+ * of its own: TCP blocks go out with sendfile() from a memfd, UDP datagrams in
+ * sendmmsg()/recvmmsg() batches with kernel receive timestamps for the jitter.
+ * Every interval's totals are queued for poll(), which a screen drains from
+ * update(). A server's queue starts over with each test and is capped, so
+ * nothing piles up when nobody drains it.
+ */
+class ThroughputEngine {
+public:
+    enum class Protocol { TCP, UDP };
+
+    struct Options {
+        Protocol protocol = Protocol::TCP;
+        int durationSec = 10;
+        uint64_t bitrate = 0;       // Bits/s per stream, 0 is unlimited for TCP and Config::THROUGHPUT_UDP_BITRATE for UDP
+        int parallel = 1;
+        bool reverse = false;       // Server sends, client receives
+        int blockSize = 0;          // Bytes per write or datagram, 0 for the protocol's default
+        const char* traceName = "throughput"; // Async trace span name, must be a string literal
+    };
+
+    // Totals of all streams over one reporting interval, as this end saw them
+    struct Interval {
+        double startSec = 0;        // Since the test began
+        double endSec = 0;
+        uint64_t bytes = 0;
+        double bitsPerSecond = 0;
+        int retransmits = -1;       // TCP sender, -1 when this end receives
+        double jitterMs = -1;       // UDP receiver, -1 when this end sends
+        int64_t lostPackets = -1;   // UDP receiver
+        uint64_t packets = 0;       // UDP datagrams sent or received
+    };
+
+    // Both ends' view of the whole test, put together from the exchanged results
+    struct Result {
+        bool valid = false;
+        double sentBitsPerSecond = 0;
+        double receivedBitsPerSecond = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        int retransmits = -1;       // TCP, -1 when the sender couldn't count them
+        double jitterMs = 0;        // UDP
+        int64_t lostPackets = 0;    // UDP
+        uint64_t packets = 0;       // UDP datagrams sent
+        double lostPercent = 0;     // UDP
+    };
+
+    ThroughputEngine() = default;
+    ~ThroughputEngine();
+
+    ThroughputEngine(const ThroughputEngine&) = delete;
+    ThroughputEngine& operator=(const ThroughputEngine&) = delete;
+
+    // Runs one test against server:port; false if the worker couldn't be started
+    bool startClient(const std::string& server, int port);
+    bool startClient(const std::string& server, int port, const Options& options);
+
+    // Serves one client at a time until stop(), turning others away as iperf3 does
+    bool startServer(int port);
+
+    void stop();
+
+    // Moves the intervals reported since the last call into intervals; false once the run is over
+    bool poll(std::vector<Interval>& intervals);
+
+    bool isRunning() const { return m_running; }
+    Result getResult() const;
+    std::string getError() const;       // Why the run failed, empty on success
+    std::string getPeer() const;        // Server: address of the client being or last served
+
+private:
+    struct Stream {
+        int fd = -1;
+        int id = 0;
+        bool sender = false;
+        uint64_t bytes = 0;
+        uint64_t intervalBytes = 0;
+        uint64_t packets = 0;           // UDP: sent, or highest sequence number received
+        uint64_t intervalPackets = 0;
+        int64_t lost = 0;               // UDP receiver: gaps in the sequence, less late arrivals
+        int64_t intervalLost = 0;
+        double jitter = 0;              // UDP receiver, seconds, smoothed as RFC 1889
+        double lastTransit = 0;
+        bool haveTransit = false;
+        uint32_t retransmits = 0;       // TCP sender, kernel total at the last interval
+        uint32_t retransmitsAtStart = 0;
+        bool active = true;             // Still in the epoll set
+        bool watchingOutput = false;    // Sender: registered for EPOLLOUT, off while the rate holds it back
+    };
+
+    // What the peer reported for one of its streams
+    struct PeerStream {
+        int id = 0;
+        uint64_t bytes = 0;
+        int retransmits = -1;
+        double jitter = 0;
+        int64_t errors = 0;
+        uint64_t packets = 0;
+        double seconds = 0;
+    };
+
+    struct Session {
+        int control = -1;
+        std::string cookie;
+        Options options;
+        bool sending = false;           // This end sends the data
+        bool counters64 = false;        // UDP sequence numbers are 64 bits wide
+        uint32_t socketBuffer = 0;      // SO_SNDBUF/SO_RCVBUF requested by the client, 0 leaves them
+        std::vector<Stream> streams;
+        std::vector<PeerStream> peer;
+        std::chrono::steady_clock::time_point startedAt;
+        double seconds = 0;             // Length of the data phase
+        double cpuUser = 0;
+        double cpuSystem = 0;
+    };
+
+    class Buffers;
+
+    void runClient(std::string server, int port, Options options);
+    void runServer(int listener, int port);
+    bool clientSession(Session& session, const struct sockaddr_in& to);
+    bool serverSession(Session& session, int listener, int port);
+    bool connectStreams(Session& session, const struct sockaddr_in& to);
+    bool acceptStreams(Session& session, int listener, int port);
+    bool runTest(Session& session, bool client, int listener);
+    bool sendStream(Session& session, Stream& stream, Buffers& buffers, double elapsed);
+    bool receiveStream(Session& session, Stream& stream, Buffers& buffers);
+    void reportInterval(Session& session, double startSec, double endSec);
+    void denyClient(int listener);
+    void sendServerError(int fd, int code);
+    std::string encodeResults(const Session& session) const;
+    bool decodeResults(Session& session, const std::string& text);
+    void finishClient(const Session& session);
+    void closeSession(Session& session);
+
+    bool readFully(int fd, void* data, size_t size, int timeoutMs);
+    bool writeFully(int fd, const void* data, size_t size, int timeoutMs);
+    bool readState(int fd, int8_t& state, int timeoutMs);
+    bool writeState(int fd, int8_t state);
+    bool readJson(int fd, std::string& text);
+    bool writeJson(int fd, const std::string& text);
+    bool waitFor(int fd, short events, int timeoutMs);
+    int connectTo(const struct sockaddr_in& to, int type);
+    void fail(const std::string& error);
+    void reset();
+    void finishRun();
+    bool stopping() const { return m_stopRequested; }
+
+    std::thread m_worker;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stopRequested{false};
+    int m_wakeFd = -1;                  // eventfd that cuts the worker's waits short on stop()
+    uint64_t m_traceId = 0;
+    const char* m_traceName = "throughput";
+
+    mutable std::mutex m_mutex;         // Guards everything below
+    std::vector<Interval> m_intervals;
+    Result m_result;
+    std::string m_error;
+    std::string m_peer;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include "Config.h"
+
+/**
+ * Lightweight always-on event tracing
+ * Spans and instant events are recorded into a fixed ring buffer per thread
+ * (no locks or allocation on the recording path; an exited thread's buffer is
+ * reused by the next one, at most Config::TRACE_MAX_THREAD_BUFFERS exist) and can be exported on
+ * demand, e.g. via SIGUSR1, as Chrome trace JSON for chrome://tracing or Perfetto
+ */
+class TraceRecorder {
+public:
+    // Event names and categories must be string literals (stored by pointer);
+    // the optional detail text is copied and truncated
+    static void complete(const char* category, const char* name, uint64_t startNs, uint64_t endNs,
+                         const char* detail = nullptr);
+    static void instant(const char* category, const char* name, const char* detail = nullptr);
+
+    // Spans that start and end in different places (e.g. child processes), matched by id
+    static void asyncBegin(const char* category, const char* name, uint64_t id, const char* detail = nullptr);
+    static void asyncEnd(const char* category, const char* name, uint64_t id);
+
+    // Monotonic timestamp in nanoseconds
+    static uint64_t nowNs();
+
+    // Enable or disable recording (enabled by default)
+    static void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Write all buffered events as Chrome trace JSON
+    static bool exportChromeJson(const std::string& path);
+
+    // Request an export from a signal handler (async-signal-safe): wakes the export
+    // thread, which otherwise sleeps without a timeout
+    static void requestExport();
+    // alsoExport, if set, runs on the export thread after each trace export
+    static void startExportThread(const std::string& path, std::function<void()> alsoExport = nullptr);
+    static void stopExportThread();
+
+private:
+    static void record(char phase, const char* category, const char* name, uint64_t startNs,
+                       uint64_t durationNs, uint64_t id, const char* detail);
+
+    static std::atomic<bool> s_enabled;
+};
+
+/**
+ * Records a complete span from construction to destruction
+ */
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name, const char* detail = nullptr)
+        : m_category(category), m_name(name),
+          m_startNs(TraceRecorder::isEnabled() ? TraceRecorder::nowNs() : 0) {
+        m_detail[0] = '\0';
+        if (detail && m_startNs != 0) {
+            strncpy(m_detail, detail, sizeof(m_detail) - 1);
+            m_detail[sizeof(m_detail) - 1] = '\0';
+        }
+    }
+
+    TraceScope(const char* category, const char* name, const std::string& detail)
+        : TraceScope(category, name, detail.c_str()) {}
+
+    ~TraceScope() {
+        if (m_startNs != 0) {
+            TraceRecorder::complete(m_category, m_name, m_startNs, TraceRecorder::nowNs(), m_detail);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_category;
+    const char* m_name;
+    char m_detail[Config::TRACE_DETAIL_LENGTH];
+    uint64_t m_startNs;
+};
+
+#define MICROPANEL_TRACE_CONCAT2(a, b) a##b
+#define MICROPANEL_TRACE_CONCAT(a, b) MICROPANEL_TRACE_CONCAT2(a, b)
+// TRACE_SCOPE("display", "sendCommand") or TRACE_SCOPE("module", "run", moduleId)
+#define TRACE_SCOPE(...) TraceScope MICROPANEL_TRACE_CONCAT(traceScope_, __LINE__)(__VA_ARGS__)
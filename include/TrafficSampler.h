@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "Config.h"
+
+/**
+ * Per-interface traffic counters and rates. Every sample is a single pread()
+ * of /proc/net/dev on a descriptor kept open between samples, so the cost is
+ * one syscall and a linear parse however many interfaces there are. Each
+ * interface keeps a short ring of past rates for sparklines.
+ */
+class TrafficSampler {
+public:
+    static constexpr int HISTORY = Config::TRAFFIC_HISTORY;
+
+    struct Counters {
+        uint64_t rxBytes = 0;
+        uint64_t rxPackets = 0;
+        uint64_t rxErrors = 0;
+        uint64_t rxDrops = 0;
+        uint64_t txBytes = 0;
+        uint64_t txPackets = 0;
+        uint64_t txErrors = 0;
+        uint64_t txDrops = 0;
+    };
+
+    struct Rates {
+        double rxBitsPerSec = 0;
+        double txBitsPerSec = 0;
+        double rxPacketsPerSec = 0;
+        double txPacketsPerSec = 0;
+    };
+
+    // Fixed size ring of rates, oldest first through at()
+    class History {
+    public:
+        void push(float value);
+        int size() const { return m_count; }
+        float at(int index) const { return m_values[(m_next - m_count + index + HISTORY) % HISTORY]; }
+        float peak() const;
+
+    private:
+        float m_values[HISTORY] = {};
+        int m_next = 0;
+        int m_count = 0;
+    };
+
+    struct Interface {
+        std::string name;
+        Counters counters;          // Totals as of the last sample
+        Rates rates;                // Over the last interval, zero after the first sample
+        History rxHistory;          // Bits per second
+        History txHistory;
+    };
+
+    TrafficSampler() = default;
+    ~TrafficSampler();
+
+    TrafficSampler(const TrafficSampler&) = delete;
+    TrafficSampler& operator=(const TrafficSampler&) = delete;
+
+    bool open();
+    void close();
+
+    // Read all counters and derive rates from the previous sample
+    bool sample();
+
+    // In /proc/net/dev order; interfaces that went away are dropped
+    const std::vector<Interface>& getInterfaces() const { return m_interfaces; }
+
+private:
+    bool readStats();
+
+    int m_fd = -1;
+    std::vector<char> m_buffer;
+    std::vector<Interface> m_interfaces;
+    std::chrono::steady_clock::time_point m_sampledAt;
+    bool m_sampled = false;
+};
@@ -142,18 +142,22 @@ if [ "$MODE" = "dhcp" ]; then
 
         # Restart networking
         # Try different methods for different buildroot configurations
-        if [ -f /etc/init.d/S40network ]; then
-            /etc/init.d/S40network restart
-        elif [ -f /etc/init.d/network ]; then
-            /etc/init.d/network restart
-        elif [ -x /sbin/ifdown ] && [ -x /sbin/ifup ]; then
-            ifdown "$INTERFACE" 2>/dev/null
-            ifup "$INTERFACE"
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            if [ -f /etc/init.d/S40network ]; then
+                /etc/init.d/S40network restart
+            elif [ -f /etc/init.d/network ]; then
+                /etc/init.d/network restart
+            elif [ -x /sbin/ifdown ] && [ -x /sbin/ifup ]; then
+                ifdown "$INTERFACE" 2>/dev/null
+                ifup "$INTERFACE"
+            else
+                # Direct interface management as last resort
+                ip link set "$INTERFACE" down
+                ip link set "$INTERFACE" up
+                udhcpc -i "$INTERFACE" -n
+            fi
         else
-            # Direct interface management as last resort
-            ip link set "$INTERFACE" down
-            ip link set "$INTERFACE" up
-            udhcpc -i "$INTERFACE" -n
+            log_verbose "Persist only, skipping networking restart"
         fi
     else
         log_verbose "[DRY-RUN] Would configure $INTERFACE for DHCP in interfaces file"
@@ -219,20 +223,24 @@ elif [ "$MODE" = "static" ]; then
 
         # Restart networking
         # Try different methods for different buildroot configurations
-        if [ -f /etc/init.d/S40network ]; then
-            /etc/init.d/S40network restart
-        elif [ -f /etc/init.d/network ]; then
-            /etc/init.d/network restart
-        elif [ -x /sbin/ifdown ] && [ -x /sbin/ifup ]; then
-            ifdown "$INTERFACE" 2>/dev/null
-            ifup "$INTERFACE"
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            if [ -f /etc/init.d/S40network ]; then
+                /etc/init.d/S40network restart
+            elif [ -f /etc/init.d/network ]; then
+                /etc/init.d/network restart
+            elif [ -x /sbin/ifdown ] && [ -x /sbin/ifup ]; then
+                ifdown "$INTERFACE" 2>/dev/null
+                ifup "$INTERFACE"
+            else
+                # Direct interface management as last resort
+                ip link set "$INTERFACE" down
+                ip addr flush dev "$INTERFACE"
+                ip addr add "$CLEAN_IP/$CIDR" dev "$INTERFACE"
+                ip link set "$INTERFACE" up
+                ip route add default via "$CLEAN_GATEWAY" dev "$INTERFACE"
+            fi
         else
-            # Direct interface management as last resort
-            ip link set "$INTERFACE" down
-            ip addr flush dev "$INTERFACE"
-            ip addr add "$CLEAN_IP/$CIDR" dev "$INTERFACE"
-            ip link set "$INTERFACE" up
-            ip route add default via "$CLEAN_GATEWAY" dev "$INTERFACE"
+            log_verbose "Persist only, skipping networking restart"
         fi
     else
         log_verbose "[DRY-RUN] Would configure $INTERFACE for static IP in interfaces file"
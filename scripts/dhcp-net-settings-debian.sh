@@ -183,7 +183,11 @@ network:
     $INTERFACE:
       dhcp4: true
 EOF
-            netplan apply
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                netplan apply
+            else
+                log_verbose "Persist only, skipping netplan apply"
+            fi
         else
             log_verbose "[DRY-RUN] Would create Netplan config for DHCP on $INTERFACE"
             log_verbose "[DRY-RUN] Would apply netplan configuration"
@@ -244,7 +248,11 @@ network:
       gateway4: $CLEAN_GATEWAY
 $(echo -e "$DNS_YAML")
 EOF
-            netplan apply
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                netplan apply
+            else
+                log_verbose "Persist only, skipping netplan apply"
+            fi
         else
             log_verbose "[DRY-RUN] Would create Netplan config for static IP on $INTERFACE"
             log_verbose "[DRY-RUN]   IP: $CLEAN_IP/$CIDR"
@@ -269,10 +277,14 @@ else
             echo "iface $INTERFACE inet dhcp" >> "$INTERFACES_FILE"
 
             # Restart networking
-            if systemctl is-active networking > /dev/null 2>&1; then
-                systemctl restart networking
-            elif [ -f /etc/init.d/networking ]; then
-                /etc/init.d/networking restart
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                if systemctl is-active networking > /dev/null 2>&1; then
+                    systemctl restart networking
+                elif [ -f /etc/init.d/networking ]; then
+                    /etc/init.d/networking restart
+                fi
+            else
+                log_verbose "Persist only, skipping networking restart"
             fi
         else
             log_verbose "[DRY-RUN] Would configure $INTERFACE for DHCP in interfaces file"
@@ -326,10 +338,14 @@ else
             fi
 
             # Restart networking
-            if systemctl is-active networking > /dev/null 2>&1; then
-                systemctl restart networking
-            elif [ -f /etc/init.d/networking ]; then
-                /etc/init.d/networking restart
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                if systemctl is-active networking > /dev/null 2>&1; then
+                    systemctl restart networking
+                elif [ -f /etc/init.d/networking ]; then
+                    /etc/init.d/networking restart
+                fi
+            else
+                log_verbose "Persist only, skipping networking restart"
             fi
         else
             log_verbose "[DRY-RUN] Would configure $INTERFACE for static IP in interfaces file"
@@ -74,7 +74,11 @@ if [ "$MODE" = "dhcp" ]; then
     if [ "$DRY_RUN" -eq 0 ]; then
         uci set network."$INTERFACE".proto=dhcp
         uci commit network
-        /etc/init.d/network restart
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            /etc/init.d/network restart
+        else
+            log_verbose "Persist only, skipping network restart"
+        fi
     else
         log_verbose "[DRY-RUN] Would set $INTERFACE to DHCP mode"
         log_verbose "[DRY-RUN] Would commit changes and restart network"
@@ -122,7 +126,11 @@ elif [ "$MODE" = "static" ]; then
         fi
 
         uci commit network
-        /etc/init.d/network restart
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            /etc/init.d/network restart
+        else
+            log_verbose "Persist only, skipping network restart"
+        fi
     else
         log_verbose "[DRY-RUN] Would set $INTERFACE to static mode with:"
         log_verbose "[DRY-RUN]   IP: $CLEAN_IP"
@@ -193,10 +193,14 @@ set_dhcpcd_dhcp() {
         sed -i "/^interface $INTERFACE$/,/^[^[:space:]]/d" "$DHCPCD_CONF"
         
         # Restart dhcpcd
-        if systemctl is-active dhcpcd >/dev/null 2>&1; then
-            systemctl restart dhcpcd
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            if systemctl is-active dhcpcd >/dev/null 2>&1; then
+                systemctl restart dhcpcd
+            else
+                service dhcpcd restart 2>/dev/null || /etc/init.d/dhcpcd restart 2>/dev/null
+            fi
         else
-            service dhcpcd restart 2>/dev/null || /etc/init.d/dhcpcd restart 2>/dev/null
+            log_verbose "Persist only, skipping dhcpcd restart"
         fi
     else
         log_verbose "[DRY-RUN] Would remove static configuration for $INTERFACE"
@@ -234,10 +238,14 @@ set_dhcpcd_static() {
         fi
 
         # Restart dhcpcd
-        if systemctl is-active dhcpcd >/dev/null 2>&1; then
-            systemctl restart dhcpcd
+        if [ "$PERSIST_ONLY" -eq 0 ]; then
+            if systemctl is-active dhcpcd >/dev/null 2>&1; then
+                systemctl restart dhcpcd
+            else
+                service dhcpcd restart 2>/dev/null || /etc/init.d/dhcpcd restart 2>/dev/null
+            fi
         else
-            service dhcpcd restart 2>/dev/null || /etc/init.d/dhcpcd restart 2>/dev/null
+            log_verbose "Persist only, skipping dhcpcd restart"
         fi
     else
         log_verbose "[DRY-RUN] Would configure $INTERFACE for static IP"
@@ -265,11 +273,15 @@ set_nm_dhcp() {
             nmcli connection modify "$CONNECTION" ipv4.addresses "" ipv4.gateway "" ipv4.dns ""
             
             # Activate the connection
-            nmcli connection up "$CONNECTION"
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                nmcli connection up "$CONNECTION"
+            fi
         else
             # Create new DHCP connection
             nmcli connection add type ethernet con-name "$INTERFACE" ifname "$INTERFACE" ipv4.method auto
-            nmcli connection up "$INTERFACE"
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                nmcli connection up "$INTERFACE"
+            fi
         fi
     else
         log_verbose "[DRY-RUN] Would configure NetworkManager connection for $INTERFACE to use DHCP"
@@ -315,7 +327,9 @@ set_nm_static() {
             fi
             
             # Activate the connection
-            nmcli connection up "$CONNECTION"
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                nmcli connection up "$CONNECTION"
+            fi
         else
             # Create new static IP connection
             nmcli connection add type ethernet con-name "$INTERFACE" ifname "$INTERFACE" \
@@ -327,7 +341,9 @@ set_nm_static() {
             fi
             
             # Activate the connection
-            nmcli connection up "$INTERFACE"
+            if [ "$PERSIST_ONLY" -eq 0 ]; then
+                nmcli connection up "$INTERFACE"
+            fi
         fi
     else
         log_verbose "[DRY-RUN] Would configure NetworkManager connection for $INTERFACE with static IP"
@@ -4,12 +4,14 @@
 #   Get current settings:  ./dhcp-net-settings.sh --interface=eth0 --os=debian
 #   Set to DHCP:          ./dhcp-net-settings.sh --interface=eth0 --os=debian --mode=dhcp
 #   Set to static:        ./dhcp-net-settings.sh --interface=eth0 --os=debian --mode=static --ip=192.168.1.2 --gateway=192.168.1.1 --netmask=255.255.255.0
+#   Save only:            add --persist-only to write the configuration without restarting networking
 
 # Default values
 SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
 BACKUP_PATH="/tmp/net-settings-bkup"
 VERBOSE=0
 DRY_RUN=0
+PERSIST_ONLY=0
 RESULT="ERROR"
 MESSAGE=""
 
@@ -134,6 +136,9 @@ parse_args() {
             --dry-run)
                 DRY_RUN=1
                 ;;
+            --persist-only)
+                PERSIST_ONLY=1
+                ;;
             *)
                 error_exit "Unknown argument: $arg"
                 ;;
@@ -251,6 +256,7 @@ main() {
     export BACKUP_PATH
     export VERBOSE
     export DRY_RUN
+    export PERSIST_ONLY
 
     # Call the OS-specific script
     "$OS_SCRIPT"
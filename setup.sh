@@ -78,10 +78,10 @@ log "Using config file: $CONFIG_FILE" force
 printf "Installing dependencies ................................ "
 if [ $VERBOSE -eq 1 ]; then
     DEBIAN_FRONTEND=noninteractive apt-get update
-    DEBIAN_FRONTEND=noninteractive apt-get install -y cmake libudev-dev nlohmann-json3-dev iperf3 libcurl4-openssl-dev avahi-daemon avahi-utils libraspberrypi-bin fbi mpv
+    DEBIAN_FRONTEND=noninteractive apt-get install -y cmake libudev-dev nlohmann-json3-dev libcurl4-openssl-dev avahi-daemon libraspberrypi-bin fbi mpv
 else
     DEBIAN_FRONTEND=noninteractive apt-get update < /dev/null > /dev/null
-    DEBIAN_FRONTEND=noninteractive apt-get install -y -qq cmake libudev-dev nlohmann-json3-dev iperf3 libcurl4-openssl-dev avahi-daemon avahi-utils libraspberrypi-bin fbi mpv < /dev/null > /dev/null
+    DEBIAN_FRONTEND=noninteractive apt-get install -y -qq cmake libudev-dev nlohmann-json3-dev libcurl4-openssl-dev avahi-daemon libraspberrypi-bin fbi mpv < /dev/null > /dev/null
 fi
 test 0 -eq $? && echo "[OK]" || { echo "[FAIL]"; exit 1; }
 
@@ -156,7 +156,7 @@ fi
 
 test 0 -eq $? && echo "[OK]" || { echo "[FAIL]"; exit 1; }
 
-#following netsocket buffer increase is necessary for iperf3 based udp test
+#following netsocket buffer increase is necessary for the udp throughput test
 printf "Updating sysctl file.................................... "
 update_sysctl "net.core.rmem_max" "26214400"
 update_sysctl "net.core.wmem_max" "26214400"
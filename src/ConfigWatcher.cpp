@@ -0,0 +1,97 @@
+#include "ConfigWatcher.h"
+#include "Config.h"
+#include "Logger.h"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+ConfigWatcher::ConfigWatcher(const std::string& filePath)
+{
+    size_t lastSlash = filePath.find_last_of('/');
+    if (lastSlash == std::string::npos) {
+        m_directory = ".";
+        m_fileName = filePath;
+    } else {
+        m_directory = lastSlash == 0 ? "/" : filePath.substr(0, lastSlash);
+        m_fileName = filePath.substr(lastSlash + 1);
+    }
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+bool ConfigWatcher::start()
+{
+    if (m_fd >= 0) {
+        return true;
+    }
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        LOG_ERROR("Failed to initialize inotify: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Writes in place end with IN_CLOSE_WRITE, atomic replacements with IN_MOVED_TO
+    m_wd = inotify_add_watch(m_fd, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (m_wd < 0) {
+        LOG_ERROR("Failed to watch config directory " + m_directory + ": " + strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    LOG_DEBUG("Watching config file for changes: " + m_directory + "/" + m_fileName);
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    if (m_fd >= 0) {
+        if (m_wd >= 0) {
+            inotify_rm_watch(m_fd, m_wd);
+            m_wd = -1;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_changePending = false;
+}
+
+bool ConfigWatcher::checkForChanges()
+{
+    if (m_fd < 0) {
+        return false;
+    }
+
+    // Drain all queued events and look for our file name
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t len;
+    while ((len = read(m_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + len; ) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            if (event->len > 0 && m_fileName == event->name) {
+                m_changePending = true;
+                m_lastChange = std::chrono::steady_clock::now();
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    if (!m_changePending) {
+        return false;
+    }
+
+    // Wait for the writer to settle so a burst of saves triggers a single reload
+    auto quietMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - m_lastChange).count();
+    if (quietMs < Config::CONFIG_RELOAD_SETTLE_MS) {
+        return false;
+    }
+
+    m_changePending = false;
+    return true;
+}
@@ -0,0 +1,411 @@
+#include "HostSweeper.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll tag of the ICMP socket; connects are tagged with their slot
+const uint64_t s_icmpTag = UINT64_MAX;
+
+std::atomic<uint64_t> s_traceIds{0};
+
+std::string formatAddress(uint32_t address) {
+    struct in_addr in;
+    in.s_addr = htonl(address);
+    return inet_ntoa(in);
+}
+
+long elapsedUs(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point now) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(now - since).count());
+}
+
+} // namespace
+
+HostSweeper::~HostSweeper() {
+    stop();
+}
+
+bool HostSweeper::start(uint32_t first, uint32_t last) {
+    return start(first, last, Options());
+}
+
+bool HostSweeper::start(uint32_t first, uint32_t last, const Options& options) {
+    stop();
+
+    if (last < first || last - first >= static_cast<uint32_t>(Config::SWEEP_MAX_HOSTS)) {
+        LOG_WARNING("HostSweeper: invalid range " + formatAddress(first) + " - " + formatAddress(last));
+        return false;
+    }
+
+    m_options = options;
+    m_options.ratePerSec = std::max(m_options.ratePerSec, 1);
+    m_options.timeoutMs = std::max(m_options.timeoutMs, 1);
+    m_options.attempts = std::max(m_options.attempts, 1);
+    m_options.maxHosts = std::max(m_options.maxHosts, 1);
+    auto& ports = m_options.tcpPorts;
+    ports.erase(std::remove_if(ports.begin(), ports.end(), [](int port) { return port <= 0 || port > 65535; }),
+                ports.end());
+    if (ports.size() > static_cast<size_t>(Config::SWEEP_MAX_TCP_PORTS)) {
+        ports.resize(Config::SWEEP_MAX_TCP_PORTS);
+    }
+
+    // Without an ICMP socket the connects alone can still find hosts
+    if (!m_socket.open() && ports.empty()) {
+        return false;
+    }
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        LOG_ERROR("HostSweeper: epoll_create1 failed: " + std::string(strerror(errno)));
+        m_socket.close();
+        return false;
+    }
+    if (m_socket.isOpen()) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = s_icmpTag;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_socket.getFd(), &event);
+    }
+
+    m_first = first;
+    m_hosts.assign(static_cast<size_t>(last - first) + 1, HostEntry());
+    m_probing.clear();
+    m_connects.clear();
+    m_freeConnects.clear();
+    m_nextHost = 0;
+    m_done = 0;
+    m_found = 0;
+    // Start with a full bucket
+    m_refilledAt = std::chrono::steady_clock::now();
+    m_tokens = std::numeric_limits<double>::max();
+    refill(m_refilledAt);
+    m_running = true;
+
+    std::string range = formatAddress(first) + "-" + formatAddress(last);
+    LOG_INFO("HostSweeper: sweeping " + range + (ports.empty() ? "" : " with TCP connects"));
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    TraceRecorder::asyncBegin("net", m_options.traceName, m_traceId, range.c_str());
+    return true;
+}
+
+void HostSweeper::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    for (size_t slot = 0; slot < m_connects.size(); slot++) {
+        if (m_connects[slot].fd >= 0) {
+            closeConnect(slot);
+        }
+    }
+    m_probing.clear();
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+    m_socket.close();
+    TraceRecorder::asyncEnd("net", m_options.traceName, m_traceId);
+}
+
+bool HostSweeper::poll(int budgetMs) {
+    if (!m_running) {
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+    struct epoll_event events[64];
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        expire(now);
+        refill(now);
+        launch(now);
+        if (m_done == getTotal()) {
+            LOG_INFO("HostSweeper: " + std::to_string(m_found) + " of " + std::to_string(getTotal()) +
+                         " hosts up");
+            stop();
+            return false;
+        }
+
+        // Sleep no longer than until the next token, expiry or the end of the budget
+        auto deadline = std::min(end, nextDeadline(now));
+        long remainingUs = deadline > now ? elapsedUs(now, deadline) : 0;
+        int count = epoll_wait(m_epollFd, events, 64, static_cast<int>((remainingUs + 999) / 1000));
+
+        now = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u64 != s_icmpTag) {
+                finishConnect(static_cast<size_t>(events[i].data.u64), now);
+                continue;
+            }
+            IcmpSocket::EchoReply echo;
+            while (m_socket.receive(echo)) {
+                uint32_t address = ntohl(echo.from.s_addr);
+                if (address >= m_first && address - m_first < m_hosts.size()) {
+                    hostUp(address - m_first, echo.rttUs, 0);
+                }
+            }
+        }
+
+        if (now >= end) {
+            return true;
+        }
+    }
+}
+
+void HostSweeper::refill(std::chrono::steady_clock::time_point now) {
+    // Up to a tenth of a second's worth can be spent at once, never less than one host's probes
+    double burst = std::max(m_options.ratePerSec / 10.0, 1.0 + m_options.tcpPorts.size());
+    m_tokens = std::min(burst, m_tokens + elapsedUs(m_refilledAt, now) * m_options.ratePerSec / 1e6);
+    m_refilledAt = now;
+}
+
+void HostSweeper::launch(std::chrono::steady_clock::time_point now) {
+    // Second echoes go out before new hosts are started
+    if (m_socket.isOpen()) {
+        std::vector<uint32_t> probing = m_probing;
+        for (uint32_t index : probing) {
+            HostEntry& host = m_hosts[index];
+            if (m_tokens < 1.0) {
+                return;
+            }
+            if (host.state == HostState::PROBING && !host.echoPending &&
+                host.echoesSent < m_options.attempts) {
+                sendEcho(index, now);
+                settle(index);
+            }
+        }
+    }
+
+    size_t ports = m_options.tcpPorts.size();
+    double cost = (m_socket.isOpen() ? 1.0 : 0.0) + ports;
+    while (m_nextHost < m_hosts.size() && m_probing.size() < static_cast<size_t>(m_options.maxHosts) &&
+           m_tokens >= cost &&
+           m_connects.size() - m_freeConnects.size() + ports <= static_cast<size_t>(Config::SWEEP_MAX_CONNECTS)) {
+        uint32_t index = static_cast<uint32_t>(m_nextHost++);
+        m_hosts[index].state = HostState::PROBING;
+        m_probing.push_back(index);
+
+        if (m_socket.isOpen()) {
+            sendEcho(index, now);
+        }
+        for (int port : m_options.tcpPorts) {
+            // An immediate answer ends the host's probing
+            if (m_hosts[index].state != HostState::PROBING) {
+                break;
+            }
+            startConnect(index, port, now);
+        }
+        settle(index);
+    }
+}
+
+bool HostSweeper::sendEcho(uint32_t index, std::chrono::steady_clock::time_point now) {
+    HostEntry& host = m_hosts[index];
+    m_tokens -= 1.0;
+    host.echoesSent++;
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(m_first + index);
+    if (!m_socket.sendEcho(to, static_cast<uint16_t>(index), IcmpSocket::MIN_PAYLOAD)) {
+        return false;
+    }
+    host.echoPending = true;
+    host.echoSentAt = now;
+    return true;
+}
+
+bool HostSweeper::startConnect(uint32_t index, int port, std::chrono::steady_clock::time_point now) {
+    m_tokens -= 1.0;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_DEBUG("HostSweeper: socket failed: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(static_cast<uint16_t>(port));
+    to.sin_addr.s_addr = htonl(m_first + index);
+    if (connect(fd, reinterpret_cast<const struct sockaddr*>(&to), sizeof(to)) == 0 || errno == ECONNREFUSED) {
+        close(fd);
+        hostUp(index, elapsedUs(now, std::chrono::steady_clock::now()), port);
+        return true;
+    }
+    if (errno != EINPROGRESS) {
+        LOG_DEBUG("HostSweeper: connect " + formatAddress(m_first + index) + ":" + std::to_string(port) +
+                  " failed: " + strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    size_t slot;
+    if (!m_freeConnects.empty()) {
+        slot = m_freeConnects.back();
+        m_freeConnects.pop_back();
+    } else {
+        slot = m_connects.size();
+        m_connects.emplace_back();
+    }
+    Connect& pending = m_connects[slot];
+    pending.fd = fd;
+    pending.host = index;
+    pending.port = port;
+    pending.startedAt = now;
+    m_hosts[index].connectsPending++;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLOUT;
+    event.data.u64 = slot;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+    return true;
+}
+
+void HostSweeper::finishConnect(size_t slot, std::chrono::steady_clock::time_point now) {
+    // The event may belong to a connect already closed earlier in this batch
+    if (slot >= m_connects.size() || m_connects[slot].fd < 0) {
+        return;
+    }
+    Connect& pending = m_connects[slot];
+    uint32_t index = pending.host;
+    int port = pending.port;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(pending.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+    long rttUs = -1;
+    if (error == 0) {
+        // The handshake RTT is measured by the kernel, without our wakeup latency
+        struct tcp_info info;
+        length = sizeof(info);
+        if (getsockopt(pending.fd, IPPROTO_TCP, TCP_INFO, &info, &length) == 0 && info.tcpi_rtt > 0) {
+            rttUs = static_cast<long>(info.tcpi_rtt);
+        }
+        // Reset rather than close, so no TIME_WAIT is left behind per probe
+        struct linger reset = { 1, 0 };
+        setsockopt(pending.fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    }
+    if (rttUs < 0) {
+        rttUs = elapsedUs(pending.startedAt, now);
+    }
+    closeConnect(slot);
+
+    if (error == 0 || error == ECONNREFUSED) {
+        hostUp(index, rttUs, port);
+    } else {
+        settle(index);
+    }
+}
+
+void HostSweeper::closeConnect(size_t slot) {
+    Connect& pending = m_connects[slot];
+    // Closing the last reference also removes it from the epoll set
+    close(pending.fd);
+    pending.fd = -1;
+    m_hosts[pending.host].connectsPending--;
+    m_freeConnects.push_back(slot);
+}
+
+void HostSweeper::expire(std::chrono::steady_clock::time_point now) {
+    auto timeout = std::chrono::milliseconds(m_options.timeoutMs);
+    for (size_t slot = 0; slot < m_connects.size(); slot++) {
+        if (m_connects[slot].fd >= 0 && now - m_connects[slot].startedAt >= timeout) {
+            uint32_t index = m_connects[slot].host;
+            closeConnect(slot);
+            settle(index);
+        }
+    }
+
+    std::vector<uint32_t> probing = m_probing;
+    for (uint32_t index : probing) {
+        HostEntry& host = m_hosts[index];
+        if (host.echoPending && now - host.echoSentAt >= timeout) {
+            host.echoPending = false;
+            settle(index);
+        }
+    }
+}
+
+void HostSweeper::hostUp(uint32_t index, long rttUs, int port) {
+    HostEntry& host = m_hosts[index];
+    // Late answers for a host already found, or already given up on, are dropped
+    if (host.state != HostState::PROBING) {
+        return;
+    }
+    host.state = HostState::UP;
+    host.echoPending = false;
+    for (size_t slot = 0; slot < m_connects.size() && host.connectsPending > 0; slot++) {
+        if (m_connects[slot].fd >= 0 && m_connects[slot].host == index) {
+            closeConnect(slot);
+        }
+    }
+    m_probing.erase(std::find(m_probing.begin(), m_probing.end(), index));
+    m_found++;
+    m_done++;
+
+    if (m_options.hostHandler) {
+        Host found;
+        found.address.s_addr = htonl(m_first + index);
+        found.rttUs = rttUs;
+        found.port = port;
+        m_options.hostHandler(found);
+    }
+}
+
+void HostSweeper::settle(uint32_t index) {
+    HostEntry& host = m_hosts[index];
+    bool echoDue = m_socket.isOpen() && host.echoesSent < m_options.attempts;
+    if (host.state != HostState::PROBING || host.echoPending || host.connectsPending > 0 || echoDue) {
+        return;
+    }
+    host.state = HostState::DOWN;
+    m_probing.erase(std::find(m_probing.begin(), m_probing.end(), index));
+    m_done++;
+}
+
+std::chrono::steady_clock::time_point HostSweeper::nextDeadline(std::chrono::steady_clock::time_point now) const {
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    auto timeout = std::chrono::milliseconds(m_options.timeoutMs);
+
+    // A host waiting for a second echo needs one token, a new host one per probe
+    double needed = 0.0;
+    for (uint32_t index : m_probing) {
+        const HostEntry& host = m_hosts[index];
+        if (host.echoPending) {
+            deadline = std::min(deadline, host.echoSentAt + timeout);
+        } else if (m_socket.isOpen() && host.echoesSent < m_options.attempts) {
+            needed = 1.0;
+        }
+    }
+    if (needed == 0.0 && m_nextHost < m_hosts.size() &&
+        m_probing.size() < static_cast<size_t>(m_options.maxHosts)) {
+        needed = (m_socket.isOpen() ? 1.0 : 0.0) + m_options.tcpPorts.size();
+    }
+    if (needed > m_tokens) {
+        long waitUs = static_cast<long>((needed - m_tokens) * 1e6 / m_options.ratePerSec) + 1;
+        deadline = std::min(deadline, now + std::chrono::microseconds(waitUs));
+    }
+
+    for (const auto& pending : m_connects) {
+        if (pending.fd >= 0) {
+            deadline = std::min(deadline, pending.startedAt + timeout);
+        }
+    }
+    return deadline;
+}
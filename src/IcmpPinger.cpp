@@ -0,0 +1,391 @@
+#include "IcmpPinger.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Raw socket option from linux/icmp.h, which doesn't mix with the glibc headers
+#ifndef ICMP_FILTER
+#define ICMP_FILTER 1
+#endif
+
+namespace {
+
+// Marks our echo payloads, after the 8 byte send timestamp
+const uint8_t s_payloadMagic[8] = { 'm', 'p', 'a', 'n', 'e', 'l', 'p', 'g' };
+
+// Kernel receive stamps older than this are taken to be across a clock step
+const uint64_t s_maxStampAgeNs = 1000000000ULL;
+
+// Distinct echo ids for raw sockets opened by the same process
+std::atomic<unsigned> s_socketCount{0};
+std::atomic<uint64_t> s_traceIds{0};
+
+uint64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint16_t checksum(const uint8_t* data, size_t size) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        sum += static_cast<uint32_t>(data[i] << 8 | data[i + 1]);
+    }
+    if (size & 1) {
+        sum += static_cast<uint32_t>(data[size - 1] << 8);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return htons(static_cast<uint16_t>(~sum));
+}
+
+} // namespace
+
+constexpr size_t IcmpSocket::MIN_PAYLOAD;
+
+IcmpSocket::~IcmpSocket() {
+    close();
+}
+
+bool IcmpSocket::open() {
+    if (m_fd >= 0) {
+        return true;
+    }
+
+    // Datagram ICMP sockets need no privileges where ping_group_range includes our group
+    m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    m_raw = false;
+    if (m_fd < 0) {
+        int dgramError = errno;
+        m_fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+        if (m_fd < 0) {
+            LOG_ERROR("IcmpSocket: no ICMP socket available (datagram: " + std::string(strerror(dgramError)) +
+                          ", raw: " + std::string(strerror(errno)) + ")");
+            return false;
+        }
+        m_raw = true;
+        m_identifier = static_cast<uint16_t>(getpid() + s_socketCount.fetch_add(1));
+
+        // A raw socket sees all ICMP traffic; only echo replies are of interest
+        uint32_t filter = ~(1U << ICMP_ECHOREPLY);
+        setsockopt(m_fd, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+    }
+
+    int on = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    setsockopt(m_fd, IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+
+    LOG_DEBUG(std::string("IcmpSocket: opened ") + (m_raw ? "raw" : "datagram") + " ICMP socket");
+    return true;
+}
+
+void IcmpSocket::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool IcmpSocket::sendEcho(const struct sockaddr_in& to, uint16_t sequence, size_t payloadSize) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    size_t size = sizeof(struct icmphdr) + std::max(payloadSize, MIN_PAYLOAD);
+    uint8_t packet[sizeof(struct icmphdr) + Config::PING_MAX_PAYLOAD_SIZE];
+    size = std::min(size, sizeof(packet));
+
+    struct icmphdr header;
+    memset(&header, 0, sizeof(header));
+    header.type = ICMP_ECHO;
+    header.un.echo.id = htons(m_identifier);
+    header.un.echo.sequence = htons(sequence);
+    memcpy(packet, &header, sizeof(header));
+
+    // Send time first, then the marker, then the usual incrementing fill pattern
+    uint8_t* payload = packet + sizeof(header);
+    uint64_t sentNs = clockNs(CLOCK_MONOTONIC);
+    memcpy(payload, &sentNs, sizeof(sentNs));
+    memcpy(payload + sizeof(sentNs), s_payloadMagic, sizeof(s_payloadMagic));
+    for (size_t i = MIN_PAYLOAD; i < size - sizeof(header); i++) {
+        payload[i] = static_cast<uint8_t>(i);
+    }
+
+    // The kernel fills in the checksum on datagram sockets, raw ones need it
+    uint16_t sum = checksum(packet, size);
+    memcpy(packet + offsetof(struct icmphdr, checksum), &sum, sizeof(sum));
+
+    ssize_t sent = sendto(m_fd, packet, size, MSG_DONTWAIT | MSG_NOSIGNAL,
+                          reinterpret_cast<const struct sockaddr*>(&to), sizeof(to));
+    if (sent < 0) {
+        LOG_DEBUG("IcmpSocket: sendto " + std::string(inet_ntoa(to.sin_addr)) + " failed: " + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool IcmpSocket::receive(EchoReply& reply) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    uint8_t buffer[60 + sizeof(struct icmphdr) + Config::PING_MAX_PAYLOAD_SIZE];
+    char control[256];
+    for (;;) {
+        struct sockaddr_in from;
+        struct iovec iov = { buffer, sizeof(buffer) };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(m_fd, &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        const uint8_t* icmp = buffer;
+        size_t length = static_cast<size_t>(n);
+        int ttl = -1;
+        if (m_raw) {
+            // Raw sockets deliver the IP header as well
+            size_t headerLength = length > 0 ? static_cast<size_t>(buffer[0] & 0x0f) * 4 : 0;
+            if (headerLength < 20 || length < headerLength) {
+                continue;
+            }
+            ttl = buffer[8];
+            icmp += headerLength;
+            length -= headerLength;
+        }
+        if (length < sizeof(struct icmphdr) + MIN_PAYLOAD) {
+            continue;
+        }
+
+        struct icmphdr header;
+        memcpy(&header, icmp, sizeof(header));
+        const uint8_t* payload = icmp + sizeof(header);
+        if (header.type != ICMP_ECHOREPLY ||
+            memcmp(payload + sizeof(uint64_t), s_payloadMagic, sizeof(s_payloadMagic)) != 0) {
+            continue;
+        }
+        // Datagram sockets only get replies to their own id
+        if (m_raw && ntohs(header.un.echo.id) != m_identifier) {
+            continue;
+        }
+
+        uint64_t stampNs = 0;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                stampNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+            } else if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TTL) {
+                memcpy(&ttl, CMSG_DATA(cmsg), sizeof(ttl));
+            }
+        }
+
+        // The kernel stamp is wall-clock time, so only the packet's age is taken from it
+        // (measured against the wall clock read just now) and applied to the monotonic
+        // clock; an NTP step can then only skew a reply that crosses it, within limits
+        uint64_t receivedNs = clockNs(CLOCK_MONOTONIC);
+        if (stampNs != 0) {
+            uint64_t nowNs = clockNs(CLOCK_REALTIME);
+            if (stampNs <= nowNs && nowNs - stampNs < s_maxStampAgeNs && nowNs - stampNs < receivedNs) {
+                receivedNs -= nowNs - stampNs;
+            }
+        }
+
+        uint64_t sentNs;
+        memcpy(&sentNs, payload, sizeof(sentNs));
+        reply.from = from.sin_addr;
+        reply.sequence = ntohs(header.un.echo.sequence);
+        reply.rttUs = receivedNs > sentNs ? static_cast<long>((receivedNs - sentNs) / 1000) : 0;
+        reply.ttl = ttl;
+        return true;
+    }
+}
+
+bool IcmpSocket::parseAddress(const std::string& text, struct sockaddr_in& address) {
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+
+    uint32_t value = 0;
+    int octets = 0;
+    const char* p = text.c_str();
+    while (octets < 4) {
+        char* end = nullptr;
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        long octet = strtol(p, &end, 10);
+        if (octet > 255 || end - p > 3) {
+            return false;
+        }
+        value = (value << 8) | static_cast<uint32_t>(octet);
+        octets++;
+        p = end;
+        if (octets < 4) {
+            if (*p != '.') {
+                return false;
+            }
+            p++;
+        }
+    }
+    if (*p != '\0') {
+        return false;
+    }
+    address.sin_addr.s_addr = htonl(value);
+    return true;
+}
+
+IcmpPinger::~IcmpPinger() {
+    stop();
+}
+
+bool IcmpPinger::start(const std::string& address) {
+    return start(address, Options());
+}
+
+bool IcmpPinger::start(const std::string& address, const Options& options) {
+    stop();
+
+    if (!IcmpSocket::parseAddress(address, m_target)) {
+        LOG_WARNING("IcmpPinger: invalid address " + address);
+        return false;
+    }
+    if (!m_socket.open()) {
+        return false;
+    }
+
+    m_options = options;
+    m_options.intervalMs = std::max(m_options.intervalMs, Config::PING_MIN_INTERVAL_MS);
+    m_options.payloadSize = std::min(std::max(m_options.payloadSize, 0), Config::PING_MAX_PAYLOAD_SIZE);
+    m_sent = 0;
+    m_received = 0;
+    m_lastRttUs = -1;
+    m_pending.clear();
+    m_nextSendAt = std::chrono::steady_clock::now();
+    m_running = true;
+
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    TraceRecorder::asyncBegin("net", m_options.traceName, m_traceId, address.c_str());
+    return true;
+}
+
+void IcmpPinger::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_pending.clear();
+    // Not kept open between runs: an idle raw socket would still queue every echo reply
+    m_socket.close();
+    TraceRecorder::asyncEnd("net", m_options.traceName, m_traceId);
+}
+
+bool IcmpPinger::poll(int waitMs) {
+    if (!m_running) {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    bool moreToSend = m_options.count == 0 || m_sent < m_options.count;
+    if (moreToSend && now >= m_nextSendAt) {
+        uint16_t sequence = m_nextSequence++;
+        m_sent++;
+        // Keep the schedule, but don't burst to catch up after a stall
+        m_nextSendAt += std::chrono::milliseconds(m_options.intervalMs);
+        if (m_nextSendAt < now) {
+            m_nextSendAt = now + std::chrono::milliseconds(m_options.intervalMs);
+        }
+        if (m_socket.sendEcho(m_target, sequence, static_cast<size_t>(m_options.payloadSize))) {
+            m_pending.push_back(Pending{sequence, now});
+        } else {
+            Reply lost;
+            lost.sequence = sequence;
+            report(lost);
+        }
+        moreToSend = m_options.count == 0 || m_sent < m_options.count;
+    }
+
+    // Sleep no longer than until the next probe or the next expiry
+    if (waitMs > 0) {
+        auto deadline = now + std::chrono::milliseconds(waitMs);
+        if (moreToSend) {
+            deadline = std::min(deadline, m_nextSendAt);
+        }
+        if (!m_pending.empty()) {
+            deadline = std::min(deadline, m_pending.front().sentAt + std::chrono::milliseconds(m_options.timeoutMs));
+        }
+        // Rounded up, so the deadline has passed when poll returns
+        long remainingUs = static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count());
+        if (remainingUs > 0) {
+            struct pollfd pfd = { m_socket.getFd(), POLLIN, 0 };
+            ::poll(&pfd, 1, static_cast<int>((remainingUs + 999) / 1000));
+        }
+    }
+
+    IcmpSocket::EchoReply echo;
+    while (m_socket.receive(echo)) {
+        if (echo.from.s_addr != m_target.sin_addr.s_addr) {
+            continue;
+        }
+        auto it = std::find_if(m_pending.begin(), m_pending.end(),
+                               [&echo](const Pending& p) { return p.sequence == echo.sequence; });
+        if (it == m_pending.end()) {
+            // Duplicate, or the reply to a probe already given up on
+            continue;
+        }
+        m_pending.erase(it);
+        m_received++;
+        m_lastRttUs = echo.rttUs;
+
+        Reply reply;
+        reply.sequence = echo.sequence;
+        reply.received = true;
+        reply.rttUs = echo.rttUs;
+        reply.ttl = echo.ttl;
+        report(reply);
+    }
+
+    now = std::chrono::steady_clock::now();
+    while (!m_pending.empty() && now - m_pending.front().sentAt >= std::chrono::milliseconds(m_options.timeoutMs)) {
+        Reply lost;
+        lost.sequence = m_pending.front().sequence;
+        m_pending.pop_front();
+        report(lost);
+    }
+
+    finishIfDone();
+    return m_running;
+}
+
+void IcmpPinger::report(const Reply& reply) {
+    if (m_options.replyHandler) {
+        m_options.replyHandler(reply);
+    }
+}
+
+void IcmpPinger::finishIfDone() {
+    if (m_options.count > 0 && m_sent >= m_options.count && m_pending.empty()) {
+        stop();
+    }
+}
@@ -0,0 +1,350 @@
+#include "InterfaceMonitor.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+// Large enough for a full dump batch, the kernel never splits a message
+const size_t s_receiveBufferSize = 32768;
+
+// A dump that stalls this long is given up on
+const int s_dumpTimeoutMs = 1000;
+
+std::string formatAddress(int family, const void* data) {
+    char text[INET6_ADDRSTRLEN];
+    if (!inet_ntop(family, data, text, sizeof(text))) {
+        return "";
+    }
+    return text;
+}
+
+} // namespace
+
+bool InterfaceMonitor::Interface::isLoopback() const {
+    return flags & IFF_LOOPBACK;
+}
+
+bool InterfaceMonitor::Interface::isUp() const {
+    return (flags & IFF_UP) && (flags & IFF_RUNNING);
+}
+
+bool InterfaceMonitor::Interface::isLinkUp() const {
+    return operState == IF_OPER_UP;
+}
+
+const InterfaceMonitor::Address* InterfaceMonitor::Interface::firstAddress(int family) const {
+    for (const auto& address : addresses) {
+        if (address.family == family) {
+            return &address;
+        }
+    }
+    return nullptr;
+}
+
+std::string InterfaceMonitor::Interface::formatHardwareAddress(const char* separator) const {
+    std::string text;
+    for (size_t i = 0; i < hardwareAddress.size(); i++) {
+        char octet[3];
+        snprintf(octet, sizeof(octet), "%02X", hardwareAddress[i]);
+        if (i > 0) {
+            text += separator;
+        }
+        text += octet;
+    }
+    return text;
+}
+
+InterfaceMonitor& InterfaceMonitor::getInstance() {
+    static InterfaceMonitor instance;
+    return instance;
+}
+
+InterfaceMonitor::~InterfaceMonitor() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+std::string InterfaceMonitor::prefixToNetmask(int prefixLength) {
+    prefixLength = std::min(std::max(prefixLength, 0), 32);
+    struct in_addr mask;
+    mask.s_addr = htonl(prefixLength == 0 ? 0 : 0xFFFFFFFFu << (32 - prefixLength));
+    return inet_ntoa(mask);
+}
+
+InterfaceMonitor::Snapshot InterfaceMonitor::getSnapshot() {
+    poll();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_snapshot ? m_snapshot : std::make_shared<const std::vector<Interface>>();
+}
+
+uint64_t InterfaceMonitor::poll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_synced) {
+        // Subscribe before dumping so nothing that changes in between is missed
+        if ((m_fd < 0 && !open()) || !resync()) {
+            return m_generation;
+        }
+        m_synced = true;
+        publish();
+    }
+
+    bool changed = false;
+    char buffer[s_receiveBufferSize];
+    while (true) {
+        struct sockaddr_nl from {};
+        socklen_t fromLength = sizeof(from);
+        ssize_t received = recvfrom(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                                    reinterpret_cast<struct sockaddr*>(&from), &fromLength);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Notifications were dropped, only a fresh dump tells what they said
+                LOG_DEBUG("InterfaceMonitor: notifications overran, resyncing");
+                if (resync()) {
+                    changed = true;
+                    continue;
+                }
+                m_synced = false;
+            }
+            break;
+        }
+        if (from.nl_pid != 0) {
+            continue;   // Only the kernel speaks for the interfaces
+        }
+
+        const struct nlmsghdr* message = reinterpret_cast<const struct nlmsghdr*>(buffer);
+        int length = static_cast<int>(received);
+        for (; NLMSG_OK(message, length); message = NLMSG_NEXT(message, length)) {
+            changed |= apply(message);
+        }
+    }
+
+    if (changed) {
+        publish();
+    }
+    return m_generation;
+}
+
+bool InterfaceMonitor::open() {
+    m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_fd < 0) {
+        LOG_ERROR("InterfaceMonitor: netlink socket failed: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct sockaddr_nl local {};
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(m_fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        LOG_ERROR("InterfaceMonitor: netlink bind failed: " + std::string(strerror(errno)));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool InterfaceMonitor::resync() {
+    m_interfaces.clear();
+
+    // Links first, so every address finds the interface it belongs to
+    if (!dump(RTM_GETLINK) || !dump(RTM_GETADDR)) {
+        m_interfaces.clear();
+        return false;
+    }
+    LOG_DEBUG("InterfaceMonitor: " + std::to_string(m_interfaces.size()) + " interfaces");
+    return true;
+}
+
+bool InterfaceMonitor::dump(int type) {
+    // Dumps get a socket of their own, so replies never interleave with notifications
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        LOG_ERROR("InterfaceMonitor: netlink socket failed: " + std::string(strerror(errno)));
+        return false;
+    }
+    struct timeval timeout = {s_dumpTimeoutMs / 1000, (s_dumpTimeoutMs % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct {
+        struct nlmsghdr header;
+        struct rtgenmsg body;
+    } request {};
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.body));
+    request.header.nlmsg_type = static_cast<uint16_t>(type);
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++m_dumpSequence;
+    request.body.rtgen_family = AF_UNSPEC;
+
+    struct sockaddr_nl kernel {};
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(fd, &request, request.header.nlmsg_len, 0,
+               reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        LOG_ERROR("InterfaceMonitor: netlink dump request failed: " + std::string(strerror(errno)));
+        close(fd);
+        return false;
+    }
+
+    char buffer[s_receiveBufferSize];
+    bool done = false;
+    bool ok = true;
+    while (!done && ok) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("InterfaceMonitor: netlink dump failed: " + std::string(strerror(errno)));
+            ok = false;
+            break;
+        }
+        if (received == 0) {
+            ok = false;
+            break;
+        }
+
+        const struct nlmsghdr* message = reinterpret_cast<const struct nlmsghdr*>(buffer);
+        int length = static_cast<int>(received);
+        for (; NLMSG_OK(message, length); message = NLMSG_NEXT(message, length)) {
+            if (message->nlmsg_seq != m_dumpSequence) {
+                continue;
+            }
+            if (message->nlmsg_type == NLMSG_DONE) {
+                done = true;
+                break;
+            }
+            if (message->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr* error = static_cast<const struct nlmsgerr*>(NLMSG_DATA(message));
+                LOG_ERROR("InterfaceMonitor: netlink dump refused: " + std::string(strerror(-error->error)));
+                ok = false;
+                break;
+            }
+            apply(message);
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+bool InterfaceMonitor::apply(const struct nlmsghdr* message) {
+    switch (message->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK: {
+            const struct ifinfomsg* info = static_cast<const struct ifinfomsg*>(NLMSG_DATA(message));
+            if (message->nlmsg_type == RTM_DELLINK) {
+                return m_interfaces.erase(info->ifi_index) > 0;
+            }
+
+            // Addresses survive a link update, everything else is replaced
+            Interface& interface = m_interfaces[info->ifi_index];
+            interface.index = info->ifi_index;
+            interface.flags = info->ifi_flags;
+
+            int length = static_cast<int>(IFLA_PAYLOAD(message));
+            for (const struct rtattr* attribute = IFLA_RTA(info); RTA_OK(attribute, length);
+                 attribute = RTA_NEXT(attribute, length)) {
+                const uint8_t* data = static_cast<const uint8_t*>(RTA_DATA(attribute));
+                size_t size = RTA_PAYLOAD(attribute);
+                switch (attribute->rta_type) {
+                    case IFLA_IFNAME:
+                        interface.name.assign(reinterpret_cast<const char*>(data), strnlen(reinterpret_cast<const char*>(data), size));
+                        break;
+                    case IFLA_ADDRESS:
+                        interface.hardwareAddress.assign(data, data + size);
+                        break;
+                    case IFLA_OPERSTATE:
+                        if (size >= 1) {
+                            interface.operState = data[0];
+                        }
+                        break;
+                }
+            }
+            return true;
+        }
+
+        case RTM_NEWADDR:
+        case RTM_DELADDR: {
+            const struct ifaddrmsg* info = static_cast<const struct ifaddrmsg*>(NLMSG_DATA(message));
+            if (info->ifa_family != AF_INET && info->ifa_family != AF_INET6) {
+                return false;
+            }
+
+            // IFA_LOCAL is the interface's own address, IFA_ADDRESS the peer on point-to-point links
+            std::string local;
+            std::string address;
+            uint32_t flags = info->ifa_flags;
+            int length = static_cast<int>(IFA_PAYLOAD(message));
+            for (const struct rtattr* attribute = IFA_RTA(info); RTA_OK(attribute, length);
+                 attribute = RTA_NEXT(attribute, length)) {
+                // The full flags word, ifa_flags only has room for the first eight
+                if (attribute->rta_type == IFA_FLAGS && RTA_PAYLOAD(attribute) >= sizeof(uint32_t)) {
+                    memcpy(&flags, RTA_DATA(attribute), sizeof(flags));
+                    continue;
+                }
+                size_t expected = info->ifa_family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+                if (RTA_PAYLOAD(attribute) < expected) {
+                    continue;
+                }
+                if (attribute->rta_type == IFA_LOCAL) {
+                    local = formatAddress(info->ifa_family, RTA_DATA(attribute));
+                } else if (attribute->rta_type == IFA_ADDRESS) {
+                    address = formatAddress(info->ifa_family, RTA_DATA(attribute));
+                }
+            }
+            if (!local.empty()) {
+                address = local;
+            }
+
+            auto found = m_interfaces.find(static_cast<int>(info->ifa_index));
+            if (address.empty() || found == m_interfaces.end()) {
+                return false;
+            }
+
+            auto& addresses = found->second.addresses;
+            auto existing = std::find_if(addresses.begin(), addresses.end(), [&](const Address& entry) {
+                return entry.family == info->ifa_family && entry.address == address;
+            });
+            if (message->nlmsg_type == RTM_DELADDR) {
+                if (existing == addresses.end()) {
+                    return false;
+                }
+                addresses.erase(existing);
+                return true;
+            }
+
+            if (existing == addresses.end()) {
+                existing = addresses.insert(addresses.end(), Address());
+                existing->family = info->ifa_family;
+                existing->address = address;
+            }
+            existing->prefixLength = info->ifa_prefixlen;
+            existing->flags = flags;
+            return true;
+        }
+    }
+    return false;
+}
+
+void InterfaceMonitor::publish() {
+    // Readers keep whatever snapshot they hold, this one only serves the next getSnapshot()
+    auto interfaces = std::make_shared<std::vector<Interface>>();
+    interfaces->reserve(m_interfaces.size());
+    for (const auto& entry : m_interfaces) {
+        interfaces->push_back(entry.second);
+    }
+    m_snapshot = interfaces;
+    m_generation++;
+}
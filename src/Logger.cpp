@@ -1,4 +1,246 @@
 #include "Logger.h"
+#include "Config.h"
+#include "MpscRing.h"
+#include <atomic>
+#include <thread>
+#include <new>
+#include <chrono>
+#include <cstdlib>
+#include <cstdarg>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 // Initialize static member
 bool Logger::m_verbose = false;
+
+namespace {
+
+struct LogEntry {
+    Logger::Level level = Logger::Level::INFO;
+    std::string message;
+};
+
+// Shared state of the asynchronous writer
+struct LogState {
+    MpscRing<LogEntry, Config::LOG_RING_CAPACITY> ring;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t droppedReported = 0;   // Writer thread only
+    std::thread writer;
+    int wakeFd = -1;                // eventfd the idle writer blocks on
+    std::atomic<bool> sleeping{false};
+};
+
+// Never destroyed, so logging from static destructors stays safe
+LogState& state() {
+    // Placement new keeps the ring's cache-line alignment (plain new doesn't in C++14)
+    alignas(LogState) static char storage[sizeof(LogState)];
+    static LogState* s = new (storage) LogState();
+    return *s;
+}
+
+// Debug and info go to stdout, warnings and errors to stderr
+int outputFd(Logger::Level level) {
+    return (level == Logger::Level::WARNING || level == Logger::Level::ERROR) ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+void appendLine(std::string& out, Logger::Level level, const std::string& message) {
+    switch (level) {
+        case Logger::Level::DEBUG:
+            out += "[DEBUG] ";
+            break;
+        case Logger::Level::INFO:
+            break;
+        case Logger::Level::WARNING:
+            out += "[WARNING] ";
+            break;
+        case Logger::Level::ERROR:
+            out += "[ERROR] ";
+            break;
+    }
+    out += message;
+    out += '\n';
+}
+
+void writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+// Writes out everything queued, one write() per run of lines for the same stream
+bool drain(LogState& s) {
+    std::string batch;
+    int batchFd = STDOUT_FILENO;
+    LogEntry entry;
+    bool any = false;
+
+    while (s.ring.pop(entry)) {
+        int fd = outputFd(entry.level);
+        if (fd != batchFd && !batch.empty()) {
+            writeAll(batchFd, batch);
+            batch.clear();
+        }
+        batchFd = fd;
+        appendLine(batch, entry.level, entry.message);
+        any = true;
+    }
+    if (!batch.empty()) {
+        writeAll(batchFd, batch);
+    }
+
+    uint64_t dropped = s.dropped.load(std::memory_order_relaxed);
+    if (dropped != s.droppedReported) {
+        std::string note;
+        appendLine(note, Logger::Level::WARNING, "Logger dropped " +
+                   std::to_string(dropped - s.droppedReported) + " messages (ring full)");
+        writeAll(STDERR_FILENO, note);
+        s.droppedReported = dropped;
+    }
+    return any;
+}
+
+// Producers only signal a writer that went idle, so a busy log costs no syscalls
+void wakeWriter(LogState& s) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (s.sleeping.exchange(false) && s.wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(s.wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+} // namespace
+
+void Logger::startAsync() {
+    LogState& s = state();
+    if (s.running.exchange(true)) {
+        return;
+    }
+
+    // Make sure queued messages are written on every exit path
+    static bool exitHandlerRegistered = false;
+    if (!exitHandlerRegistered) {
+        std::atexit(&Logger::stopAsync);
+        exitHandlerRegistered = true;
+    }
+
+    if (s.wakeFd < 0) {
+        s.wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+    s.writer = std::thread(&Logger::writerThread);
+}
+
+void Logger::stopAsync() {
+    LogState& s = state();
+    if (!s.running.exchange(false)) {
+        return;
+    }
+    s.sleeping = true;
+    wakeWriter(s);
+    if (s.writer.joinable()) {
+        s.writer.join();
+    }
+}
+
+uint64_t Logger::getDroppedCount() {
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+void Logger::enqueue(Level level, std::string message) {
+    LogState& s = state();
+    if (!s.running.load(std::memory_order_acquire)) {
+        // No writer thread (before startup or after shutdown), write directly
+        std::string line;
+        appendLine(line, level, message);
+        writeAll(outputFd(level), line);
+        return;
+    }
+
+    LogEntry entry;
+    entry.level = level;
+    entry.message = std::move(message);
+    if (s.ring.push(std::move(entry))) {
+        wakeWriter(s);
+        return;
+    }
+
+    // Problems are worth a short wait for the writer to make room; writing them
+    // directly would put them ahead of lines still queued
+    if (level == Level::WARNING || level == Level::ERROR) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(Config::LOG_FULL_WAIT_MS);
+        do {
+            wakeWriter(s);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (s.ring.push(std::move(entry))) {
+                return;
+            }
+        } while (std::chrono::steady_clock::now() < deadline);
+    }
+    s.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::logf(Level level, const char* format, ...) {
+    if (!isEnabled(level)) {
+        return;
+    }
+
+    // Format straight into the string that is moved into the ring, so there is one
+    // allocation and no copy; only unusually long messages need a second pass
+    std::string message(Config::LOG_FORMAT_RESERVE, '\0');
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(&message[0], message.size() + 1, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+
+    if (static_cast<size_t>(length) > message.size()) {
+        message.resize(static_cast<size_t>(length));
+        va_start(args, format);
+        vsnprintf(&message[0], message.size() + 1, format, args);
+        va_end(args);
+    }
+    message.resize(static_cast<size_t>(length));
+    enqueue(level, std::move(message));
+}
+
+void Logger::writerThread() {
+    LogState& s = state();
+    while (s.running.load(std::memory_order_acquire)) {
+        if (drain(s)) {
+            continue;
+        }
+
+        // Idle: block until a producer finds the ring empty-to-non-empty and signals
+        s.sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!s.ring.empty() || !s.running.load(std::memory_order_acquire)) {
+            s.sleeping.store(false);
+            continue;
+        }
+        struct pollfd pfd = { s.wakeFd, POLLIN, 0 };
+        ::poll(&pfd, 1, s.wakeFd >= 0 ? -1 : Config::LOG_FLUSH_INTERVAL_MS);
+        uint64_t count;
+        ssize_t ignored = ::read(s.wakeFd, &count, sizeof(count));
+        (void)ignored;
+        s.sleeping.store(false);
+
+        // Let the rest of a burst arrive so it goes out in a few writes
+        std::this_thread::sleep_for(std::chrono::milliseconds(Config::LOG_FLUSH_INTERVAL_MS));
+    }
+    // Final drain after stop was requested
+    drain(s);
+}
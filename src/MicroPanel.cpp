@@ -6,14 +6,19 @@
 #include "MenuScreenModule.h"
 #include "PersistentStorage.h"
 #include "ModuleDependency.h"
+#include "ScreenConfig.h"
+#include "ConfigWatcher.h"
 #include "Logger.h"
+#include "StartupTrace.h"
+#include "TraceRecorder.h"
+#include "ScriptHelper.h"
+#include "MulticastDns.h"
 #include <iostream>
 #include <signal.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <fstream>
-#include <nlohmann/json.hpp>
-using json = nlohmann::json;
+#include <cstdio>
 
 // Static instance for signal handler
 MicroPanel* MicroPanel::s_instance = nullptr;
@@ -22,12 +27,16 @@ extern std::atomic<bool> g_signalReceived;
 // Signal handler function
 void MicroPanel::signalHandler(int signal)
 {
-   (void)signal;
+   // SIGUSR1 dumps the trace buffers and a JSON view of the storage instead of stopping
+   if (signal == SIGUSR1) {
+        TraceRecorder::requestExport();
+        return;
+   }
    if (s_instance) {
         s_instance->m_running = false;
     }
    g_signalReceived.store(true);
-   Logger::debug("Signal received, initiating shutdown...");
+   LOG_DEBUG("Signal received, initiating shutdown...");
 }
 
 MicroPanel::MicroPanel(int argc, char* argv[])
@@ -42,6 +51,7 @@ MicroPanel::MicroPanel(int argc, char* argv[])
     m_config.verboseMode = false;
     m_config.autoDetect = false;
     m_config.powerSaveEnabled = false;
+    m_config.fastBoot = false;
     
     // Parse command line arguments
     parseCommandLine(argc, argv);
@@ -59,7 +69,7 @@ void MicroPanel::parseCommandLine(int argc, char* argv[])
     m_config.autoDetect = true;  // Enable auto-detection by default
 
     int opt;
-    while ((opt = getopt(argc, argv, "i:s:c:vahp")) != -1) {
+    while ((opt = getopt(argc, argv, "i:s:c:vahpf")) != -1) {
         switch (opt) {
             case 'i':
                 m_config.inputDevice = optarg;
@@ -68,25 +78,26 @@ void MicroPanel::parseCommandLine(int argc, char* argv[])
             case 's':
                 m_config.serialDevice = optarg;
                 break;
-            case 'c':
+            case 'c': {
                 m_config.configFile = optarg;
+                std::string configPath = optarg;
+                size_t lastDot = configPath.find_last_of('.');
+                std::string configBase = (lastDot != std::string::npos) ? configPath.substr(0, lastDot) : configPath;
                 // Default persistent data file location based on config file
                 if (m_config.persistentDataFile.empty()) {
-                    std::string configPath = optarg;
-                    size_t lastDot = configPath.find_last_of('.');
-                    if (lastDot != std::string::npos) {
-                        m_config.persistentDataFile = configPath.substr(0, lastDot) + "_data.json";
-                    } else {
-                        m_config.persistentDataFile = configPath + "_data.json";
-                    }
+                    m_config.persistentDataFile = configBase + "_data.json";
                 }
-                Logger::info("Using configuration file: " + std::string(optarg));
-                Logger::info("Using persistent data file: " + m_config.persistentDataFile);
+                // Main menu and compiled config caches live next to the config file
+                m_config.menuCacheFile = configBase + Config::MENU_CACHE_SUFFIX;
+                m_config.configCacheFile = configBase + Config::CONFIG_CACHE_SUFFIX;
+                LOG_INFO("Using configuration file: " + std::string(optarg));
+                LOG_INFO("Using persistent data file: " + m_config.persistentDataFile);
                 break;
+            }
             case 'v':
                 m_config.verboseMode = true;
                 Logger::setVerbose(true);
-                Logger::debug("Verbose mode enabled");
+                LOG_DEBUG("Verbose mode enabled");
                 break;
             case 'a':
                 m_config.autoDetect = true;
@@ -94,9 +105,13 @@ void MicroPanel::parseCommandLine(int argc, char* argv[])
                 break;
             case 'p':
                 m_config.powerSaveEnabled = true;
-                Logger::info("Power save mode enabled (timeout: " +
+                LOG_INFO("Power save mode enabled (timeout: " +
                           std::to_string(Config::POWER_SAVE_TIMEOUT_SEC) + " seconds)");
                 break;
+            case 'f':
+                m_config.fastBoot = true;
+                Logger::info("Fast boot mode enabled");
+                break;
             case 'h':
                 std::cout << "OLED Menu Control Daemon v" << Config::VERSION << std::endl;
                 std::cout << "Usage: " << argv[0] << " [OPTIONS]\n\n";
@@ -107,6 +122,7 @@ void MicroPanel::parseCommandLine(int argc, char* argv[])
                 std::cout << "  -a          Auto-detect HMI device (enabled by default)\n";
                 std::cout << "  -p          Enable power save mode (display turns off after "
                         << Config::POWER_SAVE_TIMEOUT_SEC << " seconds of inactivity)\n";
+                std::cout << "  -f          Fast boot: skip splash screens and paint the cached main menu immediately\n";
                 std::cout << "  -v          Enable verbose debug output\n";
                 std::cout << "  -h          Display this help message\n\n";
                 std::cout << "Example:\n";
@@ -123,7 +139,7 @@ void MicroPanel::parseCommandLine(int argc, char* argv[])
         }
     }
 
-    Logger::debug("Auto-detection: " + std::string(m_config.autoDetect ? "ENABLED" : "DISABLED"));
+    LOG_DEBUG("Auto-detection: " + std::string(m_config.autoDetect ? "ENABLED" : "DISABLED"));
 }
 
 void MicroPanel::setupSignalHandlers()
@@ -131,6 +147,7 @@ void MicroPanel::setupSignalHandlers()
     // Set up signal handlers for clean exit
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+    signal(SIGUSR1, signalHandler);
 }
 
 bool MicroPanel::initialize()
@@ -143,16 +160,16 @@ bool MicroPanel::initialize()
 
     // If auto-detect is enabled, wait for device to be connected
     if (m_config.autoDetect) {
-        std::cout << "Waiting for HMI device to be connected..." << std::endl;
+        Logger::info("Waiting for HMI device to be connected...");
 
         // First check if the device is already connected
         auto devices = m_deviceManager->detectDevices();
         if (devices.first.empty() || devices.second.empty()) {
             // Device not connected, wait for it
-            std::cout << "HMI device not found. Waiting for connection..." << std::endl;
+            Logger::info("HMI device not found. Waiting for connection...");
 
             if (!m_deviceManager->monitorDeviceUntilConnected(m_running)) {
-                std::cerr << "Gave up waiting for device" << std::endl;
+                Logger::error("Gave up waiting for device");
                 return false;
             }
 
@@ -163,13 +180,14 @@ bool MicroPanel::initialize()
         if (!devices.first.empty() && !devices.second.empty()) {
             m_config.inputDevice = devices.first;
             m_config.serialDevice = devices.second;
-            std::cout << "Auto-detected input device: " << m_config.inputDevice << std::endl;
-            std::cout << "Auto-detected serial device: " << m_config.serialDevice << std::endl;
+            LOG_INFO("Auto-detected input device: " + m_config.inputDevice);
+            LOG_INFO("Auto-detected serial device: " + m_config.serialDevice);
         } else {
-            std::cerr << "Failed to auto-detect devices" << std::endl;
+            Logger::error("Failed to auto-detect devices");
             return false;
         }
     }
+    StartupTrace::mark("devices detected");
 
     // Initialize devices
     m_displayDevice = std::make_shared<DisplayDevice>(m_config.serialDevice);
@@ -177,16 +195,18 @@ bool MicroPanel::initialize()
 
     // Open devices
     if (!m_inputDevice->open()) {
-        std::cerr << "Failed to open input device: " << m_config.inputDevice << std::endl;
+        LOG_ERROR("Failed to open input device: " + m_config.inputDevice);
         return false;
     }
 
     if (!m_displayDevice->open()) {
-        std::cerr << "Failed to open display device: " << m_config.serialDevice << std::endl;
+        LOG_ERROR("Failed to open display device: " + m_config.serialDevice);
         m_inputDevice->close();
         return false;
     }
 
+    StartupTrace::mark("devices opened");
+
     // Create display wrapper
     m_display = std::make_shared<Display>(m_displayDevice);
 
@@ -198,9 +218,39 @@ bool MicroPanel::initialize()
     // Initialize main menu
     m_mainMenu = std::make_shared<Menu>(m_display);
 
+    // Put the last-known main menu on the panel before doing any real work
+    m_cachedMenu = loadMenuCache();
+    if (m_config.fastBoot) {
+        paintCachedMenu();
+    }
+
     // Initialize modules
     initializeModules();
+    StartupTrace::mark("modules initialized");
     
+    // Compile the config once, it feeds persistent storage, dependencies and menus
+    if (!m_config.configFile.empty()) {
+        m_screenConfig = std::make_shared<ScreenConfig>();
+        if (m_screenConfig->load(m_config.configFile, m_config.configCacheFile)) {
+            StartupTrace::mark(m_screenConfig->isLoadedFromCache() ? "config loaded (cache)" : "config loaded");
+
+            // Override default persistent data file path
+            if (!m_screenConfig->getPersistentDataFile().empty()) {
+                m_config.persistentDataFile = m_screenConfig->getPersistentDataFile();
+                LOG_INFO("Using persistent data file from config: " + m_config.persistentDataFile);
+            }
+        } else {
+            m_screenConfig.reset();
+        }
+
+        // Pick up config edits at runtime
+        m_configWatcher = std::make_shared<ConfigWatcher>(m_config.configFile);
+        if (!m_configWatcher->start()) {
+            Logger::warning("Config hot reload unavailable");
+            m_configWatcher.reset();
+        }
+    }
+
     // Initialize persistent storage if config file is provided
     if (!m_config.configFile.empty()) {
         if (!initPersistentStorage()) {
@@ -227,239 +277,211 @@ bool MicroPanel::initialize()
         setupMenu();
     }
 
+    StartupTrace::report();
     return true;
 }
 
 bool MicroPanel::loadConfigFromJson() {
-    try {
-        Logger::debug("Loading configuration from: " + m_config.configFile);
-
-        // Open the file
-        std::ifstream configFile(m_config.configFile);
-        if (!configFile.is_open()) {
-            Logger::error("Could not open config file: " + m_config.configFile);
-            return false;
-        }
-
-        // Parse JSON
-        json config = json::parse(configFile);
-
-        // Check for persistent_data section
-        if (config.contains("persistent_data") && config["persistent_data"].is_object()) {
-            if (config["persistent_data"].contains("file_path") &&
-                config["persistent_data"]["file_path"].is_string()) {
-                // Override default persistent data file path
-                m_config.persistentDataFile = config["persistent_data"]["file_path"].get<std::string>();
-                Logger::info("Using persistent data file from config: " + m_config.persistentDataFile);
-
-                // Initialize persistent storage with the new path
-                initPersistentStorage();
-            }
-        }
-
-        // Initial startup delay to make sure device is fully initialized
-        usleep(Config::STARTUP_DELAY);
-        std::cout << "Initializing display..." << std::endl;
-
-        // Clear the display
-        m_display->clear();
-        usleep(Config::DISPLAY_CMD_DELAY * 15);
-
-        // Draw startup message
-        m_display->drawText(0, 0, "Menu System");
-        usleep(Config::DISPLAY_CMD_DELAY * 10);
-
-        m_display->drawText(0, 10, "Loading Config...");
-        usleep(Config::DISPLAY_CMD_DELAY * 10);
-
-        // Clear before showing menu
-        m_display->clear();
-        usleep(Config::DISPLAY_CMD_DELAY * 15);
+    if (!m_screenConfig) {
+        return false;
+    }
 
-        // Check if "modules" field exists and is an array
-        if (!config.contains("modules") || !config["modules"].is_array()) {
-            Logger::error("Config file doesn't contain valid 'modules' array");
-            return false;
-        }
+    try {
+        showStartupSplash("Loading Config...");
 
-        Logger::debug("Starting menu configuration processing");
-        Logger::debug("Found " + std::to_string(config["modules"].size()) + " modules in config");
+        const auto& modules = m_screenConfig->getModules();
+        LOG_DEBUG("Starting menu configuration processing");
+        LOG_DEBUG("Found " + std::to_string(modules.size()) + " modules in config");
 
-        // First pass: Create all menu modules
-        for (const auto& module : config["modules"]) {
+        // Create menu and list modules, then fill the main menu from the same model
+        for (const auto& module : modules) {
             // Check for required fields
-            if (!module.contains("id") || !module.contains("title")) {
+            if (!module.hasTitle) {
                 Logger::warning("Skipping module with missing required field");
                 continue;
             }
+            createConfiguredModule(module);
+        }
+        buildMainMenu(*m_mainMenu);
 
-            // Get module properties
-            std::string id = module["id"].get<std::string>();
-            std::string title = module["title"].get<std::string>();
-            bool enabled = module.contains("enabled") ? module["enabled"].get<bool>() : false;
+        // Debug the menu state
+        LOG_DEBUG("Menu setup complete, about to render");
+
+        // Force a display test (skipped in fast boot, the cached menu proved the display works)
+        if (!m_config.fastBoot) {
+            m_display->clear();
+            usleep(Config::DISPLAY_CMD_DELAY * 5);
+            m_display->drawText(0, 20, "TESTING DISPLAY");
+            usleep(Config::DISPLAY_CMD_DELAY * 20);
+        }
 
-            // Get the module type if specified
-            std::string moduleType = module.contains("type") ? module["type"].get<std::string>() : "";
+        // Initially render the menu
+        renderInitialMenu();
+        LOG_DEBUG("Menu render called");
 
-            // Check if this is a menu type module
-            bool isMenu = moduleType == "menu";
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error building menus from config: " + std::string(e.what()));
+        return false;
+    }
+}
 
-            // Check if this is a special action type module
-            bool isAction = moduleType == "action";
-            // Check if this is a GenericList type module
-            bool isGenericList = moduleType == "GenericList";
+void MicroPanel::createConfiguredModule(const ScreenConfig::ModuleEntry& module)
+{
+    const std::string& id = module.id;
 
-            // Always create menu modules, regardless of enabled status
-            if (isMenu) {
-                Logger::debug("Creating menu module: " + id);
-                auto menuModule = std::make_shared<MenuScreenModule>(m_display, m_inputDevice, id, title);
+    // Always create menu modules, regardless of enabled status
+    if (module.type == "menu") {
+        LOG_DEBUG("Creating menu module: " + id);
+        auto menuModule = std::make_shared<MenuScreenModule>(m_display, m_inputDevice, id, module.title);
 
-                // Add to module registry
-                m_modules[id] = menuModule;
+        // Set the module registry so the menu can look up modules
+        menuModule->setModuleRegistry(&m_modules);
 
-                // Add to main menu only if enabled
-                if (enabled) {
-                    registerModuleInMenu(id, title);
-                    Logger::debug("Added menu module to main menu: " + id);
-                }
-            }
-            // Handle action modules
-            else if (isAction) {
-                if (id == "invert_display" && enabled) {
-                    m_mainMenu->addItem(std::make_shared<ActionMenuItem>(title, [this]() {
-                        m_display->setInverted(!m_display->isInverted());
-                    }));
-                    Logger::debug("Added invert display action to main menu: " + title);
-                }
-            }
-            // Handle GenericList modules
-            else if (isGenericList) {
-                Logger::debug("Creating GenericList module: " + id);
-                // Create a new GenericListScreen instance for this module
-                auto genericListModule = std::make_shared<GenericListScreen>(m_display, m_inputDevice);
-                genericListModule->setId(id);
-                genericListModule->setConfig(module);
-                // Add to module registry
-                m_modules[id] = genericListModule;
-                // Add to main menu only if enabled
-                if (enabled) {
-                    registerModuleInMenu(id, title);
-                    Logger::debug("Added GenericList module to main menu: " + id);
-                }
-            }
-            // For regular modules, only add to main menu if enabled
-            else if (enabled && m_modules.find(id) != m_modules.end()) {
-                // Only add to menu if dependencies are satisfied (for non-menu modules)
-                auto& dependencies = ModuleDependency::getInstance();
-                if (dependencies.shouldSkipDependencyCheck(id) || dependencies.checkDependencies(id)) {
-                    registerModuleInMenu(id, title);
-                    Logger::debug("Registered module: " + id + " with title: " + title);
-                } else {
-                    Logger::warning("Module dependencies not satisfied: " + id);
-                }
-            }
+        // Submenu entries are resolved against the registry when the menu is entered
+        for (const auto& submenu : module.submenus) {
+            menuModule->addSubmenuItem(submenu.id, submenu.title);
+            LOG_DEBUG("Added submenu item " + submenu.id + " to menu " + id);
         }
 
-        // Second pass: Configure menu hierarchies
-        for (const auto& module : config["modules"]) {
-            // Check if this module has an ID and is a menu type
-            if (module.contains("id") &&
-                module.contains("type") &&
-                module["type"].get<std::string>() == "menu") {
+        // Enabled menus live in the main menu and are top-level menus
+        menuModule->setAsTopLevelMenu(module.enabled);
+        m_modules[id] = menuModule;
+    }
+    // Handle GenericList modules
+    else if (module.type == "GenericList") {
+        LOG_DEBUG("Creating GenericList module: " + id);
+        // Create a new GenericListScreen instance for this module
+        auto genericListModule = std::make_shared<GenericListScreen>(m_display, m_inputDevice);
+        genericListModule->setId(id);
+        genericListModule->setConfig(module.listConfig);
+        m_modules[id] = genericListModule;
+    }
+}
 
-                std::string menuId = module["id"].get<std::string>();
+void MicroPanel::buildMainMenu(Menu& menu)
+{
+    for (const auto& module : m_screenConfig->getModules()) {
+        if (!module.hasTitle || !module.enabled) {
+            continue;
+        }
 
-                // Check if the menu module exists in our registry
-                auto it = m_modules.find(menuId);
-                if (it == m_modules.end() || !std::dynamic_pointer_cast<MenuScreenModule>(it->second)) {
-                    Logger::warning("Menu module not found: " + menuId);
-                    continue;
-                }
+        const std::string& id = module.id;
+        const std::string& title = module.title;
 
-                // Get the menu module
-                auto menuModule = std::dynamic_pointer_cast<MenuScreenModule>(it->second);
+        if (module.type == "menu" || module.type == "GenericList") {
+            registerModuleInMenu(id, title, menu);
+            LOG_DEBUG("Added " + module.type + " module to main menu: " + id);
+        }
+        // Handle action modules
+        else if (module.type == "action") {
+            if (id == "invert_display") {
+                menu.addItem(std::make_shared<ActionMenuItem>(title, [this]() {
+                    m_display->setInverted(!m_display->isInverted());
+                }));
+                LOG_DEBUG("Added invert display action to main menu: " + title);
+            }
+        }
+        // For regular modules, only add to main menu if the module exists
+        // (greyed out while its dependencies are not satisfied)
+        else if (m_modules.find(id) != m_modules.end()) {
+            registerModuleInMenu(id, title, menu);
+            LOG_DEBUG("Registered module: " + id + " with title: " + title);
+        }
+    }
 
-                // Set the module registry so the menu can look up modules
-                menuModule->setModuleRegistry(&m_modules);
+    // Special case for Invert Display option if it's in the options section
+    if (m_screenConfig->hasInvertDisplayOption()) {
+        std::string title = m_screenConfig->getInvertDisplayTitle();
+        menu.addItem(std::make_shared<ActionMenuItem>(title, [this]() {
+            m_display->setInverted(!m_display->isInverted());
+        }));
+        LOG_DEBUG("Added invert display option: " + title);
+    }
+}
 
-                // Check if this menu has submenus
-                if (module.contains("submenus") && module["submenus"].is_array()) {
-                    // Add each submenu item
-                    for (const auto& submenu : module["submenus"]) {
-                        // Check for required fields
-                        if (!submenu.contains("id") || !submenu.contains("title")) {
-                            Logger::warning("Skipping submenu with missing required field");
-                            continue;
-                        }
+void MicroPanel::reloadConfig()
+{
+    LOG_INFO("Config file changed, reloading: " + m_config.configFile);
 
-                        // Get submenu properties
-                        std::string submenuId = submenu["id"].get<std::string>();
-                        std::string submenuTitle = submenu["title"].get<std::string>();
+    auto newConfig = std::make_shared<ScreenConfig>();
+    if (!newConfig->load(m_config.configFile, m_config.configCacheFile)) {
+        Logger::warning("Config reload failed, keeping the running configuration");
+        return;
+    }
 
-                        // Add to the menu without checking dependencies
-                        menuModule->addSubmenuItem(submenuId, submenuTitle);
-                        Logger::debug("Added submenu item " + submenuId + " to menu " + menuId);
-                    }
+    auto oldConfig = m_screenConfig;
+    m_screenConfig = newConfig;
+    auto& dependencies = ModuleDependency::getInstance();
+    auto isConfigured = [](const std::string& type) { return type == "menu" || type == "GenericList"; };
+    int rebuilt = 0;
+
+    // Drop configured modules and dependencies that disappeared from the file
+    if (oldConfig) {
+        for (const auto& old : oldConfig->getModules()) {
+            if (!newConfig->findModule(old.id)) {
+                if (isConfigured(old.type)) {
+                    m_modules.erase(old.id);
                 }
+                dependencies.setModuleDependencies(old.id, {});
+                LOG_DEBUG("Removed module from config: " + old.id);
             }
         }
+    }
 
-        // Special case for Invert Display option if it's in the options section
-        if (config.contains("options") && config["options"].is_object()) {
-            auto options = config["options"];
-            if (options.contains("invert_display") && options["invert_display"].is_object()) {
-                auto invertOpt = options["invert_display"];
-                if (invertOpt.contains("enabled") && invertOpt["enabled"].get<bool>() &&
-                    invertOpt.contains("title") && invertOpt["title"].is_string()) {
-                    // Add the invert display option with custom title
-                    std::string title = invertOpt["title"].get<std::string>();
-                    m_mainMenu->addItem(std::make_shared<ActionMenuItem>(title, [this]() {
-                        m_display->setInverted(!m_display->isInverted());
-                    }));
-                    Logger::debug("Added invert display option: " + title);
-                }
-            }
+    // Rebuild only the modules whose entry changed
+    for (const auto& module : newConfig->getModules()) {
+        const ScreenConfig::ModuleEntry* old = oldConfig ? oldConfig->findModule(module.id) : nullptr;
+        if (old && *old == module) {
+            continue;
         }
 
-        // Add Exit option at the end
-        //m_mainMenu->addItem(std::make_shared<ActionMenuItem>("Exit", [this]() {
-        //    m_running = false;
-        //}));
-
-        // Debug the menu state
-        Logger::debug("Menu setup complete, about to render");
-
-        // Force a display test
-        m_display->clear();
-        usleep(Config::DISPLAY_CMD_DELAY * 5);
-        m_display->drawText(0, 20, "TESTING DISPLAY");
-        usleep(Config::DISPLAY_CMD_DELAY * 20);
+        if (!old || old->depends != module.depends) {
+            dependencies.setModuleDependencies(module.id, module.depends);
+        }
+        if (old && old->type != module.type && isConfigured(old->type)) {
+            m_modules.erase(module.id);
+        }
+        if (module.hasTitle && isConfigured(module.type)) {
+            createConfiguredModule(module);
+            rebuilt++;
+        }
+    }
 
-        // Initially render the menu
-        m_mainMenu->render();
-        Logger::debug("Menu render called");
-
-        // Mark top-level menu modules
-        for (const auto& modulePair : m_modules) {
-        auto menuModule = std::dynamic_pointer_cast<MenuScreenModule>(modulePair.second);
-        if (menuModule) {
-        // Check if this is a top-level menu (enabled and in the main menu)
-        for (const auto& module : config["modules"]) {
-            if (module.contains("id") && module["id"].get<std::string>() == modulePair.first &&
-                module.contains("enabled") && module["enabled"].get<bool>()) {
-                menuModule->setAsTopLevelMenu(true);
-                Logger::debug("Marked " + modulePair.first + " as top-level menu");
-                break;
+    // Build the main menu off-screen and only swap it in when it actually differs
+    auto candidate = std::make_shared<Menu>(m_display);
+    buildMainMenu(*candidate);
+    std::vector<std::string> current = menuSnapshot(*m_mainMenu);
+    std::vector<std::string> updated = menuSnapshot(*candidate);
+
+    if (updated != current) {
+        // Keep the cursor on the same entry if it still exists
+        auto selected = m_mainMenu->getItem(m_mainMenu->getCurrentSelection());
+        if (selected) {
+            for (size_t i = 0; i < candidate->getItemCount(); i++) {
+                if (candidate->getItem(static_cast<int>(i))->getLabel() == selected->getLabel()) {
+                    candidate->selectWithoutRedraw(static_cast<int>(i));
+                    break;
+                }
             }
-          }
-        }
         }
+        m_mainMenu = candidate;
+        m_mainMenu->render();
 
-        return true;
-    } catch (const std::exception& e) {
-        Logger::error("Error parsing JSON config: " + std::string(e.what()));
-        return false;
+        saveMenuCache(updated);
+        m_cachedMenu = updated;
+    }
+
+    // Config may relocate the persistent data file or change its backend
+    if (!newConfig->getPersistentDataFile().empty() &&
+        newConfig->getPersistentDataFile() != m_config.persistentDataFile) {
+        m_config.persistentDataFile = newConfig->getPersistentDataFile();
+        LOG_INFO("Using persistent data file from config: " + m_config.persistentDataFile);
     }
+    initPersistentStorage();
+
+    LOG_INFO("Config reloaded: " + std::to_string(rebuilt) + " modules rebuilt, main menu " +
+                 (updated != current ? "updated" : "unchanged"));
 }
 
 void MicroPanel::initializeModules()
@@ -473,22 +495,29 @@ void MicroPanel::initializeModules()
     m_modules["brightness"] = std::make_shared<BrightnessScreen>(m_display, m_inputDevice);
     m_modules["network"] = std::make_shared<NetworkInfoScreen>(m_display, m_inputDevice);
     m_modules["system"] = std::make_shared<SystemStatsScreen>(m_display, m_inputDevice);
+    m_modules["storagestats"] = std::make_shared<StorageStatsScreen>(m_display, m_inputDevice);
     m_modules["internet"] = std::make_shared<InternetTestScreen>(m_display, m_inputDevice);
     m_modules["wifi"] = std::make_shared<WiFiSettingsScreen>(m_display, m_inputDevice);
     m_modules["ping"] = std::make_shared<IPPingScreen>(m_display, m_inputDevice);
+    m_modules["sweep"] = std::make_shared<SubnetSweepScreen>(m_display, m_inputDevice);
     m_modules["netinfo"] = std::make_shared<NetInfoScreen>(m_display, m_inputDevice);
+    m_modules["traffic"] = std::make_shared<TrafficMonitorScreen>(m_display, m_inputDevice);
     m_modules["netsettings"] = std::make_shared<NetSettingsScreen>(m_display, m_inputDevice);
     m_modules["speedtest"] = std::make_shared<SpeedTestScreen>(m_display, m_inputDevice); 
     //m_modules["throughputtest"] = std::make_shared<ThroughputTestScreen>(m_display, m_inputDevice); 
     m_modules["throughputserver"] = std::make_shared<ThroughputServerScreen>(m_display, m_inputDevice); 
     m_modules["throughputclient"] = std::make_shared<ThroughputClientScreen>(m_display, m_inputDevice);
-    Logger::debug("Module initialization complete - " + std::to_string(m_modules.size()) + " modules available");
+    LOG_DEBUG("Module initialization complete - " + std::to_string(m_modules.size()) + " modules available");
 }
 
 // New helper method to register a module in the menu
 void MicroPanel::registerModuleInMenu(const std::string& moduleName, const std::string& menuTitle) {
-    m_mainMenu->addItem(std::make_shared<ActionMenuItem>(menuTitle, [this, moduleName]() {
-        std::cout << "Executing action for module: " << moduleName << std::endl;
+    registerModuleInMenu(moduleName, menuTitle, *m_mainMenu);
+}
+
+void MicroPanel::registerModuleInMenu(const std::string& moduleName, const std::string& menuTitle, Menu& menu) {
+    auto item = std::make_shared<ActionMenuItem>(menuTitle, [this, moduleName]() {
+        LOG_INFO("Executing action for module: " + moduleName);
         auto module = std::dynamic_pointer_cast<ScreenModule>(m_modules[moduleName]);
         if (module) {
        	    // Clear main menu flag if this is a menu module
@@ -502,16 +531,48 @@ void MicroPanel::registerModuleInMenu(const std::string& moduleName, const std::
             usleep(Config::DISPLAY_CMD_DELAY * 5);
             m_mainMenu->render();
         } else {
-            Logger::error("Failed to execute module: " + moduleName);
+            LOG_ERROR("Failed to execute module: " + moduleName);
         }
-    }));
+    });
+    // Dependency state is cached and kept current in the background, so this is cheap per render
+    item->setAvailabilityCheck([moduleName]() {
+        return ModuleDependency::getInstance().checkDependencies(moduleName);
+    });
+    menu.addItem(item);
 }
 
 void MicroPanel::setupMenu()
 {
+    showStartupSplash("Initializing...");
+
+    registerModuleInMenu("brightness", "Brightness");
+    registerModuleInMenu("network", "Net Settings");
+    registerModuleInMenu("system", "System Stats");
+    registerModuleInMenu("internet", "Test Internet");
+    registerModuleInMenu("wifi", "WiFi Settings");
+    registerModuleInMenu("ping", "IP Ping");
+    registerModuleInMenu("netinfo", "Net Info");
+    registerModuleInMenu("netsettings", "Net Settings");
+
+    // Add Exit option at the end
+    //m_mainMenu->addItem(std::make_shared<ActionMenuItem>("Exit", [this]() {
+    //    m_running = false;
+    //}));
+
+    // Initially render the menu
+    renderInitialMenu();
+}
+
+void MicroPanel::showStartupSplash(const std::string& status)
+{
+    // Fast boot goes straight to the menu, no settle delay or splash
+    if (m_config.fastBoot) {
+        return;
+    }
+
     // Initial startup delay to make sure device is fully initialized
     usleep(Config::STARTUP_DELAY);
-    std::cout << "Initializing display..." << std::endl;
+    Logger::info("Initializing display...");
 
     // Clear the display
     m_display->clear();
@@ -521,29 +582,102 @@ void MicroPanel::setupMenu()
     m_display->drawText(0, 0, "Menu System");
     usleep(Config::DISPLAY_CMD_DELAY * 10);
 
-    m_display->drawText(0, 10, "Initializing...");
+    m_display->drawText(0, 10, status);
     usleep(Config::DISPLAY_CMD_DELAY * 10);
 
     // Clear before showing menu
     m_display->clear();
     usleep(Config::DISPLAY_CMD_DELAY * 15);
+}
 
-    registerModuleInMenu("brightness", "Brightness");
-    registerModuleInMenu("network", "Net Settings");
-    registerModuleInMenu("system", "System Stats");
-    registerModuleInMenu("internet", "Test Internet");
-    registerModuleInMenu("wifi", "WiFi Settings");
-    registerModuleInMenu("ping", "IP Ping");
-    registerModuleInMenu("netinfo", "Net Info");
-    registerModuleInMenu("netsettings", "Net Settings");
+void MicroPanel::paintCachedMenu()
+{
+    if (m_cachedMenu.empty()) {
+        LOG_DEBUG("No cached main menu available");
+        return;
+    }
 
-    // Add Exit option at the end
-    //m_mainMenu->addItem(std::make_shared<ActionMenuItem>("Exit", [this]() {
-    //    m_running = false;
-    //}));
+    // Render a placeholder menu with the cached labels, actions are attached later
+    Menu cachedMenu(m_display, m_cachedMenu.front());
+    for (size_t i = 1; i < m_cachedMenu.size(); i++) {
+        cachedMenu.addItem(std::make_shared<ActionMenuItem>(m_cachedMenu[i], nullptr));
+    }
+    cachedMenu.render();
 
-    // Initially render the menu
-    m_mainMenu->render();
+    m_cachedMenuPainted = true;
+    StartupTrace::mark("first frame (cached menu)");
+}
+
+void MicroPanel::renderInitialMenu()
+{
+    std::vector<std::string> current = menuSnapshot(*m_mainMenu);
+
+    if (m_cachedMenuPainted && current == m_cachedMenu) {
+        // The panel already shows exactly this menu
+        LOG_DEBUG("Cached main menu is up to date, skipping initial render");
+    } else {
+        m_mainMenu->render();
+        StartupTrace::mark("first frame (main menu)");
+    }
+    m_cachedMenuPainted = false;
+
+    if (current != m_cachedMenu) {
+        saveMenuCache(current);
+        m_cachedMenu = current;
+    }
+    StartupTrace::mark("main menu ready");
+}
+
+std::vector<std::string> MicroPanel::menuSnapshot(const Menu& menu) const
+{
+    // Cache layout: title followed by the item labels
+    std::vector<std::string> snapshot;
+    snapshot.push_back(menu.getTitle());
+    for (size_t i = 0; i < menu.getItemCount(); i++) {
+        snapshot.push_back(menu.getItem(static_cast<int>(i))->getLabel());
+    }
+    return snapshot;
+}
+
+std::vector<std::string> MicroPanel::loadMenuCache() const
+{
+    std::vector<std::string> menu;
+    if (m_config.menuCacheFile.empty()) {
+        return menu;
+    }
+
+    std::ifstream file(m_config.menuCacheFile);
+    std::string line;
+    while (std::getline(file, line)) {
+        menu.push_back(line);
+    }
+    return menu;
+}
+
+void MicroPanel::saveMenuCache(const std::vector<std::string>& menu) const
+{
+    if (m_config.menuCacheFile.empty()) {
+        return;
+    }
+
+    // Write to a temporary file and rename, a torn cache must never reach the panel
+    std::string tempFile = m_config.menuCacheFile + ".tmp";
+    std::ofstream file(tempFile);
+    if (!file.is_open()) {
+        LOG_WARNING("Could not write main menu cache: " + tempFile);
+        return;
+    }
+    for (const auto& line : menu) {
+        file << line << '\n';
+    }
+    file.close();
+
+    if (!file || rename(tempFile.c_str(), m_config.menuCacheFile.c_str()) != 0) {
+        LOG_WARNING("Failed to update main menu cache: " + m_config.menuCacheFile);
+        unlink(tempFile.c_str());
+        return;
+    }
+    LOG_DEBUG("Main menu cache updated: " + m_config.menuCacheFile);
 }
 
 void MicroPanel::run()
@@ -555,6 +689,7 @@ void MicroPanel::run()
     m_running = true;
 
     // Main event loop
+    unsigned dependencyGeneration = ModuleDependency::getInstance().getStateGeneration();
     struct timeval lastBufferFlush = {0, 0};
     struct timeval now;
 
@@ -562,11 +697,11 @@ void MicroPanel::run()
         // Check if device was disconnected
         if (m_deviceManager->isDeviceDisconnected() ||
             m_display->isDisconnected()) {
-            std::cout << "Device disconnection detected!" << std::endl;
+            Logger::info("Device disconnection detected!");
 
             if (m_config.autoDetect) {
                 // For auto-detect mode, try to reconnect
-                std::cout << "Attempting to reconnect..." << std::endl;
+                Logger::info("Attempting to reconnect...");
 
                 // Clean up current devices
                 if (m_inputDevice) {
@@ -584,7 +719,7 @@ void MicroPanel::run()
                 bool reconnected = m_deviceManager->monitorDeviceUntilConnected(m_running);
 
                 if (reconnected) {
-                    std::cout << "Successfully reconnected to device!" << std::endl;
+                    Logger::info("Successfully reconnected to device!");
 
                     // Get new device paths
                     auto devices = m_deviceManager->detectDevices();
@@ -598,7 +733,7 @@ void MicroPanel::run()
                         m_displayDevice = std::make_shared<DisplayDevice>(m_config.serialDevice);
 
                         if (m_inputDevice->open() && m_displayDevice->open()) {
-                            std::cout << "Successfully opened reconnected devices" << std::endl;
+                            Logger::info("Successfully opened reconnected devices");
 
                             // Update display and redraw menu
                             m_display = std::make_shared<Display>(m_displayDevice);
@@ -608,9 +743,11 @@ void MicroPanel::run()
                             // Reinitialize modules with new device handles
                             initializeModules();
 
-                            // Reinitialize menu
+                            // Reinitialize menu, rebuilding configured menus from the loaded config
                             m_mainMenu = std::make_shared<Menu>(m_display);
-                            setupMenu();
+                            if (!m_screenConfig || !loadConfigFromJson()) {
+                                setupMenu();
+                            }
 
                             // Restart the disconnection monitor
                             m_deviceManager->startDisconnectionMonitor();
@@ -618,13 +755,13 @@ void MicroPanel::run()
                             // Continue with the main loop
                             continue;
                         } else {
-                            std::cerr << "Failed to open reconnected devices" << std::endl;
+                            Logger::error("Failed to open reconnected devices");
                         }
                     } else {
-                        std::cerr << "Failed to get device paths after reconnection" << std::endl;
+                        Logger::error("Failed to get device paths after reconnection");
                     }
                 } else {
-                    std::cerr << "Failed to reconnect to device" << std::endl;
+                    Logger::error("Failed to reconnect to device");
                 }
             }
 
@@ -646,6 +783,20 @@ void MicroPanel::run()
             );
         }
 
+        // Apply config edits while sitting in the main menu
+        if (m_configWatcher && m_configWatcher->checkForChanges()) {
+            reloadConfig();
+        }
+
+        // Redraw when a module becomes available or unavailable
+        unsigned generation = ModuleDependency::getInstance().getStateGeneration();
+        if (generation != dependencyGeneration) {
+            dependencyGeneration = generation;
+            if (m_display->isPoweredOn()) {
+                m_mainMenu->render();
+            }
+        }
+
         // Check for power save timeout
         if (m_config.powerSaveEnabled) {
             m_display->checkPowerSaveTimeout();
@@ -672,6 +823,21 @@ void MicroPanel::shutdown()
 {
     // Stop disconnection monitor
     m_deviceManager->stopDisconnectionMonitor();
+
+    // Stop dependency verification and monitoring
+    ModuleDependency::getInstance().stopMonitoring();
+
+    // Write back pending settings and stop the storage flusher
+    PersistentStorage::getInstance().shutdown();
+
+    // Stop the helper shell used by list and settings screens
+    ScriptHelper::getInstance().shutdown();
+
+    // Say goodbye for services still announced over mDNS
+    MulticastDns::getInstance().shutdown();
+
+    // Stop the trace export thread
+    TraceRecorder::stopExportThread();
     
     // Display shutdown message
     if (m_display && m_displayDevice->isOpen()) {
@@ -699,12 +865,21 @@ void MicroPanel::shutdown()
         m_mainMenu->clear();
     }
     
-    std::cout << "MicroPanel shutdown complete" << std::endl;
+    Logger::info("MicroPanel shutdown complete");
 }
 
 // Main entry point
 int main(int argc, char* argv[])
 {
+    // Keep log writes off the UI thread (drained again at exit)
+    Logger::startAsync();
+
+    // "kill -USR1 <pid>" writes the recent trace events for chrome://tracing, and a
+    // readable view of the storage
+    TraceRecorder::startExportThread(Config::TRACE_EXPORT_PATH, []() {
+        PersistentStorage::getInstance().exportSnapshots();
+    });
+
     MicroPanel app(argc, argv);
     
     if (!app.initialize()) {
@@ -725,28 +900,23 @@ bool MicroPanel::initPersistentStorage() {
         return false;
     }
     
+    PersistentStorage::Options options;
+    if (m_screenConfig) {
+        options.backend = PersistentStorage::parseBackend(m_screenConfig->getPersistentBackend());
+        options.format = PersistentStorage::parseFormat(m_screenConfig->getPersistentFormat());
+    }
+
     auto& storage = PersistentStorage::getInstance();
-    return storage.initialize(m_config.persistentDataFile);
+    return storage.initialize(m_config.persistentDataFile, options);
 }
 
-// Load module dependencies from JSON configuration
+// Load module dependencies from the compiled configuration
 bool MicroPanel::loadModuleDependencies() {
-    try {
-        // Open the file
-        std::ifstream configFile(m_config.configFile);
-        if (!configFile.is_open()) {
-            Logger::error("Could not open config file: " + m_config.configFile);
-            return false;
-        }
-        
-        // Parse JSON
-        json config = json::parse(configFile);
-        
-        // Load dependencies
-        auto& dependencies = ModuleDependency::getInstance();
-        return dependencies.loadDependencies(config);
-    } catch (const std::exception& e) {
-        Logger::error("Error loading module dependencies: " + std::string(e.what()));
+    if (!m_screenConfig) {
+        LOG_ERROR("No valid configuration loaded from: " + m_config.configFile);
         return false;
     }
+
+    auto& dependencies = ModuleDependency::getInstance();
+    return dependencies.loadDependencies(*m_screenConfig);
 }
@@ -1,6 +1,15 @@
 #include "ModuleDependency.h"
+#include "ScreenConfig.h"
+#include "Config.h"
 #include "Logger.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
 // Static instance for singleton
 ModuleDependency& ModuleDependency::getInstance() {
     static ModuleDependency instance;
@@ -11,53 +20,375 @@ ModuleDependency::ModuleDependency() {
     // Initialize with empty dependencies
 }
 
-bool ModuleDependency::loadDependencies(const nlohmann::json& config) {
-    try {
-        // Check for modules array
-        if (!config.contains("modules") || !config["modules"].is_array()) {
-            Logger::warning("No modules array found in configuration");
-            return false;
+ModuleDependency::~ModuleDependency() {
+    stopMonitoring();
+}
+
+bool ModuleDependency::loadDependencies(const ScreenConfig& config) {
+    // Clear existing dependencies
+    m_dependencies.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_modulePaths.clear();
+        m_moduleAvailable.clear();
+    }
+
+    // Dependencies were validated when the config was compiled
+    for (const auto& module : config.getModules()) {
+        for (const auto& dep : module.depends) {
+            m_dependencies[module.id][dep.first] = dep.second;
+            LOG_DEBUG("Registered dependency for " + module.id + ": " + dep.first + " -> " + dep.second);
+        }
+        indexModule(module.id);
+    }
+
+    // Resolve file dependencies in the background
+    startVerification();
+
+    Logger::info("Module dependencies loaded successfully");
+    return true;
+}
+
+void ModuleDependency::setModuleDependencies(const std::string& moduleId,
+                                             const std::map<std::string, std::string>& dependencies) {
+    if (dependencies.empty()) {
+        m_dependencies.erase(moduleId);
+    } else {
+        m_dependencies[moduleId] = dependencies;
+    }
+    indexModule(moduleId);
+    startVerification();
+    LOG_DEBUG("Updated dependencies for " + moduleId + " (" + std::to_string(dependencies.size()) + " entries)");
+}
+
+std::string ModuleDependency::resolveCheckPath(const std::string& value) {
+    // URLs are not verified (checked when the module actually uses them)
+    if (value.compare(0, 7, "http://") == 0 || value.compare(0, 8, "https://") == 0) {
+        return "";
+    }
+
+    // Expand a leading $VAR or ${VAR}, as the shell would when the script is run
+    std::string path = value;
+    if (!path.empty() && path[0] == '$') {
+        bool braced = path.size() > 1 && path[1] == '{';
+        size_t nameStart = braced ? 2 : 1;
+        size_t nameEnd = braced ? path.find('}') : path.find('/');
+        if (nameEnd == std::string::npos) {
+            nameEnd = path.size();
+        }
+        const char* env = getenv(path.substr(nameStart, nameEnd - nameStart).c_str());
+        if (!env) {
+            // Can't be verified without the environment the scripts run in
+            return "";
+        }
+        path = std::string(env) + path.substr(braced ? nameEnd + 1 : nameEnd);
+    }
+
+    // Plain settings such as ports or interface names are not files
+    return (!path.empty() && path[0] == '/') ? path : "";
+}
+
+void ModuleDependency::indexModule(const std::string& moduleId) {
+    std::vector<std::string> paths;
+    auto moduleIt = m_dependencies.find(moduleId);
+    if (moduleIt != m_dependencies.end()) {
+        for (const auto& dep : moduleIt->second) {
+            std::string path = resolveCheckPath(dep.second);
+            if (!path.empty()) {
+                paths.push_back(path);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    if (paths.empty()) {
+        m_modulePaths.erase(moduleId);
+    } else {
+        for (const auto& path : paths) {
+            m_paths.emplace(path, PathState());
+        }
+        m_modulePaths[moduleId] = paths;
+    }
+}
+
+void ModuleDependency::updateModuleStates() {
+    // Caller holds m_stateMutex
+    bool changed = false;
+    for (const auto& module : m_modulePaths) {
+        bool available = true;
+        for (const auto& path : module.second) {
+            if (!m_paths[path].exists) {
+                available = false;
+                break;
+            }
+        }
+
+        auto it = m_moduleAvailable.find(module.first);
+        if (it == m_moduleAvailable.end() || it->second != available) {
+            m_moduleAvailable[module.first] = available;
+            changed = true;
+            if (!available) {
+                LOG_WARNING("Dependencies not satisfied for module: " + module.first);
+            } else if (it != m_moduleAvailable.end()) {
+                LOG_INFO("Dependencies now satisfied for module: " + module.first);
+            }
+        }
+    }
+
+    // Modules that no longer have file dependencies are always available
+    for (auto it = m_moduleAvailable.begin(); it != m_moduleAvailable.end(); ) {
+        if (m_modulePaths.find(it->first) == m_modulePaths.end()) {
+            changed = changed || !it->second;
+            it = m_moduleAvailable.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (changed) {
+        m_generation++;
+    }
+}
+
+void ModuleDependency::startVerification() {
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        pruneStalePaths();
+        for (const auto& path : m_paths) {
+            if (!path.second.verified) {
+                pending.push_back(path.first);
+            }
+        }
+        updateModuleStates();
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    // Start the inotify monitor before checking, so no change slips in between
+    if (!m_monitorRunning) {
+        m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotifyFd >= 0) {
+            m_monitorRunning = true;
+            m_monitorThread = std::thread(&ModuleDependency::monitorThread, this);
+        } else {
+            LOG_WARNING("Dependency monitoring unavailable: " + std::string(strerror(errno)));
         }
+    }
+    for (const auto& path : pending) {
+        watchPath(path);
+    }
+
+    // One verification batch at a time
+    if (m_verifyThread.joinable()) {
+        m_verifyThread.join();
+    }
+    m_verifyThread = std::thread(&ModuleDependency::verifyPaths, this, pending);
+}
 
-        // Clear existing dependencies
-        m_dependencies.clear();
-        
-        // Process modules
-        for (const auto& module : config["modules"]) {
-            // Check for required fields
-            if (!module.contains("id") || !module["id"].is_string()) {
-                Logger::warning("Skipping module with missing or invalid id");
-                continue;
+void ModuleDependency::verifyPaths(std::vector<std::string> paths) {
+    // Check paths concurrently so one slow (e.g. NFS) path doesn't hold up the rest
+    std::vector<char> results(paths.size(), 0);
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next{0};
+    size_t workerCount = std::min(paths.size(), static_cast<size_t>(Config::DEPENDENCY_VERIFY_THREADS));
+
+    for (size_t w = 0; w < workerCount; w++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < paths.size()) {
+                results[i] = access(paths[i].c_str(), F_OK) == 0;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    for (size_t i = 0; i < paths.size(); i++) {
+        auto it = m_paths.find(paths[i]);
+        if (it != m_paths.end()) {
+            it->second.exists = results[i] != 0;
+            it->second.verified = true;
+            if (!it->second.exists) {
+                LOG_WARNING("Dependency not satisfied: " + paths[i]);
             }
-            
-            // Get module ID
-            std::string moduleId = module["id"].get<std::string>();
-            
-            // Check for dependencies
-            if (module.contains("depends") && module["depends"].is_object()) {
-                // Process dependencies
-                for (auto it = module["depends"].begin(); it != module["depends"].end(); ++it) {
-                    std::string key = it.key();
-                    
-                    // Only process string dependencies
-                    if (it.value().is_string()) {
-                        std::string path = it.value().get<std::string>();
-                        
-                        // Store dependency
-                        m_dependencies[moduleId][key] = path;
-                        Logger::debug("Registered dependency for " + moduleId + ": " + key + " -> " + path);
-                    } else {
-                        Logger::warning("Ignoring non-string dependency '" + key + "' for module " + moduleId);
+        }
+    }
+    updateModuleStates();
+    LOG_DEBUG("Verified " + std::to_string(paths.size()) + " dependency paths");
+}
+
+std::string ModuleDependency::parentDirectory(const std::string& path) {
+    size_t lastSlash = path.find_last_of('/');
+    return (lastSlash == 0 || lastSlash == std::string::npos) ? "/" : path.substr(0, lastSlash);
+}
+
+void ModuleDependency::watchPath(const std::string& path) {
+    if (m_inotifyFd < 0) {
+        return;
+    }
+
+    // Watch the directory so creation of a missing file is noticed too. While the
+    // directory doesn't exist its nearest existing ancestor is watched instead, and
+    // the watch moves down as the directories below it appear.
+    std::string dir = parentDirectory(path);
+    while (dir != "/" && access(dir.c_str(), F_OK) != 0) {
+        dir = parentDirectory(dir);
+    }
+
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(),
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                               IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0) {
+        LOG_DEBUG("Cannot watch dependency directory " + dir + ": " + strerror(errno));
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_watchedDirs[wd] = dir;
+    auto it = m_paths.find(path);
+    int previous = -1;
+    if (it != m_paths.end()) {
+        previous = it->second.watchDescriptor;
+        it->second.watchDescriptor = wd;
+    }
+    // Drops the new watch too if the path was pruned meanwhile
+    if (previous >= 0 && previous != wd) {
+        releaseWatch(previous);
+    }
+    releaseWatch(wd);
+}
+
+void ModuleDependency::releaseWatch(int wd) {
+    for (const auto& path : m_paths) {
+        if (path.second.watchDescriptor == wd) {
+            return;
+        }
+    }
+    // Already gone when the directory was deleted; the IN_IGNORED that follows is skipped
+    inotify_rm_watch(m_inotifyFd, wd);
+    m_watchedDirs.erase(wd);
+}
+
+void ModuleDependency::pruneStalePaths() {
+    // Paths of modules removed or changed by a config reload are no longer checked
+    std::set<std::string> used;
+    for (const auto& module : m_modulePaths) {
+        used.insert(module.second.begin(), module.second.end());
+    }
+    for (auto it = m_paths.begin(); it != m_paths.end(); ) {
+        if (used.count(it->first)) {
+            ++it;
+            continue;
+        }
+        int wd = it->second.watchDescriptor;
+        LOG_DEBUG("No longer watching dependency path " + it->first);
+        it = m_paths.erase(it);
+        if (wd >= 0 && m_inotifyFd >= 0) {
+            releaseWatch(wd);
+        }
+    }
+}
+
+void ModuleDependency::monitorThread() {
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (m_monitorRunning) {
+        struct pollfd pfd = {m_inotifyFd, POLLIN, 0};
+        if (poll(&pfd, 1, Config::DEPENDENCY_MONITOR_POLL_MS) <= 0) {
+            continue;
+        }
+
+        // Collect the paths touched by this batch of events, and those whose watch has to move
+        std::set<std::string> touched;
+        std::set<std::string> rewatch;
+        ssize_t len;
+        while ((len = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            for (char* ptr = buffer; ptr < buffer + len; ) {
+                auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+                ptr += sizeof(struct inotify_event) + event->len;
+                auto dirIt = m_watchedDirs.find(event->wd);
+                if (dirIt == m_watchedDirs.end()) {
+                    continue;
+                }
+                const std::string dir = dirIt->second;
+
+                // The watched directory went away: everything below it is re-checked and
+                // watched again from the nearest ancestor that still exists
+                bool dirGone = (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0;
+                if (event->mask & IN_IGNORED) {
+                    m_watchedDirs.erase(dirIt);
+                }
+
+                for (auto& path : m_paths) {
+                    if (path.second.watchDescriptor != event->wd) {
+                        continue;
+                    }
+                    if (dirGone) {
+                        if (event->mask & IN_IGNORED) {
+                            path.second.watchDescriptor = -1;
+                        }
+                        touched.insert(path.first);
+                        rewatch.insert(path.first);
+                        continue;
+                    }
+                    if (event->len == 0) {
+                        continue;
+                    }
+                    // The event names the next component of the path below the watched directory
+                    size_t start = dir.size() + (dir == "/" ? 0 : 1);
+                    size_t end = path.first.find('/', start);
+                    size_t length = end == std::string::npos ? std::string::npos : end - start;
+                    if (path.first.compare(start, length, event->name) != 0) {
+                        continue;
+                    }
+                    touched.insert(path.first);
+                    if (end != std::string::npos) {
+                        // A directory on the way to a missing dependency appeared or went
+                        rewatch.insert(path.first);
                     }
                 }
             }
         }
-        
-        Logger::info("Module dependencies loaded successfully");
-        return true;
-    } catch (const std::exception& e) {
-        Logger::error("Error loading module dependencies: " + std::string(e.what()));
-        return false;
+
+        for (const auto& path : rewatch) {
+            watchPath(path);
+        }
+
+        // Re-check only what changed
+        for (const auto& path : touched) {
+            bool exists = access(path.c_str(), F_OK) == 0;
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            auto it = m_paths.find(path);
+            if (it != m_paths.end() && it->second.exists != exists) {
+                it->second.exists = exists;
+                LOG_DEBUG("Dependency path " + path + (exists ? " appeared" : " disappeared"));
+            }
+        }
+        if (!touched.empty()) {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            updateModuleStates();
+        }
+    }
+}
+
+void ModuleDependency::stopMonitoring() {
+    if (m_verifyThread.joinable()) {
+        m_verifyThread.join();
+    }
+    if (m_monitorRunning) {
+        m_monitorRunning = false;
+        if (m_monitorThread.joinable()) {
+            m_monitorThread.join();
+        }
+    }
+    if (m_inotifyFd >= 0) {
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
     }
 }
 
@@ -106,31 +437,10 @@ bool ModuleDependency::checkDependencies(const std::string& moduleId) {
         return true;
     }
 
-    // If the module has no dependencies, they're satisfied by default
-    auto moduleIt = m_dependencies.find(moduleId);
-    if (moduleIt == m_dependencies.end()) {
-        return true;
-    }
-
-    // For each dependency, check if it exists
-    for (const auto& dep : moduleIt->second) {
-        std::string key = dep.first;
-        std::string path = dep.second;
-
-        // Skip URL dependencies (http:// or https://)
-        if (path.substr(0, 7) == "http://" || path.substr(0, 8) == "https://") {
-            Logger::debug("Skipping URL dependency check for: " + path);
-            continue;
-        }
-
-        // Check if file exists
-        if (access(path.c_str(), F_OK) != 0) {
-            Logger::warning("Dependency not satisfied: " + path + " for module " + moduleId);
-            return true;  // Changed to true as per your code comment
-        }
-    }
-
-    return true;
+    // Modules without file dependencies, or not yet verified, are available
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    auto it = m_moduleAvailable.find(moduleId);
+    return it == m_moduleAvailable.end() || it->second;
 }
 
 bool ModuleDependency::shouldSkipDependencyCheck(const std::string& moduleId) {
@@ -0,0 +1,1053 @@
+#include "MulticastDns.h"
+#include "InterfaceMonitor.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const uint16_t s_port = 5353;
+const char s_group[] = "224.0.0.251";
+
+const uint16_t s_typeA = 1;
+const uint16_t s_typePtr = 12;
+const uint16_t s_typeTxt = 16;
+const uint16_t s_typeSrv = 33;
+const uint16_t s_typeAny = 255;
+const uint16_t s_classIn = 1;
+const uint16_t s_classAny = 255;
+
+// Top bit of the class: cache flush in records, unicast response wanted in questions
+const uint16_t s_classTopBit = 0x8000;
+
+const uint16_t s_flagResponse = 0x8000;
+const uint16_t s_flagAuthoritative = 0x0400;
+const uint16_t s_opcodeMask = 0x7800;
+
+// Queries not sent from port 5353 come from plain resolvers, which get short-lived answers
+const uint32_t s_legacyTtl = 10;
+
+// A record is multicast on an interface at most once in this span
+const int s_multicastSpacingMs = 1000;
+
+const size_t s_headerSize = 12;
+const size_t s_maxPacket = 9000;
+const size_t s_maxLabel = 63;
+const size_t s_maxName = 255;
+const size_t s_maxText = 255;
+const int s_maxPointerJumps = 16;
+const int s_packetsPerWake = 32;
+
+// Records of one announced service, in the order serviceRecords() produces them
+enum ServiceRecord { SERVICE_PTR, SERVICE_SRV, SERVICE_TXT, SERVICE_A, SERVICE_ENUMERATION };
+
+const char* const s_enumerationName[] = {"_services", "_dns-sd", "_udp", "local"};
+
+std::atomic<uint64_t> s_traceIds{0};
+
+std::string lowered(const std::string& text) {
+    std::string result = text;
+    for (auto& c : result) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return result;
+}
+
+// DNS names compare case-insensitively; labels may contain dots, so they are kept apart by NULs
+std::string nameKey(const std::vector<std::string>& name) {
+    std::string key;
+    for (const auto& label : name) {
+        key += lowered(label);
+        key += '\0';
+    }
+    return key;
+}
+
+std::string nameText(const std::vector<std::string>& name) {
+    std::string text;
+    for (const auto& label : name) {
+        text += (text.empty() ? "" : ".") + label;
+    }
+    return text;
+}
+
+// "_iperf3._tcp" becomes "_iperf3", "_tcp", "local"
+bool parseServiceType(const std::string& type, std::vector<std::string>& name) {
+    size_t dot = type.find('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string service = type.substr(0, dot);
+    std::string protocol = lowered(type.substr(dot + 1));
+    if (service.size() < 2 || service.size() > 16 || service[0] != '_' ||
+        (protocol != "_tcp" && protocol != "_udp")) {
+        return false;
+    }
+    name = {service, protocol, "local"};
+    return true;
+}
+
+uint16_t read16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+uint32_t read32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 |
+           static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+void append16(std::string& out, uint16_t value) {
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value & 0xff);
+}
+
+void append32(std::string& out, uint32_t value) {
+    append16(out, static_cast<uint16_t>(value >> 16));
+    append16(out, static_cast<uint16_t>(value & 0xffff));
+}
+
+// Written uncompressed, the packets stay small enough without
+void appendName(std::string& out, const std::vector<std::string>& name) {
+    for (const auto& label : name) {
+        size_t length = std::min(label.size(), s_maxLabel);
+        out += static_cast<char>(length);
+        out.append(label, 0, length);
+    }
+    out += '\0';
+}
+
+// Follows compression pointers; offset ends up behind the name where it started
+bool readName(const uint8_t* data, size_t size, size_t& offset, std::vector<std::string>& name) {
+    name.clear();
+    size_t position = offset;
+    size_t total = 0;
+    int jumps = 0;
+    bool jumped = false;
+    for (;;) {
+        if (position >= size) {
+            return false;
+        }
+        uint8_t length = data[position];
+        if ((length & 0xc0) == 0xc0) {
+            if (position + 1 >= size || ++jumps > s_maxPointerJumps) {
+                return false;
+            }
+            if (!jumped) {
+                offset = position + 2;
+                jumped = true;
+            }
+            position = static_cast<size_t>(length & 0x3f) << 8 | data[position + 1];
+            continue;
+        }
+        if (length & 0xc0) {
+            return false;
+        }
+        position++;
+        if (length == 0) {
+            break;
+        }
+        total += length + 1;
+        if (position + length > size || total > s_maxName) {
+            return false;
+        }
+        name.emplace_back(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+    }
+    if (!jumped) {
+        offset = position;
+    }
+    return true;
+}
+
+std::string formatAddress(uint32_t address) {
+    char text[INET_ADDRSTRLEN] = "";
+    inet_ntop(AF_INET, &address, text, sizeof(text));
+    return text;
+}
+
+} // namespace
+
+struct MulticastDns::Record {
+    Name name;
+    uint16_t type = 0;
+    bool cacheFlush = false;        // Unique to this host, caches drop what they had for the name
+    uint32_t ttl = 0;
+    Name target;                    // PTR and SRV
+    uint16_t port = 0;              // SRV
+    std::vector<std::string> txt;
+    uint32_t address = 0;           // A, network byte order
+
+    bool sameAs(const Record& other) const {
+        return type == other.type && port == other.port && address == other.address && txt == other.txt &&
+               nameKey(name) == nameKey(other.name) && nameKey(target) == nameKey(other.target);
+    }
+};
+
+struct MulticastDns::Message {
+    struct Question {
+        Name name;
+        uint16_t type = 0;
+        bool unicast = false;       // QU bit, the asker wants the answer sent back to it
+    };
+
+    uint16_t id = 0;
+    uint16_t flags = 0;
+    std::vector<Question> questions;
+    std::vector<Record> records;    // Of all sections, those of types handled here
+    size_t answerCount = 0;         // Leading records from the answer section
+};
+
+// Builds one DNS message section by section
+class MulticastDns::Writer {
+public:
+    Writer(uint16_t id, uint16_t flags) : m_id(id), m_flags(flags) {}
+
+    void question(const Name& name, uint16_t type) {
+        appendName(m_questions, name);
+        append16(m_questions, type);
+        append16(m_questions, s_classIn);
+        m_questionCount++;
+    }
+
+    void answer(const Record& record) {
+        appendRecord(m_answers, record);
+        m_answerCount++;
+    }
+
+    void additional(const Record& record) {
+        appendRecord(m_additionals, record);
+        m_additionalCount++;
+    }
+
+    std::string finish() const {
+        std::string packet;
+        append16(packet, m_id);
+        append16(packet, m_flags);
+        append16(packet, m_questionCount);
+        append16(packet, m_answerCount);
+        append16(packet, 0);
+        append16(packet, m_additionalCount);
+        return packet + m_questions + m_answers + m_additionals;
+    }
+
+private:
+    static void appendRecord(std::string& out, const Record& record) {
+        appendName(out, record.name);
+        append16(out, record.type);
+        append16(out, s_classIn | (record.cacheFlush ? s_classTopBit : 0));
+        append32(out, record.ttl);
+
+        std::string data;
+        switch (record.type) {
+            case s_typeA:
+                data.append(reinterpret_cast<const char*>(&record.address), sizeof(record.address));
+                break;
+            case s_typePtr:
+                appendName(data, record.target);
+                break;
+            case s_typeSrv:
+                append16(data, 0);      // Priority
+                append16(data, 0);      // Weight
+                append16(data, record.port);
+                appendName(data, record.target);
+                break;
+            case s_typeTxt:
+                for (const auto& text : record.txt) {
+                    size_t length = std::min(text.size(), s_maxText);
+                    data += static_cast<char>(length);
+                    data.append(text, 0, length);
+                }
+                // A TXT record can't be empty, no strings is one empty string
+                if (record.txt.empty()) {
+                    data += '\0';
+                }
+                break;
+        }
+        append16(out, static_cast<uint16_t>(data.size()));
+        out += data;
+    }
+
+    uint16_t m_id;
+    uint16_t m_flags;
+    uint16_t m_questionCount = 0;
+    uint16_t m_answerCount = 0;
+    uint16_t m_additionalCount = 0;
+    std::string m_questions;
+    std::string m_answers;
+    std::string m_additionals;
+};
+
+MulticastDns& MulticastDns::getInstance() {
+    static MulticastDns instance;
+    return instance;
+}
+
+MulticastDns::~MulticastDns() {
+    shutdown();
+}
+
+bool MulticastDns::announce(const Service& service) {
+    Announced announced;
+    announced.service = service;
+    if (!parseServiceType(service.type, announced.typeName) || service.instance.empty() ||
+        service.port <= 0 || service.port > 65535) {
+        LOG_ERROR("MulticastDns: can't announce '" + service.instance + "' as " + service.type +
+                  " on port " + std::to_string(service.port));
+        return false;
+    }
+    announced.instanceName = announced.typeName;
+    announced.instanceName.insert(announced.instanceName.begin(), service.instance.substr(0, s_maxLabel));
+    announced.announcementsLeft = Config::MDNS_ANNOUNCEMENTS;
+    announced.announceIntervalMs = Config::MDNS_ANNOUNCE_INTERVAL_MS;
+    announced.nextAnnouncement = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!start()) {
+        return false;
+    }
+    std::string key = nameKey(announced.instanceName);
+    auto existing = std::find_if(m_services.begin(), m_services.end(), [&key](const Announced& other) {
+        return nameKey(other.instanceName) == key;
+    });
+    if (existing != m_services.end()) {
+        *existing = announced;
+    } else {
+        m_services.push_back(announced);
+    }
+    LOG_INFO("MulticastDns: announcing '" + service.instance + "' " + service.type +
+             " on port " + std::to_string(service.port));
+    wake();
+    return true;
+}
+
+void MulticastDns::withdraw(const std::string& instance, const std::string& type) {
+    Name instanceName;
+    if (!parseServiceType(type, instanceName)) {
+        return;
+    }
+    instanceName.insert(instanceName.begin(), instance.substr(0, s_maxLabel));
+    std::string key = nameKey(instanceName);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto existing = std::find_if(m_services.begin(), m_services.end(), [&key](const Announced& announced) {
+        return nameKey(announced.instanceName) == key;
+    });
+    if (existing == m_services.end()) {
+        return;
+    }
+    sendAnnouncement(*existing, true);
+    m_services.erase(existing);
+    LOG_INFO("MulticastDns: withdrew '" + instance + "' " + type);
+}
+
+bool MulticastDns::browse(const std::string& type, int durationMs) {
+    Name typeName;
+    if (!parseServiceType(type, typeName)) {
+        LOG_ERROR("MulticastDns: can't browse for malformed service type " + type);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!start()) {
+        return false;
+    }
+    if (m_browsing) {
+        TraceRecorder::asyncEnd("net", "mdns-browse", m_traceId);
+    }
+    auto now = std::chrono::steady_clock::now();
+    m_browsing = true;
+    m_browseTypeText = type;
+    m_browseType = typeName;
+    m_browseEnds = now + std::chrono::milliseconds(durationMs);
+    m_nextQuery = now;
+    m_queryIntervalMs = Config::MDNS_QUERY_INTERVAL_MS;
+    m_resolving.clear();
+    m_addresses.clear();
+    m_found.clear();
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    TraceRecorder::asyncBegin("net", "mdns-browse", m_traceId, type.c_str());
+    LOG_INFO("MulticastDns: browsing for " + type);
+    wake();
+    return true;
+}
+
+void MulticastDns::stopBrowsing() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_browsing) {
+        m_browsing = false;
+        TraceRecorder::asyncEnd("net", "mdns-browse", m_traceId);
+        LOG_INFO("MulticastDns: browse for " + m_browseTypeText + " stopped");
+    }
+}
+
+bool MulticastDns::poll(std::vector<Found>& found) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    found.insert(found.end(), m_found.begin(), m_found.end());
+    m_found.clear();
+    return m_browsing;
+}
+
+void MulticastDns::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fd < 0) {
+            return;
+        }
+        for (const auto& announced : m_services) {
+            sendAnnouncement(announced, true);
+        }
+        m_services.clear();
+        if (m_browsing) {
+            m_browsing = false;
+            TraceRecorder::asyncEnd("net", "mdns-browse", m_traceId);
+        }
+    }
+
+    m_stopRequested = true;
+    wake();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close(m_fd);
+    close(m_wakeFd);
+    m_fd = -1;
+    m_wakeFd = -1;
+    m_links.clear();
+    m_lastMulticast.clear();
+}
+
+bool MulticastDns::start() {
+    if (m_fd >= 0) {
+        return true;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("MulticastDns: socket failed: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Avahi may hold the port as well; multicast reaches every socket bound to it
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    struct sockaddr_in local {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(s_port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        LOG_ERROR("MulticastDns: binding port 5353 failed: " + std::string(strerror(errno)));
+        close(fd);
+        return false;
+    }
+
+    // The interface a query arrived on decides which address answers it. Looped back
+    // multicast lets a browse find this host's own services.
+    int ttl = 255;
+    setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        LOG_ERROR("MulticastDns: eventfd failed: " + std::string(strerror(errno)));
+        close(fd);
+        return false;
+    }
+    m_fd = fd;
+
+    char host[HOST_NAME_MAX + 1] = "";
+    gethostname(host, sizeof(host) - 1);
+    m_hostLabel = std::string(host).substr(0, std::string(host).find('.'));
+    if (m_hostLabel.empty()) {
+        m_hostLabel = "micropanel";
+    }
+
+    // Joined on the worker's first round
+    m_links.clear();
+    m_linkGeneration = UINT64_MAX;
+    m_stopRequested = false;
+    m_worker = std::thread(&MulticastDns::run, this);
+    LOG_INFO("MulticastDns: responding as " + m_hostLabel + ".local");
+    return true;
+}
+
+void MulticastDns::run() {
+    while (!m_stopRequested) {
+        int waitMs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            refreshLinks();
+            auto now = std::chrono::steady_clock::now();
+            sendDue(now);
+            waitMs = nextWaitMs(now);
+        }
+
+        struct pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+        if (::poll(fds, 2, waitMs) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("MulticastDns: poll failed: " + std::string(strerror(errno)));
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t value;
+            ssize_t ignored = read(m_wakeFd, &value, sizeof(value));
+            (void)ignored;
+        }
+        if (fds[0].revents & POLLIN) {
+            receive();
+        }
+    }
+}
+
+void MulticastDns::refreshLinks() {
+    auto& monitor = InterfaceMonitor::getInstance();
+    uint64_t generation = monitor.poll();
+    if (generation == m_linkGeneration) {
+        return;
+    }
+    m_linkGeneration = generation;
+
+    struct ip_mreqn request {};
+    inet_pton(AF_INET, s_group, &request.imr_multiaddr);
+
+    std::vector<Link> links;
+    bool changed = false;
+    auto snapshot = monitor.getSnapshot();
+    for (const auto& interface : *snapshot) {
+        const InterfaceMonitor::Address* address = interface.firstAddress(AF_INET);
+        if (interface.isLoopback() || !interface.isUp() || !(interface.flags & IFF_MULTICAST) || !address) {
+            continue;
+        }
+        Link link;
+        link.index = interface.index;
+        if (inet_pton(AF_INET, address->address.c_str(), &link.address) != 1) {
+            continue;
+        }
+
+        auto joined = std::find_if(m_links.begin(), m_links.end(), [&link](const Link& other) {
+            return other.index == link.index;
+        });
+        if (joined == m_links.end()) {
+            request.imr_ifindex = link.index;
+            if (setsockopt(m_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0 && errno != EADDRINUSE) {
+                LOG_WARNING("MulticastDns: joining the group on " + interface.name + " failed: " +
+                            std::string(strerror(errno)));
+                continue;
+            }
+            LOG_DEBUG("MulticastDns: listening on " + interface.name);
+            changed = true;
+        } else if (joined->address != link.address) {
+            changed = true;
+        }
+        links.push_back(link);
+    }
+
+    for (const auto& link : m_links) {
+        bool kept = std::any_of(links.begin(), links.end(), [&link](const Link& other) {
+            return other.index == link.index;
+        });
+        if (!kept) {
+            // Fails when the interface is gone, the membership went with it
+            request.imr_ifindex = link.index;
+            setsockopt(m_fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &request, sizeof(request));
+        }
+    }
+    m_links = links;
+
+    // A new link or address hasn't heard of the services yet
+    if (changed) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& announced : m_services) {
+            announced.announcementsLeft = Config::MDNS_ANNOUNCEMENTS;
+            announced.announceIntervalMs = Config::MDNS_ANNOUNCE_INTERVAL_MS;
+            announced.nextAnnouncement = now;
+        }
+    }
+}
+
+void MulticastDns::receive() {
+    char buffer[s_maxPacket];
+    char control[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    for (int i = 0; i < s_packetsPerWake; i++) {
+        struct sockaddr_in from {};
+        struct iovec vector = {buffer, sizeof(buffer)};
+        struct msghdr message {};
+        message.msg_name = &from;
+        message.msg_namelen = sizeof(from);
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t size = recvmsg(m_fd, &message, 0);
+        if (size < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_WARNING("MulticastDns: receive failed: " + std::string(strerror(errno)));
+            }
+            return;
+        }
+
+        int index = 0;
+        for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_PKTINFO) {
+                struct in_pktinfo info;
+                memcpy(&info, CMSG_DATA(header), sizeof(info));
+                index = info.ipi_ifindex;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        handlePacket(buffer, static_cast<size_t>(size), from, index, std::chrono::steady_clock::now());
+    }
+}
+
+void MulticastDns::handlePacket(const char* data, size_t size, const struct sockaddr_in& from, int index,
+                                TimePoint now) {
+    Message message;
+    if (!parse(data, size, message)) {
+        LOG_DEBUG("MulticastDns: malformed packet from " + formatAddress(from.sin_addr.s_addr));
+        return;
+    }
+
+    if (message.flags & s_flagResponse) {
+        if (m_browsing) {
+            readResponse(message, from);
+        }
+        return;
+    }
+
+    if ((message.flags & s_opcodeMask) != 0 || m_services.empty()) {
+        return;
+    }
+    auto link = std::find_if(m_links.begin(), m_links.end(), [index](const Link& other) {
+        return other.index == index;
+    });
+    if (link != m_links.end()) {
+        answerQuery(message, from, *link, now);
+    }
+}
+
+void MulticastDns::answerQuery(const Message& query, const struct sockaddr_in& from, const Link& link,
+                               TimePoint now) {
+    bool legacy = ntohs(from.sin_port) != s_port;
+    bool unicast = legacy;
+
+    std::vector<Record> answers;
+    std::vector<Record> additionals;
+    for (const auto& question : query.questions) {
+        unicast = unicast || question.unicast;
+        std::string key = nameKey(question.name);
+        for (const auto& announced : m_services) {
+            std::vector<Record> records;
+            serviceRecords(announced, link, records);
+            for (size_t i = 0; i < records.size(); i++) {
+                if ((question.type != s_typeAny && question.type != records[i].type) || nameKey(records[i].name) != key) {
+                    continue;
+                }
+                answers.push_back(records[i]);
+
+                // What it takes to connect goes along, saving the asker further queries
+                if (i == SERVICE_PTR) {
+                    additionals.push_back(records[SERVICE_SRV]);
+                    additionals.push_back(records[SERVICE_TXT]);
+                    additionals.push_back(records[SERVICE_A]);
+                } else if (i == SERVICE_SRV) {
+                    additionals.push_back(records[SERVICE_A]);
+                }
+            }
+        }
+    }
+
+    // Known-answer suppression: the asker lists what it has cached, and still fresh entries aren't repeated
+    auto known = [&query](const Record& record) {
+        for (size_t i = 0; i < query.answerCount; i++) {
+            if (query.records[i].sameAs(record) && query.records[i].ttl >= record.ttl / 2) {
+                return true;
+            }
+        }
+        return false;
+    };
+    answers.erase(std::remove_if(answers.begin(), answers.end(), known), answers.end());
+
+    if (!unicast) {
+        auto recent = [this, &link, now](const Record& record) {
+            std::string key = std::to_string(link.index) + '\0' + nameKey(record.name) + std::to_string(record.type);
+            auto last = m_lastMulticast.find(key);
+            if (last != m_lastMulticast.end() && now - last->second < std::chrono::milliseconds(s_multicastSpacingMs)) {
+                return true;
+            }
+            m_lastMulticast[key] = now;
+            return false;
+        };
+        answers.erase(std::remove_if(answers.begin(), answers.end(), recent), answers.end());
+    }
+    if (answers.empty()) {
+        return;
+    }
+
+    Writer writer(legacy ? query.id : 0, s_flagResponse | s_flagAuthoritative);
+    if (legacy) {
+        // A plain resolver checks the answer against its question
+        for (const auto& question : query.questions) {
+            writer.question(question.name, question.type);
+        }
+    }
+    std::vector<Record> written;
+    auto add = [&written, &writer, legacy](Record record, bool additional) {
+        for (const auto& other : written) {
+            if (other.sameAs(record)) {
+                return;
+            }
+        }
+        written.push_back(record);
+        if (legacy) {
+            record.ttl = std::min(record.ttl, s_legacyTtl);
+            record.cacheFlush = false;
+        }
+        if (additional) {
+            writer.additional(record);
+        } else {
+            writer.answer(record);
+        }
+    };
+    for (const auto& record : answers) {
+        add(record, false);
+    }
+    for (const auto& record : additionals) {
+        add(record, true);
+    }
+
+    if (unicast) {
+        sendTo(writer.finish(), link, from);
+    } else {
+        sendMulticast(writer.finish(), link);
+    }
+}
+
+void MulticastDns::readResponse(const Message& response, const struct sockaddr_in& from) {
+    std::string typeKey = nameKey(m_browseType);
+    auto isInstance = [this, &typeKey](const Name& name) {
+        return name.size() == m_browseType.size() + 1 && nameKey(Name(name.begin() + 1, name.end())) == typeKey;
+    };
+
+    for (const auto& record : response.records) {
+        if (record.type == s_typeA) {
+            if (record.ttl > 0) {
+                m_addresses[nameKey(record.name)] = record.address;
+            }
+            continue;
+        }
+
+        const Name* instance = nullptr;
+        if (record.type == s_typePtr && nameKey(record.name) == typeKey && isInstance(record.target)) {
+            instance = &record.target;
+        } else if ((record.type == s_typeSrv || record.type == s_typeTxt) && isInstance(record.name)) {
+            instance = &record.name;
+        }
+        if (!instance) {
+            continue;
+        }
+
+        std::string key = nameKey(*instance);
+        if (record.ttl == 0) {
+            // Goodbye; an instance already listed stays there
+            auto resolving = m_resolving.find(key);
+            if (record.type == s_typePtr && resolving != m_resolving.end() && !resolving->second.reported) {
+                m_resolving.erase(resolving);
+            }
+            continue;
+        }
+
+        Resolving& resolving = m_resolving[key];
+        resolving.instanceName = *instance;
+        resolving.found.instance = instance->front();
+        resolving.found.type = m_browseTypeText;
+        if (record.type == s_typeSrv) {
+            resolving.haveService = true;
+            resolving.found.host = nameText(record.target);
+            resolving.found.port = record.port;
+            resolving.targetKey = nameKey(record.target);
+            resolving.sender = from.sin_addr.s_addr;
+        } else if (record.type == s_typeTxt) {
+            resolving.found.txt = record.txt;
+        }
+    }
+
+    Writer resolve(0, 0);
+    bool resolveQueried = false;
+    for (auto& entry : m_resolving) {
+        Resolving& resolving = entry.second;
+        if (!resolving.haveService) {
+            // The PTR came alone, ask the instance for the rest
+            if (!resolving.queried) {
+                resolve.question(resolving.instanceName, s_typeSrv);
+                resolve.question(resolving.instanceName, s_typeTxt);
+                resolving.queried = true;
+                resolveQueried = true;
+            }
+            continue;
+        }
+        if (resolving.reported) {
+            continue;
+        }
+
+        // Responders send the A record along with the SRV; without it the sender is the host
+        auto address = m_addresses.find(resolving.targetKey);
+        resolving.found.address = formatAddress(address != m_addresses.end() ? address->second : resolving.sender);
+        resolving.reported = true;
+        m_found.push_back(resolving.found);
+        LOG_INFO("MulticastDns: found '" + resolving.found.instance + "' at " + resolving.found.address +
+                 ":" + std::to_string(resolving.found.port));
+    }
+    if (resolveQueried) {
+        std::string packet = resolve.finish();
+        for (const auto& link : m_links) {
+            sendMulticast(packet, link);
+        }
+    }
+}
+
+void MulticastDns::sendDue(TimePoint now) {
+    for (auto& announced : m_services) {
+        if (announced.announcementsLeft > 0 && now >= announced.nextAnnouncement) {
+            sendAnnouncement(announced, false);
+            announced.announcementsLeft--;
+            announced.nextAnnouncement = now + std::chrono::milliseconds(announced.announceIntervalMs);
+            announced.announceIntervalMs *= 2;
+        }
+    }
+
+    if (!m_browsing) {
+        return;
+    }
+    if (now >= m_browseEnds) {
+        m_browsing = false;
+        TraceRecorder::asyncEnd("net", "mdns-browse", m_traceId);
+        LOG_INFO("MulticastDns: browse for " + m_browseTypeText + " ended");
+    } else if (now >= m_nextQuery) {
+        sendBrowseQuery();
+        m_nextQuery = now + std::chrono::milliseconds(m_queryIntervalMs);
+        m_queryIntervalMs *= 2;
+    }
+}
+
+void MulticastDns::sendAnnouncement(const Announced& announced, bool goodbye) {
+    for (const auto& link : m_links) {
+        std::vector<Record> records;
+        serviceRecords(announced, link, records);
+        Writer writer(0, s_flagResponse | s_flagAuthoritative);
+        for (size_t i = 0; i < records.size(); i++) {
+            // The host name may still be in use by other services, only the service's records go
+            if (goodbye && i == SERVICE_A) {
+                continue;
+            }
+            if (goodbye) {
+                records[i].ttl = 0;
+            }
+            writer.answer(records[i]);
+        }
+        sendMulticast(writer.finish(), link);
+    }
+}
+
+void MulticastDns::sendBrowseQuery() {
+    Writer writer(0, 0);
+    writer.question(m_browseType, s_typePtr);
+    std::string packet = writer.finish();
+    for (const auto& link : m_links) {
+        sendMulticast(packet, link);
+    }
+}
+
+void MulticastDns::serviceRecords(const Announced& announced, const Link& link, std::vector<Record>& records) const {
+    Name host = {m_hostLabel, "local"};
+
+    Record pointer;
+    pointer.name = announced.typeName;
+    pointer.type = s_typePtr;
+    pointer.ttl = Config::MDNS_SERVICE_TTL;
+    pointer.target = announced.instanceName;
+    records.push_back(pointer);
+
+    Record service;
+    service.name = announced.instanceName;
+    service.type = s_typeSrv;
+    service.cacheFlush = true;
+    service.ttl = Config::MDNS_HOST_TTL;
+    service.port = static_cast<uint16_t>(announced.service.port);
+    service.target = host;
+    records.push_back(service);
+
+    Record text;
+    text.name = announced.instanceName;
+    text.type = s_typeTxt;
+    text.cacheFlush = true;
+    text.ttl = Config::MDNS_SERVICE_TTL;
+    text.txt = announced.service.txt;
+    records.push_back(text);
+
+    Record address;
+    address.name = host;
+    address.type = s_typeA;
+    address.cacheFlush = true;
+    address.ttl = Config::MDNS_HOST_TTL;
+    address.address = link.address;
+    records.push_back(address);
+
+    // Lets "every service type on the network" browsers see this one
+    Record enumeration;
+    enumeration.name.assign(std::begin(s_enumerationName), std::end(s_enumerationName));
+    enumeration.type = s_typePtr;
+    enumeration.ttl = Config::MDNS_SERVICE_TTL;
+    enumeration.target = announced.typeName;
+    records.push_back(enumeration);
+}
+
+bool MulticastDns::sendTo(const std::string& packet, const Link& link, const struct sockaddr_in& to) {
+    if (sendto(m_fd, packet.data(), packet.size(), MSG_DONTWAIT, reinterpret_cast<const struct sockaddr*>(&to),
+               sizeof(to)) < 0) {
+        LOG_DEBUG("MulticastDns: send on interface " + std::to_string(link.index) + " failed: " +
+                  std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}
+
+bool MulticastDns::sendMulticast(const std::string& packet, const Link& link) {
+    struct ip_mreqn request {};
+    request.imr_ifindex = link.index;
+    setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request));
+
+    struct sockaddr_in to {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(s_port);
+    inet_pton(AF_INET, s_group, &to.sin_addr);
+    return sendTo(packet, link, to);
+}
+
+int MulticastDns::nextWaitMs(TimePoint now) const {
+    TimePoint next = now + std::chrono::milliseconds(Config::MDNS_LINK_CHECK_MS);
+    for (const auto& announced : m_services) {
+        if (announced.announcementsLeft > 0) {
+            next = std::min(next, announced.nextAnnouncement);
+        }
+    }
+    if (m_browsing) {
+        next = std::min(next, std::min(m_nextQuery, m_browseEnds));
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+    return static_cast<int>(std::max<decltype(wait)>(wait, 0));
+}
+
+void MulticastDns::wake() {
+    if (m_wakeFd >= 0) {
+        uint64_t value = 1;
+        ssize_t ignored = write(m_wakeFd, &value, sizeof(value));
+        (void)ignored;
+    }
+}
+
+bool MulticastDns::parse(const char* data, size_t size, Message& message) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    if (size < s_headerSize) {
+        return false;
+    }
+    message.id = read16(bytes);
+    message.flags = read16(bytes + 2);
+    int questions = read16(bytes + 4);
+    int answers = read16(bytes + 6);
+    int records = answers + read16(bytes + 8) + read16(bytes + 10);
+
+    size_t offset = s_headerSize;
+    for (int i = 0; i < questions; i++) {
+        Message::Question question;
+        if (!readName(bytes, size, offset, question.name) || offset + 4 > size) {
+            return false;
+        }
+        question.type = read16(bytes + offset);
+        uint16_t questionClass = read16(bytes + offset + 2);
+        offset += 4;
+        question.unicast = (questionClass & s_classTopBit) != 0;
+        questionClass &= ~s_classTopBit;
+        if (questionClass == s_classIn || questionClass == s_classAny) {
+            message.questions.push_back(question);
+        }
+    }
+
+    for (int i = 0; i < records; i++) {
+        Record record;
+        if (!readName(bytes, size, offset, record.name) || offset + 10 > size) {
+            return false;
+        }
+        record.type = read16(bytes + offset);
+        uint16_t recordClass = read16(bytes + offset + 2);
+        record.ttl = read32(bytes + offset + 4);
+        size_t length = read16(bytes + offset + 8);
+        offset += 10;
+        if (offset + length > size) {
+            return false;
+        }
+        size_t end = offset + length;
+        record.cacheFlush = (recordClass & s_classTopBit) != 0;
+
+        bool keep = (recordClass & ~s_classTopBit) == s_classIn;
+        size_t at = offset;
+        if (keep) {
+            switch (record.type) {
+                case s_typeA:
+                    keep = length == sizeof(record.address);
+                    if (keep) {
+                        memcpy(&record.address, bytes + offset, sizeof(record.address));
+                    }
+                    break;
+                case s_typePtr:
+                    keep = readName(bytes, size, at, record.target);
+                    break;
+                case s_typeSrv:
+                    at += 6;
+                    keep = length > 6 && readName(bytes, size, at, record.target);
+                    if (keep) {
+                        record.port = read16(bytes + offset + 4);
+                    }
+                    break;
+                case s_typeTxt:
+                    while (keep && at < end) {
+                        size_t textLength = bytes[at++];
+                        keep = at + textLength <= end;
+                        if (keep && textLength > 0) {
+                            record.txt.emplace_back(reinterpret_cast<const char*>(bytes + at), textLength);
+                        }
+                        at += textLength;
+                    }
+                    break;
+                default:
+                    keep = false;
+            }
+        }
+        offset = end;
+
+        if (keep) {
+            message.records.push_back(record);
+        }
+        if (i < answers) {
+            message.answerCount = message.records.size();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,442 @@
+#include "NetlinkConfig.h"
+#include "InterfaceMonitor.h"
+#include "IcmpPinger.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t s_receiveBufferSize = 32768;
+
+// The kernel answers at once, this only guards against a wedged socket
+const int s_replyTimeoutMs = 1000;
+
+// Header, family message, then attributes
+struct Request {
+    struct nlmsghdr header;
+    union {
+        struct ifaddrmsg address;
+        struct rtmsg route;
+    } body;
+    char attributes[128];
+};
+
+void addAttribute(Request& request, int type, const void* data, size_t size) {
+    struct rtattr* attribute = reinterpret_cast<struct rtattr*>(
+        reinterpret_cast<char*>(&request) + NLMSG_ALIGN(request.header.nlmsg_len));
+    attribute->rta_type = static_cast<unsigned short>(type);
+    attribute->rta_len = static_cast<unsigned short>(RTA_LENGTH(size));
+    memcpy(RTA_DATA(attribute), data, size);
+    request.header.nlmsg_len = NLMSG_ALIGN(request.header.nlmsg_len) + RTA_ALIGN(attribute->rta_len);
+}
+
+uint32_t prefixMask(int prefixLength) {
+    return htonl(prefixLength <= 0 ? 0 : 0xFFFFFFFFu << (32 - std::min(prefixLength, 32)));
+}
+
+// The same strict dotted quad parser as everywhere else, in network byte order
+bool parseAddress(const std::string& text, uint32_t& address) {
+    struct sockaddr_in parsed;
+    if (!IcmpSocket::parseAddress(text, parsed)) {
+        return false;
+    }
+    address = parsed.sin_addr.s_addr;
+    return true;
+}
+
+std::string formatAddress(uint32_t address) {
+    struct in_addr in;
+    in.s_addr = address;
+    return inet_ntoa(in);
+}
+
+int interfaceIndex(const std::string& name) {
+    for (const auto& interface : *InterfaceMonitor::getInstance().getSnapshot()) {
+        if (interface.name == name) {
+            return interface.index;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+// Netlink socket that sends one request at a time and waits for its answer
+class NetlinkConfig::Socket {
+public:
+    Socket() {
+        m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (m_fd < 0) {
+            LOG_ERROR("NetlinkConfig: netlink socket failed: " + std::string(strerror(errno)));
+            return;
+        }
+        struct timeval timeout = {s_replyTimeoutMs / 1000, (s_replyTimeoutMs % 1000) * 1000};
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    ~Socket() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool isOpen() const { return m_fd >= 0; }
+
+    // 0 once the kernel acknowledged the change, otherwise a negative errno
+    int request(Request& request) {
+        request.header.nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+        int result = -EIO;
+        exchange(request.header, [&result](const struct nlmsghdr* message) {
+            if (message->nlmsg_type == NLMSG_ERROR) {
+                result = static_cast<const struct nlmsgerr*>(NLMSG_DATA(message))->error;
+                return true;
+            }
+            return false;
+        });
+        return result;
+    }
+
+    // Every message of an RTM_GET* dump goes to handler
+    bool dump(int type, int family, const std::function<void(const struct nlmsghdr*)>& handler) {
+        Request request {};
+        request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+        request.header.nlmsg_type = static_cast<uint16_t>(type);
+        request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        request.body.route.rtm_family = static_cast<unsigned char>(family);
+
+        bool ok = false;
+        bool answered = exchange(request.header, [&](const struct nlmsghdr* message) {
+            if (message->nlmsg_type == NLMSG_DONE) {
+                ok = true;
+                return true;
+            }
+            if (message->nlmsg_type == NLMSG_ERROR) {
+                return true;
+            }
+            handler(message);
+            return false;
+        });
+        return answered && ok;
+    }
+
+private:
+    // Send a request and hand its replies to handler until it returns true
+    bool exchange(struct nlmsghdr& header, const std::function<bool(const struct nlmsghdr*)>& handler) {
+        if (m_fd < 0) {
+            return false;
+        }
+        header.nlmsg_seq = ++m_sequence;
+
+        struct sockaddr_nl kernel {};
+        kernel.nl_family = AF_NETLINK;
+        if (sendto(m_fd, &header, header.nlmsg_len, 0,
+                   reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+            LOG_ERROR("NetlinkConfig: netlink send failed: " + std::string(strerror(errno)));
+            return false;
+        }
+
+        std::vector<char> buffer(s_receiveBufferSize);
+        while (true) {
+            ssize_t received = recv(m_fd, buffer.data(), buffer.size(), 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                LOG_ERROR("NetlinkConfig: no netlink answer: " + std::string(strerror(errno)));
+                return false;
+            }
+
+            const struct nlmsghdr* message = reinterpret_cast<const struct nlmsghdr*>(buffer.data());
+            int length = static_cast<int>(received);
+            for (; NLMSG_OK(message, length); message = NLMSG_NEXT(message, length)) {
+                if (message->nlmsg_seq == m_sequence && handler(message)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    int m_fd = -1;
+    uint32_t m_sequence = 0;
+};
+
+int NetlinkConfig::netmaskToPrefix(const std::string& netmask) {
+    uint32_t mask;
+    if (!parseAddress(netmask, mask)) {
+        return -1;
+    }
+    mask = ntohl(mask);
+
+    // Contiguous ones from the top: inverting leaves a value one below a power of two
+    uint32_t inverted = ~mask;
+    if ((inverted & (inverted + 1)) != 0) {
+        return -1;
+    }
+    int prefixLength = 0;
+    while (mask & 0x80000000u) {
+        prefixLength++;
+        mask <<= 1;
+    }
+    return prefixLength;
+}
+
+bool NetlinkConfig::readAddresses(int index, std::vector<Address>& addresses) {
+    addresses.clear();
+    for (const auto& interface : *InterfaceMonitor::getInstance().getSnapshot()) {
+        if (interface.index != index) {
+            continue;
+        }
+        for (const auto& entry : interface.addresses) {
+            Address address;
+            if (entry.family == AF_INET && parseAddress(entry.address, address.address)) {
+                address.prefixLength = entry.prefixLength;
+                addresses.push_back(address);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool NetlinkConfig::readDefaultRoutes(Socket& socket, int index, std::vector<Route>& routes) {
+    routes.clear();
+    return socket.dump(RTM_GETROUTE, AF_INET, [&](const struct nlmsghdr* message) {
+        if (message->nlmsg_type != RTM_NEWROUTE) {
+            return;
+        }
+        const struct rtmsg* info = static_cast<const struct rtmsg*>(NLMSG_DATA(message));
+        if (info->rtm_family != AF_INET || info->rtm_dst_len != 0 || info->rtm_type != RTN_UNICAST) {
+            return;
+        }
+
+        Route route;
+        route.protocol = info->rtm_protocol;
+        uint32_t table = info->rtm_table;
+        int outputIndex = 0;
+        int length = static_cast<int>(RTM_PAYLOAD(message));
+        for (const struct rtattr* attribute = RTM_RTA(info); RTA_OK(attribute, length);
+             attribute = RTA_NEXT(attribute, length)) {
+            if (RTA_PAYLOAD(attribute) < sizeof(uint32_t)) {
+                continue;
+            }
+            switch (attribute->rta_type) {
+                case RTA_TABLE:
+                    memcpy(&table, RTA_DATA(attribute), sizeof(table));
+                    break;
+                case RTA_OIF:
+                    memcpy(&outputIndex, RTA_DATA(attribute), sizeof(outputIndex));
+                    break;
+                case RTA_GATEWAY:
+                    memcpy(&route.gateway, RTA_DATA(attribute), sizeof(route.gateway));
+                    break;
+                case RTA_PRIORITY:
+                    memcpy(&route.priority, RTA_DATA(attribute), sizeof(route.priority));
+                    break;
+            }
+        }
+        if (table == RT_TABLE_MAIN && outputIndex == index) {
+            routes.push_back(route);
+        }
+    });
+}
+
+bool NetlinkConfig::read(const std::string& interface, Ipv4Settings& settings) {
+    settings = Ipv4Settings();
+
+    int index = interfaceIndex(interface);
+    if (index == 0) {
+        LOG_WARNING("NetlinkConfig: no interface " + interface);
+        return false;
+    }
+
+    for (const auto& entry : *InterfaceMonitor::getInstance().getSnapshot()) {
+        if (entry.index != index) {
+            continue;
+        }
+        const InterfaceMonitor::Address* address = entry.firstAddress(AF_INET);
+        if (address) {
+            settings.address = address->address;
+            settings.prefixLength = address->prefixLength;
+            settings.leased = !(address->flags & IFA_F_PERMANENT);
+        }
+    }
+
+    Socket socket;
+    std::vector<Route> routes;
+    if (!readDefaultRoutes(socket, index, routes)) {
+        return false;
+    }
+
+    // The preferred default route is the one with the lowest metric
+    auto best = std::min_element(routes.begin(), routes.end(), [](const Route& a, const Route& b) {
+        return a.priority < b.priority;
+    });
+    if (best != routes.end() && best->gateway != 0) {
+        settings.gateway = formatAddress(best->gateway);
+    }
+    return true;
+}
+
+bool NetlinkConfig::applyStatic(const std::string& interface, const std::string& address, int prefixLength,
+                                const std::string& gateway, std::string& error) {
+    Address wanted;
+    uint32_t wantedGateway = 0;
+    if (!parseAddress(address, wanted.address) || prefixLength < 1 || prefixLength > 32) {
+        error = "invalid address";
+        return false;
+    }
+    wanted.prefixLength = prefixLength;
+    if (!gateway.empty() && !parseAddress(gateway, wantedGateway)) {
+        error = "invalid gateway";
+        return false;
+    }
+
+    int index = interfaceIndex(interface);
+    Socket socket;
+    std::vector<Address> oldAddresses;
+    std::vector<Route> oldRoutes;
+    if (index == 0 || !readAddresses(index, oldAddresses)) {
+        error = "no interface " + interface;
+        return false;
+    }
+    if (!socket.isOpen() || !readDefaultRoutes(socket, index, oldRoutes)) {
+        error = "netlink unavailable";
+        return false;
+    }
+
+    auto addressRequest = [index](int type, int flags, const Address& entry) {
+        Request request {};
+        request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+        request.header.nlmsg_type = static_cast<uint16_t>(type);
+        request.header.nlmsg_flags = static_cast<uint16_t>(flags);
+        request.body.address.ifa_family = AF_INET;
+        request.body.address.ifa_prefixlen = static_cast<unsigned char>(entry.prefixLength);
+        request.body.address.ifa_scope = RT_SCOPE_UNIVERSE;
+        request.body.address.ifa_index = static_cast<uint32_t>(index);
+        addAttribute(request, IFA_LOCAL, &entry.address, sizeof(entry.address));
+        addAttribute(request, IFA_ADDRESS, &entry.address, sizeof(entry.address));
+        if (type == RTM_NEWADDR && entry.prefixLength < 31) {
+            uint32_t broadcast = entry.address | ~prefixMask(entry.prefixLength);
+            addAttribute(request, IFA_BROADCAST, &broadcast, sizeof(broadcast));
+        }
+        return request;
+    };
+
+    auto routeRequest = [index](int type, int flags, const Route& route) {
+        Request request {};
+        request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+        request.header.nlmsg_type = static_cast<uint16_t>(type);
+        request.header.nlmsg_flags = static_cast<uint16_t>(flags);
+        request.body.route.rtm_family = AF_INET;
+        request.body.route.rtm_table = RT_TABLE_MAIN;
+        if (type == RTM_NEWROUTE) {
+            request.body.route.rtm_protocol = route.protocol;
+            request.body.route.rtm_scope = RT_SCOPE_UNIVERSE;
+            request.body.route.rtm_type = RTN_UNICAST;
+        } else {
+            // Left unspecified, a delete matches whatever the route was added with
+            request.body.route.rtm_scope = RT_SCOPE_NOWHERE;
+        }
+        if (route.gateway != 0) {
+            addAttribute(request, RTA_GATEWAY, &route.gateway, sizeof(route.gateway));
+        }
+        addAttribute(request, RTA_OIF, &index, sizeof(index));
+        if (route.priority != 0) {
+            addAttribute(request, RTA_PRIORITY, &route.priority, sizeof(route.priority));
+        }
+        return request;
+    };
+
+    // What each step changed, undone in reverse when a later one is refused
+    std::vector<Request> undo;
+    bool ok = true;
+
+    // Old addresses go first; the kernel drops the routes that relied on them
+    for (const Address& old : oldAddresses) {
+        if (!ok || (old.address == wanted.address && old.prefixLength == wanted.prefixLength)) {
+            continue;
+        }
+        Request remove = addressRequest(RTM_DELADDR, 0, old);
+        int result = socket.request(remove);
+        if (result == 0 || result == -EADDRNOTAVAIL) {
+            // Also gone when a primary took its secondaries with it; a restored lease
+            // comes back without its lifetime until the DHCP client renews it
+            undo.push_back(addressRequest(RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, old));
+        } else {
+            error = "remove " + formatAddress(old.address) + ": " + strerror(-result);
+            ok = false;
+        }
+    }
+
+    bool present = std::any_of(oldAddresses.begin(), oldAddresses.end(), [&wanted](const Address& old) {
+        return old.address == wanted.address && old.prefixLength == wanted.prefixLength;
+    });
+    if (ok && !present) {
+        Request add = addressRequest(RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL, wanted);
+        int result = socket.request(add);
+        if (result == 0) {
+            undo.push_back(addressRequest(RTM_DELADDR, 0, wanted));
+        } else {
+            error = "add " + formatAddress(wanted.address) + ": " + strerror(-result);
+            ok = false;
+        }
+    }
+
+    // Default routes through this interface that survived are replaced by the new one
+    std::vector<Route> routes;
+    if (ok && !readDefaultRoutes(socket, index, routes)) {
+        error = "route dump failed";
+        ok = false;
+    }
+    for (const Route& route : routes) {
+        if (!ok) {
+            break;
+        }
+        Request remove = routeRequest(RTM_DELROUTE, 0, route);
+        int result = socket.request(remove);
+        if (result != 0 && result != -ESRCH) {
+            error = "remove default route: " + std::string(strerror(-result));
+            ok = false;
+        }
+    }
+
+    if (ok && wantedGateway != 0) {
+        Route route;
+        route.gateway = wantedGateway;
+        route.protocol = RTPROT_STATIC;
+        Request add = routeRequest(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, route);
+        int result = socket.request(add);
+        if (result == 0) {
+            undo.push_back(routeRequest(RTM_DELROUTE, 0, route));
+        } else {
+            error = "add default route via " + formatAddress(wantedGateway) + ": " + strerror(-result);
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        LOG_INFO("NetlinkConfig: " + interface + " set to " + formatAddress(wanted.address) + "/" +
+                 std::to_string(prefixLength) + (wantedGateway ? " via " + formatAddress(wantedGateway) : ""));
+        return true;
+    }
+
+    // Roll back, then put back the default routes the old addresses took down with them
+    LOG_WARNING("NetlinkConfig: " + interface + ": " + error + ", rolling back");
+    for (auto step = undo.rbegin(); step != undo.rend(); ++step) {
+        socket.request(*step);
+    }
+    for (const Route& route : oldRoutes) {
+        Request restore = routeRequest(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, route);
+        socket.request(restore);
+    }
+    return false;
+}
@@ -1,13 +1,20 @@
 #include "PersistentStorage.h"
 #include "Logger.h"
+#include "TraceRecorder.h"
 #include <fstream>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cerrno>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <libgen.h>
+#include <ctime>
 
 // Helper function to check if file exists
 bool fileExists(const std::string& path) {
@@ -40,6 +47,66 @@ bool renameFile(const std::string& oldPath, const std::string& newPath) {
     return rename(oldPath.c_str(), newPath.c_str()) == 0;
 }
 
+// Write all bytes to a file descriptor, retrying partial writes
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// CRC-32 (IEEE 802.3) for journal records
+static uint32_t crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void putU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint32_t getU32(const uint8_t* in) {
+    return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) |
+           (static_cast<uint32_t>(in[2]) << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+// Journal record: payload length, CRC-32 of the payload, then [moduleId, key, value] as CBOR
+static constexpr size_t JOURNAL_HEADER_SIZE = 8;
+
+static void encodeJournalRecord(std::string& out, const std::string& moduleId, const std::string& key,
+                                const nlohmann::json& value) {
+    std::vector<uint8_t> payload = nlohmann::json::to_cbor(nlohmann::json::array({moduleId, key, value}));
+    putU32(out, static_cast<uint32_t>(payload.size()));
+    putU32(out, crc32(payload.data(), payload.size()));
+    out.append(payload.begin(), payload.end());
+}
+
 // Static instance for singleton
 PersistentStorage& PersistentStorage::getInstance() {
     static PersistentStorage instance;
@@ -47,27 +114,131 @@ PersistentStorage& PersistentStorage::getInstance() {
 }
 
 PersistentStorage::PersistentStorage() 
-    : m_initialized(false), m_isDirty(false), m_savePending(false) {
+    : m_initialized(false), m_isDirty(false) {
     // Nothing to do in constructor
 }
 
 PersistentStorage::~PersistentStorage() {
     // Ensure pending changes are saved when object is destroyed
-    if (m_isDirty && m_initialized) {
+    shutdown();
+}
+
+void PersistentStorage::setFlushPolicy(const FlushPolicy& policy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+    m_flushCondition.notify_one();
+}
+
+void PersistentStorage::shutdown() {
+    bool flush;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopFlusher = true;
+        flush = m_policy.flushOnShutdown;
+        m_flushCondition.notify_one();
+    }
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+    if (flush) {
         saveToFile();
     }
+
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+    saveIoStats();
+}
+
+PersistentStorage::Backend PersistentStorage::parseBackend(const std::string& name) {
+    return name == "journal" ? Backend::JOURNAL : Backend::SNAPSHOT;
+}
+
+PersistentStorage::Format PersistentStorage::parseFormat(const std::string& name) {
+    if (name == "cbor") {
+        return Format::CBOR;
+    }
+    if (name == "msgpack") {
+        return Format::MSGPACK;
+    }
+    return Format::JSON;
+}
+
+std::string PersistentStorage::formatPath(const std::string& basePath, Format format) {
+    if (format == Format::JSON) {
+        return basePath;
+    }
+
+    // settings.json -> settings.cbor
+    std::string stem = basePath;
+    size_t lastSlash = stem.find_last_of('/');
+    size_t lastDot = stem.find_last_of('.');
+    if (lastDot != std::string::npos && (lastSlash == std::string::npos || lastDot > lastSlash)) {
+        stem = stem.substr(0, lastDot);
+    }
+    return stem + (format == Format::CBOR ? ".cbor" : ".msgpack");
+}
+
+// Serialize the whole document in the given format
+static std::string encodeSnapshot(const nlohmann::json& data, PersistentStorage::Format format) {
+    std::vector<uint8_t> bytes;
+    switch (format) {
+        case PersistentStorage::Format::CBOR:
+            bytes = nlohmann::json::to_cbor(data);
+            break;
+        case PersistentStorage::Format::MSGPACK:
+            bytes = nlohmann::json::to_msgpack(data);
+            break;
+        case PersistentStorage::Format::JSON:
+            return data.dump(2);
+    }
+    return std::string(bytes.begin(), bytes.end());
+}
+
+// Parse a whole document in the given format, throws nlohmann::json::exception on bad input
+static nlohmann::json decodeSnapshot(const std::string& content, PersistentStorage::Format format) {
+    switch (format) {
+        case PersistentStorage::Format::CBOR:
+            return nlohmann::json::from_cbor(content);
+        case PersistentStorage::Format::MSGPACK:
+            return nlohmann::json::from_msgpack(content);
+        case PersistentStorage::Format::JSON:
+            break;
+    }
+    return nlohmann::json::parse(content);
 }
 
 bool PersistentStorage::initialize(const std::string& filePath) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    // If already initialized with the same path, just return success
-    if (m_initialized && m_storageFilePath == filePath) {
-        return true;
+    return initialize(filePath, Options());
+}
+
+bool PersistentStorage::initialize(const std::string& filePath, const Options& options) {
+    // Write out changes that belong to the previous file before switching
+    bool switchingFile;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        switchingFile = m_initialized && !filePath.empty() && m_storageFilePath != filePath;
     }
+    if (switchingFile) {
+        saveToFile();
+        std::lock_guard<std::mutex> saveLock(m_saveMutex);
+        saveIoStats();
+    }
+
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+    std::lock_guard<std::mutex> lock(m_mutex);
     
-    // If no file path provided and already initialized, keep using current path
-    if (filePath.empty() && m_initialized) {
+    // If already initialized with the same path, just apply changed options
+    if (m_initialized && (m_storageFilePath == filePath || filePath.empty())) {
+        if (options != m_options) {
+            if (options.format != m_options.format) {
+                m_legacyFilePath = formatPath(m_storageFilePath, m_options.format);
+            }
+            m_options = options;
+            // A full rewrite brings the file in line with the new backend
+            m_pendingChanges.clear();
+            m_isDirty = true;
+            m_firstChangeTime = m_lastChangeTime = std::chrono::steady_clock::now();
+            m_flushCondition.notify_one();
+        }
         return true;
     }
     
@@ -79,18 +250,22 @@ bool PersistentStorage::initialize(const std::string& filePath) {
     
     // Set the new file path
     m_storageFilePath = filePath;
+    m_options = options;
+    m_pendingChanges.clear();
+    m_legacyFilePath.clear();
+    m_isDirty = false;
     
     // Create parent directory if it doesn't exist
     try {
         std::string parentPath = getParentPath(m_storageFilePath);
         if (!parentPath.empty() && !directoryExists(parentPath)) {
             if (!createDirectory(parentPath)) {
-                Logger::error("Failed to create directory for storage file: " + parentPath);
+                LOG_ERROR("Failed to create directory for storage file: " + parentPath);
                 return false;
             }
         }
     } catch (const std::exception& e) {
-        Logger::error("Failed to create directory for storage file: " + std::string(e.what()));
+        LOG_ERROR("Failed to create directory for storage file: " + std::string(e.what()));
         return false;
     }
 
@@ -102,22 +277,64 @@ bool PersistentStorage::initialize(const std::string& filePath) {
         // This is not an error - it could be the first run
         Logger::info("Starting with empty persistent storage (file not found or invalid)");
     }
+
+    // Write history of this storage file
+    loadIoStats();
+
+    // Changes journaled after the last snapshot
+    m_journalBytes = 0;
+    size_t replayed = replayJournal();
+    if ((replayed > 0 && m_options.backend == Backend::SNAPSHOT) || !m_legacyFilePath.empty()) {
+        // Fold the journal into the file and drop it, or migrate to the configured format
+        m_isDirty = true;
+        m_firstChangeTime = m_lastChangeTime = std::chrono::steady_clock::now();
+        m_flushCondition.notify_one();
+    }
     
     m_initialized = true;
+
+    // Every handle has to re-read from the newly loaded data
+    for (auto& resolved : m_slots) {
+        resolved.second->version.fetch_add(1, std::memory_order_release);
+    }
+
+    // Start the write-back thread once
+    if (!m_flusher.joinable()) {
+        m_stopFlusher = false;
+        m_flusher = std::thread(&PersistentStorage::flushThread, this);
+    }
     return true;
 }
 
 bool PersistentStorage::loadFromFile() {
+    // Caller holds m_saveMutex and m_mutex
+    // The configured format first, then the others so a format change migrates the data
+    const Format formats[] = { Format::JSON, Format::CBOR, Format::MSGPACK };
+    if (loadSnapshot(formatPath(m_storageFilePath, m_options.format), m_options.format)) {
+        return true;
+    }
+    for (Format format : formats) {
+        std::string path = formatPath(m_storageFilePath, format);
+        if (format != m_options.format && loadSnapshot(path, format)) {
+            LOG_INFO("Migrating persistent storage from " + path);
+            m_legacyFilePath = path;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PersistentStorage::loadSnapshot(const std::string& filePath, Format format) {
     try {
         // Check if file exists
-        if (!fileExists(m_storageFilePath)) {
+        if (!fileExists(filePath)) {
             return false;
         }
 
         // Open the file
-        std::ifstream file(m_storageFilePath);
+        std::ifstream file(filePath, std::ios::binary);
         if (!file.is_open()) {
-            Logger::error("Failed to open storage file: " + m_storageFilePath);
+            LOG_ERROR("Failed to open storage file: " + filePath);
             return false;
         }
 
@@ -128,123 +345,501 @@ bool PersistentStorage::loadFromFile() {
             return false;
         }
 
-        // Parse JSON
+        // Parse the document
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
         try {
-            m_data = nlohmann::json::parse(file);
-        } catch (const nlohmann::json::parse_error& e) {
-            Logger::error("JSON parse error in storage file: " + std::string(e.what()));
+            m_data = decodeSnapshot(content, format);
+        } catch (const nlohmann::json::exception& e) {
+            LOG_ERROR("Parse error in storage file " + filePath + ": " + std::string(e.what()));
             m_data = nlohmann::json::object();
             return false;
         }
 
         // Check if root is an object
         if (!m_data.is_object()) {
-            Logger::error("Storage file does not contain a valid JSON object");
+            LOG_ERROR("Storage file does not contain a valid object: " + filePath);
             m_data = nlohmann::json::object();
             return false;
         }
 
-        Logger::debug("Successfully loaded persistent storage from " + m_storageFilePath);
+        LOG_DEBUG("Successfully loaded persistent storage from " + filePath);
         return true;
     } catch (const std::exception& e) {
-        Logger::error("Error loading storage file: " + std::string(e.what()));
+        LOG_ERROR("Error loading storage file: " + std::string(e.what()));
         return false;
     }
 }
 
 bool PersistentStorage::saveToFile() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    // If not initialized or no changes to save, return early
-    if (!m_initialized || !m_isDirty) {
-        return m_initialized;
+    TRACE_SCOPE("storage", "saveToFile");
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+
+    // Serialize under the data lock, write the file without holding it
+    std::string content;
+    std::string records;
+    std::string filePath;
+    std::string journalPath;
+    std::string legacyPath;
+    bool journal;
+    std::set<std::pair<std::string, std::string>> changes;
+    std::map<std::string, uint64_t> moduleBytes;   // Share of the write per changed module
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // If not initialized or no changes to save, return early
+        if (!m_initialized || !m_isDirty) {
+            return m_initialized;
+        }
+
+        filePath = formatPath(m_storageFilePath, m_options.format);
+        journalPath = getJournalPath();
+        legacyPath = m_legacyFilePath;
+        changes.swap(m_pendingChanges);
+
+        // Journal only the changed values, until the journal is due for compaction
+        // (no recorded changes means a full rewrite was requested)
+        journal = m_options.backend == Backend::JOURNAL && !changes.empty() &&
+                  m_journalBytes < Config::STORAGE_JOURNAL_COMPACT_BYTES;
+        if (journal) {
+            for (const auto& change : changes) {
+                size_t before = records.size();
+                encodeJournalRecord(records, change.first, change.second, m_data[change.first][change.second]);
+                moduleBytes[change.first] += records.size() - before;
+            }
+        } else {
+            content = encodeSnapshot(m_data, m_options.format);
+            for (const auto& change : changes) {
+                moduleBytes[change.first] = 0;
+            }
+            if (moduleBytes.empty()) {
+                moduleBytes["(storage)"] = 0;
+            }
+
+            // A rewrite is shared evenly by the modules that caused it
+            uint64_t share = content.size() / moduleBytes.size();
+            for (auto& module : moduleBytes) {
+                module.second = share;
+            }
+            moduleBytes.begin()->second += content.size() % moduleBytes.size();
+        }
+        m_isDirty = false;
     }
-    
-    try {
-        // Create a temporary filename
-        std::string tempFile = m_storageFilePath + ".tmp";
-        
-        // Write to temporary file first
-        std::ofstream file(tempFile);
-        if (!file.is_open()) {
-            Logger::error("Failed to open temporary storage file for writing: " + tempFile);
-            return false;
+
+    bool saved;
+    IoCounters io;
+    if (journal) {
+        saved = appendJournal(journalPath, records, io);
+        if (saved) {
+            m_journalBytes += records.size();
+            LOG_DEBUG("Journaled " + std::to_string(changes.size()) + " changes (" +
+                      std::to_string(records.size()) + " bytes) to " + journalPath);
         }
-        
-        // Write formatted JSON
-        file << m_data.dump(2);
-        file.close();
-        
-        // Check for write errors
-        if (!file) {
-            Logger::error("Error writing to temporary storage file");
-            return false;
+    } else {
+        saved = writeSnapshot(filePath, content, &io);
+        if (saved) {
+            LOG_DEBUG("Successfully saved persistent storage to " + filePath);
+
+            // The file now holds every journaled change
+            if (m_journalBytes > 0 || fileExists(journalPath)) {
+                if (unlink(journalPath.c_str()) != 0 && errno != ENOENT) {
+                    LOG_WARNING("Failed to remove storage journal: " + journalPath);
+                }
+                m_journalBytes = 0;
+            }
+
+            // Keep the file of the previous format for reference, out of the load path
+            if (!legacyPath.empty() && legacyPath != filePath) {
+                if (renameFile(legacyPath, legacyPath + ".migrated")) {
+                    LOG_INFO("Persistent storage migrated to " + filePath +
+                                 ", previous file kept as " + legacyPath + ".migrated");
+                }
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_legacyFilePath == legacyPath) {
+                    m_legacyFilePath.clear();
+                }
+            }
         }
-        
-        // Rename temporary file to actual file (atomic operation)
-        if (!renameFile(tempFile, m_storageFilePath)) {
-            Logger::error("Failed to rename temporary file to target file");
+    }
+
+    // Failed writes count too, whatever reached the device wore it
+    bool saveHistory;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        accountIo(io, moduleBytes);
+        saveHistory = std::chrono::steady_clock::now() - m_ioStatsSavedAt >=
+                      std::chrono::seconds(Config::STORAGE_IOSTATS_SAVE_INTERVAL_SEC);
+    }
+    if (saveHistory) {
+        // Piggybacks on a save so an idle panel doesn't write just for the statistics
+        saveIoStats();
+    }
+
+    if (!saved) {
+        // Keep the changes pending; the flusher retries after another debounce period
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingChanges.insert(changes.begin(), changes.end());
+        m_isDirty = true;
+        m_firstChangeTime = m_lastChangeTime = std::chrono::steady_clock::now();
+        // The flusher waits without a timeout while clean, a save from another thread must wake it
+        m_flushCondition.notify_one();
+    }
+    return saved;
+}
+
+void PersistentStorage::accountIo(const IoCounters& io, const std::map<std::string, uint64_t>& moduleBytes) {
+    m_ioStatsDirty = true;
+    m_ioStats.session.add(io);
+    m_ioStats.lifetime.add(io);
+
+    for (const auto& module : moduleBytes) {
+        IoCounters share = io;
+        share.bytes = module.second;
+        m_ioStats.sessionModules[module.first].add(share);
+        m_ioStats.lifetimeModules[module.first].add(share);
+    }
+}
+
+// Counters as a JSON object
+static nlohmann::json ioCountersToJson(const PersistentStorage::IoCounters& io) {
+    return {{"saves", io.saves}, {"bytes", io.bytes}, {"fsyncs", io.fsyncs}, {"renames", io.renames}};
+}
+
+static PersistentStorage::IoCounters ioCountersFromJson(const nlohmann::json& j) {
+    PersistentStorage::IoCounters io;
+    io.saves = j.value("saves", static_cast<uint64_t>(0));
+    io.bytes = j.value("bytes", static_cast<uint64_t>(0));
+    io.fsyncs = j.value("fsyncs", static_cast<uint64_t>(0));
+    io.renames = j.value("renames", static_cast<uint64_t>(0));
+    return io;
+}
+
+void PersistentStorage::loadIoStats() {
+    // Caller holds m_saveMutex and m_mutex
+    m_ioStats.lifetime = IoCounters();
+    m_ioStats.lifetimeModules.clear();
+    m_ioStats.runs = 0;
+    m_ioStats.since = 0;
+
+    std::ifstream file(getIoStatsPath());
+    if (file.is_open()) {
+        try {
+            nlohmann::json history = nlohmann::json::parse(file);
+            m_ioStats.runs = history.value("runs", static_cast<uint64_t>(0));
+            m_ioStats.since = history.value("since", static_cast<int64_t>(0));
+            if (history.contains("total") && history["total"].is_object()) {
+                m_ioStats.lifetime = ioCountersFromJson(history["total"]);
+            }
+            if (history.contains("modules") && history["modules"].is_object()) {
+                for (auto it = history["modules"].begin(); it != history["modules"].end(); ++it) {
+                    if (it.value().is_object()) {
+                        m_ioStats.lifetimeModules[it.key()] = ioCountersFromJson(it.value());
+                    }
+                }
+            }
+        } catch (const nlohmann::json::exception& e) {
+            LOG_WARNING("Ignoring unreadable storage write history: " + std::string(e.what()));
+        }
+    }
+
+    // This run's writes so far belong to the previous file
+    m_ioStats.session = IoCounters();
+    m_ioStats.sessionModules.clear();
+    m_ioStatsDirty = false;
+    m_ioStats.runs++;
+    if (m_ioStats.since == 0) {
+        m_ioStats.since = static_cast<int64_t>(time(nullptr));
+    }
+    m_ioStatsSavedAt = std::chrono::steady_clock::now();
+}
+
+bool PersistentStorage::saveIoStats() {
+    // Caller holds m_saveMutex
+    std::string path;
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_initialized || !m_ioStatsDirty) {
+            return m_initialized;
+        }
+        nlohmann::json history;
+        history["runs"] = m_ioStats.runs;
+        history["since"] = m_ioStats.since;
+        history["total"] = ioCountersToJson(m_ioStats.lifetime);
+        history["modules"] = nlohmann::json::object();
+        for (const auto& module : m_ioStats.lifetimeModules) {
+            history["modules"][module.first] = ioCountersToJson(module.second);
+        }
+        path = getIoStatsPath();
+        content = history.dump(2);
+        m_ioStatsSavedAt = std::chrono::steady_clock::now();
+    }
+
+    // The history file wears the flash like any other write
+    IoCounters io;
+    bool saved = writeSnapshot(path, content, &io);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    accountIo(io, {{"(iostats)", io.bytes}});
+    // Its own write goes out with the next one, not in a write of its own
+    m_ioStatsDirty = !saved;
+    return saved;
+}
+
+PersistentStorage::IoStats PersistentStorage::getIoStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ioStats;
+}
+
+nlohmann::json PersistentStorage::getIoStatsJson() {
+    IoStats stats = getIoStats();
+    Options options;
+    std::string filePath;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        options = m_options;
+        filePath = m_storageFilePath;
+    }
+
+    nlohmann::json result;
+    result["file"] = filePath;
+    result["backend"] = options.backend == Backend::JOURNAL ? "journal" : "snapshot";
+    result["format"] = options.format == Format::CBOR ? "cbor" :
+                       options.format == Format::MSGPACK ? "msgpack" : "json";
+    result["runs"] = stats.runs;
+    result["since"] = stats.since;
+
+    result["session"]["total"] = ioCountersToJson(stats.session);
+    result["session"]["modules"] = nlohmann::json::object();
+    for (const auto& module : stats.sessionModules) {
+        result["session"]["modules"][module.first] = ioCountersToJson(module.second);
+    }
+    result["lifetime"]["total"] = ioCountersToJson(stats.lifetime);
+    result["lifetime"]["modules"] = nlohmann::json::object();
+    for (const auto& module : stats.lifetimeModules) {
+        result["lifetime"]["modules"][module.first] = ioCountersToJson(module.second);
+    }
+    return result;
+}
+
+bool PersistentStorage::exportIoStats(const std::string& path) {
+    std::string content = getIoStatsJson().dump(2);
+
+    // Exports go to tmpfs and are not booked as storage writes
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+    if (!writeSnapshot(path, content)) {
+        return false;
+    }
+    LOG_INFO("Exported storage write statistics to " + path);
+    return true;
+}
+
+bool PersistentStorage::exportJson(const std::string& path) {
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_initialized) {
             return false;
         }
-        
-        Logger::debug("Successfully saved persistent storage to " + m_storageFilePath);
-        m_isDirty = false;
-        m_savePending = false;
-        return true;
-    } catch (const std::exception& e) {
-        Logger::error("Error saving storage file: " + std::string(e.what()));
+        content = m_data.dump(2);
+    }
+
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+    if (!writeSnapshot(path, content)) {
         return false;
     }
+    LOG_INFO("Exported persistent storage to " + path);
+    return true;
 }
 
-void PersistentStorage::scheduleSave() {
-    // If a save is already pending, don't schedule another one
-    if (m_savePending) {
-        return;
+bool PersistentStorage::writeSnapshot(const std::string& filePath, const std::string& content, IoCounters* io) {
+    // Create a temporary filename
+    std::string tempFile = filePath + ".tmp";
+
+    // Write to temporary file first
+    int fd = open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open temporary storage file for writing: " + tempFile);
+        return false;
     }
-    
-    m_savePending = true;
-    
-    // Start a thread that waits a bit then saves
-    std::thread([this]() {
-        // Wait 2 seconds before saving
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        
-        // Check if save is still pending (could have been canceled)
-        if (m_savePending) {
-            saveToFile();
+
+    // Data must be on disk before the rename makes it the live file
+    IoCounters done;
+    done.saves = 1;
+    bool ok = writeAll(fd, content.data(), content.size());
+    if (ok) {
+        done.bytes = content.size();
+        done.fsyncs = 1;
+        ok = fsync(fd) == 0;
+    }
+    ok = (close(fd) == 0) && ok;
+    if (!ok) {
+        LOG_ERROR("Error writing to temporary storage file: " + std::string(strerror(errno)));
+        unlink(tempFile.c_str());
+    } else if (!renameFile(tempFile, filePath)) {
+        // Rename temporary file to actual file (atomic operation)
+        Logger::error("Failed to rename temporary file to target file");
+        ok = false;
+    } else {
+        done.renames = 1;
+    }
+
+    if (io) {
+        io->add(done);
+    }
+    return ok;
+}
+
+bool PersistentStorage::appendJournal(const std::string& journalPath, const std::string& records, IoCounters& io) {
+    int fd = open(journalPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open storage journal: " + journalPath);
+        return false;
+    }
+
+    // A torn append is detected by the CRC and dropped on the next load
+    io.saves++;
+    bool ok = writeAll(fd, records.data(), records.size());
+    if (ok) {
+        io.bytes += records.size();
+        io.fsyncs++;
+        ok = fdatasync(fd) == 0;
+    }
+    ok = (close(fd) == 0) && ok;
+    if (!ok) {
+        LOG_ERROR("Error appending to storage journal: " + std::string(strerror(errno)));
+    }
+    return ok;
+}
+
+size_t PersistentStorage::replayJournal() {
+    // Caller holds m_saveMutex and m_mutex
+    std::string journalPath = getJournalPath();
+    std::ifstream file(journalPath, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t offset = 0;
+    size_t applied = 0;
+
+    while (offset + JOURNAL_HEADER_SIZE <= data.size()) {
+        uint32_t length = getU32(bytes + offset);
+        uint32_t crc = getU32(bytes + offset + 4);
+        if (length > data.size() - offset - JOURNAL_HEADER_SIZE) {
+            break;
+        }
+        const uint8_t* payload = bytes + offset + JOURNAL_HEADER_SIZE;
+        if (crc32(payload, length) != crc) {
+            break;
+        }
+
+        nlohmann::json record = nlohmann::json::from_cbor(payload, payload + length, true, false);
+        if (!record.is_array() || record.size() != 3 || !record[0].is_string() || !record[1].is_string()) {
+            break;
+        }
+        const std::string moduleId = record[0].get<std::string>();
+        if (!m_data[moduleId].is_object()) {
+            m_data[moduleId] = nlohmann::json::object();
+        }
+        m_data[moduleId][record[1].get<std::string>()] = record[2];
+
+        offset += JOURNAL_HEADER_SIZE + length;
+        applied++;
+    }
+
+    if (offset < data.size()) {
+        // Torn or corrupt tail from an interrupted write, cut it off so appends continue cleanly
+        LOG_WARNING("Discarding " + std::to_string(data.size() - offset) +
+                        " bytes of damaged storage journal");
+        if (truncate(journalPath.c_str(), static_cast<off_t>(offset)) != 0) {
+            LOG_ERROR("Failed to truncate storage journal: " + journalPath);
         }
-    }).detach();
+    }
+
+    m_journalBytes = offset;
+    if (applied > 0) {
+        LOG_DEBUG("Replayed " + std::to_string(applied) + " journal records from " + journalPath);
+    }
+    return applied;
 }
 
-void PersistentStorage::cancelScheduledSave() {
-    m_savePending = false;
+void PersistentStorage::exportSnapshots() {
+    exportJson(Config::STORAGE_JSON_EXPORT_PATH);
+    exportIoStats(Config::STORAGE_IOSTATS_EXPORT_PATH);
 }
 
-// String values
-bool PersistentStorage::setValue(const std::string& moduleId, const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
+void PersistentStorage::flushThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopFlusher) {
+        // Nothing to do until a change or stop() notifies
+        if (!m_isDirty) {
+            m_flushCondition.wait(lock);
+            continue;
+        }
+
+        // Save once changes have settled, or when the oldest one has waited long enough
+        auto debounceDeadline = m_lastChangeTime + std::chrono::milliseconds(m_policy.debounceMs);
+        auto latencyDeadline = m_firstChangeTime + std::chrono::milliseconds(m_policy.maxLatencyMs);
+        auto deadline = std::min(debounceDeadline, latencyDeadline);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < deadline) {
+            m_flushCondition.wait_until(lock, deadline);
+            continue;
+        }
+
+        lock.unlock();
+        saveToFile();
+        lock.lock();
+    }
+}
+
+bool PersistentStorage::setJsonValue(const std::string& moduleId, const std::string& key, nlohmann::json value) {
     if (!m_initialized) {
         Logger::warning("Attempted to set value before initializing storage");
         return false;
     }
-    
+
     // Ensure module section exists
     if (!m_data.contains(moduleId) || !m_data[moduleId].is_object()) {
         m_data[moduleId] = nlohmann::json::object();
     }
-    
-    // Set the value
-    m_data[moduleId][key] = value;
-    m_isDirty = true;
-    
-    // Schedule a delayed save
-    scheduleSave();
-    
+
+    // Unchanged values don't need a write
+    nlohmann::json& slot = m_data[moduleId][key];
+    if (slot == value) {
+        return true;
+    }
+    slot = std::move(value);
+    m_pendingChanges.emplace(moduleId, key);
+
+    // Let handles on this value know their cached copy is stale
+    auto resolved = m_slots.find(std::make_pair(moduleId, key));
+    if (resolved != m_slots.end()) {
+        resolved->second->version.fetch_add(1, std::memory_order_release);
+    }
+
+    // Coalesce with any changes already waiting for the flusher
+    auto now = std::chrono::steady_clock::now();
+    if (!m_isDirty) {
+        m_firstChangeTime = now;
+        m_isDirty = true;
+    }
+    m_lastChangeTime = now;
+    m_flushCondition.notify_one();
+
     return true;
 }
 
+// String values
+bool PersistentStorage::setValue(const std::string& moduleId, const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return setJsonValue(moduleId, key, value);
+}
+
 std::string PersistentStorage::getValue(const std::string& moduleId, const std::string& key, const std::string& defaultValue) {
     std::lock_guard<std::mutex> lock(m_mutex);
     
@@ -265,25 +860,7 @@ std::string PersistentStorage::getValue(const std::string& moduleId, const std::
 // Integer values
 bool PersistentStorage::setValue(const std::string& moduleId, const std::string& key, int value) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    
-    if (!m_initialized) {
-        Logger::warning("Attempted to set value before initializing storage");
-        return false;
-    }
-    
-    // Ensure module section exists
-    if (!m_data.contains(moduleId) || !m_data[moduleId].is_object()) {
-        m_data[moduleId] = nlohmann::json::object();
-    }
-    
-    // Set the value
-    m_data[moduleId][key] = value;
-    m_isDirty = true;
-    
-    // Schedule a delayed save
-    scheduleSave();
-    
-    return true;
+    return setJsonValue(moduleId, key, value);
 }
 
 int PersistentStorage::getValue(const std::string& moduleId, const std::string& key, int defaultValue) {
@@ -306,25 +883,7 @@ int PersistentStorage::getValue(const std::string& moduleId, const std::string&
 // Boolean values
 bool PersistentStorage::setValue(const std::string& moduleId, const std::string& key, bool value) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    
-    if (!m_initialized) {
-        Logger::warning("Attempted to set value before initializing storage");
-        return false;
-    }
-    
-    // Ensure module section exists
-    if (!m_data.contains(moduleId) || !m_data[moduleId].is_object()) {
-        m_data[moduleId] = nlohmann::json::object();
-    }
-    
-    // Set the value
-    m_data[moduleId][key] = value;
-    m_isDirty = true;
-    
-    // Schedule a delayed save
-    scheduleSave();
-    
-    return true;
+    return setJsonValue(moduleId, key, value);
 }
 
 bool PersistentStorage::getValue(const std::string& moduleId, const std::string& key, bool defaultValue) {
@@ -347,25 +906,7 @@ bool PersistentStorage::getValue(const std::string& moduleId, const std::string&
 // Double values
 bool PersistentStorage::setValue(const std::string& moduleId, const std::string& key, double value) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    
-    if (!m_initialized) {
-        Logger::warning("Attempted to set value before initializing storage");
-        return false;
-    }
-    
-    // Ensure module section exists
-    if (!m_data.contains(moduleId) || !m_data[moduleId].is_object()) {
-        m_data[moduleId] = nlohmann::json::object();
-    }
-    
-    // Set the value
-    m_data[moduleId][key] = value;
-    m_isDirty = true;
-    
-    // Schedule a delayed save
-    scheduleSave();
-    
-    return true;
+    return setJsonValue(moduleId, key, value);
 }
 
 double PersistentStorage::getValue(const std::string& moduleId, const std::string& key, double defaultValue) {
@@ -385,6 +926,23 @@ double PersistentStorage::getValue(const std::string& moduleId, const std::strin
     return defaultValue;
 }
 
+PersistentStorage::KeySlot* PersistentStorage::resolveSlot(const std::string& moduleId, const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::unique_ptr<KeySlot>& slot = m_slots[std::make_pair(moduleId, key)];
+    if (!slot) {
+        slot = std::make_unique<KeySlot>();
+        slot->moduleId = moduleId;
+        slot->key = key;
+    }
+    return slot.get();
+}
+
+bool PersistentStorage::writeSlot(const KeySlot& slot, nlohmann::json value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return setJsonValue(slot.moduleId, slot.key, std::move(value));
+}
+
 // Check if value exists
 bool PersistentStorage::hasValue(const std::string& moduleId, const std::string& key) {
     std::lock_guard<std::mutex> lock(m_mutex);
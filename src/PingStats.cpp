@@ -0,0 +1,86 @@
+#include "PingStats.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+// Upper bound of bucket 0, the rest double every four buckets from here
+const long s_baseUs = 10;
+const int s_bucketsPerOctave = 4;
+
+} // namespace
+
+constexpr int PingStats::BUCKET_COUNT;
+
+void PingStats::reset() {
+    *this = PingStats();
+}
+
+void PingStats::addReply(long rttUs) {
+    rttUs = std::max(rttUs, 0L);
+
+    // RFC 3550 jitter: smoothed difference between consecutive round trips
+    if (m_lastUs >= 0) {
+        double difference = std::fabs(static_cast<double>(rttUs - m_lastUs));
+        m_jitterUs += (difference - m_jitterUs) / 16.0;
+    }
+
+    if (m_received == 0 || rttUs < m_minUs) {
+        m_minUs = rttUs;
+    }
+    if (m_received == 0 || rttUs > m_maxUs) {
+        m_maxUs = rttUs;
+    }
+    m_received++;
+    m_sumUs += static_cast<double>(rttUs);
+    m_lastUs = rttUs;
+    m_buckets[bucketFor(rttUs)]++;
+}
+
+void PingStats::addLoss() {
+    m_lost++;
+}
+
+double PingStats::getLossPercent() const {
+    uint64_t probes = getProbes();
+    return probes ? 100.0 * static_cast<double>(m_lost) / static_cast<double>(probes) : 0.0;
+}
+
+double PingStats::getAverageUs() const {
+    return m_received ? m_sumUs / static_cast<double>(m_received) : -1.0;
+}
+
+long PingStats::getPercentileUs(double percent) const {
+    if (m_received == 0) {
+        return -1;
+    }
+
+    uint64_t target = static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(m_received)));
+    target = std::min(std::max<uint64_t>(target, 1), m_received);
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_buckets[i];
+        if (seen >= target) {
+            // The bucket bound, but never outside what was actually measured
+            return std::min(std::max(bucketUpperUs(i), m_minUs), m_maxUs);
+        }
+    }
+    return m_maxUs;
+}
+
+long PingStats::bucketUpperUs(int index) {
+    if (index >= BUCKET_COUNT - 1) {
+        return LONG_MAX;
+    }
+    return static_cast<long>(std::lround(s_baseUs * std::exp2(static_cast<double>(index) / s_bucketsPerOctave)));
+}
+
+int PingStats::bucketFor(long rttUs) {
+    if (rttUs < s_baseUs) {
+        return 0;
+    }
+    int index = 1 + static_cast<int>(std::floor(s_bucketsPerOctave * std::log2(static_cast<double>(rttUs) / s_baseUs)));
+    return std::min(index, BUCKET_COUNT - 1);
+}
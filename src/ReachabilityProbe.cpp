@@ -0,0 +1,643 @@
+#include "ReachabilityProbe.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll tags of the shared sockets; TCP probes are tagged with their index
+const uint64_t s_icmpTag = UINT64_MAX;
+const uint64_t s_dnsTag = UINT64_MAX - 1;
+const uint64_t s_httpTag = UINT64_MAX - 2;
+
+const uint16_t s_dnsTypeA = 1;
+const uint16_t s_dnsClassIn = 1;
+
+std::atomic<uint64_t> s_traceIds{0};
+
+long elapsedUs(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point now) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(now - since).count());
+}
+
+// "address[:port]" with a dotted quad address
+bool parseEndpoint(const std::string& text, int defaultPort, struct sockaddr_in& address) {
+    size_t colon = text.find(':');
+    if (!IcmpSocket::parseAddress(text.substr(0, colon), address)) {
+        return false;
+    }
+    int port = colon == std::string::npos ? defaultPort : atoi(text.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    return true;
+}
+
+// First IPv4 nameserver of the system resolver
+bool systemResolver(struct sockaddr_in& address) {
+    std::ifstream file("/etc/resolv.conf");
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        std::string server;
+        if (words >> keyword >> server && keyword == "nameserver" && parseEndpoint(server, 53, address)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void putShort(std::string& packet, uint16_t value) {
+    packet.push_back(static_cast<char>(value >> 8));
+    packet.push_back(static_cast<char>(value & 0xff));
+}
+
+uint16_t getShort(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+// Standard query for the A record of name, recursion desired
+std::string buildQuery(uint16_t id, const std::string& name) {
+    std::string packet;
+    putShort(packet, id);
+    putShort(packet, 0x0100);
+    putShort(packet, 1);
+    putShort(packet, 0);
+    putShort(packet, 0);
+    putShort(packet, 0);
+
+    std::istringstream labels(name);
+    std::string label;
+    while (std::getline(labels, label, '.')) {
+        if (!label.empty()) {
+            packet.push_back(static_cast<char>(std::min<size_t>(label.size(), 63)));
+            packet.append(label, 0, 63);
+        }
+    }
+    packet.push_back('\0');
+    putShort(packet, s_dnsTypeA);
+    putShort(packet, s_dnsClassIn);
+    return packet;
+}
+
+bool skipName(const uint8_t* data, size_t size, size_t& pos) {
+    while (pos < size) {
+        uint8_t length = data[pos];
+        if ((length & 0xc0) == 0xc0) {
+            pos += 2;
+            return pos <= size;
+        }
+        pos += 1 + length;
+        if (length == 0) {
+            return pos <= size;
+        }
+    }
+    return false;
+}
+
+// Response to query id: its rcode, and the first A record if there is one
+bool parseResponse(const uint8_t* data, size_t size, uint16_t id, int& rcode, struct in_addr& address,
+                   bool& hasAddress) {
+    if (size < 12 || getShort(data) != id || !(data[2] & 0x80)) {
+        return false;
+    }
+    rcode = data[3] & 0x0f;
+    hasAddress = false;
+
+    size_t pos = 12;
+    for (int i = getShort(data + 4); i > 0; i--) {
+        if (!skipName(data, size, pos) || pos + 4 > size) {
+            return false;
+        }
+        pos += 4;
+    }
+    for (int i = getShort(data + 6); i > 0; i--) {
+        if (!skipName(data, size, pos) || pos + 10 > size) {
+            return true;
+        }
+        uint16_t type = getShort(data + pos);
+        uint16_t length = getShort(data + pos + 8);
+        pos += 10;
+        if (pos + length > size) {
+            return true;
+        }
+        // CNAMEs come first, the address follows them
+        if (type == s_dnsTypeA && length == 4) {
+            memcpy(&address, data + pos, 4);
+            hasAddress = true;
+            return true;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+} // namespace
+
+constexpr int ReachabilityProbe::LAYER_COUNT;
+
+ReachabilityProbe::~ReachabilityProbe() {
+    stop();
+}
+
+const char* ReachabilityProbe::layerName(Layer layer) {
+    switch (layer) {
+        case Layer::ICMP: return "ICMP";
+        case Layer::TCP: return "TCP";
+        case Layer::DNS: return "DNS";
+        case Layer::HTTP: return "HTTP";
+    }
+    return "";
+}
+
+bool ReachabilityProbe::start() {
+    return start(Options());
+}
+
+bool ReachabilityProbe::start(const Options& options) {
+    stop();
+
+    m_options = options;
+    m_options.timeoutMs = std::max(m_options.timeoutMs, 1);
+    for (auto& result : m_results) {
+        result = LayerResult();
+    }
+    m_firstSuccessUs = -1;
+    m_retried = false;
+    m_tcpError.clear();
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        LOG_ERROR("ReachabilityProbe: epoll_create1 failed: " + std::string(strerror(errno)));
+        return false;
+    }
+    m_startedAt = std::chrono::steady_clock::now();
+    m_running = true;
+
+    // The HTTP host either is an address, or is what the DNS probe looks up
+    m_httpHost.clear();
+    m_httpNeedsDns = false;
+    const std::string scheme = "http://";
+    if (m_options.httpUrl.compare(0, scheme.size(), scheme) == 0) {
+        std::string rest = m_options.httpUrl.substr(scheme.size());
+        size_t slash = rest.find('/');
+        m_httpPath = slash == std::string::npos ? "/" : rest.substr(slash);
+        std::string hostPort = rest.substr(0, slash);
+        size_t colon = hostPort.find(':');
+        m_httpHost = hostPort.substr(0, colon);
+        m_httpPort = colon == std::string::npos ? 80 : atoi(hostPort.c_str() + colon + 1);
+    }
+    struct sockaddr_in httpAddress;
+    if (m_httpHost.empty() || m_httpPort <= 0 || m_httpPort > 65535) {
+        fail(Layer::HTTP, "none configured");
+    } else if (IcmpSocket::parseAddress(m_httpHost, httpAddress)) {
+        startHttp(httpAddress.sin_addr);
+    } else {
+        m_httpNeedsDns = true;
+    }
+
+    startIcmp();
+    startTcp();
+    startDns();
+
+    if (!isReachable() && std::all_of(std::begin(m_results), std::end(m_results),
+                                      [](const LayerResult& r) { return r.status == Status::FAILED; })) {
+        Logger::warning("ReachabilityProbe: no probe could be started");
+        stop();
+        return false;
+    }
+
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    TraceRecorder::asyncBegin("net", m_options.traceName, m_traceId, m_httpHost.c_str());
+    LOG_DEBUG("ReachabilityProbe: started " + std::to_string(m_icmpTargets.size()) + " echoes, " +
+              std::to_string(m_tcpPending) + " connects" + (m_dnsFd >= 0 ? ", DNS " + m_dnsName : ""));
+    return true;
+}
+
+void ReachabilityProbe::stop() {
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        closeLayer(static_cast<Layer>(i));
+    }
+    m_tcp.clear();
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+    if (m_running && m_traceId != 0) {
+        TraceRecorder::asyncEnd("net", m_options.traceName, m_traceId);
+    }
+    m_traceId = 0;
+    m_running = false;
+}
+
+bool ReachabilityProbe::poll(int budgetMs) {
+    if (!m_running) {
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+    struct epoll_event events[16];
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        if (!m_retried && now - m_startedAt >= std::chrono::milliseconds(m_options.retryMs)) {
+            // One more echo and query, in case the first ones were lost
+            m_retried = true;
+            if (getResult(Layer::ICMP).status == Status::PENDING) {
+                sendEchoes();
+            }
+            if (getResult(Layer::DNS).status == Status::PENDING) {
+                sendDnsQuery();
+            }
+        }
+        if (now - m_startedAt >= std::chrono::milliseconds(m_options.timeoutMs)) {
+            for (int i = 0; i < LAYER_COUNT; i++) {
+                fail(static_cast<Layer>(i), "timeout");
+            }
+        }
+        if (std::none_of(std::begin(m_results), std::end(m_results),
+                         [](const LayerResult& r) { return r.status == Status::PENDING; })) {
+            if (Logger::isEnabled(Logger::Level::INFO)) {
+                std::string summary;
+                for (int i = 0; i < LAYER_COUNT; i++) {
+                    const LayerResult& result = m_results[i];
+                    summary += std::string(summary.empty() ? "" : ", ") + layerName(static_cast<Layer>(i)) + " " +
+                               (result.status == Status::OK ? std::to_string(result.elapsedUs / 1000) + "ms"
+                                                            : "failed (" + result.detail + ")");
+                }
+                Logger::info("ReachabilityProbe: " + summary);
+            }
+            stop();
+            return false;
+        }
+
+        auto deadline = std::min(end, nextDeadline());
+        long remainingUs = deadline > now ? elapsedUs(now, deadline) : 0;
+        int count = epoll_wait(m_epollFd, events, 16, static_cast<int>((remainingUs + 999) / 1000));
+
+        now = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == s_icmpTag) {
+                receiveEchoes(now);
+            } else if (tag == s_dnsTag) {
+                receiveDns(now);
+            } else if (tag == s_httpTag) {
+                handleHttp(events[i].events, now);
+            } else {
+                finishTcp(static_cast<size_t>(tag), now);
+            }
+        }
+
+        if (now >= end) {
+            return true;
+        }
+    }
+}
+
+bool ReachabilityProbe::startIcmp() {
+    m_icmpTargets.clear();
+    for (const auto& host : m_options.icmpHosts) {
+        struct sockaddr_in address;
+        if (IcmpSocket::parseAddress(host, address)) {
+            m_icmpTargets.push_back(address);
+        }
+    }
+    if (m_icmpTargets.empty()) {
+        fail(Layer::ICMP, "none configured");
+        return false;
+    }
+    if (!m_icmp.open() || !watch(m_icmp.getFd(), EPOLLIN, s_icmpTag, EPOLL_CTL_ADD)) {
+        fail(Layer::ICMP, "no ICMP socket");
+        return false;
+    }
+    sendEchoes();
+    return getResult(Layer::ICMP).status != Status::FAILED;
+}
+
+void ReachabilityProbe::sendEchoes() {
+    int sent = 0;
+    for (size_t i = 0; i < m_icmpTargets.size(); i++) {
+        uint16_t sequence = static_cast<uint16_t>(i + (m_retried ? m_icmpTargets.size() : 0));
+        if (m_icmp.sendEcho(m_icmpTargets[i], sequence, IcmpSocket::MIN_PAYLOAD)) {
+            sent++;
+        }
+    }
+    if (sent == 0 && !m_retried) {
+        fail(Layer::ICMP, strerror(errno));
+    }
+}
+
+void ReachabilityProbe::receiveEchoes(std::chrono::steady_clock::time_point now) {
+    IcmpSocket::EchoReply echo;
+    while (m_icmp.isOpen() && m_icmp.receive(echo)) {
+        for (const auto& target : m_icmpTargets) {
+            if (target.sin_addr.s_addr == echo.from.s_addr) {
+                succeed(Layer::ICMP, now, inet_ntoa(echo.from));
+                return;
+            }
+        }
+    }
+}
+
+bool ReachabilityProbe::startTcp() {
+    for (const auto& host : m_options.tcpHosts) {
+        TcpProbe probe;
+        if (!parseEndpoint(host, 443, probe.to)) {
+            continue;
+        }
+        probe.name = host;
+        probe.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (probe.fd < 0) {
+            m_tcpError = strerror(errno);
+            continue;
+        }
+        if (connect(probe.fd, reinterpret_cast<const struct sockaddr*>(&probe.to), sizeof(probe.to)) == 0) {
+            close(probe.fd);
+            succeed(Layer::TCP, std::chrono::steady_clock::now(), host);
+            return true;
+        }
+        if (errno != EINPROGRESS) {
+            m_tcpError = strerror(errno);
+            close(probe.fd);
+            continue;
+        }
+        m_tcp.push_back(probe);
+        if (!watch(probe.fd, EPOLLOUT, m_tcp.size() - 1, EPOLL_CTL_ADD)) {
+            close(probe.fd);
+            m_tcp.back().fd = -1;
+            continue;
+        }
+        m_tcpPending++;
+    }
+    if (m_tcpPending == 0) {
+        fail(Layer::TCP, m_options.tcpHosts.empty() ? "none configured" : m_tcpError);
+        return false;
+    }
+    return true;
+}
+
+void ReachabilityProbe::finishTcp(size_t index, std::chrono::steady_clock::time_point now) {
+    // The event may belong to a probe closed earlier in this batch
+    if (index >= m_tcp.size() || m_tcp[index].fd < 0) {
+        return;
+    }
+    TcpProbe& probe = m_tcp[index];
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error == 0) {
+        // Reset rather than close, so no TIME_WAIT is left behind
+        struct linger reset = { 1, 0 };
+        setsockopt(probe.fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    }
+    close(probe.fd);
+    probe.fd = -1;
+    m_tcpPending--;
+
+    // A refused connect could just as well come from a local firewall, so only a handshake counts
+    if (error == 0) {
+        succeed(Layer::TCP, now, probe.name);
+        return;
+    }
+    m_tcpError = strerror(error);
+    if (m_tcpPending == 0) {
+        fail(Layer::TCP, m_tcpError);
+    }
+}
+
+bool ReachabilityProbe::startDns() {
+    m_dnsName = m_httpNeedsDns ? m_httpHost : m_options.dnsName;
+    if (m_dnsName.empty()) {
+        fail(Layer::DNS, "none configured");
+        return false;
+    }
+
+    struct sockaddr_in resolver;
+    if (!systemResolver(resolver)) {
+        fail(Layer::DNS, "no resolver");
+        return false;
+    }
+
+    // Connected, so an ICMP port unreachable from the resolver shows up as ECONNREFUSED
+    m_dnsFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_dnsFd < 0 || connect(m_dnsFd, reinterpret_cast<const struct sockaddr*>(&resolver), sizeof(resolver)) != 0 ||
+        !watch(m_dnsFd, EPOLLIN, s_dnsTag, EPOLL_CTL_ADD)) {
+        fail(Layer::DNS, strerror(errno));
+        return false;
+    }
+
+    std::random_device random;
+    m_dnsId = static_cast<uint16_t>(random());
+    sendDnsQuery();
+    return getResult(Layer::DNS).status != Status::FAILED;
+}
+
+void ReachabilityProbe::sendDnsQuery() {
+    if (m_dnsFd < 0) {
+        return;
+    }
+    std::string query = buildQuery(m_dnsId, m_dnsName);
+    if (send(m_dnsFd, query.data(), query.size(), 0) < 0) {
+        fail(Layer::DNS, strerror(errno));
+    }
+}
+
+void ReachabilityProbe::receiveDns(std::chrono::steady_clock::time_point now) {
+    uint8_t buffer[512];
+    while (m_dnsFd >= 0) {
+        ssize_t n = recv(m_dnsFd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fail(Layer::DNS, strerror(errno));
+            }
+            return;
+        }
+
+        int rcode = 0;
+        struct in_addr address;
+        bool hasAddress = false;
+        if (!parseResponse(buffer, static_cast<size_t>(n), m_dnsId, rcode, address, hasAddress)) {
+            continue;
+        }
+        // NXDOMAIN still proves the resolver works, SERVFAIL does not
+        if (rcode != 0 && rcode != 3) {
+            fail(Layer::DNS, "rcode " + std::to_string(rcode));
+            return;
+        }
+        succeed(Layer::DNS, now, hasAddress ? inet_ntoa(address) : "no address");
+        if (m_httpNeedsDns) {
+            if (hasAddress) {
+                startHttp(address);
+            } else {
+                fail(Layer::HTTP, "no address");
+            }
+        }
+        return;
+    }
+}
+
+bool ReachabilityProbe::startHttp(const struct in_addr& address) {
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(static_cast<uint16_t>(m_httpPort));
+    to.sin_addr = address;
+
+    m_httpSent = false;
+    m_httpResponse.clear();
+    m_httpFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_httpFd < 0 ||
+        (connect(m_httpFd, reinterpret_cast<const struct sockaddr*>(&to), sizeof(to)) != 0 && errno != EINPROGRESS) ||
+        !watch(m_httpFd, EPOLLOUT, s_httpTag, EPOLL_CTL_ADD)) {
+        fail(Layer::HTTP, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void ReachabilityProbe::handleHttp(uint32_t events, std::chrono::steady_clock::time_point now) {
+    if (m_httpFd < 0) {
+        return;
+    }
+
+    if (!m_httpSent) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(m_httpFd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            fail(Layer::HTTP, strerror(error));
+            return;
+        }
+        // A HEAD request fits one segment, a short write means the connection is broken
+        std::string request = "HEAD " + m_httpPath + " HTTP/1.1\r\nHost: " + m_httpHost +
+                              "\r\nUser-Agent: micropanel\r\nConnection: close\r\n\r\n";
+        if (send(m_httpFd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+            fail(Layer::HTTP, strerror(errno));
+            return;
+        }
+        m_httpSent = true;
+        watch(m_httpFd, EPOLLIN, s_httpTag, EPOLL_CTL_MOD);
+        return;
+    }
+
+    char buffer[256];
+    ssize_t n;
+    while ((n = recv(m_httpFd, buffer, sizeof(buffer), 0)) > 0) {
+        m_httpResponse.append(buffer, static_cast<size_t>(n));
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        fail(Layer::HTTP, strerror(errno));
+        return;
+    }
+
+    // Any status line will do, it shows the request made it to a web server and back
+    size_t lineEnd = m_httpResponse.find("\r\n");
+    if (lineEnd != std::string::npos || n == 0 || (events & (EPOLLHUP | EPOLLERR))) {
+        std::string statusLine = m_httpResponse.substr(0, lineEnd);
+        if (statusLine.compare(0, 5, "HTTP/") == 0 && statusLine.size() >= 12) {
+            succeed(Layer::HTTP, now, "HTTP " + statusLine.substr(9, 3));
+        } else {
+            fail(Layer::HTTP, statusLine.empty() ? "no response" : "not HTTP");
+        }
+    }
+}
+
+void ReachabilityProbe::closeHttp() {
+    if (m_httpFd >= 0) {
+        close(m_httpFd);
+        m_httpFd = -1;
+    }
+}
+
+void ReachabilityProbe::succeed(Layer layer, std::chrono::steady_clock::time_point now, const std::string& detail) {
+    LayerResult& result = m_results[static_cast<int>(layer)];
+    if (result.status != Status::PENDING) {
+        return;
+    }
+    result.status = Status::OK;
+    result.elapsedUs = elapsedUs(m_startedAt, now);
+    result.detail = detail;
+
+    if (m_firstSuccessUs < 0) {
+        m_firstSuccessUs = result.elapsedUs;
+        LOG_INFO("ReachabilityProbe: reachable through " + std::string(layerName(layer)) + " (" + detail + ") after " +
+                 std::to_string(result.elapsedUs) + " us");
+    }
+
+    // The layer has its answer, the rest of its probes can go
+    closeLayer(layer);
+}
+
+void ReachabilityProbe::fail(Layer layer, const std::string& detail) {
+    LayerResult& result = m_results[static_cast<int>(layer)];
+    if (result.status != Status::PENDING) {
+        return;
+    }
+    result.status = Status::FAILED;
+    result.detail = detail;
+    LOG_DEBUG("ReachabilityProbe: " + std::string(layerName(layer)) + " failed: " + detail);
+    closeLayer(layer);
+
+    // Nothing to connect to without the lookup
+    if (layer == Layer::DNS && m_httpNeedsDns && m_httpFd < 0) {
+        fail(Layer::HTTP, "no address");
+    }
+}
+
+void ReachabilityProbe::closeLayer(Layer layer) {
+    switch (layer) {
+        case Layer::ICMP:
+            m_icmp.close();
+            break;
+        case Layer::TCP:
+            for (auto& probe : m_tcp) {
+                if (probe.fd >= 0) {
+                    close(probe.fd);
+                    probe.fd = -1;
+                }
+            }
+            m_tcpPending = 0;
+            break;
+        case Layer::DNS:
+            if (m_dnsFd >= 0) {
+                close(m_dnsFd);
+                m_dnsFd = -1;
+            }
+            break;
+        case Layer::HTTP:
+            closeHttp();
+            break;
+    }
+}
+
+bool ReachabilityProbe::watch(int fd, uint32_t events, uint64_t tag, int operation) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = tag;
+    return epoll_ctl(m_epollFd, operation, fd, &event) == 0;
+}
+
+std::chrono::steady_clock::time_point ReachabilityProbe::nextDeadline() const {
+    auto deadline = m_startedAt + std::chrono::milliseconds(m_options.timeoutMs);
+    if (!m_retried) {
+        deadline = std::min(deadline, m_startedAt + std::chrono::milliseconds(m_options.retryMs));
+    }
+    return deadline;
+}
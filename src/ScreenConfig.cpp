@@ -0,0 +1,429 @@
+#include "ScreenConfig.h"
+#include "Logger.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Cache file layout: magic, version, source key, then the encoded model
+constexpr char CACHE_MAGIC[4] = {'M', 'P', 'C', 'C'};
+constexpr uint32_t CACHE_VERSION = 3;
+
+// Appends fixed-width integers and length-prefixed strings to a byte buffer
+class CacheWriter {
+public:
+    void putU8(uint8_t v) { m_buffer.push_back(static_cast<char>(v)); }
+    void putU32(uint32_t v) { m_buffer.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void putU64(uint64_t v) { m_buffer.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void putString(const std::string& s) {
+        putU32(static_cast<uint32_t>(s.size()));
+        m_buffer.append(s);
+    }
+    const std::string& data() const { return m_buffer; }
+
+private:
+    std::string m_buffer;
+};
+
+// Bounds-checked reader over the memory-mapped cache
+class CacheReader {
+public:
+    CacheReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool getU8(uint8_t& v) { return getRaw(&v, sizeof(v)); }
+    bool getU32(uint32_t& v) { return getRaw(&v, sizeof(v)); }
+    bool getU64(uint64_t& v) { return getRaw(&v, sizeof(v)); }
+    bool getString(std::string& s) {
+        uint32_t len;
+        if (!getU32(len) || len > m_size - m_pos) {
+            return false;
+        }
+        s.assign(m_data + m_pos, len);
+        m_pos += len;
+        return true;
+    }
+    bool atEnd() const { return m_pos == m_size; }
+
+private:
+    bool getRaw(void* out, size_t len) {
+        if (len > m_size - m_pos) {
+            return false;
+        }
+        memcpy(out, m_data + m_pos, len);
+        m_pos += len;
+        return true;
+    }
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+uint64_t ScreenConfig::hashContent(const std::string& content)
+{
+    // FNV-1a, 64 bit
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : content) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void ScreenConfig::clear()
+{
+    m_modules.clear();
+    m_persistentDataFile.clear();
+    m_persistentBackend.clear();
+    m_persistentFormat.clear();
+    m_invertDisplayOption = false;
+    m_invertDisplayTitle.clear();
+    m_loadedFromCache = false;
+}
+
+const ScreenConfig::ModuleEntry* ScreenConfig::findModule(const std::string& id) const
+{
+    // Later entries win, matching how modules are registered
+    for (auto it = m_modules.rbegin(); it != m_modules.rend(); ++it) {
+        if (it->id == id) {
+            return &(*it);
+        }
+    }
+    return nullptr;
+}
+
+bool ScreenConfig::load(const std::string& configPath, const std::string& cachePath)
+{
+    struct stat st;
+    if (stat(configPath.c_str(), &st) != 0) {
+        LOG_ERROR("Could not open config file: " + configPath);
+        return false;
+    }
+
+    SourceKey current;
+    current.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    current.size = static_cast<uint64_t>(st.st_size);
+
+    // The content is always hashed: a copy that preserves mtime (rsync -t, tar) and
+    // happens to keep the size must not load a stale model. Hashing a config file
+    // this size costs far less than parsing it.
+    std::ifstream file(configPath);
+    if (!file.is_open()) {
+        LOG_ERROR("Could not open config file: " + configPath);
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+    current.hash = hashContent(content);
+
+    bool staleKey = false;
+    if (!cachePath.empty() && loadCache(cachePath, current, staleKey)) {
+        if (staleKey) {
+            // The file was touched but its content is unchanged, refresh the cache key only
+            LOG_DEBUG("Config content unchanged, refreshing cache key: " + cachePath);
+            writeCache(cachePath, current);
+        } else {
+            LOG_DEBUG("Loaded compiled config from cache: " + cachePath);
+        }
+        return true;
+    }
+
+    try {
+        if (!compile(nlohmann::json::parse(content))) {
+            return false;
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error parsing JSON config: " + std::string(e.what()));
+        return false;
+    }
+
+    if (!cachePath.empty()) {
+        writeCache(cachePath, current);
+    }
+    return true;
+}
+
+bool ScreenConfig::compile(const nlohmann::json& config)
+{
+    clear();
+
+    // Check if "modules" field exists and is an array
+    if (!config.contains("modules") || !config["modules"].is_array()) {
+        Logger::error("Config file doesn't contain valid 'modules' array");
+        return false;
+    }
+
+    for (const auto& module : config["modules"]) {
+        if (!module.is_object() || !module.contains("id") || !module["id"].is_string()) {
+            Logger::warning("Skipping module with missing or invalid id");
+            continue;
+        }
+
+        ModuleEntry entry;
+        entry.id = module["id"].get<std::string>();
+        entry.hasTitle = module.contains("title") && module["title"].is_string();
+        if (entry.hasTitle) {
+            entry.title = module["title"].get<std::string>();
+        }
+        entry.enabled = module.contains("enabled") && module["enabled"].is_boolean() &&
+                        module["enabled"].get<bool>();
+        if (module.contains("type") && module["type"].is_string()) {
+            entry.type = module["type"].get<std::string>();
+        }
+
+        // Menu hierarchy
+        if (entry.type == "menu" && module.contains("submenus") && module["submenus"].is_array()) {
+            for (const auto& submenu : module["submenus"]) {
+                if (!submenu.contains("id") || !submenu["id"].is_string() ||
+                    !submenu.contains("title") || !submenu["title"].is_string()) {
+                    LOG_WARNING("Skipping submenu with missing required field in " + entry.id);
+                    continue;
+                }
+                entry.submenus.push_back({submenu["id"].get<std::string>(),
+                                          submenu["title"].get<std::string>()});
+            }
+        }
+
+        // Dependencies (string values only)
+        if (module.contains("depends") && module["depends"].is_object()) {
+            for (auto it = module["depends"].begin(); it != module["depends"].end(); ++it) {
+                if (it.value().is_string()) {
+                    entry.depends[it.key()] = it.value().get<std::string>();
+                } else {
+                    LOG_WARNING("Ignoring non-string dependency '" + it.key() + "' for module " + entry.id);
+                }
+            }
+        }
+
+        // GenericList screens consume their full module object
+        if (entry.type == "GenericList") {
+            entry.listConfig = module;
+        }
+
+        m_modules.push_back(std::move(entry));
+    }
+
+    // Persistent data location override, storage backend and file format
+    if (config.contains("persistent_data") && config["persistent_data"].is_object()) {
+        const auto& persistentData = config["persistent_data"];
+        if (persistentData.contains("file_path") && persistentData["file_path"].is_string()) {
+            m_persistentDataFile = persistentData["file_path"].get<std::string>();
+        }
+        if (persistentData.contains("backend") && persistentData["backend"].is_string()) {
+            m_persistentBackend = persistentData["backend"].get<std::string>();
+        }
+        if (persistentData.contains("format") && persistentData["format"].is_string()) {
+            m_persistentFormat = persistentData["format"].get<std::string>();
+        }
+    }
+
+    // Invert Display option in the options section
+    if (config.contains("options") && config["options"].is_object()) {
+        const auto& options = config["options"];
+        if (options.contains("invert_display") && options["invert_display"].is_object()) {
+            const auto& invertOpt = options["invert_display"];
+            if (invertOpt.contains("enabled") && invertOpt["enabled"].is_boolean() &&
+                invertOpt["enabled"].get<bool>() &&
+                invertOpt.contains("title") && invertOpt["title"].is_string()) {
+                m_invertDisplayOption = true;
+                m_invertDisplayTitle = invertOpt["title"].get<std::string>();
+            }
+        }
+    }
+
+    LOG_DEBUG("Compiled config with " + std::to_string(m_modules.size()) + " modules");
+    return true;
+}
+
+bool ScreenConfig::loadCache(const std::string& cachePath, const SourceKey& current, bool& staleKey)
+{
+    int fd = open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    CacheReader reader(static_cast<const char*>(mapped), size);
+    bool decoding = false;
+
+    auto decode = [&]() -> bool {
+        // Header
+        uint8_t magic;
+        for (char c : CACHE_MAGIC) {
+            if (!reader.getU8(magic) || magic != static_cast<uint8_t>(c)) {
+                return false;
+            }
+        }
+        uint32_t version;
+        uint64_t mtimeNs, srcSize, hash;
+        if (!reader.getU32(version) || version != CACHE_VERSION ||
+            !reader.getU64(mtimeNs) || !reader.getU64(srcSize) || !reader.getU64(hash)) {
+            return false;
+        }
+
+        if (srcSize != current.size || hash != current.hash) {
+            return false;
+        }
+        staleKey = static_cast<int64_t>(mtimeNs) != current.mtimeNs;
+
+        // Body
+        clear();
+        decoding = true;
+        uint32_t moduleCount;
+        if (!reader.getU32(moduleCount)) {
+            return false;
+        }
+
+        for (uint32_t m = 0; m < moduleCount; m++) {
+            ModuleEntry entry;
+            uint8_t flags;
+            uint32_t submenuCount, dependsCount;
+            std::string listCbor;
+
+            if (!reader.getString(entry.id) || !reader.getString(entry.title) ||
+                !reader.getString(entry.type) || !reader.getU8(flags) ||
+                !reader.getU32(submenuCount)) {
+                return false;
+            }
+            entry.hasTitle = (flags & 0x01) != 0;
+            entry.enabled = (flags & 0x02) != 0;
+
+            for (uint32_t i = 0; i < submenuCount; i++) {
+                SubmenuEntry submenu;
+                if (!reader.getString(submenu.id) || !reader.getString(submenu.title)) {
+                    return false;
+                }
+                entry.submenus.push_back(submenu);
+            }
+
+            if (!reader.getU32(dependsCount)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < dependsCount; i++) {
+                std::string key, path;
+                if (!reader.getString(key) || !reader.getString(path)) {
+                    return false;
+                }
+                entry.depends[key] = path;
+            }
+
+            if (!reader.getString(listCbor)) {
+                return false;
+            }
+            if (!listCbor.empty()) {
+                entry.listConfig = nlohmann::json::from_cbor(listCbor, true, false);
+                if (entry.listConfig.is_discarded()) {
+                    return false;
+                }
+            }
+
+            m_modules.push_back(std::move(entry));
+        }
+
+        uint8_t invertOption;
+        if (!reader.getString(m_persistentDataFile) || !reader.getString(m_persistentBackend) ||
+            !reader.getString(m_persistentFormat) || !reader.getU8(invertOption) ||
+            !reader.getString(m_invertDisplayTitle) || !reader.atEnd()) {
+            return false;
+        }
+        m_invertDisplayOption = invertOption != 0;
+        return true;
+    };
+
+    bool ok = decode();
+    munmap(mapped, size);
+
+    if (ok) {
+        m_loadedFromCache = true;
+    } else if (decoding) {
+        // A corrupt body may have left a partial model behind
+        LOG_WARNING("Ignoring corrupt config cache: " + cachePath);
+        clear();
+    }
+    return ok;
+}
+
+bool ScreenConfig::writeCache(const std::string& cachePath, const SourceKey& key) const
+{
+    CacheWriter writer;
+    for (char c : CACHE_MAGIC) {
+        writer.putU8(static_cast<uint8_t>(c));
+    }
+    writer.putU32(CACHE_VERSION);
+    writer.putU64(static_cast<uint64_t>(key.mtimeNs));
+    writer.putU64(key.size);
+    writer.putU64(key.hash);
+
+    writer.putU32(static_cast<uint32_t>(m_modules.size()));
+    for (const auto& entry : m_modules) {
+        writer.putString(entry.id);
+        writer.putString(entry.title);
+        writer.putString(entry.type);
+        writer.putU8((entry.hasTitle ? 0x01 : 0x00) | (entry.enabled ? 0x02 : 0x00));
+
+        writer.putU32(static_cast<uint32_t>(entry.submenus.size()));
+        for (const auto& submenu : entry.submenus) {
+            writer.putString(submenu.id);
+            writer.putString(submenu.title);
+        }
+
+        writer.putU32(static_cast<uint32_t>(entry.depends.size()));
+        for (const auto& dep : entry.depends) {
+            writer.putString(dep.first);
+            writer.putString(dep.second);
+        }
+
+        if (entry.listConfig.is_null()) {
+            writer.putString("");
+        } else {
+            std::vector<uint8_t> cbor = nlohmann::json::to_cbor(entry.listConfig);
+            writer.putString(std::string(cbor.begin(), cbor.end()));
+        }
+    }
+
+    writer.putString(m_persistentDataFile);
+    writer.putString(m_persistentBackend);
+    writer.putString(m_persistentFormat);
+    writer.putU8(m_invertDisplayOption ? 1 : 0);
+    writer.putString(m_invertDisplayTitle);
+
+    // Write to a temporary file and rename so a reader never maps a torn cache
+    std::string tempFile = cachePath + ".tmp";
+    std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_DEBUG("Could not write config cache: " + tempFile);
+        return false;
+    }
+    file.write(writer.data().data(), static_cast<std::streamsize>(writer.data().size()));
+    file.close();
+
+    if (!file || rename(tempFile.c_str(), cachePath.c_str()) != 0) {
+        LOG_WARNING("Failed to update config cache: " + cachePath);
+        unlink(tempFile.c_str());
+        return false;
+    }
+
+    LOG_DEBUG("Config cache updated: " + cachePath);
+    return true;
+}
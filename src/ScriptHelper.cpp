@@ -0,0 +1,263 @@
+#include "ScriptHelper.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+
+// Request loop run by the helper. Each request is a background job so set -m gives
+// it its own process group: a timeout kills the job and not the helper, and the
+// helper going away leaves daemons started by earlier requests alone.
+static const char* s_helperScript = R"HELPER(
+set -m
+__helper_run() {
+    case $1 in
+    *[\|\&\;\<\>\(\)\`]*|*$'\n'*)
+        eval "$1"
+        return ;;
+    esac
+    eval "set -- $1"
+    local script=$1 first
+    if [ "${BASH_VERSINFO[0]}" -ge 5 ] && [ -f "$script" ] && IFS= read -r first < "$script"; then
+        case $first in
+        '#!/bin/bash'|'#!/bin/bash '*|'#!/usr/bin/env bash'|'#!/usr/bin/env bash '*)
+            shift
+            BASH_ARGV0=$script
+            . "$script"
+            return ;;
+        esac
+    fi
+    "$@"
+}
+while IFS=' ' read -r tag id mode; do
+    [ "$tag" = REQ ] || exit 1
+    IFS= read -r -d '' cmd || exit 1
+    case $mode in
+    merge) ( printf '%s BEGIN %s\n' "$id" "$BASHPID"; __helper_run "$cmd" ) </dev/null 2>&1 & ;;
+    null)  ( printf '%s BEGIN %s\n' "$id" "$BASHPID"; __helper_run "$cmd" >/dev/null ) </dev/null & ;;
+    *)     ( printf '%s BEGIN %s\n' "$id" "$BASHPID"; __helper_run "$cmd" ) </dev/null & ;;
+    esac
+    wait $!
+    printf '\n%s END %s\n' "$id" "$?"
+done
+)HELPER";
+
+ScriptHelper& ScriptHelper::getInstance() {
+    static ScriptHelper instance;
+    return instance;
+}
+
+ScriptHelper::ScriptHelper() {
+    std::random_device rd;
+    char session[24];
+    snprintf(session, sizeof(session), "%08x%08x-", rd(), rd());
+    m_session = session;
+}
+
+ScriptHelper::~ScriptHelper() {
+    shutdown();
+}
+
+void ScriptHelper::shutdown() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stopHelper();
+}
+
+void ScriptHelper::stopHelper() {
+    if (m_helper.isRunning()) {
+        // Without input the loop ends by itself; terminate() covers a stuck helper
+        m_helper.closeInput();
+        m_helper.poll(Config::SUBPROCESS_REAP_POLL_MS);
+        m_helper.terminate();
+        LOG_DEBUG("ScriptHelper: stopped");
+    }
+}
+
+std::string ScriptHelper::quote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+Subprocess::Result ScriptHelper::runShell(const std::string& command) {
+    return runShell(command, Subprocess::Options());
+}
+
+Subprocess::Result ScriptHelper::run(const std::vector<std::string>& argv) {
+    return run(argv, Subprocess::Options());
+}
+
+Subprocess::Result ScriptHelper::runShell(const std::string& command, const Subprocess::Options& options) {
+    // A separate stderr stream isn't part of the protocol, nor is running commands concurrently
+    if (!options.captureStderr || options.mergeStderr) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        Subprocess::Result result;
+        if (lock.owns_lock() && execute(command, options, result)) {
+            return result;
+        }
+    }
+    return Subprocess::runShell(command, options);
+}
+
+Subprocess::Result ScriptHelper::run(const std::vector<std::string>& argv, const Subprocess::Options& options) {
+    if (!options.captureStderr || options.mergeStderr) {
+        std::string command;
+        for (const auto& arg : argv) {
+            command += (command.empty() ? "" : " ") + quote(arg);
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        Subprocess::Result result;
+        if (lock.owns_lock() && execute(command, options, result)) {
+            return result;
+        }
+    }
+    return Subprocess::run(argv, options);
+}
+
+bool ScriptHelper::ensureRunning() {
+    if (m_helper.isRunning() && m_helper.poll()) {
+        return true;
+    }
+    if (m_unavailable || std::chrono::steady_clock::now() < m_retryAfter) {
+        return false;
+    }
+    if (access("/bin/bash", X_OK) != 0) {
+        Logger::info("ScriptHelper: /bin/bash not available, running commands directly");
+        m_unavailable = true;
+        return false;
+    }
+
+    Subprocess::Options options;
+    options.pipeStdin = true;
+    options.traceName = "script-helper";
+    if (!m_helper.start({"/bin/bash", "--noprofile", "--norc", "-c", s_helperScript, "micropanel-helper"},
+                        options)) {
+        m_retryAfter = std::chrono::steady_clock::now() + std::chrono::seconds(Config::SCRIPT_HELPER_RETRY_SEC);
+        return false;
+    }
+    LOG_INFO("ScriptHelper: started with PID " + std::to_string(m_helper.getPid()));
+    return true;
+}
+
+bool ScriptHelper::execute(const std::string& command, const Subprocess::Options& options,
+                           Subprocess::Result& result) {
+    if (command.find('\0') != std::string::npos || !ensureRunning()) {
+        return false;
+    }
+
+    // Whatever a background job of an earlier request printed since doesn't belong to this one
+    m_helper.takeOutput();
+
+    uint64_t serial = m_nextId++;
+    std::string id = m_session + std::to_string(serial);
+    const char* mode = options.mergeStderr ? "merge" : (options.captureStdout ? "out" : "null");
+    std::string request = "REQ " + id + " " + mode + "\n" + command;
+    request.push_back('\0');
+    if (!m_helper.writeInput(request)) {
+        Logger::warning("ScriptHelper: helper stopped accepting requests");
+        stopHelper();
+        m_retryAfter = std::chrono::steady_clock::now() + std::chrono::seconds(Config::SCRIPT_HELPER_RETRY_SEC);
+        return false;
+    }
+
+    const std::string beginMarker = id + " BEGIN ";
+    const std::string endMarker = "\n" + id + " END ";
+    std::string buffer;
+    bool begun = false;
+    pid_t jobGroup = -1;
+    bool termSent = false;
+    bool killSent = false;
+    auto start = std::chrono::steady_clock::now();
+    auto signalledAt = start;
+
+    // Output goes to the caller's handler as it arrives, or is collected like Subprocess does
+    auto deliver = [&](size_t count) {
+        if (options.outputHandler) {
+            options.outputHandler(buffer.data(), count);
+        } else {
+            result.output.append(buffer, 0, count);
+        }
+        buffer.erase(0, count);
+    };
+
+    for (;;) {
+        bool alive = m_helper.poll(Config::SCRIPT_HELPER_POLL_MS);
+        buffer += m_helper.takeOutput();
+
+        if (!begun) {
+            size_t pos = buffer.find(beginMarker);
+            size_t eol = pos == std::string::npos ? pos : buffer.find('\n', pos);
+            if (eol != std::string::npos) {
+                jobGroup = static_cast<pid_t>(atol(buffer.c_str() + pos + beginMarker.size()));
+                buffer.erase(0, eol + 1);
+                begun = true;
+                TraceRecorder::asyncBegin("process", options.traceName, serial, "helper");
+            }
+        }
+        if (begun) {
+            size_t pos = buffer.find(endMarker);
+            size_t eol = pos == std::string::npos ? pos : buffer.find('\n', pos + endMarker.size());
+            if (eol != std::string::npos) {
+                int status = atoi(buffer.c_str() + pos + endMarker.size());
+                // A job we had to kill reports 128 + signal; Subprocess reports those as -1
+                result.exitCode = termSent ? -1 : status;
+                result.timedOut = termSent;
+                deliver(pos);
+                TraceRecorder::asyncEnd("process", options.traceName, serial);
+                return true;
+            }
+            // Only the tail can still complete a marker, everything before it is output
+            size_t settled = buffer.size() > endMarker.size() ? buffer.size() - endMarker.size() : 0;
+            deliver(settled);
+        }
+
+        if (!alive) {
+            Logger::warning("ScriptHelper: helper exited during a request");
+            m_retryAfter = std::chrono::steady_clock::now() + std::chrono::seconds(Config::SCRIPT_HELPER_RETRY_SEC);
+            if (!begun) {
+                return false;
+            }
+            // The command did run; report what it produced rather than running it twice
+            TraceRecorder::asyncEnd("process", options.traceName, serial);
+            deliver(buffer.size());
+            return true;
+        }
+
+        // Same escalation as Subprocess, applied to the request's process group
+        auto now = std::chrono::steady_clock::now();
+        if (!begun && now - start >= std::chrono::milliseconds(Config::SCRIPT_HELPER_START_TIMEOUT_MS)) {
+            Logger::warning("ScriptHelper: helper didn't pick up the request, restarting");
+            stopHelper();
+            return false;
+        }
+        if (options.timeoutMs > 0 && begun && jobGroup > 1 && !termSent &&
+            now - start >= std::chrono::milliseconds(options.timeoutMs)) {
+            LOG_WARNING("ScriptHelper: request timed out: " + command);
+            termSent = true;
+            signalledAt = now;
+            kill(-jobGroup, SIGTERM);
+        } else if (termSent && !killSent && now - signalledAt >= std::chrono::milliseconds(options.killGraceMs)) {
+            killSent = true;
+            signalledAt = now;
+            kill(-jobGroup, SIGKILL);
+        } else if (killSent && now - signalledAt >= std::chrono::milliseconds(options.killGraceMs)) {
+            // The job is gone but the helper never reported it; start over with a fresh one
+            Logger::warning("ScriptHelper: helper unresponsive, restarting");
+            stopHelper();
+            TraceRecorder::asyncEnd("process", options.traceName, serial);
+            result.timedOut = true;
+            deliver(buffer.size());
+            return true;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include "StartupTrace.h"
+#include "Logger.h"
+#include <time.h>
+
+// Static members are initialized before main(), so the origin approximates process start
+std::vector<StartupTrace::Mark> StartupTrace::s_marks;
+const std::chrono::steady_clock::time_point StartupTrace::s_origin = std::chrono::steady_clock::now();
+
+long StartupTrace::elapsedMs()
+{
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - s_origin).count());
+}
+
+long StartupTrace::bootTimeMs()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0) {
+        return -1;
+    }
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+void StartupTrace::mark(const std::string& phase)
+{
+    Mark m;
+    m.phase = phase;
+    m.processMs = elapsedMs();
+    m.bootMs = bootTimeMs();
+    s_marks.push_back(m);
+
+    LOG_DEBUG("Startup: " + phase + " at +" + std::to_string(m.processMs) + " ms");
+}
+
+void StartupTrace::report()
+{
+    if (s_marks.empty()) {
+        return;
+    }
+
+    Logger::info("Startup trace (process ms / boot ms):");
+    long previous = 0;
+    for (const auto& m : s_marks) {
+        LOG_INFO("  " + m.phase + ": +" + std::to_string(m.processMs) +
+                     " ms (+" + std::to_string(m.processMs - previous) + " ms, boot " +
+                     std::to_string(m.bootMs) + " ms)");
+        previous = m.processMs;
+    }
+}
@@ -0,0 +1,45 @@
+#include "StreamParser.h"
+#include "Config.h"
+#include "Logger.h"
+#include <cstring>
+
+LineStreamParser::LineStreamParser(LineHandler onLine)
+    : m_onLine(std::move(onLine)) {
+}
+
+void LineStreamParser::feed(const char* data, size_t size) {
+    while (size > 0) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', size));
+        size_t length = newline ? static_cast<size_t>(newline - data) : size;
+
+        // Past the limit the rest of the line is dropped
+        size_t room = Config::STREAM_MAX_LINE_BYTES - m_line.size();
+        if (length > room) {
+            m_truncated = true;
+        }
+        m_line.append(data, length < room ? length : room);
+
+        if (!newline) {
+            return;
+        }
+        finish();
+        data = newline + 1;
+        size -= length + 1;
+    }
+}
+
+void LineStreamParser::finish() {
+    if (m_line.empty() && !m_truncated) {
+        return;
+    }
+    if (m_truncated) {
+        LOG_DEBUG("LineStreamParser: truncated a line longer than " +
+                  std::to_string(Config::STREAM_MAX_LINE_BYTES) + " bytes");
+    }
+    if (!m_line.empty() && m_line.back() == '\r') {
+        m_line.pop_back();
+    }
+    m_onLine(m_line);
+    m_line.clear();
+    m_truncated = false;
+}
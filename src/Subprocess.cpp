@@ -0,0 +1,447 @@
+#include "Subprocess.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <string.h>
+#include <thread>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+// Signals the daemon handles or ignores, reset to their defaults in the child
+static const int s_defaultSignals[] = { SIGINT, SIGTERM, SIGHUP, SIGUSR1, SIGPIPE, SIGCHLD };
+
+// Wait out the rest of the grace period for a child that was sent SIGTERM,
+// SIGKILL it if it is still there, and reap it; runs on its own thread
+static void reapDetached(pid_t pid, int pidFd, std::chrono::steady_clock::time_point killAt) {
+    int status = 0;
+    for (;;) {
+        pid_t result = waitpid(pid, &status, WNOHANG);
+        if (result == pid || (result < 0 && errno != EINTR)) {
+            break;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            killAt - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            if (kill(-pid, SIGKILL) != 0) {
+                kill(pid, SIGKILL);
+            }
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            break;
+        }
+        if (pidFd >= 0) {
+            struct pollfd fd = { pidFd, POLLIN, 0 };
+            ::poll(&fd, 1, static_cast<int>(remaining));
+        } else {
+            usleep(static_cast<useconds_t>(std::min<long>(remaining, Config::SUBPROCESS_REAP_POLL_MS)) * 1000);
+        }
+    }
+    if (pidFd >= 0) {
+        close(pidFd);
+    }
+}
+
+Subprocess::~Subprocess() {
+    // No poll() here, the output handler may belong to an owner being torn down
+    int status = 0;
+    if (isRunning() && waitpid(m_pid, &status, WNOHANG) == m_pid) {
+        TraceRecorder::asyncEnd("process", m_options.traceName, static_cast<uint64_t>(m_pid));
+        m_pid = -1;
+    }
+    if (isRunning()) {
+        // Don't hold the caller up for the grace period, the child is reaped in the background
+        if (!m_termSent) {
+            m_termSentAt = std::chrono::steady_clock::now();
+            signalGroup(SIGTERM);
+        }
+        auto killAt = m_killSent ? m_termSentAt : m_termSentAt + std::chrono::milliseconds(m_options.killGraceMs);
+        LOG_DEBUG("Subprocess: PID " + std::to_string(m_pid) + " left to the background reaper");
+        TraceRecorder::asyncEnd("process", m_options.traceName, static_cast<uint64_t>(m_pid));
+        std::thread(reapDetached, m_pid, m_pidFd, killAt).detach();
+        m_pidFd = -1;
+        m_pid = -1;
+    }
+    closeFds();
+}
+
+bool Subprocess::start(const std::vector<std::string>& argv) {
+    return start(argv, Options());
+}
+
+bool Subprocess::startShell(const std::string& command) {
+    return startShell(command, Options());
+}
+
+bool Subprocess::startShell(const std::string& command, const Options& options) {
+    return start({"/bin/sh", "-c", command}, options);
+}
+
+bool Subprocess::start(const std::vector<std::string>& argv, const Options& options) {
+    if (isRunning()) {
+        LOG_WARNING("Subprocess: already running, not starting " + (argv.empty() ? "" : argv[0]));
+        return false;
+    }
+    if (argv.empty()) {
+        return false;
+    }
+
+    closeFds();
+    m_options = options;
+    m_exitCode = -1;
+    m_timedOut = false;
+    m_termSent = false;
+    m_killSent = false;
+    m_output.clear();
+    m_errors.clear();
+
+    int outPipe[2] = { -1, -1 };
+    int errPipe[2] = { -1, -1 };
+    int inPipe[2] = { -1, -1 };
+    if ((options.pipeStdin && pipe2(inPipe, O_CLOEXEC) != 0) ||
+        (options.captureStdout && pipe2(outPipe, O_CLOEXEC) != 0) ||
+        (options.captureStderr && !options.mergeStderr && pipe2(errPipe, O_CLOEXEC) != 0)) {
+        LOG_ERROR("Subprocess: pipe failed: " + std::string(strerror(errno)));
+        // Whichever pipes were created before the failure
+        for (int fd : { inPipe[0], inPipe[1], outPipe[0], outPipe[1], errPipe[0], errPipe[1] }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        return false;
+    }
+
+    // Child side: stdin from /dev/null or the input pipe, stdout/stderr into the pipes or /dev/null
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (inPipe[0] >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, inPipe[0], STDIN_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    if (outPipe[1] >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+    if (options.mergeStderr) {
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    } else if (errPipe[1] >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    // Own process group so a timeout also stops whatever the child started
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    for (int sig : s_defaultSignals) {
+        sigaddset(&defaults, sig);
+    }
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    // Parent keeps only its ends of the pipes
+    for (int fd : { outPipe[1], errPipe[1], inPipe[0] }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    m_stdoutFd = outPipe[0];
+    m_stderrFd = errPipe[0];
+    m_stdinFd = inPipe[1];
+
+    if (rc != 0) {
+        LOG_ERROR("Subprocess: failed to start " + argv[0] + ": " + std::string(strerror(rc)));
+        closeFds();
+        return false;
+    }
+
+    for (int fd : { m_stdoutFd, m_stderrFd }) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    m_pid = pid;
+    m_pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    m_startTime = std::chrono::steady_clock::now();
+    TraceRecorder::asyncBegin("process", options.traceName, static_cast<uint64_t>(pid), argv[0].c_str());
+    LOG_DEBUG("Subprocess: started " + argv[0] + " with PID " + std::to_string(pid));
+    return true;
+}
+
+bool Subprocess::poll(int waitMs) {
+    if (!isRunning()) {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    // Escalate a timeout: SIGTERM first, SIGKILL once the grace period has passed
+    if (m_options.timeoutMs > 0 && !m_termSent &&
+        now - m_startTime >= std::chrono::milliseconds(m_options.timeoutMs)) {
+        LOG_WARNING("Subprocess: PID " + std::to_string(m_pid) + " timed out");
+        m_timedOut = true;
+        m_termSent = true;
+        m_termSentAt = now;
+        signalGroup(SIGTERM);
+    }
+    if (m_termSent && !m_killSent && now - m_termSentAt >= std::chrono::milliseconds(m_options.killGraceMs)) {
+        m_killSent = true;
+        signalGroup(SIGKILL);
+    }
+
+    // Don't sleep past the next escalation step, nor past an exit we can't be woken for
+    if (m_options.timeoutMs > 0 && !m_killSent) {
+        auto deadline = m_termSent ? m_termSentAt + std::chrono::milliseconds(m_options.killGraceMs)
+                                   : m_startTime + std::chrono::milliseconds(m_options.timeoutMs);
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        waitMs = std::min<long>(waitMs, std::max<long>(remaining, 0));
+    }
+    if (m_pidFd < 0) {
+        waitMs = std::min(waitMs, Config::SUBPROCESS_REAP_POLL_MS);
+    }
+
+    struct pollfd fds[3];
+    nfds_t count = 0;
+    for (int fd : { m_stdoutFd, m_stderrFd, m_pidFd }) {
+        if (fd >= 0) {
+            fds[count].fd = fd;
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            count++;
+        }
+    }
+    ::poll(fds, count, waitMs);
+
+    readPipe(m_stdoutFd, m_output, &m_options.outputHandler);
+    readPipe(m_stderrFd, m_errors);
+
+    int status = 0;
+    pid_t result = waitpid(m_pid, &status, WNOHANG);
+    if (result == m_pid) {
+        reap(status);
+    } else if (result < 0 && errno == ECHILD) {
+        // Reaped elsewhere; the exit status is lost
+        reap(0);
+        m_exitCode = -1;
+    }
+    return isRunning();
+}
+
+void Subprocess::wait() {
+    while (poll(100)) {
+    }
+}
+
+void Subprocess::terminate() {
+    if (!isRunning()) {
+        return;
+    }
+
+    if (!m_termSent) {
+        m_termSent = true;
+        m_termSentAt = std::chrono::steady_clock::now();
+        signalGroup(SIGTERM);
+    }
+
+    auto deadline = m_termSentAt + std::chrono::milliseconds(m_options.killGraceMs);
+    while (isRunning() && std::chrono::steady_clock::now() < deadline) {
+        poll(Config::SUBPROCESS_REAP_POLL_MS);
+    }
+
+    if (isRunning()) {
+        m_killSent = true;
+        signalGroup(SIGKILL);
+        int status = 0;
+        while (waitpid(m_pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        reap(status);
+    }
+}
+
+std::string Subprocess::takeOutput() {
+    std::string output;
+    output.swap(m_output);
+    return output;
+}
+
+bool Subprocess::writeInput(const std::string& data) {
+    if (m_stdinFd < 0) {
+        return false;
+    }
+
+    // A child that went away would raise SIGPIPE; keep it from reaching the daemon
+    sigset_t pipeMask;
+    sigset_t oldMask;
+    sigemptyset(&pipeMask);
+    sigaddset(&pipeMask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeMask, &oldMask);
+
+    size_t written = 0;
+    bool ok = true;
+    while (written < data.size()) {
+        ssize_t n = write(m_stdinFd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    if (!ok && errno == EPIPE) {
+        struct timespec zero = { 0, 0 };
+        sigtimedwait(&pipeMask, nullptr, &zero);
+    }
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+
+    if (!ok) {
+        closeInput();
+    }
+    return ok;
+}
+
+void Subprocess::closeInput() {
+    if (m_stdinFd >= 0) {
+        close(m_stdinFd);
+        m_stdinFd = -1;
+    }
+}
+
+bool Subprocess::readPipe(int& fd, std::string& buffer, const OutputHandler* handler) {
+    if (fd < 0) {
+        return false;
+    }
+
+    char chunk[4096];
+    for (;;) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            if (handler && *handler) {
+                (*handler)(chunk, static_cast<size_t>(n));
+            } else {
+                buffer.append(chunk, static_cast<size_t>(n));
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        // End of output
+        close(fd);
+        fd = -1;
+        return false;
+    }
+}
+
+void Subprocess::reap(int status) {
+    // Whatever is already in the pipes; a background grandchild may keep them open
+    readPipe(m_stdoutFd, m_output, &m_options.outputHandler);
+    readPipe(m_stderrFd, m_errors);
+
+    m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    if (WIFSIGNALED(status)) {
+        LOG_DEBUG("Subprocess: PID " + std::to_string(m_pid) + " terminated by signal " +
+                  std::to_string(WTERMSIG(status)));
+    }
+    TraceRecorder::asyncEnd("process", m_options.traceName, static_cast<uint64_t>(m_pid));
+    m_pid = -1;
+    closeFds();
+}
+
+void Subprocess::closeFds() {
+    for (int* fd : { &m_stdoutFd, &m_stderrFd, &m_stdinFd, &m_pidFd }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void Subprocess::signalGroup(int signal) {
+    if (kill(-m_pid, signal) != 0) {
+        kill(m_pid, signal);
+    }
+}
+
+bool Subprocess::isInPath(const std::string& name) {
+    const char* path = getenv("PATH");
+    std::string dirs = path ? path : "/usr/local/bin:/usr/bin:/bin";
+
+    size_t start = 0;
+    while (start <= dirs.size()) {
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos) {
+            end = dirs.size();
+        }
+        std::string dir = dirs.substr(start, end - start);
+        if (access(((dir.empty() ? "." : dir) + "/" + name).c_str(), X_OK) == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+Subprocess::Result Subprocess::run(const std::vector<std::string>& argv) {
+    return run(argv, Options());
+}
+
+Subprocess::Result Subprocess::runShell(const std::string& command) {
+    return runShell(command, Options());
+}
+
+Subprocess::Result Subprocess::run(const std::vector<std::string>& argv, const Options& options) {
+    Result result;
+    Subprocess process;
+    if (!process.start(argv, options)) {
+        return result;
+    }
+    process.wait();
+    result.exitCode = process.getExitCode();
+    result.timedOut = process.timedOut();
+    result.output = std::move(process.m_output);
+    result.errors = std::move(process.m_errors);
+    return result;
+}
+
+Subprocess::Result Subprocess::runShell(const std::string& command, const Options& options) {
+    return run({"/bin/sh", "-c", command}, options);
+}
@@ -0,0 +1,1443 @@
+#include "ThroughputEngine.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <random>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <linux/memfd.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+// iperf3 control states, each sent as one signed byte
+enum State : int8_t {
+    TEST_START = 1,
+    TEST_RUNNING = 2,
+    TEST_END = 4,
+    PARAM_EXCHANGE = 9,
+    CREATE_STREAMS = 10,
+    SERVER_TERMINATE = 11,
+    CLIENT_TERMINATE = 12,
+    EXCHANGE_RESULTS = 13,
+    DISPLAY_RESULTS = 14,
+    IPERF_DONE = 16,
+    ACCESS_DENIED = -1,
+    SERVER_ERROR = -2
+};
+
+// iperf3 error numbers a server reports after SERVER_ERROR, stock clients print their text
+const int s_errorDuration = 5;
+const int s_errorStreams = 6;
+const int s_errorBlockSize = 7;
+const int s_errorUnimplemented = 13;
+
+// 36 base32 characters and a NUL, sent first on the control and on every TCP data connection
+const size_t s_cookieSize = 37;
+const char s_cookieAlphabet[] = "abcdefghijklmnopqrstuvwxyz234567";
+
+// A UDP stream announces itself with one datagram and waits for the answer, both
+// integers in host order as iperf3 writes them; the legacy pair is still accepted
+const uint32_t s_udpConnectMessage = 0x36373839;
+const uint32_t s_udpConnectReply = 0x39383736;
+const uint32_t s_udpLegacyConnectMessage = 123456789;
+const uint32_t s_udpLegacyConnectReply = 987654321;
+
+// Seconds, microseconds and a 32 or 64 bit sequence number open every datagram
+const size_t s_udpHeaderSize = 12;
+const size_t s_udpHeaderSize64 = 16;
+const int s_udpMaxDatagram = 65507;
+
+// Largest parameter or result block taken from a peer
+const uint32_t s_maxJsonSize = 65536;
+
+// Receive buffer of TCP streams when the block is smaller
+const size_t s_tcpReceiveSize = 131072;
+
+// Writes or reads per stream before the others get their turn
+const int s_turnsPerWake = 16;
+
+// A last interval shorter than this share of a full one isn't reported on its own
+const double s_minTailShare = 0.1;
+
+// epoll tags next to the stream indices
+const uint64_t s_tagWake = UINT64_MAX;
+const uint64_t s_tagControl = UINT64_MAX - 1;
+const uint64_t s_tagListener = UINT64_MAX - 2;
+
+std::atomic<uint64_t> s_traceIds{0};
+
+std::string makeCookie() {
+    std::random_device random;
+    std::string cookie;
+    for (size_t i = 0; i < s_cookieSize - 1; i++) {
+        cookie += s_cookieAlphabet[random() % (sizeof(s_cookieAlphabet) - 1)];
+    }
+    cookie += '\0';
+    return cookie;
+}
+
+// sendfile() has no MSG_NOSIGNAL; a peer that resets mustn't raise SIGPIPE on the daemon
+void blockPipeSignal() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+uint32_t totalRetransmits(int fd) {
+    struct tcp_info info {};
+    socklen_t length = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) < 0) {
+        return 0;
+    }
+    return info.tcpi_total_retrans;
+}
+
+void threadCpuSeconds(double& user, double& system) {
+    struct rusage usage {};
+    getrusage(RUSAGE_THREAD, &usage);
+    user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    system = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int udpListener(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // Each stream keeps the socket it arrived on, connected to the client; the next one
+    // binds beside it and the kernel hands every datagram to the best match
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    struct sockaddr_in local {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(static_cast<uint16_t>(port));
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+void setSocketBuffers(int fd, uint32_t size) {
+    if (size > 0) {
+        int value = static_cast<int>(size);
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+    }
+}
+
+std::string formatRate(double bitsPerSecond) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f Mb/s", bitsPerSecond / 1e6);
+    return text;
+}
+
+} // namespace
+
+// Send and receive memory of one test, laid out for its protocol, block size and direction
+class ThroughputEngine::Buffers {
+public:
+    explicit Buffers(const Session& session) {
+        const Options& options = session.options;
+        size_t block = static_cast<size_t>(options.blockSize);
+        m_headerSize = session.counters64 ? s_udpHeaderSize64 : s_udpHeaderSize;
+
+        // Random bytes, so compressing links don't flatter the result
+        std::mt19937 random(std::random_device{}());
+        m_payload.resize(block);
+        for (auto& byte : m_payload) {
+            byte = static_cast<char>(random());
+        }
+
+        if (options.protocol == Protocol::TCP) {
+            if (session.sending) {
+                openMemfd();
+            } else {
+                m_receive.resize(std::max(block, s_tcpReceiveSize));
+            }
+            return;
+        }
+
+        int batch = Config::THROUGHPUT_UDP_BATCH;
+        m_messages.resize(batch);
+        if (session.sending) {
+            // Each datagram gets its own header in front of the shared payload
+            m_headers.resize(batch * s_udpHeaderSize64);
+            m_vectors.resize(batch * 2);
+            for (int i = 0; i < batch; i++) {
+                m_vectors[i * 2].iov_base = &m_headers[i * s_udpHeaderSize64];
+                m_vectors[i * 2].iov_len = m_headerSize;
+                m_vectors[i * 2 + 1].iov_base = m_payload.data();
+                m_vectors[i * 2 + 1].iov_len = block - m_headerSize;
+                m_messages[i].msg_hdr.msg_iov = &m_vectors[i * 2];
+                m_messages[i].msg_hdr.msg_iovlen = 2;
+            }
+        } else {
+            m_controlSize = CMSG_SPACE(sizeof(struct timeval));
+            m_receive.resize(batch * block);
+            m_control.resize(batch * m_controlSize);
+            m_vectors.resize(batch);
+            for (int i = 0; i < batch; i++) {
+                m_vectors[i].iov_base = &m_receive[i * block];
+                m_vectors[i].iov_len = block;
+                m_messages[i].msg_hdr.msg_iov = &m_vectors[i];
+                m_messages[i].msg_hdr.msg_iovlen = 1;
+            }
+        }
+    }
+
+    ~Buffers() {
+        if (m_memfd >= 0) {
+            close(m_memfd);
+        }
+    }
+
+    // One TCP block, spliced from the memfd's pages instead of copied where the kernel can
+    ssize_t sendBlock(int fd) {
+        if (m_memfd >= 0) {
+            off_t offset = 0;
+            ssize_t sent = sendfile(fd, m_memfd, &offset, m_payload.size());
+            if (sent >= 0 || (errno != EINVAL && errno != ENOSYS)) {
+                return sent;
+            }
+            Logger::warning("ThroughputEngine: sendfile unavailable, copying blocks");
+            close(m_memfd);
+            m_memfd = -1;
+        }
+        return send(fd, m_payload.data(), m_payload.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    // Headers for the next count datagrams, numbered from firstSequence
+    void stampDatagrams(int count, uint64_t firstSequence, bool counters64) {
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        uint32_t seconds = htonl(static_cast<uint32_t>(now.tv_sec));
+        uint32_t microseconds = htonl(static_cast<uint32_t>(now.tv_usec));
+        for (int i = 0; i < count; i++) {
+            char* header = &m_headers[i * s_udpHeaderSize64];
+            memcpy(header, &seconds, 4);
+            memcpy(header + 4, &microseconds, 4);
+            if (counters64) {
+                uint64_t sequence = htobe64(firstSequence + i);
+                memcpy(header + 8, &sequence, 8);
+            } else {
+                uint32_t sequence = htonl(static_cast<uint32_t>(firstSequence + i));
+                memcpy(header + 8, &sequence, 4);
+            }
+        }
+    }
+
+    // recvmmsg() shrinks the control lengths it filled in, every batch starts over
+    void prepareReceive() {
+        for (size_t i = 0; i < m_messages.size(); i++) {
+            m_messages[i].msg_hdr.msg_control = &m_control[i * m_controlSize];
+            m_messages[i].msg_hdr.msg_controllen = m_controlSize;
+            m_messages[i].msg_hdr.msg_flags = 0;
+        }
+    }
+
+    struct mmsghdr* messages() { return m_messages.data(); }
+    char* receiveBuffer() { return m_receive.data(); }
+    size_t receiveSize() const { return m_receive.size(); }
+    size_t datagramSize() const { return m_payload.size(); }
+    size_t headerSize() const { return m_headerSize; }
+
+private:
+    void openMemfd() {
+#ifdef SYS_memfd_create
+        m_memfd = static_cast<int>(syscall(SYS_memfd_create, "throughput", MFD_CLOEXEC));
+        if (m_memfd < 0) {
+            return;
+        }
+        size_t written = 0;
+        while (written < m_payload.size()) {
+            ssize_t n = write(m_memfd, m_payload.data() + written, m_payload.size() - written);
+            if (n <= 0) {
+                close(m_memfd);
+                m_memfd = -1;
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+#endif
+    }
+
+    std::vector<char> m_payload;
+    int m_memfd = -1;
+    size_t m_headerSize = s_udpHeaderSize;
+    std::vector<char> m_receive;
+    std::vector<char> m_headers;
+    std::vector<char> m_control;
+    size_t m_controlSize = 0;
+    std::vector<struct iovec> m_vectors;
+    std::vector<struct mmsghdr> m_messages;
+};
+
+ThroughputEngine::~ThroughputEngine() {
+    stop();
+}
+
+bool ThroughputEngine::startClient(const std::string& server, int port) {
+    return startClient(server, port, Options());
+}
+
+bool ThroughputEngine::startClient(const std::string& server, int port, const Options& options) {
+    stop();
+    reset();
+
+    Options resolved = options;
+    if (resolved.blockSize <= 0) {
+        resolved.blockSize = resolved.protocol == Protocol::TCP ? Config::THROUGHPUT_TCP_BLOCK : Config::THROUGHPUT_UDP_BLOCK;
+    }
+    if (resolved.protocol == Protocol::UDP) {
+        resolved.blockSize = std::min(std::max(resolved.blockSize, static_cast<int>(s_udpHeaderSize64)), s_udpMaxDatagram);
+        if (resolved.bitrate == 0) {
+            resolved.bitrate = Config::THROUGHPUT_UDP_BITRATE;
+        }
+    }
+    resolved.parallel = std::min(std::max(resolved.parallel, 1), Config::THROUGHPUT_MAX_STREAMS);
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        LOG_ERROR("ThroughputEngine: eventfd failed: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    m_traceName = resolved.traceName;
+    TraceRecorder::asyncBegin("net", m_traceName, m_traceId, server.c_str());
+
+    m_running = true;
+    m_worker = std::thread(&ThroughputEngine::runClient, this, server, port, resolved);
+    return true;
+}
+
+bool ThroughputEngine::startServer(int port) {
+    stop();
+    reset();
+
+    // Bound here rather than on the worker, so a port in use is reported to the caller
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        fail("socket: " + std::string(strerror(errno)));
+        return false;
+    }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in local {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(static_cast<uint16_t>(port));
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        fail("port " + std::to_string(port) + ": " + strerror(errno));
+        LOG_ERROR("ThroughputEngine: cannot listen on port " + std::to_string(port) + ": " + strerror(errno));
+        close(listener);
+        return false;
+    }
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        LOG_ERROR("ThroughputEngine: eventfd failed: " + std::string(strerror(errno)));
+        close(listener);
+        return false;
+    }
+
+    m_traceId = s_traceIds.fetch_add(1) + 1;
+    m_traceName = "throughput-server";
+    TraceRecorder::asyncBegin("net", m_traceName, m_traceId);
+
+    m_running = true;
+    m_worker = std::thread(&ThroughputEngine::runServer, this, listener, port);
+    return true;
+}
+
+void ThroughputEngine::stop() {
+    m_stopRequested = true;
+    if (m_wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(m_wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    finishRun();
+}
+
+bool ThroughputEngine::poll(std::vector<Interval>& intervals) {
+    // Read before draining: whatever the worker queued before it stopped is then drained too
+    bool running = m_running;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        intervals.insert(intervals.end(), m_intervals.begin(), m_intervals.end());
+        m_intervals.clear();
+    }
+    if (!running) {
+        finishRun();
+    }
+    return running;
+}
+
+ThroughputEngine::Result ThroughputEngine::getResult() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_result;
+}
+
+std::string ThroughputEngine::getError() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
+
+std::string ThroughputEngine::getPeer() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peer;
+}
+
+void ThroughputEngine::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_intervals.clear();
+    m_result = Result();
+    m_error.clear();
+    m_peer.clear();
+    m_stopRequested = false;
+}
+
+void ThroughputEngine::finishRun() {
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    if (m_wakeFd >= 0) {
+        close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+    if (m_traceId != 0) {
+        TraceRecorder::asyncEnd("net", m_traceName, m_traceId);
+        m_traceId = 0;
+    }
+    m_running = false;
+}
+
+void ThroughputEngine::fail(const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = stopping() ? "stopped" : error;
+}
+
+void ThroughputEngine::runClient(std::string server, int port, Options options) {
+    blockPipeSignal();
+
+    Session session;
+    session.options = options;
+    session.sending = !options.reverse;
+    session.socketBuffer = options.protocol == Protocol::UDP ? Config::THROUGHPUT_UDP_BUFFER : 0;
+
+    struct sockaddr_in to {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, server.c_str(), &to.sin_addr) != 1) {
+        fail("bad address " + server);
+    } else if ((session.control = connectTo(to, SOCK_STREAM)) < 0) {
+        fail("connect: " + std::string(strerror(errno)));
+    } else {
+        int one = 1;
+        setsockopt(session.control, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        session.cookie = makeCookie();
+        if (!clientSession(session, to)) {
+            // Tells the server to drop the test instead of waiting it out
+            writeState(session.control, CLIENT_TERMINATE);
+        }
+    }
+
+    std::string error = getError();
+    if (error.empty()) {
+        Result result = getResult();
+        LOG_INFO("ThroughputEngine: " + server + " sent " + formatRate(result.sentBitsPerSecond) +
+                 ", received " + formatRate(result.receivedBitsPerSecond));
+    } else if (stopping()) {
+        LOG_INFO("ThroughputEngine: test with " + server + " stopped");
+    } else {
+        LOG_WARNING("ThroughputEngine: test with " + server + " failed: " + error);
+    }
+
+    closeSession(session);
+    m_running = false;
+}
+
+bool ThroughputEngine::clientSession(Session& session, const struct sockaddr_in& to) {
+    const Options& options = session.options;
+    const int timeout = Config::THROUGHPUT_CONTROL_TIMEOUT_MS;
+
+    if (!writeFully(session.control, session.cookie.data(), s_cookieSize, timeout)) {
+        fail("control connection lost");
+        return false;
+    }
+
+    while (true) {
+        int8_t state = 0;
+        if (!readState(session.control, state, timeout)) {
+            fail("server stopped answering");
+            return false;
+        }
+
+        switch (state) {
+            case PARAM_EXCHANGE: {
+                nlohmann::json parameters;
+                parameters[options.protocol == Protocol::TCP ? "tcp" : "udp"] = true;
+                parameters["omit"] = 0;
+                parameters["time"] = options.durationSec;
+                parameters["num"] = 0;
+                parameters["blockcount"] = 0;
+                parameters["parallel"] = options.parallel;
+                if (options.reverse) {
+                    parameters["reverse"] = true;
+                }
+                if (session.socketBuffer > 0) {
+                    parameters["window"] = session.socketBuffer;
+                }
+                parameters["len"] = options.blockSize;
+                if (options.bitrate > 0) {
+                    parameters["bandwidth"] = options.bitrate;
+                }
+                parameters["pacing_timer"] = Config::THROUGHPUT_PACING_US;
+                parameters["client_version"] = std::string("micropanel ") + Config::VERSION;
+                if (!writeJson(session.control, parameters.dump())) {
+                    fail("parameters not sent");
+                    return false;
+                }
+                break;
+            }
+
+            case CREATE_STREAMS:
+                if (!connectStreams(session, to)) {
+                    return false;
+                }
+                break;
+
+            case TEST_START:
+                break;
+
+            case TEST_RUNNING:
+                if (!runTest(session, true, -1)) {
+                    return false;
+                }
+                if (!writeState(session.control, TEST_END)) {
+                    fail("control connection lost");
+                    return false;
+                }
+                break;
+
+            case EXCHANGE_RESULTS: {
+                std::string results;
+                if (!writeJson(session.control, encodeResults(session)) || !readJson(session.control, results)) {
+                    fail("results not exchanged");
+                    return false;
+                }
+                if (!decodeResults(session, results)) {
+                    fail("bad results from server");
+                    return false;
+                }
+                break;
+            }
+
+            case DISPLAY_RESULTS:
+                writeState(session.control, IPERF_DONE);
+                finishClient(session);
+                return true;
+
+            case ACCESS_DENIED:
+                fail("server busy");
+                return false;
+
+            case SERVER_ERROR: {
+                uint32_t codes[2] = {0, 0};
+                readFully(session.control, codes, sizeof(codes), timeout);
+                fail("server error " + std::to_string(ntohl(codes[0])));
+                return false;
+            }
+
+            case SERVER_TERMINATE:
+                fail("server ended the test");
+                return false;
+
+            default:
+                fail("unexpected state " + std::to_string(state));
+                return false;
+        }
+    }
+}
+
+bool ThroughputEngine::connectStreams(Session& session, const struct sockaddr_in& to) {
+    const Options& options = session.options;
+    bool tcp = options.protocol == Protocol::TCP;
+
+    for (int i = 0; i < options.parallel; i++) {
+        Stream stream;
+        stream.id = i == 0 ? 1 : i + 2;     // iperf3 numbers them 1, 3, 4, ...
+        stream.sender = session.sending;
+        stream.fd = connectTo(to, tcp ? SOCK_STREAM : SOCK_DGRAM);
+        if (stream.fd < 0) {
+            fail("stream connect: " + std::string(strerror(errno)));
+            return false;
+        }
+        session.streams.push_back(stream);
+
+        if (tcp) {
+            if (!writeFully(stream.fd, session.cookie.data(), s_cookieSize, Config::THROUGHPUT_CONNECT_TIMEOUT_MS)) {
+                fail("stream cookie not sent");
+                return false;
+            }
+            continue;
+        }
+
+        setSocketBuffers(stream.fd, session.socketBuffer);
+        if (!stream.sender) {
+            int one = 1;
+            setsockopt(stream.fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one));
+        }
+        uint32_t message = s_udpConnectMessage;
+        uint32_t reply = 0;
+        if (send(stream.fd, &message, sizeof(message), MSG_NOSIGNAL) < 0 ||
+            !readFully(stream.fd, &reply, sizeof(reply), Config::THROUGHPUT_CONNECT_TIMEOUT_MS) ||
+            (reply != s_udpConnectReply && reply != s_udpLegacyConnectReply)) {
+            fail("UDP stream not accepted");
+            return false;
+        }
+    }
+    return true;
+}
+
+void ThroughputEngine::runServer(int listener, int port) {
+    blockPipeSignal();
+    LOG_INFO("ThroughputEngine: serving on port " + std::to_string(port));
+
+    while (!stopping()) {
+        if (!waitFor(listener, POLLIN, -1)) {
+            continue;
+        }
+        struct sockaddr_in from {};
+        socklen_t fromLength = sizeof(from);
+        int control = accept4(listener, reinterpret_cast<struct sockaddr*>(&from), &fromLength,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (control < 0) {
+            continue;
+        }
+
+        char address[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_peer = address;
+            m_error.clear();
+            m_intervals.clear();
+        }
+        LOG_INFO("ThroughputEngine: test from " + std::string(address));
+
+        Session session;
+        session.control = control;
+        if (!serverSession(session, listener, port)) {
+            if (session.control >= 0) {
+                writeState(session.control, SERVER_TERMINATE);
+            }
+            LOG_WARNING("ThroughputEngine: test from " + std::string(address) + " failed: " + getError());
+        }
+        closeSession(session);
+    }
+
+    close(listener);
+    Logger::info("ThroughputEngine: server stopped");
+    m_running = false;
+}
+
+bool ThroughputEngine::serverSession(Session& session, int listener, int port) {
+    const int timeout = Config::THROUGHPUT_CONTROL_TIMEOUT_MS;
+
+    char cookie[s_cookieSize];
+    if (!readFully(session.control, cookie, sizeof(cookie), timeout)) {
+        fail("no cookie from client");
+        return false;
+    }
+    session.cookie.assign(cookie, sizeof(cookie));
+
+    std::string text;
+    if (!writeState(session.control, PARAM_EXCHANGE) || !readJson(session.control, text)) {
+        fail("no parameters from client");
+        return false;
+    }
+    nlohmann::json parameters = nlohmann::json::parse(text, nullptr, false);
+    if (parameters.is_discarded() || !parameters.is_object()) {
+        fail("bad parameters from client");
+        return false;
+    }
+    auto number = [&parameters](const char* key) {
+        auto found = parameters.find(key);
+        return found != parameters.end() && found->is_number() ? found->get<double>() : 0.0;
+    };
+    auto flag = [&parameters](const char* key) {
+        auto found = parameters.find(key);
+        return found != parameters.end() && ((found->is_boolean() && found->get<bool>()) ||
+                                             (found->is_number() && found->get<double>() != 0));
+    };
+
+    Options& options = session.options;
+    options.protocol = flag("udp") ? Protocol::UDP : Protocol::TCP;
+    options.durationSec = static_cast<int>(number("time"));
+    options.parallel = std::max(static_cast<int>(number("parallel")), 1);
+    options.reverse = flag("reverse");
+    options.blockSize = static_cast<int>(number("len"));
+    options.bitrate = static_cast<uint64_t>(number("bandwidth"));
+    session.sending = options.reverse;
+    session.counters64 = flag("udp_counters_64bit");
+    session.socketBuffer = static_cast<uint32_t>(std::min(number("window"), 64.0 * 1024 * 1024));
+    if (options.blockSize <= 0) {
+        options.blockSize = options.protocol == Protocol::TCP ? Config::THROUGHPUT_TCP_BLOCK : Config::THROUGHPUT_UDP_BLOCK;
+    }
+
+    // Tests that end on a byte count, skip their first seconds or run both ways aren't supported
+    int refusal = 0;
+    if (flag("bidirectional") || number("num") > 0 || number("blockcount") > 0 || number("omit") > 0) {
+        refusal = s_errorUnimplemented;
+    } else if (options.parallel > Config::THROUGHPUT_MAX_STREAMS) {
+        refusal = s_errorStreams;
+    } else if (options.durationSec <= 0 || options.durationSec > Config::THROUGHPUT_MAX_DURATION_SEC) {
+        refusal = s_errorDuration;
+    } else if (options.blockSize > Config::THROUGHPUT_MAX_BLOCK ||
+               (options.protocol == Protocol::UDP &&
+                (options.blockSize > s_udpMaxDatagram || options.blockSize < static_cast<int>(s_udpHeaderSize64)))) {
+        refusal = s_errorBlockSize;
+    }
+    if (refusal != 0) {
+        sendServerError(session.control, refusal);
+        fail("refused parameters " + text);
+        return false;
+    }
+
+    if (!acceptStreams(session, listener, port) ||
+        !writeState(session.control, TEST_START) || !writeState(session.control, TEST_RUNNING)) {
+        return false;
+    }
+    if (!runTest(session, false, listener)) {
+        return false;
+    }
+
+    std::string results;
+    if (!writeState(session.control, EXCHANGE_RESULTS) || !readJson(session.control, results) ||
+        !decodeResults(session, results) || !writeJson(session.control, encodeResults(session)) ||
+        !writeState(session.control, DISPLAY_RESULTS)) {
+        fail("results not exchanged");
+        return false;
+    }
+
+    // The client closes once it has them; its goodbye is only a courtesy
+    int8_t state = 0;
+    readState(session.control, state, timeout);
+
+    uint64_t bytes = 0;
+    for (const auto& stream : session.streams) {
+        bytes += stream.bytes;
+    }
+    LOG_INFO("ThroughputEngine: test from " + getPeer() + " done, " +
+             (session.sending ? "sent " : "received ") +
+             formatRate(session.seconds > 0 ? bytes * 8 / session.seconds : 0));
+    return true;
+}
+
+bool ThroughputEngine::acceptStreams(Session& session, int listener, int port) {
+    const Options& options = session.options;
+    const int timeout = Config::THROUGHPUT_CONTROL_TIMEOUT_MS;
+    bool tcp = options.protocol == Protocol::TCP;
+
+    int udp = -1;
+    if (!tcp && (udp = udpListener(port)) < 0) {
+        fail("UDP port " + std::to_string(port) + ": " + strerror(errno));
+        return false;
+    }
+    if (!writeState(session.control, CREATE_STREAMS)) {
+        if (udp >= 0) {
+            close(udp);
+        }
+        fail("control connection lost");
+        return false;
+    }
+
+    bool ok = true;
+    while (ok && static_cast<int>(session.streams.size()) < options.parallel) {
+        struct pollfd fds[3] = {
+            {tcp ? listener : udp, POLLIN, 0},
+            {session.control, POLLIN, 0},
+            {m_wakeFd, POLLIN, 0}
+        };
+        int ready = ::poll(fds, 3, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0 || fds[2].revents || fds[1].revents) {
+            // Nothing is expected on the control connection until the streams are up
+            fail(ready == 0 ? "streams never arrived" : "client gave up");
+            ok = false;
+            break;
+        }
+
+        Stream stream;
+        stream.id = session.streams.empty() ? 1 : static_cast<int>(session.streams.size()) + 2;
+        stream.sender = session.sending;
+
+        if (tcp) {
+            stream.fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (stream.fd < 0) {
+                continue;
+            }
+            char cookie[s_cookieSize];
+            if (!readFully(stream.fd, cookie, sizeof(cookie), Config::THROUGHPUT_CONNECT_TIMEOUT_MS) ||
+                session.cookie.compare(0, s_cookieSize, cookie, sizeof(cookie)) != 0) {
+                // Someone else's control connection, iperf3 turns those away the same way
+                int8_t denied = ACCESS_DENIED;
+                send(stream.fd, &denied, sizeof(denied), MSG_DONTWAIT | MSG_NOSIGNAL);
+                close(stream.fd);
+                continue;
+            }
+            setSocketBuffers(stream.fd, session.socketBuffer);
+            session.streams.push_back(stream);
+            continue;
+        }
+
+        uint32_t message = 0;
+        struct sockaddr_in from {};
+        socklen_t fromLength = sizeof(from);
+        ssize_t received = recvfrom(udp, &message, sizeof(message), MSG_DONTWAIT,
+                                    reinterpret_cast<struct sockaddr*>(&from), &fromLength);
+        if (received != sizeof(message) ||
+            (message != s_udpConnectMessage && message != s_udpLegacyConnectMessage)) {
+            continue;
+        }
+        if (connect(udp, reinterpret_cast<struct sockaddr*>(&from), fromLength) < 0) {
+            fail("UDP connect: " + std::string(strerror(errno)));
+            ok = false;
+            break;
+        }
+        stream.fd = udp;
+        udp = -1;
+        setSocketBuffers(stream.fd, session.socketBuffer);
+        if (!stream.sender) {
+            int one = 1;
+            setsockopt(stream.fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one));
+        }
+        session.streams.push_back(stream);
+
+        uint32_t reply = s_udpConnectReply;
+        if (message == s_udpLegacyConnectMessage) {
+            reply = s_udpLegacyConnectReply;
+        }
+        send(stream.fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+
+        if (static_cast<int>(session.streams.size()) < options.parallel && (udp = udpListener(port)) < 0) {
+            fail("UDP port " + std::to_string(port) + ": " + strerror(errno));
+            ok = false;
+        }
+    }
+
+    if (udp >= 0) {
+        close(udp);
+    }
+    return ok;
+}
+
+bool ThroughputEngine::runTest(Session& session, bool client, int listener) {
+    const Options& options = session.options;
+    bool tcp = options.protocol == Protocol::TCP;
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        fail("epoll: " + std::string(strerror(errno)));
+        return false;
+    }
+    auto watch = [epollFd](int fd, uint32_t events, uint64_t tag, int operation) {
+        struct epoll_event event {};
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epollFd, operation, fd, &event);
+    };
+    watch(m_wakeFd, EPOLLIN, s_tagWake, EPOLL_CTL_ADD);
+    watch(session.control, EPOLLIN, s_tagControl, EPOLL_CTL_ADD);
+    if (listener >= 0) {
+        watch(listener, EPOLLIN, s_tagListener, EPOLL_CTL_ADD);
+    }
+    for (size_t i = 0; i < session.streams.size(); i++) {
+        Stream& stream = session.streams[i];
+        stream.watchingOutput = stream.sender;
+        watch(stream.fd, stream.sender ? EPOLLOUT : EPOLLIN, i, EPOLL_CTL_ADD);
+        if (stream.sender && tcp) {
+            stream.retransmitsAtStart = stream.retransmits = totalRetransmits(stream.fd);
+        }
+    }
+
+    Buffers buffers(session);
+    std::vector<struct epoll_event> events(session.streams.size() + 3);
+
+    double cpuUser = 0;
+    double cpuSystem = 0;
+    threadCpuSeconds(cpuUser, cpuSystem);
+
+    // The client ends the test; the server only gives up on one that never does
+    const double intervalSec = Config::THROUGHPUT_INTERVAL_MS / 1000.0;
+    const double endSec = options.durationSec + (client ? 0 : Config::THROUGHPUT_END_GRACE_SEC);
+    const double bytesPerSec = options.bitrate / 8.0;
+    double reportedSec = 0;
+    double nextReportSec = intervalSec;
+    double elapsed = 0;
+    bool ok = true;
+    bool ended = false;
+    session.startedAt = std::chrono::steady_clock::now();
+
+    while (ok && !ended) {
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - session.startedAt).count();
+        if (elapsed >= endSec) {
+            if (!client) {
+                fail("client never ended the test");
+                ok = false;
+            }
+            break;
+        }
+        if (elapsed >= nextReportSec) {
+            reportInterval(session, reportedSec, elapsed);
+            reportedSec = elapsed;
+            nextReportSec += intervalSec;
+        }
+
+        // A rate limited sender stops watching for room while it's ahead, the pacing wakeup lets it go on
+        bool pacing = false;
+        for (size_t i = 0; i < session.streams.size(); i++) {
+            Stream& stream = session.streams[i];
+            if (!stream.sender || !stream.active) {
+                continue;
+            }
+            bool due = options.bitrate == 0 || stream.bytes < bytesPerSec * elapsed;
+            if (due != stream.watchingOutput) {
+                watch(stream.fd, due ? static_cast<uint32_t>(EPOLLOUT) : 0u, i, EPOLL_CTL_MOD);
+                stream.watchingOutput = due;
+            }
+            pacing |= !due;
+        }
+
+        double waitSec = std::min(nextReportSec, endSec) - elapsed;
+        int timeoutMs = static_cast<int>(std::ceil(waitSec * 1000));
+        if (pacing) {
+            timeoutMs = std::min(timeoutMs, std::max(Config::THROUGHPUT_PACING_US / 1000, 1));
+        }
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), std::max(timeoutMs, 0));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("epoll: " + std::string(strerror(errno)));
+            ok = false;
+            break;
+        }
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - session.startedAt).count();
+        for (int e = 0; e < count && ok; e++) {
+            uint64_t tag = events[e].data.u64;
+            if (tag == s_tagWake) {
+                fail("stopped");
+                ok = false;
+            } else if (tag == s_tagControl) {
+                int8_t state = 0;
+                ssize_t received = recv(session.control, &state, sizeof(state), MSG_DONTWAIT);
+                if (received < 0 && (errno == EAGAIN || errno == EINTR)) {
+                    continue;
+                }
+                if (received == 1 && !client && state == TEST_END) {
+                    ended = true;
+                } else if (received <= 0) {
+                    fail("control connection lost");
+                    ok = false;
+                } else {
+                    fail(std::string(client ? "server" : "client") + " ended the test (state " + std::to_string(state) + ")");
+                    ok = false;
+                }
+            } else if (tag == s_tagListener) {
+                denyClient(listener);
+            } else if (tag < session.streams.size()) {
+                Stream& stream = session.streams[tag];
+                bool keep = stream.sender ? sendStream(session, stream, buffers, elapsed)
+                                          : receiveStream(session, stream, buffers);
+                if (!keep) {
+                    // The control connection tells whether the test is over or the peer is gone
+                    watch(stream.fd, 0, tag, EPOLL_CTL_DEL);
+                    stream.active = false;
+                }
+            }
+        }
+    }
+
+    session.seconds = elapsed;
+    if (elapsed - reportedSec >= intervalSec * s_minTailShare || reportedSec == 0) {
+        reportInterval(session, reportedSec, elapsed);
+    } else {
+        for (auto& stream : session.streams) {
+            if (stream.sender && tcp) {
+                stream.retransmits = totalRetransmits(stream.fd);
+            }
+        }
+    }
+
+    double user = 0;
+    double system = 0;
+    threadCpuSeconds(user, system);
+    session.cpuUser = user - cpuUser;
+    session.cpuSystem = system - cpuSystem;
+
+    close(epollFd);
+    return ok;
+}
+
+bool ThroughputEngine::sendStream(Session& session, Stream& stream, Buffers& buffers, double elapsed) {
+    const Options& options = session.options;
+    double budget = options.bitrate > 0 ? options.bitrate / 8.0 * elapsed - stream.bytes : 0;
+
+    if (options.protocol == Protocol::TCP) {
+        for (int turn = 0; turn < s_turnsPerWake; turn++) {
+            if (options.bitrate > 0 && budget <= 0) {
+                break;
+            }
+            ssize_t sent = buffers.sendBlock(stream.fd);
+            if (sent < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+            stream.bytes += sent;
+            stream.intervalBytes += sent;
+            budget -= sent;
+        }
+        return true;
+    }
+
+    size_t datagram = buffers.datagramSize();
+    for (int turn = 0; turn < s_turnsPerWake; turn++) {
+        int count = Config::THROUGHPUT_UDP_BATCH;
+        if (options.bitrate > 0) {
+            if (budget <= 0) {
+                break;
+            }
+            count = std::min(count, static_cast<int>(std::ceil(budget / datagram)));
+        }
+        buffers.stampDatagrams(count, stream.packets + 1, session.counters64);
+        int sent = sendmmsg(stream.fd, buffers.messages(), count, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            // A full queue or an ICMP error from the peer costs this batch, not the stream
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ||
+                   errno == ENOBUFS || errno == ECONNREFUSED;
+        }
+        stream.packets += sent;
+        stream.intervalPackets += sent;
+        stream.bytes += sent * datagram;
+        stream.intervalBytes += sent * datagram;
+        budget -= sent * static_cast<double>(datagram);
+        if (sent < count) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool ThroughputEngine::receiveStream(Session& session, Stream& stream, Buffers& buffers) {
+    if (session.options.protocol == Protocol::TCP) {
+        for (int turn = 0; turn < s_turnsPerWake; turn++) {
+            ssize_t received = recv(stream.fd, buffers.receiveBuffer(), buffers.receiveSize(), MSG_DONTWAIT);
+            if (received < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+            if (received == 0) {
+                return false;
+            }
+            stream.bytes += received;
+            stream.intervalBytes += received;
+        }
+        return true;
+    }
+
+    size_t headerSize = buffers.headerSize();
+    for (int turn = 0; turn < s_turnsPerWake; turn++) {
+        buffers.prepareReceive();
+        int count = recvmmsg(stream.fd, buffers.messages(), Config::THROUGHPUT_UDP_BATCH, MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNREFUSED;
+        }
+
+        struct timeval batchTime;
+        gettimeofday(&batchTime, nullptr);
+        for (int i = 0; i < count; i++) {
+            const struct msghdr& message = buffers.messages()[i].msg_hdr;
+            size_t length = buffers.messages()[i].msg_len;
+            if (length < headerSize) {
+                continue;   // A repeated connect message
+            }
+            stream.bytes += length;
+            stream.intervalBytes += length;
+            stream.intervalPackets++;
+
+            const char* header = static_cast<const char*>(message.msg_iov[0].iov_base);
+            uint32_t seconds;
+            uint32_t microseconds;
+            memcpy(&seconds, header, 4);
+            memcpy(&microseconds, header + 4, 4);
+            uint64_t sequence;
+            if (session.counters64) {
+                memcpy(&sequence, header + 8, 8);
+                sequence = be64toh(sequence);
+            } else {
+                uint32_t sequence32;
+                memcpy(&sequence32, header + 8, 4);
+                sequence = ntohl(sequence32);
+            }
+
+            // Gaps count as lost until a late datagram fills one in, as iperf3 counts them
+            if (sequence > stream.packets) {
+                int64_t gap = static_cast<int64_t>(sequence - stream.packets - 1);
+                stream.lost += gap;
+                stream.intervalLost += gap;
+                stream.packets = sequence;
+            } else if (stream.lost > 0) {
+                stream.lost--;
+                stream.intervalLost--;
+            }
+
+            // Kernel receive time where the socket delivers one, the batch's time otherwise
+            struct timeval arrival = batchTime;
+            for (struct cmsghdr* control = CMSG_FIRSTHDR(&message); control;
+                 control = CMSG_NXTHDR(const_cast<struct msghdr*>(&message), control)) {
+                if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMP) {
+                    memcpy(&arrival, CMSG_DATA(control), sizeof(arrival));
+                }
+            }
+            double transit = (arrival.tv_sec - static_cast<double>(ntohl(seconds))) +
+                             (arrival.tv_usec - static_cast<double>(ntohl(microseconds))) / 1e6;
+            if (stream.haveTransit) {
+                stream.jitter += (std::fabs(transit - stream.lastTransit) - stream.jitter) / 16.0;
+            }
+            stream.lastTransit = transit;
+            stream.haveTransit = true;
+        }
+        if (count < Config::THROUGHPUT_UDP_BATCH) {
+            break;
+        }
+    }
+    return true;
+}
+
+void ThroughputEngine::reportInterval(Session& session, double startSec, double endSec) {
+    bool tcp = session.options.protocol == Protocol::TCP;
+
+    Interval interval;
+    interval.startSec = startSec;
+    interval.endSec = endSec;
+    double jitter = 0;
+    int receivers = 0;
+    for (auto& stream : session.streams) {
+        interval.bytes += stream.intervalBytes;
+        interval.packets += stream.intervalPackets;
+        if (stream.sender && tcp) {
+            uint32_t total = totalRetransmits(stream.fd);
+            interval.retransmits = std::max(interval.retransmits, 0) + static_cast<int>(total - stream.retransmits);
+            stream.retransmits = total;
+        } else if (!stream.sender && !tcp) {
+            jitter += stream.jitter;
+            interval.lostPackets = std::max<int64_t>(interval.lostPackets, 0) + stream.intervalLost;
+            receivers++;
+        }
+        stream.intervalBytes = 0;
+        stream.intervalPackets = 0;
+        stream.intervalLost = 0;
+    }
+    if (receivers > 0) {
+        interval.jitterMs = jitter / receivers * 1000;
+    }
+    double seconds = endSec - startSec;
+    interval.bitsPerSecond = seconds > 0 ? interval.bytes * 8 / seconds : 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_intervals.size() >= Config::THROUGHPUT_MAX_QUEUED_INTERVALS) {
+        m_intervals.erase(m_intervals.begin());
+    }
+    m_intervals.push_back(interval);
+}
+
+void ThroughputEngine::denyClient(int listener) {
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) {
+        int8_t denied = ACCESS_DENIED;
+        send(fd, &denied, sizeof(denied), MSG_DONTWAIT | MSG_NOSIGNAL);
+        close(fd);
+        Logger::info("ThroughputEngine: turned a second client away");
+    }
+}
+
+void ThroughputEngine::sendServerError(int fd, int code) {
+    // The error number and errno follow the state, stock clients print their text
+    uint32_t codes[2] = {htonl(static_cast<uint32_t>(code)), 0};
+    if (writeState(fd, SERVER_ERROR)) {
+        writeFully(fd, codes, sizeof(codes), Config::THROUGHPUT_CONTROL_TIMEOUT_MS);
+    }
+}
+
+std::string ThroughputEngine::encodeResults(const Session& session) const {
+    bool tcp = session.options.protocol == Protocol::TCP;
+
+    nlohmann::json results;
+    double seconds = session.seconds > 0 ? session.seconds : 1;
+    results["cpu_util_total"] = (session.cpuUser + session.cpuSystem) / seconds * 100;
+    results["cpu_util_user"] = session.cpuUser / seconds * 100;
+    results["cpu_util_system"] = session.cpuSystem / seconds * 100;
+    results["sender_has_retransmits"] = session.sending ? (tcp ? 1 : 0) : -1;
+
+    nlohmann::json streams = nlohmann::json::array();
+    for (const auto& stream : session.streams) {
+        nlohmann::json entry;
+        entry["id"] = stream.id;
+        entry["bytes"] = stream.bytes;
+        entry["retransmits"] = session.sending && tcp ? static_cast<int>(stream.retransmits - stream.retransmitsAtStart) : -1;
+        entry["jitter"] = stream.jitter;
+        entry["errors"] = stream.lost;
+        entry["packets"] = stream.packets;
+        entry["start_time"] = 0;
+        entry["end_time"] = session.seconds;
+        streams.push_back(entry);
+    }
+    results["streams"] = streams;
+    return results.dump();
+}
+
+bool ThroughputEngine::decodeResults(Session& session, const std::string& text) {
+    nlohmann::json results = nlohmann::json::parse(text, nullptr, false);
+    if (results.is_discarded() || !results.is_object()) {
+        return false;
+    }
+    auto streams = results.find("streams");
+    if (streams == results.end() || !streams->is_array()) {
+        return false;
+    }
+
+    auto number = [](const nlohmann::json& object, const char* key) {
+        auto found = object.find(key);
+        return found != object.end() && found->is_number() ? found->get<double>() : 0.0;
+    };
+    session.peer.clear();
+    for (const auto& entry : *streams) {
+        if (!entry.is_object()) {
+            return false;
+        }
+        PeerStream peer;
+        peer.id = static_cast<int>(number(entry, "id"));
+        peer.bytes = static_cast<uint64_t>(number(entry, "bytes"));
+        peer.retransmits = static_cast<int>(number(entry, "retransmits"));
+        peer.jitter = number(entry, "jitter");
+        peer.errors = static_cast<int64_t>(number(entry, "errors"));
+        peer.packets = static_cast<uint64_t>(number(entry, "packets"));
+        peer.seconds = number(entry, "end_time") - number(entry, "start_time");
+        session.peer.push_back(peer);
+    }
+    return true;
+}
+
+void ThroughputEngine::finishClient(const Session& session) {
+    bool tcp = session.options.protocol == Protocol::TCP;
+
+    uint64_t bytes = 0;
+    uint64_t packets = 0;
+    int64_t lost = 0;
+    double jitter = 0;
+    int retransmits = 0;
+    for (const auto& stream : session.streams) {
+        bytes += stream.bytes;
+        packets += stream.packets;
+        lost += stream.lost;
+        jitter += stream.jitter;
+        retransmits += static_cast<int>(stream.retransmits - stream.retransmitsAtStart);
+    }
+
+    uint64_t peerBytes = 0;
+    uint64_t peerPackets = 0;
+    int64_t peerLost = 0;
+    double peerJitter = 0;
+    int peerRetransmits = 0;
+    bool peerCountedRetransmits = !session.peer.empty();
+    double peerSeconds = 0;
+    for (const auto& peer : session.peer) {
+        peerBytes += peer.bytes;
+        peerPackets += peer.packets;
+        peerLost += peer.errors;
+        peerJitter += peer.jitter;
+        peerRetransmits += std::max(peer.retransmits, 0);
+        peerCountedRetransmits &= peer.retransmits >= 0;
+        peerSeconds = std::max(peerSeconds, peer.seconds);
+    }
+    double seconds = session.seconds > 0 ? session.seconds : 1;
+    if (peerSeconds <= 0) {
+        peerSeconds = seconds;
+    }
+    size_t peerStreams = std::max<size_t>(session.peer.size(), 1);
+    size_t ownStreams = std::max<size_t>(session.streams.size(), 1);
+
+    Result result;
+    result.valid = true;
+    if (session.sending) {
+        result.bytesSent = bytes;
+        result.sentBitsPerSecond = bytes * 8 / seconds;
+        result.bytesReceived = peerBytes;
+        result.receivedBitsPerSecond = peerBytes * 8 / peerSeconds;
+        result.retransmits = tcp ? retransmits : -1;
+        result.jitterMs = peerJitter / peerStreams * 1000;
+        result.lostPackets = peerLost;
+        result.packets = packets;
+    } else {
+        result.bytesSent = peerBytes;
+        result.sentBitsPerSecond = peerBytes * 8 / peerSeconds;
+        result.bytesReceived = bytes;
+        result.receivedBitsPerSecond = bytes * 8 / seconds;
+        result.retransmits = tcp && peerCountedRetransmits ? peerRetransmits : -1;
+        result.jitterMs = jitter / ownStreams * 1000;
+        result.lostPackets = lost;
+        result.packets = peerPackets > 0 ? peerPackets : packets;
+    }
+    result.lostPercent = result.packets > 0 ? 100.0 * result.lostPackets / result.packets : 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_result = result;
+}
+
+void ThroughputEngine::closeSession(Session& session) {
+    for (auto& stream : session.streams) {
+        if (stream.fd >= 0) {
+            close(stream.fd);
+        }
+    }
+    session.streams.clear();
+    if (session.control >= 0) {
+        close(session.control);
+        session.control = -1;
+    }
+}
+
+bool ThroughputEngine::waitFor(int fd, short events, int timeoutMs) {
+    struct pollfd fds[2] = {{fd, events, 0}, {m_wakeFd, POLLIN, 0}};
+    while (!stopping()) {
+        int ready = ::poll(fds, 2, timeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        return ready > 0 && fds[0].revents != 0 && fds[1].revents == 0;
+    }
+    return false;
+}
+
+bool ThroughputEngine::readFully(int fd, void* data, size_t size, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    char* cursor = static_cast<char*>(data);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t received = recv(fd, cursor + done, size - done, MSG_DONTWAIT);
+        if (received > 0) {
+            done += static_cast<size_t>(received);
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return false;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0 || !waitFor(fd, POLLIN, static_cast<int>(left))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThroughputEngine::writeFully(int fd, const void* data, size_t size, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    const char* cursor = static_cast<const char*>(data);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t sent = send(fd, cursor + done, size - done, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent > 0) {
+            done += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return false;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0 || !waitFor(fd, POLLOUT, static_cast<int>(left))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThroughputEngine::readState(int fd, int8_t& state, int timeoutMs) {
+    return readFully(fd, &state, sizeof(state), timeoutMs);
+}
+
+bool ThroughputEngine::writeState(int fd, int8_t state) {
+    return writeFully(fd, &state, sizeof(state), Config::THROUGHPUT_CONTROL_TIMEOUT_MS);
+}
+
+bool ThroughputEngine::readJson(int fd, std::string& text) {
+    // A four byte length in network order, then the JSON itself
+    uint32_t length = 0;
+    if (!readFully(fd, &length, sizeof(length), Config::THROUGHPUT_CONTROL_TIMEOUT_MS)) {
+        return false;
+    }
+    length = ntohl(length);
+    if (length == 0 || length > s_maxJsonSize) {
+        return false;
+    }
+    text.resize(length);
+    return readFully(fd, &text[0], length, Config::THROUGHPUT_CONTROL_TIMEOUT_MS);
+}
+
+bool ThroughputEngine::writeJson(int fd, const std::string& text) {
+    uint32_t length = htonl(static_cast<uint32_t>(text.size()));
+    return writeFully(fd, &length, sizeof(length), Config::THROUGHPUT_CONTROL_TIMEOUT_MS) &&
+           writeFully(fd, text.data(), text.size(), Config::THROUGHPUT_CONTROL_TIMEOUT_MS);
+}
+
+int ThroughputEngine::connectTo(const struct sockaddr_in& to, int type) {
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const struct sockaddr*>(&to), sizeof(to)) == 0) {
+        return fd;
+    }
+    int error = errno;
+    if (error == EINPROGRESS) {
+        if (waitFor(fd, POLLOUT, Config::THROUGHPUT_CONNECT_TIMEOUT_MS)) {
+            socklen_t length = sizeof(error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        } else {
+            error = stopping() ? EINTR : ETIMEDOUT;
+        }
+        if (error == 0) {
+            return fd;
+        }
+    }
+    close(fd);
+    errno = error;
+    return -1;
+}
@@ -0,0 +1,271 @@
+#include "TraceRecorder.h"
+#include "Logger.h"
+#include <nlohmann/json.hpp>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <cerrno>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+using json = nlohmann::json;
+
+std::atomic<bool> TraceRecorder::s_enabled{true};
+
+namespace {
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t id;
+    int32_t tid;                // Per event: a buffer outlives the thread that filled it
+    char phase;
+    char detail[Config::TRACE_DETAIL_LENGTH];
+};
+
+// Written only by its owning thread; the exporter reads it without locking,
+// so an event being overwritten during export may come out garbled
+struct ThreadBuffer {
+    int32_t tid = 0;            // Current owner
+    std::atomic<uint64_t> count{0};
+    TraceEvent events[Config::TRACE_EVENTS_PER_THREAD];
+};
+
+struct TraceState {
+    std::mutex buffersMutex;   // Only taken when a thread records its first event or exits, and on export
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> freeBuffers;     // Left by exited threads, events kept until reused
+    std::thread exportThread;
+    std::atomic<bool> exportRunning{false};
+};
+
+// eventfd the export thread sleeps on; a plain static so the signal handler never
+// runs an initializer
+std::atomic<int> s_exportWakeFd{-1};
+
+// Never destroyed, so spans recorded from static destructors stay safe
+TraceState& state() {
+    static TraceState* s = new TraceState();
+    return *s;
+}
+
+// A thread's claim on a buffer, handed back for the next thread when it exits,
+// so short-lived worker threads don't each leave a buffer behind
+struct BufferLease {
+    ThreadBuffer* buffer = nullptr;
+    bool denied = false;
+
+    ~BufferLease() {
+        if (buffer) {
+            TraceState& s = state();
+            std::lock_guard<std::mutex> lock(s.buffersMutex);
+            s.freeBuffers.push_back(buffer);
+        }
+    }
+};
+
+// Null once TRACE_MAX_THREAD_BUFFERS threads are recording at the same time
+ThreadBuffer* threadBuffer() {
+    thread_local BufferLease lease;
+    if (!lease.buffer && !lease.denied) {
+        TraceState& s = state();
+        std::lock_guard<std::mutex> lock(s.buffersMutex);
+        if (!s.freeBuffers.empty()) {
+            lease.buffer = s.freeBuffers.back();
+            s.freeBuffers.pop_back();
+        } else if (s.buffers.size() < Config::TRACE_MAX_THREAD_BUFFERS) {
+            s.buffers.emplace_back(new ThreadBuffer());
+            lease.buffer = s.buffers.back().get();
+        } else {
+            lease.denied = true;
+            return nullptr;
+        }
+        lease.buffer->tid = static_cast<int32_t>(syscall(SYS_gettid));
+    }
+    return lease.buffer;
+}
+
+} // namespace
+
+uint64_t TraceRecorder::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void TraceRecorder::record(char phase, const char* category, const char* name, uint64_t startNs,
+                           uint64_t durationNs, uint64_t id, const char* detail) {
+    ThreadBuffer* owned = threadBuffer();
+    if (!owned) {
+        return;
+    }
+    ThreadBuffer& buffer = *owned;
+    uint64_t index = buffer.count.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer.events[index & (Config::TRACE_EVENTS_PER_THREAD - 1)];
+
+    event.category = category;
+    event.name = name;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    event.id = id;
+    event.tid = buffer.tid;
+    event.phase = phase;
+    event.detail[0] = '\0';
+    if (detail) {
+        strncpy(event.detail, detail, sizeof(event.detail) - 1);
+        event.detail[sizeof(event.detail) - 1] = '\0';
+    }
+
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void TraceRecorder::complete(const char* category, const char* name, uint64_t startNs, uint64_t endNs,
+                             const char* detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    record('X', category, name, startNs, endNs > startNs ? endNs - startNs : 0, 0, detail);
+}
+
+void TraceRecorder::instant(const char* category, const char* name, const char* detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    record('i', category, name, nowNs(), 0, 0, detail);
+}
+
+void TraceRecorder::asyncBegin(const char* category, const char* name, uint64_t id, const char* detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    record('b', category, name, nowNs(), 0, id, detail);
+}
+
+void TraceRecorder::asyncEnd(const char* category, const char* name, uint64_t id) {
+    if (!isEnabled()) {
+        return;
+    }
+    record('e', category, name, nowNs(), 0, id, nullptr);
+}
+
+bool TraceRecorder::exportChromeJson(const std::string& path) {
+    TraceState& s = state();
+    json events = json::array();
+    long pid = getpid();
+
+    {
+        std::lock_guard<std::mutex> lock(s.buffersMutex);
+        for (const auto& buffer : s.buffers) {
+            uint64_t count = buffer->count.load(std::memory_order_acquire);
+            uint64_t first = count > Config::TRACE_EVENTS_PER_THREAD ? count - Config::TRACE_EVENTS_PER_THREAD : 0;
+
+            for (uint64_t i = first; i < count; i++) {
+                const TraceEvent& event = buffer->events[i & (Config::TRACE_EVENTS_PER_THREAD - 1)];
+                json entry = {
+                    {"name", event.name},
+                    {"cat", event.category},
+                    {"ph", std::string(1, event.phase)},
+                    {"ts", event.startNs / 1000.0},
+                    {"pid", pid},
+                    {"tid", event.tid}
+                };
+                if (event.phase == 'X') {
+                    entry["dur"] = event.durationNs / 1000.0;
+                } else if (event.phase == 'i') {
+                    entry["s"] = "t";
+                } else {
+                    entry["id"] = event.id;
+                }
+                if (event.detail[0] != '\0') {
+                    entry["args"] = {{"detail", std::string(event.detail)}};
+                }
+                events.push_back(entry);
+            }
+        }
+    }
+
+    // Write to a temporary file first so a reader never sees a partial trace
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath);
+    if (!file.is_open()) {
+        LOG_ERROR("Cannot write trace file: " + tempPath);
+        return false;
+    }
+    json trace = {{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+    // Replace invalid UTF-8 from truncated detail text instead of throwing
+    file << trace.dump(-1, ' ', false, json::error_handler_t::replace);
+    file.close();
+    if (!file || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("Failed to save trace file: " + path);
+        return false;
+    }
+
+    LOG_INFO("Trace exported to " + path + " (" + std::to_string(events.size()) + " events)");
+    return true;
+}
+
+void TraceRecorder::requestExport() {
+    int fd = s_exportWakeFd.load();
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void TraceRecorder::startExportThread(const std::string& path, std::function<void()> alsoExport) {
+    TraceState& s = state();
+    if (s.exportRunning.exchange(true)) {
+        return;
+    }
+    if (s_exportWakeFd.load() < 0) {
+        int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (fd < 0) {
+            LOG_WARNING("Trace export unavailable: eventfd failed: " + std::string(strerror(errno)));
+            s.exportRunning = false;
+            return;
+        }
+        s_exportWakeFd.store(fd);
+    }
+
+    // Exports from its own thread, so a trace can be taken while the UI thread is stuck;
+    // it only wakes up when an export is requested
+    s.exportThread = std::thread([path, alsoExport]() {
+        TraceState& st = state();
+        int fd = s_exportWakeFd.load();
+        while (st.exportRunning) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (::poll(&pfd, 1, -1) <= 0) {
+                continue;
+            }
+            uint64_t count;
+            if (::read(fd, &count, sizeof(count)) != sizeof(count) || !st.exportRunning) {
+                continue;
+            }
+            exportChromeJson(path);
+            if (alsoExport) {
+                alsoExport();
+            }
+        }
+    });
+}
+
+void TraceRecorder::stopExportThread() {
+    TraceState& s = state();
+    if (!s.exportRunning.exchange(false)) {
+        return;
+    }
+    requestExport();
+    if (s.exportThread.joinable()) {
+        s.exportThread.join();
+    }
+}
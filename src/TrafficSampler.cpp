@@ -0,0 +1,168 @@
+#include "TrafficSampler.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// /proc/net/dev columns after the interface name
+enum Column {
+    RX_BYTES = 0, RX_PACKETS = 1, RX_ERRORS = 2, RX_DROPS = 3,
+    TX_BYTES = 8, TX_PACKETS = 9, TX_ERRORS = 10, TX_DROPS = 11,
+    COLUMN_COUNT = 16
+};
+
+// Per second rate of a counter; a counter that went backwards was reset
+double rate(uint64_t now, uint64_t before, double seconds) {
+    return now >= before ? static_cast<double>(now - before) / seconds : 0.0;
+}
+
+} // namespace
+
+constexpr int TrafficSampler::HISTORY;
+
+void TrafficSampler::History::push(float value) {
+    m_values[m_next] = value;
+    m_next = (m_next + 1) % HISTORY;
+    m_count = std::min(m_count + 1, HISTORY);
+}
+
+float TrafficSampler::History::peak() const {
+    float peak = 0;
+    for (int i = 0; i < m_count; i++) {
+        peak = std::max(peak, at(i));
+    }
+    return peak;
+}
+
+TrafficSampler::~TrafficSampler() {
+    close();
+}
+
+bool TrafficSampler::open() {
+    close();
+    m_fd = ::open(Config::TRAFFIC_STATS_PATH, O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0) {
+        LOG_ERROR("TrafficSampler: cannot open " + std::string(Config::TRAFFIC_STATS_PATH) + ": " + strerror(errno));
+        return false;
+    }
+    m_buffer.resize(Config::TRAFFIC_READ_BUFFER);
+    m_interfaces.clear();
+    m_sampled = false;
+    return true;
+}
+
+void TrafficSampler::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool TrafficSampler::readStats() {
+    // pread from the start regenerates the whole table without reopening it
+    while (true) {
+        ssize_t length = pread(m_fd, m_buffer.data(), m_buffer.size() - 1, 0);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("TrafficSampler: read failed: " + std::string(strerror(errno)));
+            return false;
+        }
+        if (static_cast<size_t>(length) < m_buffer.size() - 1) {
+            m_buffer[length] = '\0';
+            return true;
+        }
+        m_buffer.resize(m_buffer.size() * 2);
+    }
+}
+
+bool TrafficSampler::sample() {
+    if (m_fd < 0 || !readStats()) {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - m_sampledAt).count();
+    bool haveRates = m_sampled && seconds > 0;
+
+    std::vector<Interface> current;
+    current.reserve(m_interfaces.size());
+
+    // Two header lines, then "  name: 16 counters" per interface
+    char* line = m_buffer.data();
+    for (int skip = 0; skip < 2 && line; skip++) {
+        line = strchr(line, '\n');
+        line = line ? line + 1 : nullptr;
+    }
+    while (line && *line) {
+        char* end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+
+        char* colon = strchr(line, ':');
+        if (colon) {
+            char* name = line + strspn(line, " ");
+            std::string interfaceName(name, colon - name);
+
+            uint64_t values[COLUMN_COUNT] = {};
+            char* cursor = colon + 1;
+            for (int i = 0; i < COLUMN_COUNT; i++) {
+                values[i] = strtoull(cursor, &cursor, 10);
+            }
+
+            // The order rarely changes, so the entry in the same place is tried first
+            size_t position = current.size();
+            Interface entry;
+            bool isNew = false;
+            if (position < m_interfaces.size() && m_interfaces[position].name == interfaceName) {
+                entry = std::move(m_interfaces[position]);
+            } else {
+                auto found = std::find_if(m_interfaces.begin(), m_interfaces.end(), [&](const Interface& known) {
+                    return known.name == interfaceName;
+                });
+                if (found != m_interfaces.end()) {
+                    entry = std::move(*found);
+                } else {
+                    entry.name = interfaceName;
+                    isNew = true;
+                }
+            }
+
+            Counters counters;
+            counters.rxBytes = values[RX_BYTES];
+            counters.rxPackets = values[RX_PACKETS];
+            counters.rxErrors = values[RX_ERRORS];
+            counters.rxDrops = values[RX_DROPS];
+            counters.txBytes = values[TX_BYTES];
+            counters.txPackets = values[TX_PACKETS];
+            counters.txErrors = values[TX_ERRORS];
+            counters.txDrops = values[TX_DROPS];
+
+            // A new interface has nothing to compare against until the next sample
+            if (haveRates && !isNew) {
+                entry.rates.rxBitsPerSec = rate(counters.rxBytes, entry.counters.rxBytes, seconds) * 8;
+                entry.rates.txBitsPerSec = rate(counters.txBytes, entry.counters.txBytes, seconds) * 8;
+                entry.rates.rxPacketsPerSec = rate(counters.rxPackets, entry.counters.rxPackets, seconds);
+                entry.rates.txPacketsPerSec = rate(counters.txPackets, entry.counters.txPackets, seconds);
+                entry.rxHistory.push(static_cast<float>(entry.rates.rxBitsPerSec));
+                entry.txHistory.push(static_cast<float>(entry.rates.txBitsPerSec));
+            }
+            entry.counters = counters;
+            current.push_back(std::move(entry));
+        }
+
+        line = end ? end + 1 : nullptr;
+    }
+
+    m_interfaces.swap(current);
+    m_sampledAt = now;
+    m_sampled = true;
+    return true;
+}
@@ -11,6 +11,43 @@
 #include <linux/input.h>
 #include <dirent.h>  // For DIR and readdir
 #include "Logger.h"
+#include "Subprocess.h"
+#include <sstream>
+#include <cctype>
+
+// First "<devicePrefix><number>" in a kernel log line containing marker or up to
+// followLines lines after it (what "dmesg | grep -A n marker | grep -o" used to do)
+static std::string findInKernelLog(const std::string& marker, int followLines, const std::string& devicePrefix)
+{
+    Subprocess::Options options;
+    options.traceName = "dmesg";
+    std::istringstream log(Subprocess::run({"dmesg"}, options).output);
+
+    std::string line;
+    int remaining = -1;
+    while (std::getline(log, line)) {
+        if (line.find(marker) != std::string::npos) {
+            remaining = followLines;
+        }
+        if (remaining < 0) {
+            continue;
+        }
+        remaining--;
+
+        size_t pos = line.find(devicePrefix);
+        while (pos != std::string::npos) {
+            size_t end = pos + devicePrefix.size();
+            while (end < line.size() && isdigit(static_cast<unsigned char>(line[end]))) {
+                end++;
+            }
+            if (end > pos + devicePrefix.size()) {
+                return line.substr(pos, end - pos);
+            }
+            pos = line.find(devicePrefix, end);
+        }
+    }
+    return "";
+}
 
 DeviceManager::DeviceManager()
     : m_deviceDisconnected(false),
@@ -45,12 +82,12 @@ bool DeviceManager::checkDevicePresent() const
         return false;
     }
     
-    Logger::debug("Looking for HMI device with VID:PID " + std::string(Config::HMI_VENDOR_ID) + ":" + 
+    LOG_DEBUG("Looking for HMI device with VID:PID " + std::string(Config::HMI_VENDOR_ID) + ":" + 
                 std::string(Config::HMI_PRODUCT_ID));
     
     // List all input devices for debugging
     if (Logger::isVerbose()) {
-        Logger::debug("Available input devices:");
+        LOG_DEBUG("Available input devices:");
         DIR* dir = opendir("/dev/input");
         if (dir) {
             struct dirent* entry;
@@ -64,13 +101,13 @@ bool DeviceManager::checkDevicePresent() const
                     if (fd >= 0) {
                         char name[256] = "Unknown";
                         if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) >= 0) {
-                            Logger::debug("  " + path + ": " + name);
+                            LOG_DEBUG("  " + path + ": " + name);
                         } else {
-                            Logger::debug("  " + path + ": <unknown>");
+                            LOG_DEBUG("  " + path + ": <unknown>");
                         }
                         close(fd);
                     } else {
-                        Logger::debug("  " + path + ": <cannot open>");
+                        LOG_DEBUG("  " + path + ": <cannot open>");
                     }
                 }
             }
@@ -105,7 +142,7 @@ bool DeviceManager::checkDevicePresent() const
                     deviceInfo += " - " + std::string(manufacturer ? manufacturer : "") + " " + 
                                std::string(productName ? productName : "");
                 }
-                Logger::debug(deviceInfo);
+                LOG_DEBUG(deviceInfo);
             }
             
             // Check if this is our HMI device
@@ -117,7 +154,7 @@ bool DeviceManager::checkDevicePresent() const
                     strstr(manufacturer, Config::HMI_MANUFACTURER) != NULL &&
                     strstr(productName, Config::HMI_PRODUCT_NAME) != NULL) {
                     
-                    Logger::info("Found device: " + std::string(manufacturer) + " " + 
+                    LOG_INFO("Found device: " + std::string(manufacturer) + " " + 
                               std::string(productName) + " (VID:PID " + vendor + ":" + product + ")");
                     found = true;
                 }
@@ -257,7 +294,7 @@ bool DeviceManager::monitorDeviceUntilConnected(std::atomic<bool>& runningFlag)
                             strcmp(vendor, Config::HMI_VENDOR_ID) == 0 &&
                             strcmp(product, Config::HMI_PRODUCT_ID) == 0) {
 
-                            Logger::debug("USB device connected (VID:PID " + std::string(vendor) + ":" +
+                            LOG_DEBUG("USB device connected (VID:PID " + std::string(vendor) + ":" +
                                       std::string(product) + ")");
 
                             // Give some time for all device nodes to be created
@@ -291,7 +328,7 @@ bool DeviceManager::monitorDeviceUntilConnected(std::atomic<bool>& runningFlag)
             reconnectAttempts++;
 
             // Print a progress message
-            Logger::debug("Waiting for device... Attempt " +
+            LOG_DEBUG("Waiting for device... Attempt " +
                        std::to_string(reconnectAttempts) + " of " +
                        std::to_string(maxReconnectAttempts));
 
@@ -311,7 +348,7 @@ bool DeviceManager::monitorDeviceUntilConnected(std::atomic<bool>& runningFlag)
         }
     }
 
-    Logger::warning("Gave up waiting for device after " +
+    LOG_WARNING("Gave up waiting for device after " +
                  std::to_string(maxReconnectAttempts) + " attempts");
 
     // Clean up
@@ -354,7 +391,7 @@ void DeviceManager::disconnectionMonitorThread()
     // Create udev context
     udev = udev_new();
     if (!udev) {
-        std::cerr << "Failed to create udev context in monitor thread" << std::endl;
+        Logger::error("Failed to create udev context in monitor thread");
         return;
     }
     
@@ -369,7 +406,7 @@ void DeviceManager::disconnectionMonitorThread()
     fds[0].fd = fd;
     fds[0].events = POLLIN;
     
-    std::cout << "Disconnection monitor thread started" << std::endl;
+    Logger::info("Disconnection monitor thread started");
     
     // Track time for periodic checks
     time_t lastCheckTime = time(NULL);
@@ -380,7 +417,7 @@ void DeviceManager::disconnectionMonitorThread()
         if (now - lastCheckTime >= 5) {
             // Check that the device is still present
             if (!checkDevicePresentSilent()) {
-                std::cout << "Device disconnected (periodic check)" << std::endl;
+                Logger::info("Device disconnected (periodic check)");
                 m_deviceDisconnected = true;
                 break;
             }
@@ -410,7 +447,7 @@ void DeviceManager::disconnectionMonitorThread()
                             strcmp(vendor, Config::HMI_VENDOR_ID) == 0 &&
                             strcmp(product, Config::HMI_PRODUCT_ID) == 0) {
                             
-                            std::cout << "USB device disconnected (VID:PID " << vendor << ":" << product << ")" << std::endl;
+                            LOG_INFO(std::string("USB device disconnected (VID:PID ") + vendor + ":" + product + ")");
                             m_deviceDisconnected = true;
                             udev_device_unref(dev);
                             break;
@@ -426,7 +463,7 @@ void DeviceManager::disconnectionMonitorThread()
     udev_monitor_unref(mon);
     udev_unref(udev);
     
-    std::cout << "Disconnection monitor thread exiting" << std::endl;
+    Logger::info("Disconnection monitor thread exiting");
 }
 
 std::string DeviceManager::findHmiInputDevice() const
@@ -443,7 +480,7 @@ std::string DeviceManager::findHmiInputDevice() const
         return result;
     }
     
-    Logger::debug("Searching for HMI input device (VID=" + std::string(Config::HMI_VENDOR_ID) + 
+    LOG_DEBUG("Searching for HMI input device (VID=" + std::string(Config::HMI_VENDOR_ID) + 
                 " PID=" + std::string(Config::HMI_PRODUCT_ID) + 
                 " Product=" + std::string(Config::HMI_PRODUCT_NAME) + ")");
     
@@ -469,12 +506,12 @@ std::string DeviceManager::findHmiInputDevice() const
         // Check the device name
         const char* name = udev_device_get_property_value(dev, "NAME");
         if (name) {
-            Logger::debug("Found input device: " + std::string(devnode) + " - Name: " + std::string(name));
+            LOG_DEBUG("Found input device: " + std::string(devnode) + " - Name: " + std::string(name));
             
             // Check if this device's name matches our product
             if (strstr(name, Config::HMI_PRODUCT_NAME) != NULL || 
                 strstr(name, "Pico Encoder") != NULL) {
-                Logger::debug("Found matching input device by name: " + std::string(devnode));
+                LOG_DEBUG("Found matching input device by name: " + std::string(devnode));
                 result = devnode;
                 udev_device_unref(dev);
                 break;
@@ -505,7 +542,7 @@ std::string DeviceManager::findHmiInputDevice() const
             const char* manufacturer = udev_device_get_sysattr_value(usbDev, "manufacturer");
             const char* productName = udev_device_get_sysattr_value(usbDev, "product");
             
-            Logger::debug("  USB device: " +
+            LOG_DEBUG("  USB device: " +
                        std::string(vendor ? vendor : "unknown") + ":" +
                        std::string(product ? product : "unknown") + " - " +
                        std::string(manufacturer ? manufacturer : "unknown") + " " +
@@ -516,7 +553,7 @@ std::string DeviceManager::findHmiInputDevice() const
                 strcmp(vendor, Config::HMI_VENDOR_ID) == 0 &&
                 strcmp(product, Config::HMI_PRODUCT_ID) == 0) {
                 
-                Logger::debug("Found matching input device by VID:PID: " + std::string(devnode));
+                LOG_DEBUG("Found matching input device by VID:PID: " + std::string(devnode));
                 result = devnode;
                 udev_device_unref(dev);
                 break;
@@ -529,29 +566,19 @@ std::string DeviceManager::findHmiInputDevice() const
     
     // If we didn't find a device, try the more direct approach
     if (result.empty()) {
-        Logger::debug("Trying alternative detection method...");
+        LOG_DEBUG("Trying alternative detection method...");
         
         // Look for device by dmesg pattern (recent device appears in dmesg)
-        FILE* fp = popen("dmesg | grep -A 2 \"input: DIY Projects Pico Encoder Display as\" | grep -o \"/dev/input/event[0-9]*\"", "r");
-        if (fp) {
-            char path[64];
-            if (fgets(path, sizeof(path), fp) != NULL) {
-                // Remove trailing newline
-                size_t len = strlen(path);
-                if (len > 0 && path[len-1] == '\n') {
-                    path[len-1] = '\0';
-                }
-                
-                Logger::debug("Found input device from dmesg: " + std::string(path));
-                result = path;
-            }
-            pclose(fp);
+        std::string path = findInKernelLog("input: DIY Projects Pico Encoder Display as", 2, "/dev/input/event");
+        if (!path.empty()) {
+            LOG_DEBUG("Found input device from dmesg: " + path);
+            result = path;
         }
     }
     
     // If we still didn't find a device, check all input devices for Mouse capability
     if (result.empty()) {
-        Logger::debug("Searching for any mouse-like input device...");
+        LOG_DEBUG("Searching for any mouse-like input device...");
         
         enumerate = udev_enumerate_new(udev);
         udev_enumerate_add_match_subsystem(enumerate, "input");
@@ -583,7 +610,7 @@ std::string DeviceManager::findHmiInputDevice() const
                     if ((evbit[EV_REL/8/sizeof(long)] & (1 << (EV_REL % (8 * sizeof(long))))) &&
                         (relbit[REL_X/8/sizeof(long)] & (1 << (REL_X % (8 * sizeof(long)))))) {
                         
-                        Logger::debug("Found input device with REL_X capability: " + std::string(devnode));
+                        LOG_DEBUG("Found input device with REL_X capability: " + std::string(devnode));
                         result = devnode;
                         close(fd);
                         udev_device_unref(dev);
@@ -604,7 +631,7 @@ std::string DeviceManager::findHmiInputDevice() const
     if (result.empty()) {
         Logger::error("Failed to find any suitable input device!");
     } else {
-        Logger::info("Selected input device: " + result);
+        LOG_INFO("Selected input device: " + result);
     }
     
     return result;
@@ -620,13 +647,11 @@ std::string DeviceManager::findHmiSerialDevice() const
     // Create udev context
     udev = udev_new();
     if (!udev) {
-        std::cerr << "Failed to create udev context" << std::endl;
+        Logger::error("Failed to create udev context");
         return result;
     }
     
-    std::cout << "Searching for HMI serial device (VID=" << Config::HMI_VENDOR_ID 
-              << " PID=" << Config::HMI_PRODUCT_ID 
-              << " Product=" << Config::HMI_PRODUCT_NAME << ")" << std::endl;
+    LOG_INFO(std::string("Searching for HMI serial device (VID=") + Config::HMI_VENDOR_ID + " PID=" + Config::HMI_PRODUCT_ID + " Product=" + Config::HMI_PRODUCT_NAME + ")");
     
     // First try standard approach via tty subsystem
     enumerate = udev_enumerate_new(udev);
@@ -647,7 +672,7 @@ std::string DeviceManager::findHmiSerialDevice() const
             continue;
         }
         
-        std::cout << "Found TTY device: " << devnode << std::endl;
+        LOG_INFO(std::string("Found TTY device: ") + devnode);
         
         // Walk up the device tree to check parent USB device
         struct udev_device* parent = dev;
@@ -673,18 +698,14 @@ std::string DeviceManager::findHmiSerialDevice() const
             const char* manufacturer = udev_device_get_sysattr_value(usbDev, "manufacturer");
             const char* productName = udev_device_get_sysattr_value(usbDev, "product");
             
-            std::cout << "  USB device: "
-                      << (vendor ? vendor : "unknown") << ":"
-                      << (product ? product : "unknown") << " - "
-                      << (manufacturer ? manufacturer : "unknown") << " "
-                      << (productName ? productName : "unknown") << std::endl;
+            LOG_INFO(std::string("  USB device: ") + (vendor ? vendor : "unknown") + ":" + (product ? product : "unknown") + " - " + (manufacturer ? manufacturer : "unknown") + " " + (productName ? productName : "unknown"));
             
             // Check if this matches our HMI device
             if (vendor && product &&
                 strcmp(vendor, Config::HMI_VENDOR_ID) == 0 &&
                 strcmp(product, Config::HMI_PRODUCT_ID) == 0) {
                 
-                std::cout << "Found matching serial device by VID:PID: " << devnode << std::endl;
+                LOG_INFO(std::string("Found matching serial device by VID:PID: ") + devnode);
                 result = devnode;
                 udev_device_unref(dev);
                 break;
@@ -698,29 +719,19 @@ std::string DeviceManager::findHmiSerialDevice() const
     
     // If we didn't find a device, try the more direct approach
     if (result.empty()) {
-        std::cout << "Trying alternative detection method for serial device..." << std::endl;
+        Logger::info("Trying alternative detection method for serial device...");
         
         // Look for device by dmesg pattern
-        FILE* fp = popen("dmesg | grep -A 1 \"Product: Pico Encoder Display\" | grep -o \"/dev/ttyACM[0-9]*\"", "r");
-        if (fp) {
-            char path[64];
-            if (fgets(path, sizeof(path), fp) != NULL) {
-                // Remove trailing newline
-                size_t len = strlen(path);
-                if (len > 0 && path[len-1] == '\n') {
-                    path[len-1] = '\0';
-                }
-                
-                std::cout << "Found serial device from dmesg: " << path << std::endl;
-                result = path;
-            }
-            pclose(fp);
+        std::string path = findInKernelLog("Product: Pico Encoder Display", 1, "/dev/ttyACM");
+        if (!path.empty()) {
+            LOG_INFO("Found serial device from dmesg: " + path);
+            result = path;
         }
     }
     
     // Final fallback - just look for any ttyACM device
     if (result.empty()) {
-        std::cout << "Checking for any ttyACM device..." << std::endl;
+        Logger::info("Checking for any ttyACM device...");
         
         // Try to find any ttyACM device
         DIR* dir = opendir("/dev");
@@ -730,7 +741,7 @@ std::string DeviceManager::findHmiSerialDevice() const
                 if (strncmp(entry->d_name, "ttyACM", 6) == 0) {
                     std::string path = "/dev/";
                     path += entry->d_name;
-                    std::cout << "Found ttyACM device: " << path << std::endl;
+                    LOG_INFO(std::string("Found ttyACM device: ") + path);
                     result = path;
                     break;
                 }
@@ -742,9 +753,9 @@ std::string DeviceManager::findHmiSerialDevice() const
     udev_unref(udev);
     
     if (result.empty()) {
-        std::cerr << "Failed to find any suitable serial device!" << std::endl;
+        Logger::error("Failed to find any suitable serial device!");
     } else {
-        std::cout << "Selected serial device: " << result << std::endl;
+        LOG_INFO(std::string("Selected serial device: ") + result);
     }
     
     return result;
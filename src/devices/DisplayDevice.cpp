@@ -1,4 +1,6 @@
 #include "DeviceInterfaces.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
 #include <cstring>
 #include <cerrno>
 #include <unistd.h>
@@ -31,7 +33,7 @@ bool DisplayDevice::open()
     
     m_fd = ::open(m_devicePath.c_str(), O_RDWR | O_NOCTTY);
     if (m_fd < 0) {
-        std::cerr << "Failed to open serial device: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to open serial device: ") + strerror(errno));
         return false;
     }
     
@@ -40,7 +42,7 @@ bool DisplayDevice::open()
     memset(&tty, 0, sizeof(tty));
     
     if (tcgetattr(m_fd, &tty) != 0) {
-        std::cerr << "Failed to get serial attributes: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to get serial attributes: ") + strerror(errno));
         ::close(m_fd);
         m_fd = -1;
         return false;
@@ -68,7 +70,7 @@ bool DisplayDevice::open()
     
     // Set attributes
     if (tcsetattr(m_fd, TCSANOW, &tty) != 0) {
-        std::cerr << "Failed to set serial attributes: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to set serial attributes: ") + strerror(errno));
         ::close(m_fd);
         m_fd = -1;
         return false;
@@ -139,28 +141,28 @@ void DisplayDevice::flushBuffer()
     std::lock_guard<std::mutex> lock(m_mutex);
     
     if (m_cmdBuffer.used > 0 && isOpen()) {
+        TRACE_SCOPE("display", "flushBuffer");
         ssize_t bytesWritten = write(m_fd, m_cmdBuffer.buffer, m_cmdBuffer.used);
         if (bytesWritten < 0) {
-            std::cerr << "Error writing to serial device: " << strerror(errno) << std::endl;
+            LOG_ERROR(std::string("Error writing to serial device: ") + strerror(errno));
             
             // If error indicates device disconnection, set the flag
             if (errno == EIO || errno == ENODEV || errno == ENXIO) {
-                std::cerr << "Serial buffer write error indicates device disconnection" << std::endl;
+                Logger::error("Serial buffer write error indicates device disconnection");
                 m_disconnected = true;
             }
         } else if ((size_t)bytesWritten < m_cmdBuffer.used) {
-            std::cerr << "Warning: Only wrote " << bytesWritten << " of " 
-                      << m_cmdBuffer.used << " bytes" << std::endl;
+            LOG_WARNING("Only wrote " + std::to_string(bytesWritten) + " of " + std::to_string(m_cmdBuffer.used) + " bytes");
         }
         
         // Flush the output only if device still connected
         if (!m_disconnected) {
             if (tcdrain(m_fd) < 0) {
-                std::cerr << "Error draining serial output: " << strerror(errno) << std::endl;
+                LOG_ERROR(std::string("Error draining serial output: ") + strerror(errno));
                 
                 // Check if tcdrain error indicates device disconnection
                 if (errno == EIO || errno == ENODEV || errno == ENXIO) {
-                    std::cerr << "Serial buffer drain error indicates device disconnection" << std::endl;
+                    Logger::error("Serial buffer drain error indicates device disconnection");
                     m_disconnected = true;
                 }
             }
@@ -173,33 +175,33 @@ void DisplayDevice::flushBuffer()
 // Send a command immediately to the serial device
 void DisplayDevice::sendCommand(const uint8_t* data, size_t length)
 {
+    TRACE_SCOPE("display", "sendCommand");
     std::lock_guard<std::mutex> lock(m_mutex);
     
     if (isOpen()) {
         // Write the data and check return value
         ssize_t bytesWritten = write(m_fd, data, length);
         if (bytesWritten < 0) {
-            std::cerr << "Error writing to serial device: " << strerror(errno) << std::endl;
+            LOG_ERROR(std::string("Error writing to serial device: ") + strerror(errno));
             
             // If error indicates device disconnection, set the flag
             if (errno == EIO || errno == ENODEV || errno == ENXIO) {
-                std::cerr << "Serial write error indicates device disconnection" << std::endl;
+                Logger::error("Serial write error indicates device disconnection");
                 m_disconnected = true;
             }
         } else if ((size_t)bytesWritten < length) {
-            std::cerr << "Warning: Only wrote " << bytesWritten << " of " 
-                      << length << " bytes" << std::endl;
+            LOG_WARNING("Only wrote " + std::to_string(bytesWritten) + " of " + std::to_string(length) + " bytes");
         }
         
         // Flush the output buffer to ensure command is sent immediately
         // But only if the device hasn't been disconnected
         if (!m_disconnected) {
             if (tcdrain(m_fd) < 0) {
-                std::cerr << "Error draining serial output: " << strerror(errno) << std::endl;
+                LOG_ERROR(std::string("Error draining serial output: ") + strerror(errno));
                 
                 // Check if tcdrain error indicates device disconnection
                 if (errno == EIO || errno == ENODEV || errno == ENXIO) {
-                    std::cerr << "Serial drain error indicates device disconnection" << std::endl;
+                    Logger::error("Serial drain error indicates device disconnection");
                     m_disconnected = true;
                 }
             }
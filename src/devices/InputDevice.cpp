@@ -1,5 +1,7 @@
 #include "DeviceInterfaces.h"
 #include "Config.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
 #include <cstring>
 #include <cerrno>
 #include <iostream>
@@ -26,44 +28,44 @@ bool InputDevice::open()
 {
     // Return true if already open
     if (isOpen()) {
-        std::cout << "Input device already open with fd: " << m_fd << std::endl;
+        LOG_INFO("Input device already open with fd: " + std::to_string(m_fd));
         return true;
     }
 
-    std::cout << "Opening input device: " << m_devicePath << std::endl;
+    LOG_INFO("Opening input device: " + m_devicePath);
 
     // Open the input device in read-only mode
     m_fd = ::open(m_devicePath.c_str(), O_RDONLY);
     if (m_fd < 0) {
-        std::cerr << "Failed to open input device: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to open input device: ") + strerror(errno));
         return false;
     }
 
-    std::cout << "Input device opened successfully with fd: " << m_fd << std::endl;
+    LOG_INFO("Input device opened successfully with fd: " + std::to_string(m_fd));
 
     // Set non-blocking mode
     setNonBlocking();
     // NEW: Grab exclusive access to the device
     if (ioctl(m_fd, EVIOCGRAB, 1) < 0) {
-        std::cerr << "Failed to get exclusive access to input device: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to get exclusive access to input device: ") + strerror(errno));
         // You can decide whether to continue or fail here
         // If this is critical, you might want to return false
         // For now, we'll just log the error and continue
     } else {
-        std::cout << "Successfully grabbed exclusive access to input device" << std::endl;
+        Logger::info("Successfully grabbed exclusive access to input device");
     }
 
     // Test reading device capabilities
     unsigned long evbit[EV_MAX/8/sizeof(long) + 1];
     if (ioctl(m_fd, EVIOCGBIT(0, sizeof(evbit)), evbit) < 0) {
-        std::cerr << "Failed to get device capabilities: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Failed to get device capabilities: ") + strerror(errno));
     } else {
-        std::cout << "Device supports:" << std::endl;
+        Logger::info("Device supports:");
         if (evbit[EV_REL/8/sizeof(long)] & (1 << (EV_REL % (8 * sizeof(long))))) {
-            std::cout << "  - EV_REL (Relative axes)" << std::endl;
+            Logger::info("  - EV_REL (Relative axes)");
         }
         if (evbit[EV_KEY/8/sizeof(long)] & (1 << (EV_KEY % (8 * sizeof(long))))) {
-            std::cout << "  - EV_KEY (Keys/Buttons)" << std::endl;
+            Logger::info("  - EV_KEY (Keys/Buttons)");
         }
     }
 
@@ -108,25 +110,25 @@ void InputDevice::setNonBlocking()
 int InputDevice::waitForEvents(int timeoutMs)
 {
     if (!isOpen()) {
-        std::cerr << "Input device not open in waitForEvents" << std::endl;
+        Logger::error("Input device not open in waitForEvents");
         return -1;
     }
 
     // Double-check that the file descriptor is still valid
     if (fcntl(m_fd, F_GETFD) < 0) {
-        std::cerr << "Input device file descriptor is invalid: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Input device file descriptor is invalid: ") + strerror(errno));
         // Try to reopen the device
         close();
         if (!open()) {
-            std::cerr << "Failed to reopen input device" << std::endl;
+            Logger::error("Failed to reopen input device");
             return -1;
         }
-        std::cout << "Successfully reopened input device" << std::endl;
+        Logger::info("Successfully reopened input device");
         // NEW: Re-establish exclusive grab after reopening
         if (ioctl(m_fd, EVIOCGRAB, 1) < 0) {
-            std::cerr << "Failed to re-grab exclusive access to input device: " << strerror(errno) << std::endl;
+            LOG_ERROR(std::string("Failed to re-grab exclusive access to input device: ") + strerror(errno));
         } else {
-            std::cout << "Successfully re-grabbed exclusive access to input device" << std::endl;
+            Logger::info("Successfully re-grabbed exclusive access to input device");
         }
     }
 
@@ -147,7 +149,7 @@ int InputDevice::waitForEvents(int timeoutMs)
     } else if (ret == 0) {
         // Timeout - normal, don't log to avoid spam
     } else if (errno != EINTR) {
-        std::cerr << "Select error: " << strerror(errno) << std::endl;
+        LOG_ERROR(std::string("Select error: ") + strerror(errno));
     }
 
     return ret;
@@ -156,8 +158,9 @@ int InputDevice::waitForEvents(int timeoutMs)
 
 bool InputDevice::processEvents(std::function<void(int)> onRotation, std::function<void()> onButtonPress)
 {
+    TRACE_SCOPE("input", "processEvents");
     if (!isOpen()) {
-        std::cerr << "Input device not open in processEvents" << std::endl;
+        Logger::error("Input device not open in processEvents");
         return false;
     }
 
@@ -1,6 +1,7 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
 #include "Config.h"
+#include "Logger.h"
 #include <unistd.h>
 #include <iostream>
 
@@ -71,12 +72,12 @@ void Display::setPower(bool on)
     // Signal power save activation when turning off
     if (!on) {
         m_powerSaveActivated = true;
-        std::cout << "Power save activated - signaling all menus to exit" << std::endl;
+        Logger::info("Power save activated - signaling all menus to exit");
     } else {
         m_powerSaveActivated = false;
     }
 
-    std::cout << "Display power set to: " << (on ? "ON" : "OFF") << std::endl;
+    LOG_INFO(std::string("Display power set to: ") + (on ? "ON" : "OFF"));
 }
 
 void Display::enablePowerSave(bool enable)
@@ -118,8 +119,7 @@ void Display::checkPowerSaveTimeout()
     long timeDiffSec = (now.tv_sec - m_lastActivityTime.tv_sec);
 
     if (timeDiffSec >= Config::POWER_SAVE_TIMEOUT_SEC) {
-        std::cout << "Power save timeout reached (" << timeDiffSec 
-                  << " seconds of inactivity)" << std::endl;
+        LOG_INFO("Power save timeout reached (" + std::to_string(timeDiffSec) + " seconds of inactivity)");
 
         // Turn off the display
         setPower(false);
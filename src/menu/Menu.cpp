@@ -1,5 +1,6 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
+#include "TraceRecorder.h"
 #include <iostream>
 #include <unistd.h>
 #include <algorithm>
@@ -7,7 +8,7 @@
 Menu::Menu(std::shared_ptr<Display> display, const std::string& title)
     : m_title(title), m_display(display)
 {
-    gettimeofday(&m_lastUpdateTime, nullptr);
+    // Leave m_lastUpdateTime zeroed so the first render is never debounced
 }
 
 void Menu::addItem(std::shared_ptr<MenuItem> item)
@@ -54,6 +55,23 @@ void Menu::setCurrentSelection(int selection)
     }
 }
 
+void Menu::selectWithoutRedraw(int selection)
+{
+    if (selection >= 0 && static_cast<size_t>(selection) < m_items.size()) {
+        m_currentItem = selection;
+    }
+}
+
+std::string Menu::formatItem(int index, bool selected) const
+{
+    const auto& item = m_items[index];
+    std::string prefix = selected ? "> " : "  ";
+    if (!item->isEnabled()) {
+        return prefix + "(" + item->getLabel() + ")";
+    }
+    return prefix + item->getLabel();
+}
+
 void Menu::updateSelection(int oldSelection, int newSelection)
 {
     // Check if either the old or new selection is currently visible
@@ -73,7 +91,7 @@ void Menu::updateSelection(int oldSelection, int newSelection)
     if (!oldVisible) {
         int menuPos = newSelection - m_scrollOffset;
         // Format with the arrow indicator
-        std::string buffer = "> " + m_items[newSelection]->getLabel();
+        std::string buffer = formatItem(newSelection, true);
         
         // Calculate position and draw
         int yPos = Config::MENU_START_Y + (menuPos * Config::MENU_ITEM_SPACING);
@@ -86,7 +104,7 @@ void Menu::updateSelection(int oldSelection, int newSelection)
     if (oldSelection >= 0 && static_cast<size_t>(oldSelection) < m_items.size()) {
         int menuPos = oldSelection - m_scrollOffset;
         // Format without the arrow indicator
-        std::string buffer = "  " + m_items[oldSelection]->getLabel();
+        std::string buffer = formatItem(oldSelection, false);
         
         // Calculate y position and draw
         int yPos = Config::MENU_START_Y + (menuPos * Config::MENU_ITEM_SPACING);
@@ -98,7 +116,7 @@ void Menu::updateSelection(int oldSelection, int newSelection)
     if (newSelection >= 0 && static_cast<size_t>(newSelection) < m_items.size()) {
         int menuPos = newSelection - m_scrollOffset;
         // Format with the arrow indicator
-        std::string buffer = "> " + m_items[newSelection]->getLabel();
+        std::string buffer = formatItem(newSelection, true);
         
         // Calculate y position and draw
         int yPos = Config::MENU_START_Y + (menuPos * Config::MENU_ITEM_SPACING);
@@ -109,6 +127,8 @@ void Menu::updateSelection(int oldSelection, int newSelection)
 
 void Menu::render()
 {
+    TRACE_SCOPE("menu", "render", m_title);
+
     struct timeval now;
     gettimeofday(&now, nullptr);
 
@@ -169,13 +189,8 @@ void Menu::render()
             break;
         }
 
-        std::string buffer;
         // Format menu item text with selection indicator
-        if (menuIndex == m_currentItem) {
-            buffer = "> " + m_items[menuIndex]->getLabel();
-        } else {
-            buffer = "  " + m_items[menuIndex]->getLabel();
-        }
+        std::string buffer = formatItem(menuIndex, menuIndex == m_currentItem);
 
         // Calculate y position based on menu start position and spacing
         int yPos = Config::MENU_START_Y + (i * Config::MENU_ITEM_SPACING);
@@ -8,15 +8,15 @@
 #include <unistd.h>
 
 BrightnessScreen::BrightnessScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
-    : ScreenModule(display, input)
+    : ScreenModule(display, input),
+      m_savedLevel(PersistentStorage::getInstance().resolveKey<int>("brightness", "level", -1))
 {
 }
 
 void BrightnessScreen::enter()
 {
     // Try to load the saved brightness from persistent storage
-    auto& storage = PersistentStorage::getInstance();
-    int savedBrightness = storage.getValue("brightness", "level", -1);
+    int savedBrightness = m_savedLevel.get();
     
     // If we have a saved value, use it
     if (savedBrightness >= 0 && savedBrightness <= 255) {
@@ -42,12 +42,11 @@ void BrightnessScreen::exit()
 {
     // Save the changed Brightness value
     int currentBrightness = m_display->getBrightness();
-    auto& storage = PersistentStorage::getInstance();
     
     // Only save if it's changed
     if (currentBrightness != m_previousBrightness) {
-        Logger::debug("Saving brightness value to persistent storage: " + std::to_string(currentBrightness));
-        storage.setValue("brightness", "level", currentBrightness);
+        LOG_DEBUG("Saving brightness value to persistent storage: " + std::to_string(currentBrightness));
+        m_savedLevel.set(currentBrightness);
     }
 }
 
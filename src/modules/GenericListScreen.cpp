@@ -3,6 +3,7 @@
 #include "DeviceInterfaces.h"
 #include "MenuSystem.h"
 #include "Logger.h"
+#include "ScriptHelper.h"
 #include <iostream>
 #include <unistd.h>
 #include <memory>
@@ -73,6 +74,11 @@ void GenericListScreen::setConfig(const nlohmann::json& config)
         m_itemsAction = config["items_action"].get<std::string>();
     }
 
+    // Commands may go through the long-lived helper shell instead of a new one each
+    if (config.contains("use_helper") && config["use_helper"].is_boolean()) {
+        m_useHelper = config["use_helper"].get<bool>();
+    }
+
     // Load dynamic items if source is specified
     if (!m_itemsSource.empty()) {
         loadDynamicItems();
@@ -85,12 +91,12 @@ void GenericListScreen::setConfig(const nlohmann::json& config)
     if (config.contains("callback_action") && config["callback_action"].is_string()) {
         m_callbackAction = config["callback_action"].get<std::string>();
     }
-    Logger::debug("GenericListScreen configured: " + m_id);
+    LOG_DEBUG("GenericListScreen configured: " + m_id);
 }
 
 void GenericListScreen::enter()
 {
-    Logger::debug("Entering GenericListScreen: " + m_id);
+    LOG_DEBUG("Entering GenericListScreen: " + m_id);
     // Reload dynamic items if needed
     if (!m_itemsSource.empty()) {
         loadDynamicItems();
@@ -124,7 +130,7 @@ void GenericListScreen::update()
 
 void GenericListScreen::exit()
 {
-    Logger::debug("Exiting GenericListScreen: " + m_id);
+    LOG_DEBUG("Exiting GenericListScreen: " + m_id);
 
     // Clear the display
     m_display->clear();
@@ -288,8 +294,8 @@ void GenericListScreen::executeAction(const std::string& actionTemplate)
 
     // Execute the command
     std::string result = executeCommand(action);
-    Logger::debug("GenericListScreen '" + m_id + "' executed action: " + action);
-    Logger::debug("Executed action: " + action);
+    LOG_DEBUG("GenericListScreen '" + m_id + "' executed action: " + action);
+    LOG_DEBUG("Executed action: " + action);
     // If in state mode, redraw the screen to show updated state
     if (m_stateMode) {
         renderList();
@@ -298,20 +304,20 @@ void GenericListScreen::executeAction(const std::string& actionTemplate)
 
 std::string GenericListScreen::executeCommand(const std::string& command) const
 {
-    std::array<char, 128> buffer;
-    std::string result;
-
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return "ERROR";
+    // Configured commands are command lines, so these go through the shell
+    Subprocess::Options options;
+    options.traceName = "list-command";
+    if (m_useHelper) {
+        return ScriptHelper::getInstance().runShell(command, options).output;
     }
 
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
+    Subprocess process;
+    if (!process.startShell(command, options)) {
+        return "ERROR";
     }
 
-    pclose(pipe);
-    return result;
+    process.wait();
+    return process.getOutput();
 }
 
 void GenericListScreen::loadDynamicItems()
@@ -320,7 +326,7 @@ void GenericListScreen::loadDynamicItems()
         return;  // No dynamic source defined
     }
 
-    Logger::debug("Loading dynamic items from: " + m_itemsSource);
+    LOG_DEBUG("Loading dynamic items from: " + m_itemsSource);
 
     // Build the command - include path if specified
     std::string command = m_itemsSource;
@@ -374,5 +380,5 @@ void GenericListScreen::loadDynamicItems()
         m_items.push_back(item);
     }
 
-    Logger::debug("Loaded " + std::to_string(m_items.size()) + " items (including static items)");
+    LOG_DEBUG("Loaded " + std::to_string(m_items.size()) + " items (including static items)");
 }
@@ -2,6 +2,7 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
 #include "Config.h"
+#include "Logger.h"
 #include <iostream>
 #include <unistd.h>
 #include <string>
@@ -53,12 +54,12 @@ bool HelloWorldScreen::handleInput()
             [](int) {
                 // Just consume rotation events without doing anything
                 // This prevents rotation events from "leaking" back to the main menu
-                std::cout << "HelloWorld: Ignoring rotation event" << std::endl;
+                Logger::info("HelloWorld: Ignoring rotation event");
             },
             [&]() {
                 // Button press exits
                 buttonPressed = true;
-                std::cout << "HelloWorld: Button pressed, exiting" << std::endl;
+                Logger::info("HelloWorld: Button pressed, exiting");
             }
         );
         
@@ -120,12 +121,12 @@ bool CounterScreen::handleInput()
             [](int) {
                 // Just consume rotation events without doing anything
                 // This prevents rotation events from "leaking" back to the main menu
-                std::cout << "Counter: Ignoring rotation event" << std::endl;
+                Logger::info("Counter: Ignoring rotation event");
             },
             [&]() {
                 // Button press exits
                 buttonPressed = true;
-                std::cout << "Counter: Button pressed, exiting" << std::endl;
+                Logger::info("Counter: Button pressed, exiting");
             }
         );
         
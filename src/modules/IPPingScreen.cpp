@@ -2,8 +2,11 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
 #include "IPSelector.h"
+#include "ModuleDependency.h"
 #include "Logger.h"
 #include "Config.h"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <unistd.h>
 #include <string>
@@ -12,10 +15,34 @@
 #include <thread>
 #include <atomic>
 #include <csignal>
-#include <sys/wait.h>
 #include <fstream>
 #include <sstream>
 
+namespace {
+
+// Histogram rows below the separator, label on the left and bar after it
+const int s_histogramRows = 6;
+const int s_barX = 40;
+const int s_barWidth = 88;
+
+// Milliseconds in at most four characters: "0.35", "12.3", "250"
+std::string formatMs(long us) {
+    char text[16];
+    double ms = us / 1000.0;
+    if (us < 0) {
+        snprintf(text, sizeof(text), "-");
+    } else if (ms < 10.0) {
+        snprintf(text, sizeof(text), "%.2f", ms);
+    } else if (ms < 100.0) {
+        snprintf(text, sizeof(text), "%.1f", ms);
+    } else {
+        snprintf(text, sizeof(text), "%.0f", ms);
+    }
+    return text;
+}
+
+} // namespace
+
 IPPingScreen::IPPingScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
     : ScreenModule(display, input)
 {
@@ -25,7 +52,7 @@ IPPingScreen::IPPingScreen(std::shared_ptr<Display> display, std::shared_ptr<Inp
     // Create IP Selector with callback
     auto callback = [this](const std::string& ip) {
         m_targetIp = ip;
-        Logger::debug("IP address changed to: " + ip);
+        LOG_DEBUG("IP address changed to: " + ip);
     };
 
     // Create redraw callback to update menu
@@ -37,18 +64,24 @@ IPPingScreen::IPPingScreen(std::shared_ptr<Display> display, std::shared_ptr<Inp
 }
 
 void IPPingScreen::enter() {
-    Logger::debug("IPPingScreen: Entered");
+    LOG_DEBUG("IPPingScreen: Entered");
 
     // Reset state
     m_state = IPPingMenuState::MENU_STATE_IP;
     m_pingInProgress = false;
-    m_pingPid = -1;
     m_pingResult = -1;
     m_statusMessage.clear();
     m_shouldExit = false;
     m_lastStatusText = "";   // Reset last status
     m_statusChanged = true;  // Force initial status update
     m_pingTimeMs = 0.0;      // Reset ping time
+    m_looping = false;
+    m_showHistogram = false;
+
+    // Probe interval of the continuous ping
+    std::string interval = ModuleDependency::getInstance().getDependencyPath("ping", "interval_ms");
+    m_loopIntervalMs = interval.empty() ? Config::PING_INTERVAL_MS : atoi(interval.c_str());
+    m_loopIntervalMs = std::max(m_loopIntervalMs, Config::PING_MIN_INTERVAL_MS);
 
     // Reset IP selector
     m_ipSelector->reset();
@@ -58,6 +91,18 @@ void IPPingScreen::enter() {
 }
 
 void IPPingScreen::update() {
+    if (m_looping) {
+        // Replies land in m_stats through the handler; the display follows a few times a second
+        m_ping.poll(Config::PING_LOOP_SLICE_MS);
+        auto now = std::chrono::steady_clock::now();
+        if (m_statsChanged && now - m_loopDrawnAt >= std::chrono::milliseconds(Config::PING_LOOP_REDRAW_MS)) {
+            renderLoop(false);
+            m_statsChanged = false;
+            m_loopDrawnAt = now;
+        }
+        return;
+    }
+
     // Check ping status periodically if ping is in progress
     if (m_pingInProgress) {
         bool wasInProgress = m_pingInProgress;
@@ -76,19 +121,14 @@ void IPPingScreen::update() {
     }
 }
 void IPPingScreen::exit() {
-    Logger::debug("IPPingScreen: Exiting");
+    LOG_DEBUG("IPPingScreen: Exiting");
 
     // Terminate any ongoing ping process
-    if (m_pingInProgress && m_pingPid > 0) {
-        kill(m_pingPid, SIGTERM);
-        waitpid(m_pingPid, nullptr, 0);
+    if (m_pingInProgress) {
+        m_ping.stop();
         m_pingInProgress = false;
-        m_pingPid = -1;
     }
-
-    // Clean up temporary file if it exists
-    std::string tempFile = "/tmp/micropanel_ping_result.txt";
-    unlink(tempFile.c_str());
+    stopLoop();
 
     // Clear display
     m_display->clear();
@@ -96,7 +136,8 @@ void IPPingScreen::exit() {
 }
 
 bool IPPingScreen::handleInput() {
-    if (m_input->waitForEvents(100) > 0) {
+    // A continuous ping gets most of the loop, input is checked in between
+    if (m_input->waitForEvents(m_looping ? Config::PING_LOOP_INPUT_WAIT_MS : 100) > 0) {
         bool buttonPressed = false;
         int rotationDirection = 0;
 
@@ -112,6 +153,19 @@ bool IPPingScreen::handleInput() {
             }
         );
 
+        if (m_looping) {
+            if (buttonPressed) {
+                // Back to the menu
+                stopLoop();
+                renderMenu(true);
+            } else if (rotationDirection != 0) {
+                // Switch between the numbers and the histogram
+                m_showHistogram = !m_showHistogram;
+                renderLoop(true);
+            }
+            return true;
+        }
+
         // Process button and rotation
         bool redrawNeeded = false;
         IPPingMenuState previousState = m_state;
@@ -133,6 +187,10 @@ bool IPPingScreen::handleInput() {
                     redrawNeeded = true;
                     break;
 
+                case IPPingMenuState::MENU_STATE_LOOP:
+                    startLoop();
+                    return true;
+
                 case IPPingMenuState::MENU_STATE_EXIT:
                     // Exit screen
                     m_shouldExit = true;
@@ -160,9 +218,12 @@ bool IPPingScreen::handleInput() {
                         case IPPingMenuState::MENU_STATE_PING:
                             m_state = IPPingMenuState::MENU_STATE_IP;
                             break;
-                        case IPPingMenuState::MENU_STATE_EXIT:
+                        case IPPingMenuState::MENU_STATE_LOOP:
                             m_state = IPPingMenuState::MENU_STATE_PING;
                             break;
+                        case IPPingMenuState::MENU_STATE_EXIT:
+                            m_state = IPPingMenuState::MENU_STATE_LOOP;
+                            break;
                     }
                 } else {
                     // Rotate right - next menu item
@@ -171,6 +232,9 @@ bool IPPingScreen::handleInput() {
                             m_state = IPPingMenuState::MENU_STATE_PING;
                             break;
                         case IPPingMenuState::MENU_STATE_PING:
+                            m_state = IPPingMenuState::MENU_STATE_LOOP;
+                            break;
+                        case IPPingMenuState::MENU_STATE_LOOP:
                             m_state = IPPingMenuState::MENU_STATE_EXIT;
                             break;
                         case IPPingMenuState::MENU_STATE_EXIT:
@@ -223,9 +287,14 @@ void IPPingScreen::renderMenu(bool fullRedraw) {
     m_display->drawText(0, 32, pingLine);
     usleep(Config::DISPLAY_CMD_DELAY);
 
+    // Draw Loop line with selection marker
+    std::string loopLine = (m_state == IPPingMenuState::MENU_STATE_LOOP ? ">Ping Continuous" : " Ping Continuous");
+    m_display->drawText(0, 40, loopLine);
+    usleep(Config::DISPLAY_CMD_DELAY);
+
     // Draw Exit line with selection marker
     std::string exitLine = (m_state == IPPingMenuState::MENU_STATE_EXIT ? ">Exit" : " Exit");
-    m_display->drawText(0, 40, exitLine);
+    m_display->drawText(0, 48, exitLine);
     usleep(Config::DISPLAY_CMD_DELAY);
 
     // Update status line
@@ -246,7 +315,8 @@ void IPPingScreen::updateStatusLine() {
         if (m_pingResult == 0) {
             // Format with ping time if available
             char buffer[32];
-            snprintf(buffer, sizeof(buffer), "Success!(%.1fms)", m_pingTimeMs);
+            snprintf(buffer, sizeof(buffer), m_pingTimeMs < 10.0 ? "Success!(%.2fms)" : "Success!(%.1fms)",
+                     m_pingTimeMs);
             statusText = buffer;
         } else {
             statusText = "No Response";
@@ -255,9 +325,9 @@ void IPPingScreen::updateStatusLine() {
 
     // Only update display if status text has changed
     if (statusText != m_lastStatusText) {
-        m_display->drawText(0, 48, "                ");
+        m_display->drawText(0, 56, "                ");
         if (!statusText.empty()) {
-            m_display->drawText(0, 48, statusText);
+            m_display->drawText(0, 56, statusText);
         }
         usleep(Config::DISPLAY_CMD_DELAY);
 
@@ -270,42 +340,18 @@ void IPPingScreen::checkPingStatus() {
     if (!m_pingInProgress) return;
 
     // Check if the ping process has completed
-    int status;
-    pid_t result = waitpid(m_pingPid, &status, WNOHANG);
-
-    if (result == m_pingPid) {
-        // Ping process has completed
+    if (!m_ping.poll()) {
         m_pingInProgress = false;
-        m_pingPid = -1;
 
         // Determine ping result
-        if (WIFEXITED(status)) {
-            m_pingResult = WEXITSTATUS(status);
-
-            // If ping succeeded, try to read the ping time from temp file
-            if (m_pingResult == 0) {
-                std::ifstream pingFile("/tmp/micropanel_ping_result.txt");
-                if (pingFile.is_open()) {
-                    std::string line;
-                    if (std::getline(pingFile, line)) {
-                        try {
-                            m_pingTimeMs = std::stod(line);
-                        } catch (...) {
-                            Logger::error("Failed to parse ping time");
-                            m_pingTimeMs = 0.0;
-                        }
-                    }
-                    pingFile.close();
-                }
-
-                // Clean up temporary file
-                unlink("/tmp/micropanel_ping_result.txt");
-            }
+        if (m_ping.getReceived() > 0) {
+            m_pingResult = 0;
+            m_pingTimeMs = m_ping.getLastRttUs() / 1000.0;
         } else {
-            m_pingResult = 1; // Error
+            m_pingResult = 1; // No reply within the timeout
         }
 
-        Logger::debug("Ping completed with result: " + std::to_string(m_pingResult) +
+        LOG_DEBUG("Ping completed with result: " + std::to_string(m_pingResult) +
                      (m_pingResult == 0 ? " time: " + std::to_string(m_pingTimeMs) + "ms" : ""));
 
         // Mark status as changed so it will update once
@@ -319,7 +365,7 @@ void IPPingScreen::startPing() {
 
     // Get current IP for ping
     std::string ipAddress = m_ipSelector->getIp();
-    Logger::debug("Starting ping to " + ipAddress);
+    LOG_DEBUG("Starting ping to " + ipAddress);
 
     // Reset ping state
     m_pingResult = -1;
@@ -328,30 +374,172 @@ void IPPingScreen::startPing() {
     m_statusChanged = true;  // Force status update
     m_lastStatusText = "";   // Reset last status
 
-    // Fork to run ping
-    pid_t child_pid = fork();
-
-    if (child_pid == 0) {
-        // Child process - run ping
-        char command[256];
-        // Use ping with time output and grep to extract time value, save to temp file
-        snprintf(command, sizeof(command),
-                "ping -c 1 -W 2 %s | grep -oP 'time=\\K[0-9.]+' > /tmp/micropanel_ping_result.txt",
-                ipAddress.c_str());
-        int result = system(command);
-        std::quick_exit(result == 0 ? 0 : 1);
-    } else if (child_pid < 0) {
-        // Fork failed
-        Logger::error("Failed to fork ping process");
+    // One echo request, update() collects the reply
+    IcmpPinger::Options options;
+    options.count = 1;
+    options.timeoutMs = 2000;
+    if (!m_ping.start(ipAddress, options)) {
         m_pingInProgress = false;
         m_pingResult = 1;
         m_statusChanged = true;  // Force status update
+    }
+}
+
+void IPPingScreen::startLoop() {
+    if (m_pingInProgress) {
+        m_ping.stop();
+        m_pingInProgress = false;
+    }
+
+    std::string ipAddress = m_ipSelector->getIp();
+    LOG_DEBUG("Starting continuous ping to " + ipAddress + " every " + std::to_string(m_loopIntervalMs) + "ms");
+
+    m_stats.reset();
+    m_statsChanged = false;
+
+    // Probes until stop(), every one of them ends up in the statistics
+    IcmpPinger::Options options;
+    options.count = 0;
+    options.intervalMs = m_loopIntervalMs;
+    options.traceName = "ping-loop";
+    options.replyHandler = [this](const IcmpPinger::Reply& reply) {
+        if (reply.received) {
+            m_stats.addReply(reply.rttUs);
+        } else {
+            m_stats.addLoss();
+        }
+        m_statsChanged = true;
+    };
+    if (!m_ping.start(ipAddress, options)) {
+        m_pingResult = 1;
+        m_statusChanged = true;
+        return;
+    }
+
+    m_looping = true;
+    renderLoop(true);
+}
+
+void IPPingScreen::stopLoop() {
+    if (!m_looping) {
+        return;
+    }
+    m_ping.stop();
+    m_looping = false;
+    m_lastStatusText.clear();
+
+    LOG_DEBUG("Continuous ping stopped after " + std::to_string(m_stats.getProbes()) + " probes, " +
+              std::to_string(m_stats.getLossPercent()) + "% loss");
+}
+
+void IPPingScreen::renderLoop(bool fullRedraw) {
+    if (fullRedraw) {
+        m_display->clear();
+        usleep(Config::DISPLAY_CMD_DELAY * 3);
+
+        for (auto& row : m_loopRows) {
+            row.clear();
+        }
+        std::fill(std::begin(m_loopBars), std::end(m_loopBars), -1);
+
+        m_display->drawText(0, 8, Config::MENU_SEPARATOR);
+        usleep(Config::DISPLAY_CMD_DELAY);
+    }
+
+    if (m_showHistogram) {
+        renderLoopHistogram();
     } else {
-        // Parent process
-        m_pingPid = child_pid;
+        renderLoopStats();
     }
 }
 
+void IPPingScreen::renderLoopStats() {
+    char line[32];
+
+    drawLoopRow(0, m_ipSelector->getIp());
+
+    double loss = m_stats.getLossPercent();
+    snprintf(line, sizeof(line), loss < 10.0 ? "n%-7llu loss%.1f%%" : "n%-7llu loss%.0f%%",
+             static_cast<unsigned long long>(m_stats.getProbes()), loss);
+    drawLoopRow(2, line);
+
+    snprintf(line, sizeof(line), "last  %sms", formatMs(m_stats.getLastUs()).c_str());
+    drawLoopRow(3, line);
+
+    snprintf(line, sizeof(line), "lo/hi %s/%s", formatMs(m_stats.getMinUs()).c_str(),
+             formatMs(m_stats.getMaxUs()).c_str());
+    drawLoopRow(4, line);
+
+    snprintf(line, sizeof(line), "avg/j %s/%s", formatMs(static_cast<long>(m_stats.getAverageUs())).c_str(),
+             formatMs(m_stats.getReceived() ? static_cast<long>(m_stats.getJitterUs()) : -1).c_str());
+    drawLoopRow(5, line);
+
+    snprintf(line, sizeof(line), "p50/95 %s/%s", formatMs(m_stats.getPercentileUs(50)).c_str(),
+             formatMs(m_stats.getPercentileUs(95)).c_str());
+    drawLoopRow(6, line);
+
+    snprintf(line, sizeof(line), "p99 %-6s %4.1fs", formatMs(m_stats.getPercentileUs(99)).c_str(),
+             m_loopIntervalMs / 1000.0);
+    drawLoopRow(7, line);
+}
+
+void IPPingScreen::renderLoopHistogram() {
+    char line[32];
+    snprintf(line, sizeof(line), "RTT ms  n%llu", static_cast<unsigned long long>(m_stats.getReceived()));
+    drawLoopRow(0, line);
+
+    // The occupied part of the histogram, folded into the rows available
+    int first = PingStats::BUCKET_COUNT;
+    int last = -1;
+    for (int i = 0; i < PingStats::BUCKET_COUNT; i++) {
+        if (m_stats.getBucket(i) > 0) {
+            first = std::min(first, i);
+            last = i;
+        }
+    }
+    int span = last < 0 ? 1 : (last - first + s_histogramRows) / s_histogramRows;
+
+    uint32_t counts[s_histogramRows] = {};
+    uint32_t largest = 0;
+    for (int row = 0; row < s_histogramRows && last >= 0; row++) {
+        for (int i = first + row * span; i < first + (row + 1) * span && i <= last; i++) {
+            counts[row] += m_stats.getBucket(i);
+        }
+        largest = std::max(largest, counts[row]);
+    }
+
+    for (int row = 0; row < s_histogramRows; row++) {
+        int upper = first + (row + 1) * span - 1;
+        std::string label;
+        if (last >= 0 && first + row * span <= last) {
+            label = upper >= PingStats::BUCKET_COUNT - 1 ? "<inf" : "<" + formatMs(PingStats::bucketUpperUs(upper));
+        }
+        drawLoopRow(2 + row, label);
+
+        // Bars only change length now and then, most refreshes send nothing here
+        int percent = largest ? static_cast<int>(100ULL * counts[row] / largest) : 0;
+        if (label.empty()) {
+            percent = 0;
+        }
+        if (percent != m_loopBars[row]) {
+            m_display->drawProgressBar(s_barX, 16 + row * 8, s_barWidth, 6, percent);
+            usleep(Config::DISPLAY_CMD_DELAY);
+            m_loopBars[row] = percent;
+        }
+    }
+}
+
+void IPPingScreen::drawLoopRow(int row, const std::string& text) {
+    // Histogram rows leave the right part of the line to the bar
+    std::string fitted = text.substr(0, m_showHistogram && row >= 2 ? s_barX / 8 : 16);
+    if (fitted == m_loopRows[row]) {
+        return;
+    }
+    m_display->drawText(0, row * 8, std::string(m_loopRows[row].size(), ' '));
+    m_display->drawText(0, row * 8, fitted);
+    usleep(Config::DISPLAY_CMD_DELAY);
+    m_loopRows[row] = fitted;
+}
 
 const std::string& IPPingScreen::getSelectedIp() const {
     return m_ipSelector->getIp();
@@ -101,7 +101,7 @@ void IPSelector::moveCursorLeft()
     if (m_cursorPosition < 0) {
         m_cursorMode = false;
         m_digitEditMode = false;
-        Logger::debug("Exiting cursor mode (moved left from first position)");
+        LOG_DEBUG("Exiting cursor mode (moved left from first position)");
     }
 }
 
@@ -121,14 +121,14 @@ void IPSelector::moveCursorRight()
     if (m_cursorPosition > 14) {
         m_cursorMode = false;
         m_digitEditMode = false;
-        Logger::debug("Exiting cursor mode (moved right past last position)");
+        LOG_DEBUG("Exiting cursor mode (moved right past last position)");
     }
 }
 
 // Handle button press
 bool IPSelector::handleButton()
 {
-    Logger::debug("IPSelector: handleButton - Current state: cursorMode=" + 
+    LOG_DEBUG("IPSelector: handleButton - Current state: cursorMode=" + 
                   std::to_string(m_cursorMode) + ", digitEditMode=" + 
                   std::to_string(m_digitEditMode));
 
@@ -142,7 +142,7 @@ bool IPSelector::handleButton()
             m_onRedraw();
         }
         
-        Logger::debug("Entered cursor mode");
+        LOG_DEBUG("Entered cursor mode");
         return true;
     }
 
@@ -155,7 +155,7 @@ bool IPSelector::handleButton()
             m_onRedraw();
         }
         
-        Logger::debug("Entered digit edit mode");
+        LOG_DEBUG("Entered digit edit mode");
         return true;
     }
 
@@ -168,7 +168,7 @@ bool IPSelector::handleButton()
             m_onRedraw();
         }
         
-        Logger::debug("Exited digit edit mode");
+        LOG_DEBUG("Exited digit edit mode");
         return true;
     }
 
@@ -179,7 +179,7 @@ bool IPSelector::handleButton()
 // Handle rotation
 bool IPSelector::handleRotation(int direction)
 {
-    Logger::debug("IPSelector: handleRotation - Current state: cursorMode=" +
+    LOG_DEBUG("IPSelector: handleRotation - Current state: cursorMode=" +
                   std::to_string(m_cursorMode) + ", digitEditMode=" +
                   std::to_string(m_digitEditMode) +
                   ", direction=" + std::to_string(direction) +
@@ -187,7 +187,7 @@ bool IPSelector::handleRotation(int direction)
 
     // Skip rotation if not in edit modes
     if (!m_cursorMode) {
-        Logger::debug("Rotation ignored: not in cursor mode");
+        LOG_DEBUG("Rotation ignored: not in cursor mode");
         return false;
     }
 
@@ -195,20 +195,20 @@ bool IPSelector::handleRotation(int direction)
     if (m_digitEditMode) {
         if (direction < 0) {
             decrementDigit();
-            Logger::debug("Decremented digit at position " + std::to_string(m_cursorPosition));
+            LOG_DEBUG("Decremented digit at position " + std::to_string(m_cursorPosition));
         } else if (direction > 0) {
             incrementDigit();
-            Logger::debug("Incremented digit at position " + std::to_string(m_cursorPosition));
+            LOG_DEBUG("Incremented digit at position " + std::to_string(m_cursorPosition));
         }
     }
     // In cursor mode (not digit edit), move the cursor
     else {
         if (direction < 0) {
             moveCursorLeft();
-            Logger::debug("Moved cursor left to position " + std::to_string(m_cursorPosition));
+            LOG_DEBUG("Moved cursor left to position " + std::to_string(m_cursorPosition));
         } else if (direction > 0) {
             moveCursorRight();
-            Logger::debug("Moved cursor right to position " + std::to_string(m_cursorPosition));
+            LOG_DEBUG("Moved cursor right to position " + std::to_string(m_cursorPosition));
         }
     }
     
@@ -26,7 +26,7 @@ IPSelectorScreen::IPSelectorScreen(std::shared_ptr<Display> display,
 
 void IPSelectorScreen::enter()
 {
-    Logger::debug("IPSelectorScreen: Entered");
+    LOG_DEBUG("IPSelectorScreen: Entered");
     
     m_shouldExit = false;
 
@@ -72,7 +72,7 @@ void IPSelectorScreen::update()
 
 void IPSelectorScreen::exit()
 {
-    Logger::debug("IPSelectorScreen: Exiting with IP: " + m_selectedIp);
+    LOG_DEBUG("IPSelectorScreen: Exiting with IP: " + m_selectedIp);
     
     // Call the completion callback if provided
     if (m_onComplete) {
@@ -134,7 +134,7 @@ const std::string& IPSelectorScreen::getSelectedIp() const
 
 void IPSelectorScreen::onIpChanged(const std::string& ipAddress)
 {
-    Logger::debug("IP address changed to: " + ipAddress);
+    LOG_DEBUG("IP address changed to: " + ipAddress);
     m_selectedIp = ipAddress;
     
     // Update immediately
@@ -1,6 +1,7 @@
 #include "ScreenModules.h"
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
+#include "ModuleDependency.h"
 #include "Config.h"
 #include "Logger.h"
 #include <iostream>
@@ -8,20 +9,41 @@
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <sstream>
+
+namespace {
+
+// One row per probed layer below the result line
+const int s_layerTop = 24;
+
+// Comma separated list from the module config, or the default when it isn't set
+std::vector<std::string> configList(const std::string& key, const char* fallback) {
+    std::string value = ModuleDependency::getInstance().getDependencyPath("internet", key);
+    std::stringstream list(value.empty() ? fallback : value);
+    std::vector<std::string> items;
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+} // namespace
 
 InternetTestScreen::InternetTestScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
     : ScreenModule(display, input),
       m_testCompleted(false),
-      m_testResult(-1),
-      m_progress(0)
+      m_testResult(-1)
 {
 }
 
 void InternetTestScreen::enter()
 {
-    Logger::debug("InternetTestScreen: Entered");
+    LOG_DEBUG("InternetTestScreen: Entered");
     m_running = true;
-    
+
     // Clear display and show initial screen
     m_display->clear();
     usleep(Config::DISPLAY_CMD_DELAY * 3);
@@ -34,136 +56,145 @@ void InternetTestScreen::enter()
     m_display->drawText(0, 8, "----------------");
     usleep(Config::DISPLAY_CMD_DELAY);
 
-    // Draw testing message
-    m_display->drawText(20, 20, "Testing...");
-    usleep(Config::DISPLAY_CMD_DELAY);
-
-    // Initial progress bar (0%)
-    m_display->drawProgressBar(10, 35, 108, 15, 0);
-    usleep(Config::DISPLAY_CMD_DELAY);
-
     // Reset state
     m_testCompleted = false;
     m_testResult = -1;
-    m_progress = 0;
-    m_progressLastUpdated = 0;
-    m_animationLastUpdated = 0;
+    m_animationLastUpdated = -1;
     m_resultDisplayed = false;
+    m_exitHintDisplayed = false;
+    for (auto& text : m_layerText) {
+        text.clear();
+    }
 
     // Record start time
     m_startTime = std::chrono::steady_clock::now();
 
-    // Start the test in a separate thread
+    // Start the test, update() collects the answers
     startTest();
-    
-    Logger::debug("InternetTestScreen: Test started");
+    renderLayers();
+
+    LOG_DEBUG("InternetTestScreen: Test started");
 }
 
 void InternetTestScreen::startTest()
 {
-    // Start a new thread for the test
-    m_testThread = std::thread([this]() {
-        Logger::debug("InternetTestScreen: Test thread started for " + m_testServer);
-        
-        // Sleep for a short time to allow UI to initialize
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        // Perform the ping test
-        int result = pingServer(m_testServer, m_timeoutSec);
-        
-        Logger::debug("InternetTestScreen: Test completed with result " + std::to_string(result));
-
-        // Update state when complete
-        m_testResult = result;
+    // Every layer is probed at once, the first answer decides
+    ReachabilityProbe::Options options;
+    options.icmpHosts = configList("icmp_hosts", Config::REACH_ICMP_HOSTS);
+    options.tcpHosts = configList("tcp_hosts", Config::REACH_TCP_HOSTS);
+    std::string url = ModuleDependency::getInstance().getDependencyPath("internet", "http_url");
+    options.httpUrl = url.empty() ? Config::REACH_HTTP_URL : url;
+    std::string name = ModuleDependency::getInstance().getDependencyPath("internet", "dns_name");
+    if (!name.empty()) {
+        options.dnsName = name;
+    }
+
+    if (!m_probe.start(options)) {
+        m_testResult = 1;
         m_testCompleted = true;
-        m_progress = 100;
-    });
+    }
+}
+
+void InternetTestScreen::checkTest()
+{
+    if (m_testCompleted) {
+        return;
+    }
 
-    // Detach the thread to allow it to run independently
-    m_testThread.detach();
+    bool running = m_probe.poll(Config::REACH_SLICE_MS);
+
+    // Connected as soon as any layer got through, the others keep filling in the breakdown
+    if (m_testResult == -1 && m_probe.isReachable()) {
+        m_testResult = 0;
+        LOG_DEBUG("InternetTestScreen: Reachable after " + std::to_string(m_probe.getFirstSuccessUs()) + " us");
+    }
+    if (!running) {
+        if (m_testResult == -1) {
+            m_testResult = 1;
+        }
+        m_testCompleted = true;
+        LOG_DEBUG("InternetTestScreen: Test completed with result " + std::to_string(m_testResult));
+    }
 }
 
 void InternetTestScreen::update()
 {
+    checkTest();
+    renderLayers();
+
     auto currentTime = std::chrono::steady_clock::now();
     auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
         currentTime - m_startTime).count();
-    
-    // Update animation every 500ms
-    bool shouldUpdateAnimation = (elapsedMs - m_animationLastUpdated >= 500);
-    if (shouldUpdateAnimation) {
+
+    // Update animation every 500ms until there is an answer
+    if (m_testResult == -1 && (m_animationLastUpdated < 0 || elapsedMs - m_animationLastUpdated >= 500)) {
         m_animationLastUpdated = elapsedMs;
-        
-        if (!m_testCompleted) {
-            // Update animation dots
-            int dots = ((elapsedMs / 500) % 4);
-            std::string message = "Testing";
-            for (int i = 0; i < dots; i++) {
-                message += ".";
-            }
-            for (int i = dots; i < 3; i++) {
-                message += " ";
-            }
-            
-            m_display->drawText(0, 20, "                ");
-            m_display->drawText(20, 20, message);
-            usleep(Config::DISPLAY_CMD_DELAY);
-            
-            Logger::debug("InternetTestScreen: Animation update: " + message);
-        }
-    }
-    
-    // Update progress every 250ms if test is running
-    bool shouldUpdateProgress = (elapsedMs - m_progressLastUpdated >= 250);
-    if (shouldUpdateProgress && !m_testCompleted) {
-        m_progressLastUpdated = elapsedMs;
-        
-        // Calculate progress as a percentage of the timeout
-        int progress = static_cast<int>((elapsedMs * 100) / (m_timeoutSec * 1000));
-        if (progress > 95) progress = 95;  // Cap at 95% until complete
-        
-        if (progress > m_progress) {
-            m_progress = progress;
-            m_display->drawProgressBar(10, 35, 108, 15, progress);
-            usleep(Config::DISPLAY_CMD_DELAY);
-            Logger::debug("InternetTestScreen: Progress update: " + std::to_string(progress) + "%");
-        }
-    }
-    
-    // Handle test completion
-    if (m_testCompleted && !m_resultDisplayed) {
-        // Update to 100%
-        m_display->drawProgressBar(10, 35, 108, 15, 100);
+
+        int dots = ((elapsedMs / 500) % 4);
+        std::string message = "Testing" + std::string(dots, '.') + std::string(3 - dots, ' ');
+        m_display->drawText(0, 16, "                ");
+        m_display->drawText(20, 16, message);
         usleep(Config::DISPLAY_CMD_DELAY);
-        
-        // Clear testing message
-        m_display->drawText(0, 20, "                ");
+    }
+
+    // Show the answer once it is known, which may be well before every layer is done
+    if (m_testResult != -1 && !m_resultDisplayed) {
+        m_display->drawText(0, 16, "                ");
         usleep(Config::DISPLAY_CMD_DELAY);
-        
-        // Show result
+
         if (m_testResult == 0) {
-            m_display->drawText(20, 20, "CONNECTED!");
-            Logger::debug("InternetTestScreen: Showing CONNECTED message");
+            char text[32];
+            snprintf(text, sizeof(text), "CONNECTED %ldms", m_probe.getFirstSuccessUs() / 1000);
+            m_display->drawText(0, 16, text);
+            LOG_DEBUG("InternetTestScreen: Showing CONNECTED message");
         } else {
-            m_display->drawText(20, 20, "NO CONNECTION");
-            Logger::debug("InternetTestScreen: Showing NO CONNECTION message");
+            m_display->drawText(0, 16, "NO CONNECTION");
+            LOG_DEBUG("InternetTestScreen: Showing NO CONNECTION message");
         }
         usleep(Config::DISPLAY_CMD_DELAY);
-        
-        // Show press button message
-        m_display->drawText(15, 60, "Press to exit");
-        usleep(Config::DISPLAY_CMD_DELAY);
-        
+
         m_resultDisplayed = true;
-        Logger::debug("InternetTestScreen: Result displayed");
+        LOG_DEBUG("InternetTestScreen: Result displayed");
+    }
+
+    if (m_testCompleted && !m_exitHintDisplayed) {
+        m_display->drawText(0, 56, " Press to exit");
+        usleep(Config::DISPLAY_CMD_DELAY);
+        m_exitHintDisplayed = true;
+    }
+}
+
+void InternetTestScreen::renderLayers()
+{
+    for (int i = 0; i < ReachabilityProbe::LAYER_COUNT; i++) {
+        auto layer = static_cast<ReachabilityProbe::Layer>(i);
+        const auto& result = m_probe.getResult(layer);
+
+        // "ICMP   12ms", "DNS    failed", "HTTP   ..."
+        char text[32];
+        if (result.status == ReachabilityProbe::Status::OK) {
+            snprintf(text, sizeof(text), "%-6s %ldms", ReachabilityProbe::layerName(layer), result.elapsedUs / 1000);
+        } else if (result.status == ReachabilityProbe::Status::FAILED || m_testCompleted) {
+            snprintf(text, sizeof(text), "%-6s failed", ReachabilityProbe::layerName(layer));
+        } else {
+            snprintf(text, sizeof(text), "%-6s ...", ReachabilityProbe::layerName(layer));
+        }
+
+        if (m_layerText[i] != text) {
+            m_display->drawText(0, s_layerTop + i * 8, "                ");
+            m_display->drawText(0, s_layerTop + i * 8, text);
+            usleep(Config::DISPLAY_CMD_DELAY);
+            m_layerText[i] = text;
+        }
     }
 }
 
 void InternetTestScreen::exit()
 {
-    Logger::debug("InternetTestScreen: Exiting");
-    
+    LOG_DEBUG("InternetTestScreen: Exiting");
+
     // Clean up
+    m_probe.stop();
     m_running = false;
     m_display->clear();
     usleep(Config::DISPLAY_CMD_DELAY * 3);
@@ -171,8 +202,8 @@ void InternetTestScreen::exit()
 
 bool InternetTestScreen::handleInput()
 {
-    // Process any pending input
-    if (m_input->waitForEvents(100) > 0) {
+    // A running test gets most of the loop, input is checked in between
+    if (m_input->waitForEvents(m_testCompleted ? 100 : Config::REACH_INPUT_WAIT_MS) > 0) {
         bool buttonPressed = false;
 
         m_input->processEvents(
@@ -181,22 +212,25 @@ bool InternetTestScreen::handleInput()
                 m_display->updateActivityTimestamp();
             },
             [&buttonPressed, this]() {
-                // Button press 
+                // Button press
                 buttonPressed = true;
                 m_display->updateActivityTimestamp();
-                Logger::debug("InternetTestScreen: Button pressed");
+                LOG_DEBUG("InternetTestScreen: Button pressed");
             }
         );
 
         if (buttonPressed) {
             if (m_testCompleted) {
-                Logger::debug("InternetTestScreen: Test completed, exiting on button press");
+                LOG_DEBUG("InternetTestScreen: Test completed, exiting on button press");
                 return false; // Exit if test is complete
             } else {
                 // If test is still running, mark it as complete with an interrupted status
-                Logger::debug("InternetTestScreen: Test interrupted by user");
+                LOG_DEBUG("InternetTestScreen: Test interrupted by user");
+                m_probe.stop();
                 m_testCompleted = true;
-                m_testResult = 2; // 2 = interrupted
+                if (m_testResult == -1) {
+                    m_testResult = 2; // 2 = interrupted
+                }
                 return true; // Stay in screen to show result
             }
         }
@@ -204,20 +238,3 @@ bool InternetTestScreen::handleInput()
 
     return m_running; // Continue as long as running is true
 }
-
-int InternetTestScreen::pingServer(const std::string& server, int timeoutSec)
-{
-    Logger::debug("InternetTestScreen: Pinging server " + server);
-    
-    // Construct ping command with timeout and minimal output
-    std::string command = "ping -c 1 -W " + std::to_string(timeoutSec) + " " + server + " > /dev/null 2>&1";
-
-    // Execute the command
-    int result = system(command.c_str());
-    
-    // Log the result
-    Logger::debug("InternetTestScreen: Ping returned " + std::to_string(result));
-
-    // Return 0 for success, non-zero for failure
-    return (result == 0) ? 0 : 1;
-}
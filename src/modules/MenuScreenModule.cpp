@@ -21,7 +21,7 @@ MenuScreenModule::~MenuScreenModule() {
 }
 
 void MenuScreenModule::enter() {
-    Logger::debug("Entering menu screen: " + m_id);
+    LOG_DEBUG("Entering menu screen: " + m_id);
     // If this is the top level menu, always clear the exit to main menu flag
     if (m_isTopLevelMenu) {
         m_exitToMainMenu = false;
@@ -38,17 +38,23 @@ void MenuScreenModule::enter() {
 
     // Render the menu
     m_menu->render();
+    m_dependencyGeneration = ModuleDependency::getInstance().getStateGeneration();
 
     // Reset exit flag
     m_exitToParent = false;
 }
 
 void MenuScreenModule::update() {
-    // Nothing to update continuously in a menu screen
+    // Redraw if a module's dependency state changed while the menu is shown
+    unsigned generation = ModuleDependency::getInstance().getStateGeneration();
+    if (generation != m_dependencyGeneration) {
+        m_dependencyGeneration = generation;
+        m_menu->render();
+    }
 }
 
 void MenuScreenModule::exit() {
-    Logger::debug("Exiting menu screen: " + m_id);
+    LOG_DEBUG("Exiting menu screen: " + m_id);
 
     // Clear the display
     m_display->clear();
@@ -92,7 +98,7 @@ void MenuScreenModule::addSubmenuItem(const std::string& moduleId, const std::st
     item.title = title;
     m_submenuItems.push_back(item);
 
-    Logger::debug("Added submenu item '" + title + "' with id '" + moduleId + "' to menu " + m_id);
+    LOG_DEBUG("Added submenu item '" + title + "' with id '" + moduleId + "' to menu " + m_id);
 }
 
 void MenuScreenModule::setModuleRegistry(const std::map<std::string, std::shared_ptr<ScreenModule>>* registry) {
@@ -138,10 +144,15 @@ void MenuScreenModule::buildSubmenu() {
         }
 
         // Otherwise, create an action item that launches the corresponding module
-        m_menu->addItem(std::make_shared<ActionMenuItem>(item.title, [this, moduleId = item.moduleId]() {
+        auto menuItem = std::make_shared<ActionMenuItem>(item.title, [this, moduleId = item.moduleId]() {
             // Execute the module
             executeSubmenuAction(moduleId);
-        }));
+        });
+        // Grey out the item while its dependencies are not satisfied
+        menuItem->setAvailabilityCheck([moduleId = item.moduleId]() {
+            return ModuleDependency::getInstance().checkDependencies(moduleId);
+        });
+        m_menu->addItem(menuItem);
     }
     // Add a "Main Menu" option if we're in a nested menu (not the top level)
     if (m_parentMenu && !m_isTopLevelMenu) {  // Only add if we have a parent and aren't the top level
@@ -174,14 +185,14 @@ void MenuScreenModule::executeSubmenuAction(const std::string& moduleId) {
     // Look up the module in the registry
     auto it = m_moduleRegistry->find(moduleId);
     if (it == m_moduleRegistry->end()) {
-        Logger::error("Module not found in registry: " + moduleId);
+        LOG_ERROR("Module not found in registry: " + moduleId);
         return;
     }
 
     // Get the module
     auto module = it->second;
     if (!module) {
-        Logger::error("Invalid module pointer for: " + moduleId);
+        LOG_ERROR("Invalid module pointer for: " + moduleId);
         return;
     }
 
@@ -196,7 +207,7 @@ void MenuScreenModule::executeSubmenuAction(const std::string& moduleId) {
     if (!isMenuModule) {
         auto& dependencies = ModuleDependency::getInstance();
         if (!dependencies.shouldSkipDependencyCheck(moduleId) && !dependencies.checkDependencies(moduleId)) {
-            Logger::warning("Dependencies not satisfied for module: " + moduleId);
+            LOG_WARNING("Dependencies not satisfied for module: " + moduleId);
 
             // Show a message on display
             m_display->clear();
@@ -225,7 +236,7 @@ void MenuScreenModule::executeSubmenuAction(const std::string& moduleId) {
     }
 
     // Execute the module
-    Logger::debug("Executing submenu module: " + moduleId);
+    LOG_DEBUG("Executing submenu module: " + moduleId);
 
     // Clear the display before launching the module
     m_display->clear();
@@ -242,7 +253,7 @@ void MenuScreenModule::executeSubmenuAction(const std::string& moduleId) {
     m_menu->render();
 }
 void MenuScreenModule::navigateToMainMenu() {
-    Logger::debug("Navigating to main menu from: " + m_id);
+    LOG_DEBUG("Navigating to main menu from: " + m_id);
 
     // Set our exit flags to trigger a return to parent menu
     m_exitToParent = true;
@@ -253,7 +264,7 @@ void MenuScreenModule::onScreenAction(const std::string& screenId,
                                     const std::string& action,
                                     const std::string& value)
 {
-    Logger::debug("Menu received callback from " + screenId +
+    LOG_DEBUG("Menu received callback from " + screenId +
                 ": Action=" + action + ", Value=" + value);
 
     // Store the value for later use
@@ -3,18 +3,11 @@
 #include "DeviceInterfaces.h"
 #include "Config.h"
 #include "Logger.h"
+#include "InterfaceMonitor.h"
 #include <iostream>
 #include <unistd.h>
 #include <vector>
 #include <algorithm>
-#include <ifaddrs.h>
-#include <netinet/in.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <arpa/inet.h>
-#include <net/if.h>
-#include <string.h>
-#include <dirent.h>
 
 // Structure to hold network interface information
 struct InterfaceInfo {
@@ -41,10 +34,9 @@ public:
     int m_scrollOffset = 0;
     // Use enum instead of static constexpr for constants
     enum { MAX_VISIBLE_ITEMS = 6 }; // Max number of items visible on screen
-    enum { REFRESH_INTERVAL = 5 };  // Refresh interval in seconds
     
-    // Timing for interface refresh
-    time_t m_lastRefreshTime = 0;
+    // Interface monitor generation the list was built from
+    uint64_t m_generation = 0;
     
     // State flags
     bool m_shouldExit = false;
@@ -55,9 +47,6 @@ public:
 
     // Network interface methods
     void refreshInterfaceList();
-    bool getInterfaceDetails(InterfaceInfo& interface);
-    bool checkLinkStatus(const std::string& interfaceName);
-    bool getMacAddress(const std::string& interfaceName, std::string& macAddress);
     
     // Drawing methods
     void renderMenu(bool fullRedraw);
@@ -78,7 +67,7 @@ NetInfoScreen::~NetInfoScreen() = default;
 
 void NetInfoScreen::enter()
 {
-    Logger::debug("NetInfoScreen: Entered");
+    LOG_DEBUG("NetInfoScreen: Entered");
     
     // Reset state
     m_pImpl->m_inSubmenu = false;
@@ -96,9 +85,8 @@ void NetInfoScreen::enter()
 
 void NetInfoScreen::update()
 {
-    // Periodically refresh interface list
-    time_t currentTime = time(nullptr);
-    if (currentTime - m_pImpl->m_lastRefreshTime >= m_pImpl->REFRESH_INTERVAL) {
+    // Rebuild the list only when the kernel reported a link or address change
+    if (InterfaceMonitor::getInstance().poll() != m_pImpl->m_generation) {
         // Save current selection
         std::string selectedName;
         if (!m_pImpl->m_interfaces.empty() && m_pImpl->m_selectedInterface >= 0 && 
@@ -118,7 +106,11 @@ void NetInfoScreen::update()
                 }
             }
         }
-        
+
+        // A removed interface may have taken the selection with it
+        m_pImpl->m_selectedInterface = std::min(m_pImpl->m_selectedInterface,
+                                                static_cast<int>(m_pImpl->m_interfaces.size()) - 1);
+
         // Update display if we're in the main menu
         if (!m_pImpl->m_inSubmenu) {
             m_pImpl->renderMenu(true);
@@ -126,14 +118,12 @@ void NetInfoScreen::update()
             // Update the details screen if we're in submenu
             m_pImpl->renderInterfaceDetails(m_pImpl->m_selectedInterface);
         }
-        
-        m_pImpl->m_lastRefreshTime = currentTime;
     }
 }
 
 void NetInfoScreen::exit()
 {
-    Logger::debug("NetInfoScreen: Exiting");
+    LOG_DEBUG("NetInfoScreen: Exiting");
     
     // Clear display
     m_display->clear();
@@ -211,158 +201,38 @@ void NetInfoScreen::Impl::refreshInterfaceList()
     // Clear existing interfaces
     m_interfaces.clear();
     
-    // Get network interfaces
-    struct ifaddrs *ifaddr, *ifa;
-    
-    if (getifaddrs(&ifaddr) == -1) {
-        Logger::error("Failed to get interface addresses");
-        
-        // Add "Back" option even if we failed
-        InterfaceInfo backOption;
-        backOption.name = "Back";
-        m_interfaces.push_back(backOption);
-        
-        return;
-    }
+    // One consistent view of every link and its addresses
+    InterfaceMonitor& monitor = InterfaceMonitor::getInstance();
+    m_generation = monitor.poll();
+    InterfaceMonitor::Snapshot snapshot = monitor.getSnapshot();
     
-    // Find all interfaces
-    for (ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == nullptr)
-            continue;
-            
+    for (const auto& link : *snapshot) {
         // Skip loopback interfaces
-        if (ifa->ifa_flags & IFF_LOOPBACK)
-            continue;
-            
-        // Check if we already have this interface
-        bool found = false;
-        for (const auto& iface : m_interfaces) {
-            if (iface.name == ifa->ifa_name) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (found)
+        if (link.isLoopback())
             continue;
             
-        // Create new interface info
         InterfaceInfo iface;
-        iface.name = ifa->ifa_name;
-        iface.linkUp = checkLinkStatus(iface.name);
-        
-        // Get MAC and populate initial values
-        getMacAddress(iface.name, iface.macAddress);
+        iface.name = link.name;
+        iface.linkUp = link.isLinkUp();
+        iface.macAddress = link.formatHardwareAddress("");
         iface.ipAddress = "<no ip>";
         iface.netmask = "<no netmask>";
         
-        // Try to fill in more details
-        getInterfaceDetails(iface);
+        const InterfaceMonitor::Address* address = link.firstAddress(AF_INET);
+        if (address) {
+            iface.ipAddress = address->address;
+            iface.netmask = InterfaceMonitor::prefixToNetmask(address->prefixLength);
+        }
         
-        // Add to list
         m_interfaces.push_back(iface);
     }
     
-    freeifaddrs(ifaddr);
-    
     // Add "Back" option
     InterfaceInfo backOption;
     backOption.name = "Back";
     m_interfaces.push_back(backOption);
     
-    // Set last refresh time
-    m_lastRefreshTime = time(nullptr);
-    
-    Logger::debug("Found " + std::to_string(m_interfaces.size() - 1) + " network interfaces");
-}
-
-bool NetInfoScreen::Impl::getInterfaceDetails(InterfaceInfo& interface)
-{
-    struct ifaddrs *ifaddr, *ifa;
-    char addrStr[INET_ADDRSTRLEN];
-    
-    if (getifaddrs(&ifaddr) == -1) {
-        return false;
-    }
-    
-    // Find matching interface
-    for (ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == nullptr || ifa->ifa_name == nullptr)
-            continue;
-            
-        if (strcmp(ifa->ifa_name, interface.name.c_str()) != 0)
-            continue;
-            
-        // Found a match
-        if (ifa->ifa_addr->sa_family == AF_INET) {
-            // IPv4 address
-            struct sockaddr_in *addr = (struct sockaddr_in *)ifa->ifa_addr;
-            struct sockaddr_in *mask = (struct sockaddr_in *)ifa->ifa_netmask;
-            
-            // Get IP address
-            inet_ntop(AF_INET, &addr->sin_addr, addrStr, sizeof(addrStr));
-            interface.ipAddress = addrStr;
-            
-            // Get netmask
-            inet_ntop(AF_INET, &mask->sin_addr, addrStr, sizeof(addrStr));
-            interface.netmask = addrStr;
-            
-            break;
-        }
-    }
-    
-    freeifaddrs(ifaddr);
-    return true;
-}
-
-bool NetInfoScreen::Impl::checkLinkStatus(const std::string& interfaceName)
-{
-    char path[64];
-    snprintf(path, sizeof(path), "/sys/class/net/%s/operstate", interfaceName.c_str());
-    
-    FILE* fp = fopen(path, "r");
-    if (!fp) {
-        return false;
-    }
-    
-    char buf[8];
-    bool linkUp = false;
-    
-    if (fgets(buf, sizeof(buf), fp)) {
-        // "up" indicates the link is up
-        if (strncmp(buf, "up", 2) == 0) {
-            linkUp = true;
-        }
-    }
-    
-    fclose(fp);
-    return linkUp;
-}
-
-bool NetInfoScreen::Impl::getMacAddress(const std::string& interfaceName, std::string& macAddress)
-{
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) {
-        return false;
-    }
-    
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, interfaceName.c_str(), IFNAMSIZ - 1);
-    
-    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
-        close(fd);
-        return false;
-    }
-    
-    unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-    char macStr[18];
-    snprintf(macStr, sizeof(macStr), "%02X%02X%02X%02X%02X%02X",
-            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    
-    macAddress = macStr;
-    close(fd);
-    return true;
+    LOG_DEBUG("Found " + std::to_string(m_interfaces.size() - 1) + " network interfaces");
 }
 
 void NetInfoScreen::Impl::renderMenu(bool fullRedraw)
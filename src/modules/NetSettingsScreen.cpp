@@ -5,6 +5,10 @@
 #include "Config.h"
 #include "Logger.h"
 #include "IPSelector.h"
+#include "ScriptHelper.h"
+#include "NetlinkConfig.h"
+#include "IcmpPinger.h"
+#include "InterfaceMonitor.h"
 #include <iostream>
 #include <unistd.h>
 #include <vector>
@@ -13,10 +17,28 @@
 #include <cstdio>
 #include <fstream>
 #include <sstream>
+#include <arpa/inet.h>
 
 // Script path for network settings
 //#define NET_SETTINGS_SCRIPT "/usr/bin/dhcp-net-settings.sh"
 
+namespace {
+
+// The address selectors only take the zero padded form, "192.168.001.010"
+std::string padAddress(const std::string& address) {
+    struct sockaddr_in parsed;
+    if (!IcmpSocket::parseAddress(address, parsed)) {
+        return "";
+    }
+    uint32_t value = ntohl(parsed.sin_addr.s_addr);
+    char text[16];
+    snprintf(text, sizeof(text), "%03u.%03u.%03u.%03u",
+             (value >> 24) & 0xFF, (value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
+    return text;
+}
+
+} // namespace
+
 // Menu states - define which menu is currently active
 enum class NetSettingsMenuState {
     MENU_MAIN,      // Main network settings menu
@@ -67,11 +89,16 @@ public:
     // Interface methods
     void refreshSettings();
     void applyNetworkSettings();
-    bool initNetworkSettingsFromScript();
+    bool initNetworkSettings();
+    void persistSettings(const std::vector<std::string>& args);
+    void startPersist(const std::vector<std::string>& args);
+    void checkPersist();
+    void finishPersist();
     void networkFieldChanged(const std::string& ip);
     std::string getNetSettingsScriptPath();
     std::string getNetSettingsOsType();
     std::string getNetSettingsInterface();
+    Subprocess::Result runNetSettingsScript(const std::vector<std::string>& args, const char* traceName);
     // Menu state management
     void switchToMainMenu();
     void switchToModeMenu();
@@ -114,6 +141,10 @@ public:
     std::unique_ptr<IPSelector> m_gatewaySelector;
     std::unique_ptr<IPSelector> m_netmaskSelector;
 
+    // Writes applied static settings to the distro's configuration in the background
+    Subprocess m_persist;
+    std::vector<std::string> m_pendingPersist;  // Latest settings applied while m_persist ran
+
     // Reference to display and input
     std::shared_ptr<Display> m_display;
     std::shared_ptr<InputDevice> m_input;
@@ -133,9 +164,9 @@ NetSettingsScreen::Impl::Impl(std::shared_ptr<Display> display, std::shared_ptr<
     m_gatewaySelector = std::make_unique<IPSelector>("192.168.001.001", 16, ip_change_callback);
     m_netmaskSelector = std::make_unique<IPSelector>("255.255.255.000", 16, ip_change_callback);
     
-    // Try to initialize from script
-    if (!initNetworkSettingsFromScript()) {
-        Logger::warning("Failed to get network settings from script, using defaults");
+    // Start from what the interface is configured with
+    if (!initNetworkSettings()) {
+        Logger::warning("Failed to read network settings, using defaults");
     }
 }
 
@@ -146,87 +177,34 @@ NetSettingsScreen::Impl::~Impl() {
     m_netmaskSelector->reset();
 }
 
-bool NetSettingsScreen::Impl::initNetworkSettingsFromScript() {
-    // Command to execute the script
-    ///usr/bin/dhcp-net-settings.sh --os=debian --interface=eth0
-    std::string cmd = getNetSettingsScriptPath();
-    std::string ostype = getNetSettingsOsType();
+bool NetSettingsScreen::Impl::initNetworkSettings() {
+    // Straight from the kernel: address, prefix and default route of the interface
     std::string iface = getNetSettingsInterface();
-    cmd+=" --os="+ostype+" --interface="+iface;
-    FILE* fp = popen(cmd.c_str(), "r");
-    if (!fp) {
-        Logger::error("Failed to run dhcp-net-settings.sh");
+    NetlinkConfig::Ipv4Settings settings;
+    if (!NetlinkConfig::read(iface, settings)) {
+        Logger::error("Failed to read network settings of " + iface);
         return false;
     }
 
-    char line[128];
-    bool hasIp = false;
-    bool hasGateway = false;
-    bool hasNetmask = false;
-    bool foundResult = false;
-
-    // Parse script output
-    while (fgets(line, sizeof(line), fp) != nullptr) {
-        // Remove newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-        }
-
-        Logger::debug("Script output: " + std::string(line));
-
-        // Check for result status
-        if (strncmp(line, "RESULT:", 7) == 0) {
-            foundResult = true;
-            if (strstr(line, "ERROR") != nullptr) {
-                Logger::error("Error reading network settings");
-                pclose(fp);
-                return false;
-            }
-        }
-        // Check mode
-        else if (strncmp(line, "mode=", 5) == 0) {
-            if (strcmp(line + 5, "static") == 0) {
-                m_mode = NetworkMode::NET_MODE_STATIC;
-            } else if (strcmp(line + 5, "dhcp") == 0) {
-                m_mode = NetworkMode::NET_MODE_DHCP;
-            }
-        }
-        // Check IP
-        else if (strncmp(line, "ip=", 3) == 0) {
-            hasIp = true;
-            m_ipSelector->setIp(line + 3);
-        }
-        // Check gateway
-        else if (strncmp(line, "gateway=", 8) == 0) {
-            hasGateway = true;
-            m_gatewaySelector->setIp(line + 8);
-        }
-        // Check netmask
-        else if (strncmp(line, "netmask=", 8) == 0) {
-            hasNetmask = true;
-            m_netmaskSelector->setIp(line + 8);
-        }
+    // A leased address means a DHCP client runs the interface, so does having none at all
+    if (settings.address.empty() || settings.leased) {
+        m_mode = NetworkMode::NET_MODE_DHCP;
+    } else {
+        m_mode = NetworkMode::NET_MODE_STATIC;
     }
 
-    pclose(fp);
-
-    // Check if we got all needed information
-    if (!foundResult) {
-        Logger::error("Script didn't return result status");
-        return false;
+    if (!settings.address.empty()) {
+        m_ipSelector->setIp(padAddress(settings.address));
+        m_netmaskSelector->setIp(padAddress(InterfaceMonitor::prefixToNetmask(settings.prefixLength)));
     }
-
-    // If mode is static, we should have all IP settings
-    if (m_mode == NetworkMode::NET_MODE_STATIC) {
-        if (!hasIp || !hasGateway || !hasNetmask) {
-            Logger::warning("Static mode but missing some IP settings");
-            // We'll continue anyway with default values
-        }
+    if (!settings.gateway.empty()) {
+        m_gatewaySelector->setIp(padAddress(settings.gateway));
     }
 
-    Logger::debug("Network settings initialized from script: mode=" + 
-                  std::string((m_mode == NetworkMode::NET_MODE_STATIC) ? "static" : "dhcp"));
+    LOG_DEBUG("Network settings of " + iface + ": mode=" +
+              std::string((m_mode == NetworkMode::NET_MODE_STATIC) ? "static" : "dhcp") +
+              " ip=" + settings.address + "/" + std::to_string(settings.prefixLength) +
+              " gateway=" + settings.gateway);
     return true;
 }
 
@@ -241,11 +219,11 @@ void NetSettingsScreen::Impl::refreshSettings() {
     std::string currentGateway = m_gatewaySelector->getIp();
     std::string currentNetmask = m_netmaskSelector->getIp();
 
-    // Refresh network settings from the script
-    Logger::debug("Refreshing network settings from script");
-    if (!initNetworkSettingsFromScript()) {
+    // Refresh network settings from the interface
+    LOG_DEBUG("Refreshing network settings");
+    if (!initNetworkSettings()) {
         Logger::warning("Failed to refresh network settings, using current values");
-        // If script failed, restore previous values
+        // If reading failed, restore previous values
         m_ipSelector->setIp(currentIp);
         m_gatewaySelector->setIp(currentGateway);
         m_netmaskSelector->setIp(currentNetmask);
@@ -253,13 +231,11 @@ void NetSettingsScreen::Impl::refreshSettings() {
 }
 
 void NetSettingsScreen::Impl::applyNetworkSettings() {
-    char cmd[512];
-    char line[128];
-    bool success = false;
-    std::string scriptPath = getNetSettingsScriptPath(); 
-    std::string ostype = getNetSettingsOsType();
-    std::string iface  = getNetSettingsInterface();
-    FILE* fp = nullptr;
+    std::vector<std::string> args = {
+        getNetSettingsScriptPath(),
+        "--os=" + getNetSettingsOsType(),
+        "--interface=" + getNetSettingsInterface()
+    };
 
     if (m_mode == NetworkMode::NET_MODE_STATIC) {
         // Get current IP values from selectors
@@ -267,94 +243,121 @@ void NetSettingsScreen::Impl::applyNetworkSettings() {
         const std::string& netmask = m_netmaskSelector->getIp();
         const std::string& gateway = m_gatewaySelector->getIp();
 
-        // Construct command with all parameters
-        snprintf(cmd, sizeof(cmd),
-                "%s --os=%s --interface=%s --mode=static --ip=%s --gateway=%s --netmask=%s",
-                scriptPath.c_str(), ostype.c_str(),iface.c_str(),ip.c_str(), gateway.c_str(), netmask.c_str());
-
-        Logger::debug("Running command: " + std::string(cmd));
+        LOG_DEBUG("Applying static IP settings:");
+        LOG_DEBUG("  IP: " + ip);
+        LOG_DEBUG("  Netmask: " + netmask);
+        LOG_DEBUG("  Gateway: " + gateway);
 
-        // Execute the command and check result
-        fp = popen(cmd, "r");
-        if (!fp) {
-            Logger::error("Failed to run dhcp-net-settings.sh");
+        // Take effect at once over netlink, a refused step rolls the others back
+        int prefixLength = NetlinkConfig::netmaskToPrefix(netmask);
+        std::string error = "invalid netmask";
+        if (prefixLength < 0 ||
+            !NetlinkConfig::applyStatic(getNetSettingsInterface(), ip, prefixLength, gateway, error)) {
             m_settingsApplied = false;
+            Logger::error("Failed to apply network settings: " + error);
             return;
         }
-
-        // Parse output to check if successful
-        while (fgets(line, sizeof(line), fp) != nullptr) {
-            // Remove newline
-            size_t len = strlen(line);
-            if (len > 0 && line[len-1] == '\n') {
-                line[len-1] = '\0';
-            }
-
-            Logger::debug("Script output: " + std::string(line));
-
-            // Check for result status
-            if (strncmp(line, "RESULT:", 7) == 0) {
-                if (strstr(line, "OK") != nullptr) {
-                    success = true;
-                }
-            }
-        }
-
-        Logger::debug("Applied static IP settings:");
-        Logger::debug("  IP: " + ip);
-        Logger::debug("  Netmask: " + netmask);
-        Logger::debug("  Gateway: " + gateway);
+        m_settingsChanged = false;
+        m_settingsApplied = true;
+        LOG_DEBUG("Network settings applied successfully");
+
+        // The distro's configuration follows, so the settings survive a reboot. Only
+        // written, restarting networking would undo what netlink just set up
+        args.push_back("--mode=static");
+        args.push_back("--ip=" + ip);
+        args.push_back("--gateway=" + gateway);
+        args.push_back("--netmask=" + netmask);
+        args.push_back("--persist-only");
+        persistSettings(args);
+        return;
     }
-    else {
-        // DHCP mode - simpler command
-        snprintf(cmd, sizeof(cmd), "%s --os=%s --interface=%s --mode=dhcp", scriptPath.c_str(),ostype.c_str(),iface.c_str());//NET_SETTINGS_SCRIPT);
 
-        Logger::debug("Running command: " + std::string(cmd));
+    // DHCP needs the distro's client, so the script does all of it
+    args.push_back("--mode=dhcp");
+    LOG_DEBUG("Applying DHCP configuration");
 
-        // Execute the command and check result
-        fp = popen(cmd, "r");
-        if (!fp) {
-            Logger::error("Failed to run dhcp-net-settings.sh");
-            m_settingsApplied = false;
-            return;
-        }
+    // A static save still writing would race the script, a queued one would undo it
+    m_pendingPersist.clear();
+    if (m_persist.isRunning()) {
+        m_persist.wait();
+        finishPersist();
+    }
 
-        // Parse output to check if successful
-        while (fgets(line, sizeof(line), fp) != nullptr) {
-            // Remove newline
-            size_t len = strlen(line);
-            if (len > 0 && line[len-1] == '\n') {
-                line[len-1] = '\0';
-            }
+    // Execute the command and check result
+    Subprocess::Result result = runNetSettingsScript(args, "net-settings-apply");
 
-            Logger::debug("Script output: " + std::string(line));
+    // Parse output to check if successful
+    bool success = false;
+    std::istringstream output(result.output);
+    std::string line;
+    while (std::getline(output, line)) {
+        LOG_DEBUG("Script output: " + line);
 
-            // Check for result status
-            if (strncmp(line, "RESULT:", 7) == 0) {
-                if (strstr(line, "OK") != nullptr) {
-                    success = true;
-                }
-            }
+        // Check for result status
+        if (line.compare(0, 7, "RESULT:") == 0 && line.find("OK") != std::string::npos) {
+            success = true;
         }
-
-        Logger::debug("Applied DHCP configuration");
-    }
-
-    if (fp) {
-        pclose(fp);
     }
 
     // Mark settings as applied only if successful
     if (success) {
         m_settingsChanged = false;
         m_settingsApplied = true;
-        Logger::debug("Network settings applied successfully");
+        LOG_DEBUG("Network settings applied successfully");
     } else {
         m_settingsApplied = false;
         Logger::error("Failed to apply network settings");
     }
 }
 
+void NetSettingsScreen::Impl::persistSettings(const std::vector<std::string>& args) {
+    // "persist": "false" in the dependencies keeps the change to this boot
+    auto& dependencies = ModuleDependency::getInstance();
+    if (dependencies.getDependencyPath("netsettings", "persist") == "false") {
+        return;
+    }
+
+    // A save cut short could leave the configuration half written, so the latest
+    // settings wait for it and replace anything queued before them
+    if (m_persist.isRunning()) {
+        m_pendingPersist = args;
+        return;
+    }
+    startPersist(args);
+}
+
+void NetSettingsScreen::Impl::startPersist(const std::vector<std::string>& args) {
+    Subprocess::Options options;
+    options.mergeStderr = true;
+    options.traceName = "net-settings-persist";
+    if (!m_persist.start(args, options)) {
+        Logger::error("Failed to start saving network settings");
+    }
+}
+
+void NetSettingsScreen::Impl::checkPersist() {
+    if (!m_persist.isRunning() || m_persist.poll()) {
+        return;
+    }
+    finishPersist();
+}
+
+void NetSettingsScreen::Impl::finishPersist() {
+    bool success = m_persist.getOutput().find("RESULT:OK") != std::string::npos;
+    if (success) {
+        LOG_DEBUG("Network settings saved");
+    } else {
+        Logger::error("Network settings are active but could not be saved");
+        LOG_DEBUG("Script output: " + m_persist.getOutput());
+    }
+
+    if (!m_pendingPersist.empty()) {
+        std::vector<std::string> args;
+        args.swap(m_pendingPersist);
+        startPersist(args);
+    }
+}
+
 void NetSettingsScreen::Impl::switchToMainMenu() {
     m_menuState = NetSettingsMenuState::MENU_MAIN;
     m_redrawNeeded = true;
@@ -901,7 +904,7 @@ NetSettingsScreen::NetSettingsScreen(std::shared_ptr<Display> display, std::shar
 NetSettingsScreen::~NetSettingsScreen() = default;
 
 void NetSettingsScreen::enter() {
-    Logger::debug("NetSettingsScreen: Entered");
+    LOG_DEBUG("NetSettingsScreen: Entered");
     
     // Reset state
     m_pImpl->m_menuState = NetSettingsMenuState::MENU_MAIN;
@@ -923,6 +926,8 @@ void NetSettingsScreen::enter() {
 }
 
 void NetSettingsScreen::update() {
+    m_pImpl->checkPersist();
+
     // If redraw is needed, update the display
     if (m_pImpl->m_redrawNeeded) {
         switch (m_pImpl->m_menuState) {
@@ -948,7 +953,7 @@ void NetSettingsScreen::update() {
 }
 
 void NetSettingsScreen::exit() {
-    Logger::debug("NetSettingsScreen: Exiting");
+    LOG_DEBUG("NetSettingsScreen: Exiting");
     
     // Clear display
     m_display->clear();
@@ -1150,11 +1155,11 @@ std::string NetSettingsScreen::Impl::getNetSettingsScriptPath() {
     std::string scriptPath = dependencies.getDependencyPath("netsettings", "action_script");
     
     if (scriptPath.empty()) {
-        Logger::debug("No action_script dependency found for netsettings, using default path");
+        LOG_DEBUG("No action_script dependency found for netsettings, using default path");
         return defaultPath;
     }
     
-    Logger::debug("Using script path from dependencies: " + scriptPath);
+    LOG_DEBUG("Using script path from dependencies: " + scriptPath);
     return scriptPath;
 }
 std::string NetSettingsScreen::Impl::getNetSettingsOsType() {
@@ -1165,10 +1170,10 @@ std::string NetSettingsScreen::Impl::getNetSettingsOsType() {
     std::string osType = dependencies.getDependencyPath("netsettings", "os_type");
 
     if (osType.empty()) {
-        Logger::debug("No os_type dependency found for netsettings, using default debian os_type");
+        LOG_DEBUG("No os_type dependency found for netsettings, using default debian os_type");
         return defaultOs;
     }
-    Logger::debug("Using os_type from dependencies: " + osType);
+    LOG_DEBUG("Using os_type from dependencies: " + osType);
     return osType;
 }
 std::string NetSettingsScreen::Impl::getNetSettingsInterface() {
@@ -1179,9 +1184,22 @@ std::string NetSettingsScreen::Impl::getNetSettingsInterface() {
     std::string interfaceName = dependencies.getDependencyPath("netsettings", "iface_name");
 
     if(interfaceName.empty()) {
-       Logger::debug("No iface_name dependency found for netsettings, using default eth0 interface");
+       LOG_DEBUG("No iface_name dependency found for netsettings, using default eth0 interface");
        return defaultInterface;
     }
-    Logger::debug("Using iface_name from dependencies: " + interfaceName);
+    LOG_DEBUG("Using iface_name from dependencies: " + interfaceName);
     return interfaceName;
 }
+
+Subprocess::Result NetSettingsScreen::Impl::runNetSettingsScript(const std::vector<std::string>& args,
+                                                                const char* traceName) {
+    Subprocess::Options options;
+    options.traceName = traceName;
+
+    // "use_helper": "true" in the dependencies runs the script in the shared helper shell
+    auto& dependencies = ModuleDependency::getInstance();
+    if (dependencies.getDependencyPath("netsettings", "use_helper") == "true") {
+        return ScriptHelper::getInstance().run(args, options);
+    }
+    return Subprocess::run(args, options);
+}
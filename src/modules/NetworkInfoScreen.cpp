@@ -2,17 +2,10 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
 #include "Config.h"
+#include "Logger.h"
+#include "InterfaceMonitor.h"
 #include <iostream>
 #include <unistd.h>
-#include <cstring>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <net/if.h>
-#include <arpa/inet.h>
-#include <ifaddrs.h>
-#include <netdb.h>
-#include <sys/ioctl.h>
 
 NetworkInfoScreen::NetworkInfoScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
     : ScreenModule(display, input)
@@ -21,6 +14,13 @@ NetworkInfoScreen::NetworkInfoScreen(std::shared_ptr<Display> display, std::shar
 
 void NetworkInfoScreen::enter()
 {
+    render();
+}
+
+void NetworkInfoScreen::render()
+{
+    m_generation = InterfaceMonitor::getInstance().poll();
+
     // Get network information
     std::string ipStr = "Unknown";
     std::string macStr = "Unknown";
@@ -76,7 +76,10 @@ void NetworkInfoScreen::enter()
 
 void NetworkInfoScreen::update()
 {
-    // Nothing to update periodically
+    // Redraw when the kernel reported a link or address change
+    if (InterfaceMonitor::getInstance().poll() != m_generation) {
+        render();
+    }
 }
 
 void NetworkInfoScreen::exit()
@@ -112,113 +115,36 @@ bool NetworkInfoScreen::handleInput()
 // Implementation of network info gathering
 void NetworkInfoScreen::getNetworkInfo(std::string& ipStr, std::string& macStr, std::string& ifaceStr)
 {
-    struct ifaddrs* ifaddr, *ifa;
-    int family, s;
-    char host[NI_MAXHOST];
-    bool foundIp = false;
-
     // Initialize with defaults
     ipStr = "Not connected";
     macStr = "Not available";
     ifaceStr = "Not available";
 
-    // Get IP address
-    if (getifaddrs(&ifaddr) == -1) {
-        std::cerr << "getifaddrs failed: " << strerror(errno) << std::endl;
-        return;
-    }
-
-    // First pass: Look for non-loopback interfaces
-    for (ifa = ifaddr; ifa != NULL && !foundIp; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == NULL)
-            continue;
-
-        family = ifa->ifa_addr->sa_family;
-
-        // Skip if not IPv4
-        if (family != AF_INET)
-            continue;
-
-        // Skip loopback interfaces (lo)
-        if (strcmp(ifa->ifa_name, "lo") == 0)
-            continue;
+    InterfaceMonitor::Snapshot snapshot = InterfaceMonitor::getInstance().getSnapshot();
 
-        // Check if interface is up and running
-        if (!(ifa->ifa_flags & IFF_UP) || !(ifa->ifa_flags & IFF_RUNNING))
-            continue;
-
-        s = getnameinfo(ifa->ifa_addr, sizeof(struct sockaddr_in),
-                      host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-
-        if (s != 0) {
-            std::cerr << "getnameinfo failed: " << gai_strerror(s) << std::endl;
-            continue;
-        }
-
-        ipStr = host;
-        ifaceStr = ifa->ifa_name;
-        foundIp = true;
-
-        // Try to get MAC address for the same interface
-        struct ifreq ifr;
-        int fd = socket(AF_INET, SOCK_DGRAM, 0);
-
-        if (fd >= 0) {
-            strcpy(ifr.ifr_name, ifa->ifa_name);
-            if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0) {
-                unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-                char macBuf[18];
-                snprintf(macBuf, sizeof(macBuf), "%02X:%02X:%02X:%02X:%02X:%02X",
-                    mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-                macStr = macBuf;
-            }
-            close(fd);
+    // First interface that is up and running with an IPv4 address, loopback only as fallback
+    const InterfaceMonitor::Interface* chosen = nullptr;
+    for (const auto& link : *snapshot) {
+        if (!link.isLoopback() && link.isUp() && link.firstAddress(AF_INET)) {
+            chosen = &link;
+            break;
         }
     }
-
-    // If we didn't find any suitable interface, use loopback as fallback
-    if (!foundIp) {
-        for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-            if (ifa->ifa_addr == NULL)
-                continue;
-
-            family = ifa->ifa_addr->sa_family;
-
-            if (family != AF_INET)
-                continue;
-
-            if (strcmp(ifa->ifa_name, "lo") == 0) {
-                s = getnameinfo(ifa->ifa_addr, sizeof(struct sockaddr_in),
-                              host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-
-                if (s != 0) {
-                    std::cerr << "getnameinfo failed: " << gai_strerror(s) << std::endl;
-                    continue;
-                }
-
-                ipStr = host;
-                ifaceStr = "lo";
-
-                // Try to get MAC for loopback too, though it likely won't have one
-                struct ifreq ifr;
-                int fd = socket(AF_INET, SOCK_DGRAM, 0);
-
-                if (fd >= 0) {
-                    strcpy(ifr.ifr_name, ifa->ifa_name);
-                    if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0) {
-                        unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-                        char macBuf[18];
-                        snprintf(macBuf, sizeof(macBuf), "%02X:%02X:%02X:%02X:%02X:%02X",
-                                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-                        macStr = macBuf;
-                    }
-                    close(fd);
-                }
-
+    if (!chosen) {
+        for (const auto& link : *snapshot) {
+            if (link.isLoopback() && link.firstAddress(AF_INET)) {
+                chosen = &link;
                 break;
             }
         }
     }
+    if (!chosen) {
+        return;
+    }
 
-    freeifaddrs(ifaddr);
+    ipStr = chosen->firstAddress(AF_INET)->address;
+    ifaceStr = chosen->name;
+    if (!chosen->hardwareAddress.empty()) {
+        macStr = chosen->formatHardwareAddress(":");
+    }
 }
@@ -3,6 +3,7 @@
 #include "DeviceInterfaces.h"
 #include "Config.h"
 #include "Logger.h"
+#include "TraceRecorder.h"
 #include <iostream>
 #include <unistd.h>
 #include <linux/input.h>
@@ -10,6 +11,9 @@
 std::atomic<bool> g_signalReceived(false);
 void ScreenModule::run()
 {
+    const std::string moduleId = getModuleId();
+    TRACE_SCOPE("module", "run", moduleId);
+
     // Set running flag
     m_running = true;
     
@@ -24,15 +28,17 @@ void ScreenModule::run()
     }
     
     while (m_running) {
+        TRACE_SCOPE("module", "iteration", moduleId);
+
         // Check for global signal flag
         if (g_signalReceived.load()) {
-            Logger::debug("Signal detected in screen module: " + getModuleId());
+            LOG_DEBUG("Signal detected in screen module: " + moduleId);
             break;
         }
 
         // Check for device disconnection
         if (m_display->isDisconnected()) {
-            std::cout << "Device disconnected during module execution" << std::endl;
+            Logger::info("Device disconnected during module execution");
             break;
         }
         
@@ -40,7 +46,7 @@ void ScreenModule::run()
         if (m_display->isPowerSaveEnabled()) {
             m_display->checkPowerSaveTimeout();
             if (!m_display->isPoweredOn() || m_display->isPowerSaveActivated()) {
-                std::cout << "Power save detected - exiting module" << std::endl;
+                Logger::info("Power save detected - exiting module");
                 break;
             }
         }
@@ -71,7 +77,7 @@ bool ScreenModule::handleInput()
     // This is a default implementation that subclasses should override
     // Check if input device is still valid
     if (!m_input || !m_input->isOpen()) {
-        std::cerr << "Input device is invalid or closed in ScreenModule::handleInput" << std::endl;
+        Logger::error("Input device is invalid or closed in ScreenModule::handleInput");
         return false; // Exit the module
     }
     
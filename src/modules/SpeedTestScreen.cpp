@@ -3,6 +3,8 @@
 #include "DeviceInterfaces.h"
 #include "Config.h"
 #include "Logger.h"
+#include "Subprocess.h"
+#include "StreamParser.h"
 #include "ModuleDependency.h"
 #include <iostream>
 #include <fstream>
@@ -67,21 +69,21 @@ bool SpeedTestScreen::checkConfiguration() {
     
     if (!url.empty()) {
         m_downloadUrl = url;
-        Logger::debug("SpeedTestScreen: Using configured download URL from JSON: " + m_downloadUrl);
+        LOG_DEBUG("SpeedTestScreen: Using configured download URL from JSON: " + m_downloadUrl);
     } else {
-        Logger::warning("SpeedTestScreen: No download_url in JSON config, using default: " + defaultUrl);
+        LOG_WARNING("SpeedTestScreen: No download_url in JSON config, using default: " + defaultUrl);
         m_downloadUrl = defaultUrl;
     }
     
     // Check for upload script configuration
     m_uploadScript = dependencies.getDependencyPath("speedtest", "upload_script");
     if (!m_uploadScript.empty()) {
-        Logger::debug("SpeedTestScreen: Upload script configured: " + m_uploadScript);
+        LOG_DEBUG("SpeedTestScreen: Upload script configured: " + m_uploadScript);
         if (access(m_uploadScript.c_str(), X_OK) == 0) {
             m_uploadEnabled = true;
-            Logger::debug("SpeedTestScreen: Upload testing enabled");
+            LOG_DEBUG("SpeedTestScreen: Upload testing enabled");
         } else {
-            Logger::warning("SpeedTestScreen: Upload script not executable: " + m_uploadScript);
+            LOG_WARNING("SpeedTestScreen: Upload script not executable: " + m_uploadScript);
             m_uploadEnabled = false;
         }
     }
@@ -90,7 +92,7 @@ bool SpeedTestScreen::checkConfiguration() {
 }
 
 void SpeedTestScreen::enter() {
-    Logger::debug("SpeedTestScreen: Entered");
+    LOG_DEBUG("SpeedTestScreen: Entered");
     m_running = true;
     
     // Reset state
@@ -155,6 +157,11 @@ void SpeedTestScreen::update() {
         m_display->drawText(0, 20, "                ");
         m_display->drawText(0, 20, statusText);
         usleep(Config::DISPLAY_CMD_DELAY);
+
+        // Interim upload rates come from the test thread
+        if (m_uploadInProgress) {
+            m_statusChanged = true;
+        }
     }
     
     // Update progress bar every 100ms during tests
@@ -202,7 +209,7 @@ void SpeedTestScreen::update() {
 }
 
 void SpeedTestScreen::exit() {
-    Logger::debug("SpeedTestScreen: Exiting");
+    LOG_DEBUG("SpeedTestScreen: Exiting");
     
     // Cancel any ongoing test
     m_downloadInProgress = false;
@@ -233,19 +240,19 @@ bool SpeedTestScreen::handleInput() {
                 // Button press
                 buttonPressed = true;
                 m_display->updateActivityTimestamp();
-                Logger::debug("SpeedTestScreen: Button pressed");
+                LOG_DEBUG("SpeedTestScreen: Button pressed");
             }
         );
         
         if (buttonPressed) {
             if (m_testCompleted || (!m_downloadInProgress && !m_uploadInProgress)) {
                 // If test is complete or not running, exit on button press
-                Logger::debug("SpeedTestScreen: Test completed, exiting on button press");
+                LOG_DEBUG("SpeedTestScreen: Test completed, exiting on button press");
                 m_shouldExit = true;
             }
             else {
                 // If test is in progress, cancel it
-                Logger::debug("SpeedTestScreen: Test in progress, canceling");
+                LOG_DEBUG("SpeedTestScreen: Test in progress, canceling");
                 m_downloadInProgress = false;
                 m_uploadInProgress = false;
                 m_testCompleted = true;
@@ -289,7 +296,13 @@ void SpeedTestScreen::updateStatusLine() {
     if (m_downloadInProgress) {
         statusText = "Testing download...";
     } else if (m_uploadInProgress) {
-        statusText = "Testing upload...";
+        if (m_uploadSpeed > 0) {
+            char buffer[24];
+            snprintf(buffer, sizeof(buffer), "Up: %.1f Mbps", m_uploadSpeed.load());
+            statusText = buffer;
+        } else {
+            statusText = "Testing upload...";
+        }
     } else if (m_testCompleted) {
         if (m_testResult == 0) {
             statusText = "Test completed";
@@ -318,7 +331,7 @@ void SpeedTestScreen::startDownloadTest() {
         return;  // Test already in progress
     }
     
-    Logger::debug("SpeedTestScreen: Starting download test to " + m_downloadUrl);
+    LOG_DEBUG("SpeedTestScreen: Starting download test to " + m_downloadUrl);
     
     // Reset state
     m_testCompleted = false;
@@ -398,11 +411,11 @@ void SpeedTestScreen::startDownloadTest() {
             curl_slist_free_all(headers);
             
             // Log more details about the download
-            Logger::debug("SpeedTestScreen: HTTP Response Code: " + std::to_string(httpCode));
-            Logger::debug("SpeedTestScreen: Content length: " + std::to_string(contentLength) + " bytes");
-            Logger::debug("SpeedTestScreen: CURL reported speed: " + std::to_string(speedDownload) + " bytes/sec");
-            Logger::debug("SpeedTestScreen: Actual downloaded: " + std::to_string(downloadedBytes) + " bytes");
-            Logger::debug("SpeedTestScreen: Download duration: " + std::to_string(duration.count()) + " ms");
+            LOG_DEBUG("SpeedTestScreen: HTTP Response Code: " + std::to_string(httpCode));
+            LOG_DEBUG("SpeedTestScreen: Content length: " + std::to_string(contentLength) + " bytes");
+            LOG_DEBUGF("SpeedTestScreen: CURL reported speed: %f bytes/sec", static_cast<double>(speedDownload));
+            LOG_DEBUG("SpeedTestScreen: Actual downloaded: " + std::to_string(downloadedBytes) + " bytes");
+            LOG_DEBUG("SpeedTestScreen: Download duration: " + std::to_string(duration.count()) + " ms");
             
             // Clean up
             curl_easy_cleanup(curl);
@@ -412,13 +425,13 @@ void SpeedTestScreen::startDownloadTest() {
             if (res == CURLE_OK && downloadedBytes > 100000 && (httpCode >= 200 && httpCode < 300)) {
                 // Calculate speed in Mbps
                 m_downloadSpeed = calculateSpeed(downloadedBytes, duration);
-                Logger::debug("SpeedTestScreen: Download completed successfully - " + 
+                LOG_DEBUG("SpeedTestScreen: Download completed successfully - " + 
                              std::to_string(downloadedBytes) + " bytes in " + 
                              std::to_string(duration.count()) + "ms = " + 
                              std::to_string(m_downloadSpeed) + " Mbps");
                 m_testResult = 0; // Success
             } else {
-                Logger::error("SpeedTestScreen: Download failed or too small - " + 
+                LOG_ERROR("SpeedTestScreen: Download failed or too small - " + 
                              std::string(curl_easy_strerror(res)) +
                              " (HTTP " + std::to_string(httpCode) + ")");
                 m_testResult = 1; // Failure
@@ -441,12 +454,13 @@ void SpeedTestScreen::startUploadTest() {
         return;  // Upload not enabled or test already in progress
     }
     
-    Logger::debug("SpeedTestScreen: Starting upload test using script: " + m_uploadScript);
+    LOG_DEBUG("SpeedTestScreen: Starting upload test using script: " + m_uploadScript);
     
     // Reset state for upload test
     m_testCompleted = false;
     m_testResult = -1;
     m_progress = 0;
+    m_uploadSpeed = 0.0;
     m_statusChanged = true;
     m_uploadInProgress = true;
     
@@ -455,43 +469,47 @@ void SpeedTestScreen::startUploadTest() {
     
     // Start test in separate thread
     m_testThread = std::thread([this]() {
-        // Create a temporary file to capture the script output
-        std::string tempFile = "/tmp/micropanel_upload_result.txt";
-        
-        // Execute the upload script
-        std::string command = m_uploadScript + " > " + tempFile + " 2>&1";
-        int result = system(command.c_str());
+        // The upload speed is on the first line of the script output. Lines of the form
+        // "interim <Mbps>" may come before it and are shown while the upload runs.
+        std::string line;
+        bool haveResult = false;
+        LineStreamParser lines([this, &line, &haveResult](const std::string& text) {
+            if (text.compare(0, 8, "interim ") == 0) {
+                m_uploadSpeed = strtod(text.c_str() + 8, nullptr);
+            } else if (!haveResult) {
+                line = text;
+                haveResult = true;
+            }
+        });
+
+        // Execute the upload script (a command line from the config), parsing its output as it comes
+        Subprocess::Options options;
+        options.mergeStderr = true;
+        options.traceName = "upload-test";
+        options.outputHandler = [&lines](const char* data, size_t size) {
+            lines.feed(data, size);
+        };
+        Subprocess::Result result = Subprocess::runShell(m_uploadScript, options);
+        lines.finish();
         
-        if (result == 0) {
-            // Try to read the upload speed from the script output
-            std::ifstream resultFile(tempFile);
-            if (resultFile.is_open()) {
-                std::string line;
-                if (std::getline(resultFile, line)) {
-                    try {
-                        m_uploadSpeed = std::stod(line);
-                        Logger::debug("SpeedTestScreen: Upload completed - " + 
-                                    std::to_string(m_uploadSpeed) + " Mbps");
-                        m_testResult = 0;
-                    } catch (...) {
-                        Logger::error("SpeedTestScreen: Failed to parse upload speed");
-                        m_testResult = 1;
-                    }
-                }
-                resultFile.close();
-            } else {
-                Logger::error("SpeedTestScreen: Failed to read upload result file");
+        if (result.exitCode == 0) {
+            try {
+                m_uploadSpeed = std::stod(line);
+                LOG_DEBUG("SpeedTestScreen: Upload completed - " + 
+                            std::to_string(m_uploadSpeed) + " Mbps");
+                m_testResult = 0;
+            } catch (...) {
+                Logger::error("SpeedTestScreen: Failed to parse upload speed");
+                m_uploadSpeed = 0.0;
                 m_testResult = 1;
             }
         } else {
-            Logger::error("SpeedTestScreen: Upload script failed with error code: " + 
-                         std::to_string(result));
+            LOG_ERROR("SpeedTestScreen: Upload script failed with error code: " + 
+                         std::to_string(result.exitCode));
+            m_uploadSpeed = 0.0;
             m_testResult = 1;
         }
         
-        // Clean up the temporary file
-        unlink(tempFile.c_str());
-        
         // Mark test as completed
         m_testCompleted = true;
     });
@@ -0,0 +1,123 @@
+#include "ScreenModules.h"
+#include "MenuSystem.h"
+#include "DeviceInterfaces.h"
+#include "Config.h"
+#include "PersistentStorage.h"
+#include <unistd.h>
+#include <cstdio>
+#include <iterator>
+
+StorageStatsScreen::StorageStatsScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
+    : ScreenModule(display, input)
+{
+}
+
+void StorageStatsScreen::enter()
+{
+    m_display->clear();
+    usleep(Config::DISPLAY_CMD_DELAY * 3);
+
+    // Draw title
+    m_display->drawText(0, 0, " Storage Writes");
+    usleep(Config::DISPLAY_CMD_DELAY);
+
+    // Draw separator
+    m_display->drawText(0, 8, "----------------");
+    usleep(Config::DISPLAY_CMD_DELAY);
+
+    m_page = 0;
+    m_lastUpdate = {0, 0};
+    update();
+}
+
+void StorageStatsScreen::update()
+{
+    // Counters only move on saves, refresh at the stats rate
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    if (now.tv_sec - m_lastUpdate.tv_sec >= Config::STAT_UPDATE_SEC || m_lastUpdate.tv_sec == 0) {
+        drawPage();
+        m_lastUpdate = now;
+    }
+}
+
+void StorageStatsScreen::exit()
+{
+    // Nothing special to clean up
+}
+
+bool StorageStatsScreen::handleInput()
+{
+    if (m_input->waitForEvents(100) > 0) {
+        bool buttonPressed = false;
+
+        m_input->processEvents(
+            [this](int direction) {
+                // Rotation pages through the counters
+                m_page += (direction > 0) ? 1 : -1;
+                drawPage();
+            },
+            [&]() {
+                // Button press exits
+                buttonPressed = true;
+            }
+        );
+
+        if (buttonPressed) {
+            m_display->updateActivityTimestamp();
+            return false; // Exit module
+        }
+    }
+
+    return true; // Continue running
+}
+
+void StorageStatsScreen::drawPage()
+{
+    PersistentStorage::IoStats stats = PersistentStorage::getInstance().getIoStats();
+
+    // Page 0 is this run, page 1 all runs, then one page per module (all runs)
+    int pageCount = 2 + static_cast<int>(stats.lifetimeModules.size());
+    m_page = ((m_page % pageCount) + pageCount) % pageCount;
+
+    std::string title;
+    PersistentStorage::IoCounters counters;
+    if (m_page == 0) {
+        title = "This run";
+        counters = stats.session;
+    } else if (m_page == 1) {
+        title = "All " + std::to_string(stats.runs) + " runs";
+        counters = stats.lifetime;
+    } else {
+        auto it = stats.lifetimeModules.begin();
+        std::advance(it, m_page - 2);
+        title = it->first;
+        counters = it->second;
+    }
+
+    char line[32];
+    m_display->drawText(0, 16, "                ");
+    m_display->drawText(0, 16, title.substr(0, 16));
+
+    snprintf(line, sizeof(line), "Saves  %-9llu", static_cast<unsigned long long>(counters.saves));
+    m_display->drawText(0, 26, line);
+    snprintf(line, sizeof(line), "Bytes  %-9s", formatBytes(counters.bytes).c_str());
+    m_display->drawText(0, 35, line);
+    snprintf(line, sizeof(line), "Fsync  %-9llu", static_cast<unsigned long long>(counters.fsyncs));
+    m_display->drawText(0, 44, line);
+    snprintf(line, sizeof(line), "Rename %-9llu", static_cast<unsigned long long>(counters.renames));
+    m_display->drawText(0, 53, line);
+}
+
+std::string StorageStatsScreen::formatBytes(uint64_t bytes)
+{
+    char text[16];
+    if (bytes < 1024) {
+        snprintf(text, sizeof(text), "%lluB", static_cast<unsigned long long>(bytes));
+    } else if (bytes < 1024 * 1024) {
+        snprintf(text, sizeof(text), "%.1fK", bytes / 1024.0);
+    } else {
+        snprintf(text, sizeof(text), "%.1fM", bytes / (1024.0 * 1024.0));
+    }
+    return text;
+}
@@ -0,0 +1,325 @@
+#include "ScreenModules.h"
+#include "MenuSystem.h"
+#include "DeviceInterfaces.h"
+#include "ModuleDependency.h"
+#include "IPSelector.h"
+#include "Logger.h"
+#include "Config.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+
+namespace {
+
+// Result rows between the separator and the status line
+const int s_listTop = 16;
+const int s_listRows = 5;
+
+} // namespace
+
+SubnetSweepScreen::SubnetSweepScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
+    : ScreenModule(display, input)
+{
+    // Redraw the menu while the network is being edited
+    auto redrawCallback = [this]() {
+        renderMenu(false);
+    };
+
+    m_ipSelector = std::make_unique<IPSelector>(localNetwork(), 16, nullptr, redrawCallback);
+}
+
+void SubnetSweepScreen::enter() {
+    LOG_DEBUG("SubnetSweepScreen: Entered");
+
+    m_state = SubnetSweepMenuState::MENU_STATE_RANGE;
+    m_shouldExit = false;
+    m_showResults = false;
+    m_lastStatusText.clear();
+
+    // Optional TCP ports, e.g. "22,80,443", find hosts that drop ICMP
+    m_tcpPorts.clear();
+    std::string ports = ModuleDependency::getInstance().getDependencyPath("sweep", "tcp_ports");
+    std::stringstream portList(ports);
+    std::string port;
+    while (std::getline(portList, port, ',')) {
+        int value = atoi(port.c_str());
+        if (value > 0 && value <= 65535) {
+            m_tcpPorts.push_back(value);
+        }
+    }
+
+    // Start from the local network again, it may have changed since the last visit
+    m_ipSelector->setIp(localNetwork());
+    m_ipSelector->reset();
+
+    renderMenu(true);
+}
+
+void SubnetSweepScreen::update() {
+    if (!m_sweeper.isRunning()) {
+        return;
+    }
+
+    // Found hosts arrive through the handler while the sweep runs
+    bool running = m_sweeper.poll(Config::SWEEP_SLICE_MS);
+
+    if (m_showResults) {
+        if (m_listChanged) {
+            renderResults(false);
+            m_listChanged = false;
+        }
+        // Progress only needs a few refreshes a second
+        auto now = std::chrono::steady_clock::now();
+        if (!running || now - m_statusDrawnAt >= std::chrono::milliseconds(250)) {
+            updateStatusLine();
+            m_statusDrawnAt = now;
+        }
+    }
+}
+
+void SubnetSweepScreen::exit() {
+    LOG_DEBUG("SubnetSweepScreen: Exiting");
+    m_sweeper.stop();
+}
+
+bool SubnetSweepScreen::handleInput() {
+    // A running sweep gets most of the loop, input is checked in between
+    int waitMs = m_sweeper.isRunning() ? Config::SWEEP_INPUT_WAIT_MS : 100;
+    if (m_input->waitForEvents(waitMs) > 0) {
+        bool buttonPressed = false;
+        int rotationDirection = 0;
+
+        m_input->processEvents(
+            [this, &rotationDirection](int direction) {
+                rotationDirection = direction;
+                m_display->updateActivityTimestamp();
+            },
+            [this, &buttonPressed]() {
+                buttonPressed = true;
+                m_display->updateActivityTimestamp();
+            }
+        );
+
+        if (m_showResults) {
+            if (buttonPressed) {
+                // Back to the menu, abandoning a sweep still in progress
+                m_sweeper.stop();
+                m_showResults = false;
+                renderMenu(true);
+            } else if (rotationDirection != 0) {
+                int maxScroll = std::max(0, static_cast<int>(m_hosts.size()) - s_listRows);
+                int scroll = std::min(std::max(m_scroll + (rotationDirection > 0 ? 1 : -1), 0), maxScroll);
+                if (scroll != m_scroll) {
+                    m_scroll = scroll;
+                    renderResults(false);
+                }
+            }
+            return true;
+        }
+
+        bool redrawNeeded = false;
+        SubnetSweepMenuState previousState = m_state;
+
+        if (buttonPressed) {
+            switch (m_state) {
+                case SubnetSweepMenuState::MENU_STATE_RANGE:
+                    if (m_ipSelector->handleButton()) {
+                        redrawNeeded = true;
+                    }
+                    break;
+
+                case SubnetSweepMenuState::MENU_STATE_SWEEP:
+                    startSweep();
+                    return true;
+
+                case SubnetSweepMenuState::MENU_STATE_EXIT:
+                    m_shouldExit = true;
+                    break;
+            }
+        }
+
+        if (rotationDirection != 0) {
+            bool handled = false;
+            if (m_state == SubnetSweepMenuState::MENU_STATE_RANGE) {
+                handled = m_ipSelector->handleRotation(rotationDirection);
+            }
+
+            if (!handled) {
+                // Three entries, wrapping around
+                int index = static_cast<int>(m_state) + (rotationDirection > 0 ? 1 : 2);
+                m_state = static_cast<SubnetSweepMenuState>(index % 3);
+                redrawNeeded = true;
+            }
+        }
+
+        if (redrawNeeded || previousState != m_state) {
+            renderMenu(false);
+        }
+    }
+
+    return !m_shouldExit;
+}
+
+void SubnetSweepScreen::startSweep() {
+    struct sockaddr_in network;
+    if (!IcmpSocket::parseAddress(m_ipSelector->getIp(), network)) {
+        LOG_WARNING("SubnetSweepScreen: invalid network " + m_ipSelector->getIp());
+        return;
+    }
+
+    // The whole /24, without its network and broadcast addresses
+    uint32_t base = ntohl(network.sin_addr.s_addr) & 0xffffff00;
+
+    m_hosts.clear();
+    m_scroll = 0;
+    m_listChanged = false;
+    m_showResults = true;
+    m_lastStatusText.clear();
+
+    HostSweeper::Options options;
+    options.tcpPorts = m_tcpPorts;
+    options.hostHandler = [this](const HostSweeper::Host& host) {
+        FoundHost found{ntohl(host.address.s_addr), host.rttUs, host.port};
+        auto it = std::lower_bound(m_hosts.begin(), m_hosts.end(), found,
+                                   [](const FoundHost& a, const FoundHost& b) { return a.address < b.address; });
+        m_hosts.insert(it, found);
+        m_listChanged = true;
+    };
+    if (!m_sweeper.start(base + 1, base + 254, options)) {
+        Logger::warning("SubnetSweepScreen: sweep could not be started");
+    }
+
+    renderResults(true);
+}
+
+void SubnetSweepScreen::renderMenu(bool fullRedraw) {
+    if (fullRedraw) {
+        m_display->clear();
+        usleep(Config::DISPLAY_CMD_DELAY * 3);
+
+        m_display->drawText(0, 0, "  Subnet Sweep");
+        usleep(Config::DISPLAY_CMD_DELAY);
+
+        m_display->drawText(0, 8, Config::MENU_SEPARATOR);
+        usleep(Config::DISPLAY_CMD_DELAY);
+    }
+
+    auto drawFunc = [this](int x, int y, const std::string& text) {
+        m_display->drawText(x, y, text);
+        usleep(Config::DISPLAY_CMD_DELAY);
+    };
+    m_ipSelector->draw(m_state == SubnetSweepMenuState::MENU_STATE_RANGE, drawFunc);
+
+    std::string sweepLine = (m_state == SubnetSweepMenuState::MENU_STATE_SWEEP ? ">Sweep /24" : " Sweep /24");
+    m_display->drawText(0, 32, sweepLine);
+    usleep(Config::DISPLAY_CMD_DELAY);
+
+    std::string exitLine = (m_state == SubnetSweepMenuState::MENU_STATE_EXIT ? ">Exit" : " Exit");
+    m_display->drawText(0, 40, exitLine);
+    usleep(Config::DISPLAY_CMD_DELAY);
+}
+
+void SubnetSweepScreen::renderResults(bool fullRedraw) {
+    if (fullRedraw) {
+        m_display->clear();
+        usleep(Config::DISPLAY_CMD_DELAY * 3);
+
+        // Title is the swept network, rows only carry the last octet
+        std::string network = m_ipSelector->getIp();
+        struct sockaddr_in address;
+        if (IcmpSocket::parseAddress(network, address)) {
+            address.sin_addr.s_addr &= htonl(0xffffff00);
+            network = std::string(inet_ntoa(address.sin_addr)) + "/24";
+        }
+        m_display->drawText(0, 0, network.substr(0, 16));
+        usleep(Config::DISPLAY_CMD_DELAY);
+
+        m_display->drawText(0, 8, Config::MENU_SEPARATOR);
+        usleep(Config::DISPLAY_CMD_DELAY);
+    }
+
+    char line[24];
+    for (int row = 0; row < s_listRows; row++) {
+        size_t index = static_cast<size_t>(m_scroll + row);
+        snprintf(line, sizeof(line), "%-16s", index < m_hosts.size() ? formatHost(m_hosts[index]).c_str() : "");
+        m_display->drawText(0, s_listTop + row * 8, line);
+        usleep(Config::DISPLAY_CMD_DELAY);
+    }
+
+    updateStatusLine();
+}
+
+void SubnetSweepScreen::updateStatusLine() {
+    if (!m_showResults) {
+        return;
+    }
+
+    char status[24];
+    if (m_sweeper.isRunning()) {
+        snprintf(status, sizeof(status), "%d up %d/%d", m_sweeper.getFound(), m_sweeper.getDone(),
+                 m_sweeper.getTotal());
+    } else if (m_sweeper.getTotal() > 0 && m_sweeper.getDone() == m_sweeper.getTotal()) {
+        snprintf(status, sizeof(status), "%d hosts up", m_sweeper.getFound());
+    } else {
+        snprintf(status, sizeof(status), "Sweep failed");
+    }
+
+    if (status != m_lastStatusText) {
+        m_display->drawText(0, 56, "                ");
+        m_display->drawText(0, 56, status);
+        usleep(Config::DISPLAY_CMD_DELAY);
+        m_lastStatusText = status;
+    }
+}
+
+std::string SubnetSweepScreen::formatHost(const FoundHost& host) {
+    char rtt[24];
+    double ms = host.rttUs / 1000.0;
+    if (ms < 10.0) {
+        snprintf(rtt, sizeof(rtt), "%.2fms", ms);
+    } else if (ms < 100.0) {
+        snprintf(rtt, sizeof(rtt), "%.1fms", ms);
+    } else {
+        snprintf(rtt, sizeof(rtt), "%ldms", host.rttUs / 1000);
+    }
+
+    // ".23  0.42ms" for an echo reply, ".23  1.10ms:443" for a connect
+    char line[32];
+    snprintf(line, sizeof(line), ".%-3u %-6s", host.address & 0xff, rtt);
+    std::string text = line;
+    if (host.port > 0) {
+        text += ":" + std::to_string(host.port);
+    }
+    return text;
+}
+
+std::string SubnetSweepScreen::localNetwork() {
+    std::string network = "192.168.001.000";
+
+    struct ifaddrs* ifaddr;
+    if (getifaddrs(&ifaddr) == -1) {
+        return network;
+    }
+
+    // First IPv4 address of an interface that is up and not loopback
+    for (struct ifaddrs* ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET ||
+            !(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK)) {
+            continue;
+        }
+        uint32_t address = ntohl(reinterpret_cast<struct sockaddr_in*>(ifa->ifa_addr)->sin_addr.s_addr);
+        char text[16];
+        snprintf(text, sizeof(text), "%03u.%03u.%03u.000", address >> 24, (address >> 16) & 0xff,
+                 (address >> 8) & 0xff);
+        network = text;
+        break;
+    }
+
+    freeifaddrs(ifaddr);
+    return network;
+}
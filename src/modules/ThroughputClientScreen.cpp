@@ -5,6 +5,7 @@
 #include "Logger.h"
 #include "Config.h"
 #include "ModuleDependency.h"
+#include "MulticastDns.h"
 #include <iostream>
 #include <unistd.h>
 #include <fcntl.h>
@@ -14,14 +15,23 @@
 #include <thread>
 #include <atomic>
 #include <csignal>
-#include <sys/wait.h>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
-#include <regex>
-#include <set>
 #include <iomanip>
+#include <cstdio>
+
+namespace {
+
+// Ink density ramp of the interval graph, as the traffic monitor's sparklines
+const char s_graphLevels[] = " .:-=+*#";
+const int s_graphLevelCount = sizeof(s_graphLevels) - 1;
+
+// Intervals the graph spans, one character each
+const size_t s_graphColumns = 16;
+
+} // namespace
 
 ThroughputClientScreen::ThroughputClientScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
     : ScreenModule(display, input),
@@ -37,14 +47,12 @@ ThroughputClientScreen::ThroughputClientScreen(std::shared_ptr<Display> display,
       m_bandwidth(0),
       m_parallel(1),
       m_testInProgress(false),
-      m_testPid(-1),
       m_testResult(-1),
       m_bandwidth_result(0.0),
       m_jitter_result(0.0),
       m_loss_result(0.0),
       m_retransmits_result(0),
-      m_discoveryInProgress(false),
-      m_discoveryPid(-1)
+      m_discoveryInProgress(false)
 {
     // Initialize menu options
     m_protocolOptions = {"TCP", "UDP"};
@@ -58,7 +66,7 @@ ThroughputClientScreen::ThroughputClientScreen(std::shared_ptr<Display> display,
     // Create IP Selector with callback
     auto callback = [this](const std::string& ip) {
         m_serverIp = ip;
-        Logger::debug("ThroughputClientScreen: Server IP changed to: " + ip);
+        LOG_DEBUG("ThroughputClientScreen: Server IP changed to: " + ip);
     };
 
     // Create redraw callback to update menu
@@ -72,24 +80,16 @@ ThroughputClientScreen::ThroughputClientScreen(std::shared_ptr<Display> display,
 }
 
 ThroughputClientScreen::~ThroughputClientScreen() {
-    // Terminate any ongoing processes
-    if (m_testInProgress && m_testPid > 0) {
-        kill(m_testPid, SIGTERM);
-        waitpid(m_testPid, nullptr, 0);
-    }
-
-    if (m_discoveryInProgress && m_discoveryPid > 0) {
-        kill(m_discoveryPid, SIGTERM);
-        waitpid(m_discoveryPid, nullptr, 0);
+    // Stop any ongoing test or discovery
+    m_engine.stop();
+    if (m_discoveryInProgress) {
+        MulticastDns::getInstance().stopBrowsing();
     }
 }
 
 void ThroughputClientScreen::refreshSettings() {
     auto& dependencies = ModuleDependency::getInstance();
 
-    // Try to get iperf3 path
-    std::string iperf3Path = dependencies.getDependencyPath("throughputclient", "iperf3_path");
-
     // Try to get port
     std::string portStr = dependencies.getDependencyPath("throughputclient", "default_port");
     if (!portStr.empty()) {
@@ -97,7 +97,7 @@ void ThroughputClientScreen::refreshSettings() {
             int port = std::stoi(portStr);
             if (port > 0 && port < 65536) {
                 m_serverPort = port;
-                Logger::debug("ThroughputClientScreen: Using configured port: " + std::to_string(m_serverPort));
+                LOG_DEBUG("ThroughputClientScreen: Using configured port: " + std::to_string(m_serverPort));
             }
         } catch (...) {
             Logger::warning("ThroughputClientScreen: Invalid port value in config, using default 5201");
@@ -110,7 +110,7 @@ void ThroughputClientScreen::refreshSettings() {
         std::transform(protocol.begin(), protocol.end(), protocol.begin(), ::toupper);
         if (protocol == "TCP" || protocol == "UDP") {
             m_protocol = protocol;
-            Logger::debug("ThroughputClientScreen: Using configured protocol: " + m_protocol);
+            LOG_DEBUG("ThroughputClientScreen: Using configured protocol: " + m_protocol);
         }
     }
 
@@ -121,7 +121,7 @@ void ThroughputClientScreen::refreshSettings() {
             int duration = std::stoi(durationStr);
             if (duration > 0) {
                 m_duration = duration;
-                Logger::debug("ThroughputClientScreen: Using configured duration: " + std::to_string(m_duration));
+                LOG_DEBUG("ThroughputClientScreen: Using configured duration: " + std::to_string(m_duration));
             }
         } catch (...) {
             Logger::warning("ThroughputClientScreen: Invalid duration value in config, using default 10s");
@@ -135,7 +135,7 @@ void ThroughputClientScreen::refreshSettings() {
             int bandwidth = std::stoi(bandwidthStr);
             if (bandwidth >= 0) {
                 m_bandwidth = bandwidth;
-                Logger::debug("ThroughputClientScreen: Using configured bandwidth: " + std::to_string(m_bandwidth) + " Mbps");
+                LOG_DEBUG("ThroughputClientScreen: Using configured bandwidth: " + std::to_string(m_bandwidth) + " Mbps");
             }
         } catch (...) {
             Logger::warning("ThroughputClientScreen: Invalid bandwidth value in config, using default 0 (Auto)");
@@ -149,7 +149,7 @@ void ThroughputClientScreen::refreshSettings() {
             int parallel = std::stoi(parallelStr);
             if (parallel > 0) {
                 m_parallel = parallel;
-                Logger::debug("ThroughputClientScreen: Using configured parallel: " + std::to_string(m_parallel));
+                LOG_DEBUG("ThroughputClientScreen: Using configured parallel: " + std::to_string(m_parallel));
             }
         } catch (...) {
             Logger::warning("ThroughputClientScreen: Invalid parallel value in config, using default 1");
@@ -167,15 +167,19 @@ void ThroughputClientScreen::refreshSettings() {
             if (m_ipSelector) {
                 m_ipSelector->setIp(m_serverIp);
             }
-            Logger::debug("ThroughputClientScreen: Using configured server IP: " + m_serverIp);
+            LOG_DEBUG("ThroughputClientScreen: Using configured server IP: " + m_serverIp);
         }
       }
       firstLoad=false;
     }
+
+    // Service type browsed for over mDNS
+    std::string serviceType = dependencies.getDependencyPath("throughputclient", "mdns_service");
+    m_serviceType = serviceType.empty() ? Config::MDNS_IPERF3_SERVICE : serviceType;
 }
 
 void ThroughputClientScreen::enter() {
-    Logger::debug("ThroughputClientScreen: Entered");
+    LOG_DEBUG("ThroughputClientScreen: Entered");
 
     // Reset state
     m_state = ThroughputClientState::MENU_STATE_START;
@@ -183,10 +187,8 @@ void ThroughputClientScreen::enter() {
     m_editingIp = false;
     m_shouldExit = false;
     m_testInProgress = false;
-    m_testPid = -1;
     m_testResult = -1;
     m_discoveryInProgress = false;
-    m_discoveryPid = -1;
     m_statusMessage.clear();
     m_statusChanged = true;
 
@@ -214,26 +216,15 @@ void ThroughputClientScreen::enter() {
 }
 
 void ThroughputClientScreen::exit() {
-    Logger::debug("ThroughputClientScreen: Exiting");
+    LOG_DEBUG("ThroughputClientScreen: Exiting");
 
     // Terminate any ongoing test or discovery
-    if (m_testInProgress && m_testPid > 0) {
-        kill(m_testPid, SIGTERM);
-        waitpid(m_testPid, nullptr, 0);
-        m_testInProgress = false;
-        m_testPid = -1;
-    }
-
-    if (m_discoveryInProgress && m_discoveryPid > 0) {
-        kill(m_discoveryPid, SIGTERM);
-        waitpid(m_discoveryPid, nullptr, 0);
-        m_discoveryInProgress = false;
-        m_discoveryPid = -1;
+    m_engine.stop();
+    m_testInProgress = false;
+    if (m_discoveryInProgress) {
+        MulticastDns::getInstance().stopBrowsing();
     }
-
-    // Clean up temporary files if they exist
-    unlink("/tmp/micropanel_iperf_result.txt");
-    unlink("/tmp/micropanel_avahi_result.txt");
+    m_discoveryInProgress = false;
 
     // Clear display
     m_display->clear();
@@ -242,29 +233,6 @@ void ThroughputClientScreen::exit() {
 
 // Helper methods
 
-std::string ThroughputClientScreen::getIperf3Path() const {
-    auto& dependencies = ModuleDependency::getInstance();
-
-    // First check client-specific iperf3 path, then fall back to server config
-    std::string path = dependencies.getDependencyPath("throughputclient", "iperf3_path");
-    if (path.empty()) {
-        path = dependencies.getDependencyPath("throughputserver", "iperf3_path");
-    }
-    if (path.empty()) {
-        return "/usr/bin/iperf3";
-    }
-    return path;
-}
-
-bool ThroughputClientScreen::isIperf3Available() const {
-    std::string iperf3Path = getIperf3Path();
-    return (access(iperf3Path.c_str(), X_OK) == 0);
-}
-
-bool ThroughputClientScreen::isAvahiAvailable() const {
-    return (system("which avahi-browse > /dev/null 2>&1") == 0);
-}
-
 std::string ThroughputClientScreen::getBandwidthString(int value) const {
 //    if (value <= 0) {
 //        return "Auto";
@@ -822,9 +790,7 @@ void ThroughputClientScreen::renderAutoDiscoverScreen(bool fullRedraw) {
             m_display->drawText(0, 8, "----------------");
             usleep(Config::DISPLAY_CMD_DELAY);
 
-            // Draw scanning message
-            m_display->drawText(0, 16, "Scanning...");
-            usleep(Config::DISPLAY_CMD_DELAY);
+            renderAutoDiscoverScreen(false);
         } else if (!m_discoveredServers.empty()) {
             // Discovery completed and servers found
 
@@ -874,7 +840,21 @@ void ThroughputClientScreen::renderAutoDiscoverScreen(bool fullRedraw) {
             m_display->drawText(0, 46, backText);
             usleep(Config::DISPLAY_CMD_DELAY);
         }
-    } else if (!m_discoveryInProgress) {
+    } else if (m_discoveryInProgress) {
+        // Servers found so far, with the scanning message below the last one
+        int numToShow = std::min(static_cast<int>(m_discoveredServers.size()), 4);
+        int yPos = 16;
+        for (int i = 0; i < numToShow; i++) {
+            // Padded, the line may have held the scanning message
+            std::string serverText = " " + m_discoveredServers[i].first;
+            serverText.resize(16, ' ');
+            m_display->drawText(0, yPos, serverText);
+            usleep(Config::DISPLAY_CMD_DELAY);
+            yPos += 10;
+        }
+        m_display->drawText(0, yPos, "Scanning...");
+        usleep(Config::DISPLAY_CMD_DELAY);
+    } else {
         // Just update selection markers for discovered servers
         if (!m_discoveredServers.empty()) {
             int numToShow = std::min(static_cast<int>(m_discoveredServers.size()), 5);
@@ -909,9 +889,9 @@ void ThroughputClientScreen::updateStatusLine() {
 
     // Show different status based on current state
     if (m_testInProgress) {
-        // Show test progress
+        // Show the latest interval rate once there is one, test progress until then
         static int dots = 0;
-        statusText = "Testing" + std::string(dots, '.');
+        statusText = m_liveBandwidth > 0 ? formatBandwidth(m_liveBandwidth) : "Testing" + std::string(dots, '.');
         dots = (dots + 1) % 4;
     } else if (m_testResult != -1) {
         // Show last test result
@@ -1116,15 +1096,10 @@ bool ThroughputClientScreen::handleInput() {
                         redrawNeeded = true;
                     } else if (m_submenuSelection == 1) {
                         // Auto-discover
-                        if (isAvahiAvailable()) {
-                            m_state = ThroughputClientState::SUBMENU_STATE_AUTO_DISCOVER;
-                            m_submenuSelection = 0;
-                            startDiscovery();
-                            renderAutoDiscoverScreen(true);
-                        } else {
-                            m_statusMessage = "Avahi not available";
-                            m_statusChanged = true;
-                        }
+                        m_state = ThroughputClientState::SUBMENU_STATE_AUTO_DISCOVER;
+                        m_submenuSelection = 0;
+                        startDiscovery();
+                        renderAutoDiscoverScreen(true);
                     } else {
                         // Back option selected
                         m_state = ThroughputClientState::MENU_STATE_SERVER_IP;
@@ -1152,6 +1127,9 @@ bool ThroughputClientScreen::handleInput() {
                             m_submenuSelection = 0;
                             renderServerIPSubmenu(true);
                         }
+                    } else {
+                        // Stop listening early, the servers found so far become selectable
+                        MulticastDns::getInstance().stopBrowsing();
                     }
                     break;
 		case ThroughputClientState::MENU_STATE_RESULTS:
@@ -1159,7 +1137,7 @@ bool ThroughputClientScreen::handleInput() {
 		        // Return to main menu when any button is pressed
 		        m_waitingForButtonPress = false;
 			m_state = ThroughputClientState::MENU_STATE_START;
-		        Logger::debug("ThroughputClientScreen: Button pressed on results screen, returning to main menu");
+		        LOG_DEBUG("ThroughputClientScreen: Button pressed on results screen, returning to main menu");
 			renderMainMenu(true);
 		    }
 		    break;
@@ -1168,15 +1146,11 @@ bool ThroughputClientScreen::handleInput() {
 		    // or allow cancellation with a confirmation prompt
 		    if (buttonPressed && !m_testCancellationPrompt) {
 		        m_testCancellationPrompt = true;
-		        // Show confirmation prompt
-		        m_display->drawText(0, 56, "Cancel test? Press again");
+		        // Show confirmation prompt in place of the elapsed time
+		        drawTestRow(7, "Again to cancel");
 		    } else if (buttonPressed && m_testCancellationPrompt) {
 		        // Cancel the test
-		        if (m_testPid > 0) {
-		            kill(m_testPid, SIGTERM);
-		            waitpid(m_testPid, NULL, 0);
-		            m_testPid = -1;
-		        }
+		        m_engine.stop();
 		        m_testInProgress = false;
 		        m_testCancellationPrompt = false;
 		        m_state = ThroughputClientState::MENU_STATE_START;
@@ -1349,33 +1323,23 @@ void ThroughputClientScreen::startTest() {
     // Normalize the IP address (remove leading zeros)
     std::string normalizedIp = normalizeIp(m_serverIp);
     m_serverIp = normalizedIp;
-    Logger::debug("ThroughputClientScreen: Using normalized IP: " + normalizedIp);
-
-    // In startTest() method, add detailed command logging
-    std::string cmdLine = getIperf3Path() + " -c " + m_serverIp + " -p " + std::to_string(m_serverPort) +
-                    " -t " + std::to_string(m_duration) + " -J -l 9000 -w 1M";
-    if (m_protocol == "UDP") cmdLine += " -u";
-    if (m_bandwidth > 0) cmdLine += " -b " + std::to_string(m_bandwidth) + "m";
-    if (m_parallel > 1) cmdLine += " -P " + std::to_string(m_parallel);
-    if (m_reverseMode) cmdLine += " -R";
-    Logger::debug("ThroughputClientScreen: Executing: " + cmdLine);
+    LOG_DEBUG("ThroughputClientScreen: Using normalized IP: " + normalizedIp);
 
     if (m_testInProgress) return;
 
-    // Check if iperf3 is available
-    if (!isIperf3Available()) {
-        Logger::error("ThroughputClientScreen: iperf3 not found");
-        m_statusMessage = "iperf3 not found";
-        m_statusChanged = true;
-        return;
-    }
-
     // Reset test state
     m_testResult = -1;
     m_bandwidth_result = 0.0;
     m_jitter_result = 0.0;
     m_loss_result = 0.0;
     m_retransmits_result = 0;
+    m_liveBandwidth = 0.0;
+    m_intervalRates.clear();
+    m_lastInterval = ThroughputEngine::Interval();
+    m_liveRetransmits = 0;
+    m_liveLost = 0;
+    m_livePackets = 0;
+    m_testCancellationPrompt = false;
     m_testInProgress = true;
     m_statusChanged = true;
 
@@ -1383,69 +1347,19 @@ void ThroughputClientScreen::startTest() {
     m_state = ThroughputClientState::MENU_STATE_TESTING;
     renderTestingScreen();
 
-    Logger::debug("ThroughputClientScreen: Starting iperf3 test to " + m_serverIp);
-
-    // Fork to run iperf3 client
-    pid_t child_pid = fork();
-    if (child_pid == 0) {
-        // Child process - run iperf3 client
-        // Prepare command arguments
-        std::vector<std::string> args;
-        args.push_back("iperf3");
-        args.push_back("-c");
-        args.push_back(m_serverIp);
-        args.push_back("-p");
-        args.push_back(std::to_string(m_serverPort));
-        args.push_back("-t");
-        args.push_back(std::to_string(m_duration));
-        args.push_back("-J"); // JSON output
-
-	// Add protocol flag if UDP
-        if (m_protocol == "UDP") {
-            args.push_back("-u");
-	    //following args improve udp test, but need kernel buffer increase in /etc/sysctl.conf
-	    args.push_back("-l");
-            args.push_back("9000");
-            args.push_back("-w");
-            args.push_back("1M");
-        }
-        // Add bandwidth flag if not Auto
-        if (m_bandwidth > 0) {
-            args.push_back("-b");
-            args.push_back(std::to_string(m_bandwidth) + "m");
-        }
-        // Add parallel flag if not 1
-        if (m_parallel > 1) {
-            args.push_back("-P");
-            args.push_back(std::to_string(m_parallel));
-        }
-        if (m_reverseMode) {
-            args.push_back("-R");
-        }
-        // Create C-style arguments array
-        std::vector<char*> c_args;
-        for (const auto& arg : args) {
-            c_args.push_back(const_cast<char*>(arg.c_str()));
-        }
-        c_args.push_back(nullptr);
-        // Redirect stdout to temporary file to capture JSON output
-        int outFile = open("/tmp/micropanel_iperf_result.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (outFile != -1) {
-            dup2(outFile, STDOUT_FILENO);
-            close(outFile);
-        }
-        // Execute iperf3 with the appropriate arguments
-        execvp(getIperf3Path().c_str(), c_args.data());
-        // If execvp returns, it failed
-        Logger::error("ThroughputClientScreen: Failed to execute iperf3");
-        std::exit(1);
-    } else if (child_pid > 0) {
-        // Parent process
-        m_testPid = child_pid;
-        Logger::info("ThroughputClientScreen: Started iperf3 client with PID " + std::to_string(child_pid));
+    LOG_DEBUG("ThroughputClientScreen: Starting test to " + m_serverIp);
+
+    // The built-in engine speaks iperf3's protocol, any iperf3 server will do
+    ThroughputEngine::Options options;
+    options.protocol = m_protocol == "UDP" ? ThroughputEngine::Protocol::UDP : ThroughputEngine::Protocol::TCP;
+    options.durationSec = m_duration;
+    options.bitrate = static_cast<uint64_t>(m_bandwidth) * 1000000;    // Per stream, 0 is Auto
+    options.parallel = m_parallel;
+    options.reverse = m_reverseMode;
+    if (m_engine.startClient(m_serverIp, m_serverPort, options)) {
+        LOG_INFO("ThroughputClientScreen: Started " + m_protocol + " test to " +
+                     m_serverIp + ":" + std::to_string(m_serverPort));
     } else {
-        // Fork failed
-        Logger::error("ThroughputClientScreen: Failed to fork for iperf3 client");
         m_testInProgress = false;
         m_statusMessage = "Failed to start test";
         m_statusChanged = true;
@@ -1458,140 +1372,76 @@ void ThroughputClientScreen::startTest() {
 void ThroughputClientScreen::checkTestStatus() {
     if (!m_testInProgress) return;
 
-    // Check if the test process has completed
-    int status;
-    pid_t result = waitpid(m_testPid, &status, WNOHANG);
-
-    if (result == m_testPid) {
-        // Test process has completed
-        m_testInProgress = false;
-        m_testPid = -1;
-
-        // Determine test result
-        if (WIFEXITED(status)) {
-            m_testResult = WEXITSTATUS(status);
-            Logger::debug("ThroughputClientScreen: iperf3 test completed with status " +
-                         std::to_string(m_testResult));
-
-            // Parse results from the temporary file if test succeeded
-            if (m_testResult == 0) {
-                parseTestResults();
-                Logger::info("ThroughputClientScreen: Test results - Bandwidth: " +
-                            std::to_string(m_bandwidth_result) + " Mbps");
-
-                // Switch to results screen - ONLY change state and render
-                m_state = ThroughputClientState::MENU_STATE_RESULTS;
-                m_waitingForButtonPress = true;  // Add this flag to your class
-                showResultsScreen();  // Renamed to better reflect what it does
-                Logger::debug("ThroughputClientScreen: Waiting for button press on results screen");
-
-                // IMPORTANT: Do NOT call renderMainMenu or anything else here
-            } else {
-                Logger::warning("ThroughputClientScreen: iperf3 client exited with error code " +
-                               std::to_string(m_testResult));
-                m_statusMessage = "Test failed";
-                m_statusChanged = true;
-                m_state = ThroughputClientState::MENU_STATE_START;
-                renderMainMenu(true);
-            }
-        } else {
-            m_testResult = 1; // Error
-            Logger::warning("ThroughputClientScreen: iperf3 client terminated abnormally");
-            m_statusMessage = "Test terminated";
-            m_statusChanged = true;
-            m_state = ThroughputClientState::MENU_STATE_START;
-            renderMainMenu(true);
+    // Interval reports arrive while the test runs, the result once it is over
+    std::vector<ThroughputEngine::Interval> intervals;
+    bool running = m_engine.poll(intervals);
+    for (const auto& interval : intervals) {
+        m_intervalRates.push_back(interval.bitsPerSecond / 1000000.0);
+        if (m_intervalRates.size() > s_graphColumns) {
+            m_intervalRates.erase(m_intervalRates.begin());
         }
+        if (interval.retransmits > 0) {
+            m_liveRetransmits += interval.retransmits;
+        }
+        if (interval.lostPackets != -1) {
+            m_liveLost += interval.lostPackets;
+        }
+        m_livePackets += interval.packets;
+        m_lastInterval = interval;
     }
-}
-void ThroughputClientScreen::parseTestResults() {
-    // Read the JSON output file
-    std::ifstream file("/tmp/micropanel_iperf_result.txt");
-    if (!file.is_open()) {
-        Logger::error("ThroughputClientScreen: Failed to open test results file");
+    if (!intervals.empty()) {
+        m_liveBandwidth = m_intervalRates.back();
+        LOG_DEBUG("ThroughputClientScreen: Interval " + std::to_string(m_lastInterval.endSec) +
+                      "s: " + formatBandwidth(m_liveBandwidth));
+        if (m_state == ThroughputClientState::MENU_STATE_TESTING) {
+            drawTestProgress();
+        }
+    }
+    if (running) {
         return;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string output = buffer.str();
-    file.close();
-
-    // Clean up the file
-    unlink("/tmp/micropanel_iperf_result.txt");
-
-    // Parse the JSON structure to extract result data
-    try {
-        // For TCP tests, look for bits_per_second in the end->sum_sent section
-        // Based on the actual JSON structure
-        size_t sumSentPos = output.find("\"sum_sent\":");
-        if (sumSentPos != std::string::npos) {
-            size_t bpsPos = output.find("\"bits_per_second\":", sumSentPos);
-            if (bpsPos != std::string::npos) {
-                size_t valueStart = bpsPos + 18; // Length of "\"bits_per_second\":"
-                size_t valueEnd = output.find(",", valueStart);
-                if (valueEnd != std::string::npos) {
-                    std::string bpsStr = output.substr(valueStart, valueEnd - valueStart);
-                    try {
-                        // Convert from bits/sec to Mbits/sec
-                        double bps = std::stod(bpsStr);
-                        m_bandwidth_result = bps / 1000000.0;
-                        Logger::debug("ThroughputClientScreen: Parsed bandwidth: " +
-                                     std::to_string(m_bandwidth_result) + " Mbps");
-                    } catch (const std::exception& e) {
-                        Logger::error("ThroughputClientScreen: Failed to parse bandwidth: " +
-                                     std::string(e.what()));
-                    }
-                }
-            }
-
-            // Look for retransmits (TCP only)
-            if (m_protocol == "TCP") {
-                size_t retransPos = output.find("\"retransmits\":", sumSentPos);
-                if (retransPos != std::string::npos) {
-                    size_t valueStart = retransPos + 14; // Length of "\"retransmits\":"
-                    size_t valueEnd = output.find(",", valueStart);
-                    if (valueEnd != std::string::npos) {
-                        std::string retransStr = output.substr(valueStart, valueEnd - valueStart);
-                        try {
-                            m_retransmits_result = std::stoi(retransStr);
-                            Logger::debug("ThroughputClientScreen: Parsed retransmits: " +
-                                         std::to_string(m_retransmits_result));
-                        } catch (const std::exception& e) {
-                            Logger::error("ThroughputClientScreen: Failed to parse retransmits: " +
-                                         std::string(e.what()));
-                        }
-                    }
-                }
-            }
-        }
-
-        // For UDP tests, look for jitter and lost packets
-	if (m_protocol == "UDP") {
-		UDPTestResult udpResult = parseUDPTestResults(output);
-		if (udpResult.valid) {
-			// Store the results in class members
-			m_bandwidth_result = udpResult.bandwidth_mbps;
-			m_jitter_result = udpResult.jitter_ms;
-			m_loss_result = udpResult.lost_percent;  // Match the variable used in showResultsAndWait
-
-			// Log the results
-		        Logger::info("ThroughputClientScreen: UDP Test results - "
-				"Bandwidth: " + std::to_string(m_bandwidth_result) + " Mbps, "
-				"Jitter: " + std::to_string(m_jitter_result) + " ms, "
-				"Loss: " + std::to_string(m_loss_result) + "%, "
-				"Lost packets: " + std::to_string(udpResult.lost_packets) + " / " +
-				std::to_string(udpResult.total_packets));
-		} else {
-			Logger::warning("ThroughputClientScreen: Failed to parse UDP test results");
-		}
-	}
+    m_testInProgress = false;
+    std::string error = m_engine.getError();
+    if (error.empty()) {
+        m_testResult = 0;
+        finishTestResults();
+
+        // Switch to results screen - ONLY change state and render
+        m_state = ThroughputClientState::MENU_STATE_RESULTS;
+        m_waitingForButtonPress = true;
+        showResultsScreen();
+        LOG_DEBUG("ThroughputClientScreen: Waiting for button press on results screen");
+    } else {
+        m_testResult = 1;
+        LOG_WARNING("ThroughputClientScreen: Test failed: " + error);
+        m_statusMessage = "Test failed";
+        m_statusChanged = true;
+        m_state = ThroughputClientState::MENU_STATE_START;
+        renderMainMenu(true);
+    }
+}
 
-    } catch (const std::exception& e) {
-        Logger::error("ThroughputClientScreen: Exception parsing results: " + std::string(e.what()));
+void ThroughputClientScreen::finishTestResults() {
+    ThroughputEngine::Result result = m_engine.getResult();
+
+    // What reached the receiving end is the throughput, the sender's rate is only what it offered
+    m_bandwidth_result = result.receivedBitsPerSecond / 1000000.0;
+    if (m_protocol == "UDP") {
+        m_jitter_result = result.jitterMs;
+        m_loss_result = result.lostPercent;
+
+        LOG_INFO("ThroughputClientScreen: UDP Test results - "
+            "Bandwidth: " + std::to_string(m_bandwidth_result) + " Mbps, "
+            "Jitter: " + std::to_string(m_jitter_result) + " ms, "
+            "Loss: " + std::to_string(m_loss_result) + "%, "
+            "Lost packets: " + std::to_string(result.lostPackets) + " / " +
+            std::to_string(result.packets));
+    } else {
+        m_retransmits_result = std::max(result.retransmits, 0);
     }
 
-    Logger::info("ThroughputClientScreen: Test results - Bandwidth: " +
+    LOG_INFO("ThroughputClientScreen: Test results - Bandwidth: " +
                 std::to_string(m_bandwidth_result) + " Mbps" +
                 (m_protocol == "TCP" ? ", Retransmits: " + std::to_string(m_retransmits_result) : ""));
 }
@@ -1599,199 +1449,67 @@ void ThroughputClientScreen::parseTestResults() {
 void ThroughputClientScreen::startDiscovery() {
     if (m_discoveryInProgress) return;
 
-    // Check if avahi is available
-    if (!isAvahiAvailable()) {
-        Logger::error("ThroughputClientScreen: avahi-browse not found");
-        m_statusMessage = "Avahi not available";
-        m_statusChanged = true;
-        return;
-    }
-
     // Reset discovery state
     m_discoveredServers.clear();
     m_discoveredServerNames.clear();
-    m_discoveryInProgress = true;
-    m_statusChanged = true;
 
-    Logger::debug("ThroughputClientScreen: Starting Avahi discovery");
-
-    // Fork to run avahi-browse
-    pid_t child_pid = fork();
-
-    if (child_pid == 0) {
-        // Child process - run avahi-browse
-
-        // Redirect stdout to temporary file to capture output
-        int outFile = open("/tmp/micropanel_avahi_result.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (outFile != -1) {
-            dup2(outFile, STDOUT_FILENO);
-            close(outFile);
-        }
-
-        // Execute avahi-browse to search for iperf3 services
-        // Add -t to terminate after resolving and ensure -p for parsable output
-        execl("/usr/bin/avahi-browse", "avahi-browse", "-p", "-t", "-r", "_iperf3._tcp", NULL);
-
-        // If execl returns, it failed
-        Logger::error("ThroughputClientScreen: Failed to execute avahi-browse");
-        std::exit(1);
-    } else if (child_pid > 0) {
-        // Parent process
-        m_discoveryPid = child_pid;
-        Logger::info("ThroughputClientScreen: Started avahi-browse with PID " + std::to_string(child_pid));
+    // Servers are listed as they answer, until the browse ends or a button press stops it
+    LOG_DEBUG("ThroughputClientScreen: Starting mDNS discovery of " + m_serviceType);
+    if (MulticastDns::getInstance().browse(m_serviceType)) {
+        m_discoveryInProgress = true;
     } else {
-        // Fork failed
-        Logger::error("ThroughputClientScreen: Failed to fork for avahi-browse");
-        m_discoveryInProgress = false;
         m_statusMessage = "Discovery failed";
-        m_statusChanged = true;
     }
+    m_statusChanged = true;
 }
 
 void ThroughputClientScreen::checkDiscoveryStatus() {
     if (!m_discoveryInProgress) return;
 
-    // Check if the discovery process has completed
-    int status;
-    pid_t result = waitpid(m_discoveryPid, &status, WNOHANG);
-
-    if (result == m_discoveryPid) {
-        // Discovery process has completed
-        m_discoveryInProgress = false;
-        m_discoveryPid = -1;
-
-        // Determine discovery result
-        if (WIFEXITED(status)) {
-            int exitStatus = WEXITSTATUS(status);
-            Logger::debug("ThroughputClientScreen: avahi-browse completed with status " +
-                         std::to_string(exitStatus));
-
-            // Parse results from the temporary file
-            parseDiscoveryResults();
+    std::vector<MulticastDns::Found> found;
+    bool browsing = MulticastDns::getInstance().poll(found);
+    size_t known = m_discoveredServers.size();
+    for (const auto& server : found) {
+        addDiscoveredServer(server);
+    }
 
-            if (m_discoveredServers.empty()) {
-                Logger::warning("ThroughputClientScreen: No iperf3 servers found");
-                m_statusMessage = "No servers found";
-                m_statusChanged = true;
-            } else {
-                Logger::info("ThroughputClientScreen: Found " +
-                            std::to_string(m_discoveredServers.size()) + " iperf3 servers");
-            }
-        } else {
-            Logger::warning("ThroughputClientScreen: avahi-browse terminated abnormally");
-            m_statusMessage = "Discovery failed";
-            m_statusChanged = true;
+    if (browsing) {
+        // Show the newcomers while the browse goes on
+        if (m_discoveredServers.size() != known) {
+            renderAutoDiscoverScreen(false);
         }
-
-        // Update display with discovery results
-        renderAutoDiscoverScreen(true);
-    }
-}
-void ThroughputClientScreen::parseDiscoveryResults() {
-    std::ifstream file("/tmp/micropanel_avahi_result.txt");
-    if (!file.is_open()) {
-        Logger::error("ThroughputClientScreen: Failed to open discovery results file");
         return;
     }
 
-    // Debug: Log the entire file content
-    std::string allContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    Logger::debug("ThroughputClientScreen: Discovery file content:\n" + allContent);
-
-    // Reset file position to beginning
-    file.clear();
-    file.seekg(0);
-
-    // Track IPv4 addresses we've seen to avoid duplicates
-    std::set<std::string> seenIPs;
-
-    // First, find all IPv4 entries
-    std::string line;
-    std::vector<std::string> ipv4Lines;
-
-    while (std::getline(file, line)) {
-        // Look specifically for IPv4 lines (avoid IPv6)
-        if (line.empty()) continue;
-
-        if (line.find(";IPv4;") != std::string::npos) {
-            ipv4Lines.push_back(line);
-        }
+    m_discoveryInProgress = false;
+    if (m_discoveredServers.empty()) {
+        Logger::warning("ThroughputClientScreen: No iperf3 servers found");
+        m_statusMessage = "No servers found";
+        m_statusChanged = true;
+    } else {
+        LOG_INFO("ThroughputClientScreen: Found " +
+                    std::to_string(m_discoveredServers.size()) + " iperf3 servers");
     }
 
-    // Now process each IPv4 line
-    for (const auto& ipv4Line : ipv4Lines) {
-        std::vector<std::string> fields;
-        std::string field;
-        std::istringstream lineStream(ipv4Line);
-
-        while (std::getline(lineStream, field, ';')) {
-            fields.push_back(field);
-        }
-
-        // Must have at least basic fields
-        if (fields.size() < 4) continue;
-
-        // Extract service name
-        std::string serviceName = fields[3];
-        // Unescape special characters
-        serviceName = std::regex_replace(serviceName, std::regex("\\\\032"), " ");
-        //serviceName = std::regex_replace(serviceName, std::regex("\\\\\."), ".");
-	serviceName = std::regex_replace(serviceName, std::regex("\\\\."), ".");
-        // Try to extract IP from service name (common format)
-        std::string ipAddress;
-        size_t lastSpace = serviceName.find_last_of(' ');
-        if (lastSpace != std::string::npos) {
-            std::string possibleIP = serviceName.substr(lastSpace + 1);
-            // Simple IPv4 validation (contains dots, no colons)
-            if (possibleIP.find('.') != std::string::npos &&
-                possibleIP.find(':') == std::string::npos) {
-                ipAddress = possibleIP;
-            }
-        }
-
-        // If we couldn't extract from service name, look for IP in resolved entries
-        if (ipAddress.empty() && fields[0] == "=") {
-            // In resolved entries, IP should be in field 7
-            if (fields.size() >= 8) {
-                std::string possibleIP = fields[7];
-                if (possibleIP.find('.') != std::string::npos &&
-                    possibleIP.find(':') == std::string::npos) {
-                    ipAddress = possibleIP;
-                }
-            }
-        }
-
-        // Skip if no valid IP found or already processed this IP
-        if (ipAddress.empty() || seenIPs.find(ipAddress) != seenIPs.end()) {
-            continue;
-        }
+    // Update display with discovery results
+    m_submenuSelection = 0;
+    renderAutoDiscoverScreen(true);
+}
 
-        // Try to extract port number
-        int port = 5201; // Default iperf3 port
-        if (fields[0] == "=" && fields.size() >= 9) {
-            try {
-                port = std::stoi(fields[8]);
-            } catch (...) {
-                Logger::warning("ThroughputClientScreen: Failed to parse port, using default");
-            }
+void ThroughputClientScreen::addDiscoveredServer(const MulticastDns::Found& server) {
+    // A server announced on several interfaces or under several names is listed once
+    for (const auto& known : m_discoveredServers) {
+        if (known.first == server.address && known.second == server.port) {
+            return;
         }
-
-        // Record this IP
-        seenIPs.insert(ipAddress);
-
-        // Add to discovered servers
-        m_discoveredServers.push_back(std::make_pair(ipAddress, port));
-        m_discoveredServerNames.push_back(serviceName);
-
-        Logger::debug("ThroughputClientScreen: Discovered server - " +
-                      ipAddress + ":" + std::to_string(port) + " (" + serviceName + ")");
     }
+    m_discoveredServers.push_back(std::make_pair(server.address, server.port));
+    m_discoveredServerNames.push_back(server.instance);
 
-    file.close();
-
-    // Clean up temporary file
-    unlink("/tmp/micropanel_avahi_result.txt");
+    LOG_DEBUG("ThroughputClientScreen: Discovered server - " +
+                  server.address + ":" + std::to_string(server.port) + " (" + server.instance + ")");
 }
+
 void ThroughputClientScreen::selectServer(int index) {
     if (index >= 0 && index < static_cast<int>(m_discoveredServers.size())) {
         // Get selected server
@@ -1803,7 +1521,7 @@ void ThroughputClientScreen::selectServer(int index) {
             m_ipSelector->setIp(m_serverIp);
         }
 
-        Logger::info("ThroughputClientScreen: Selected server: " +
+        LOG_INFO("ThroughputClientScreen: Selected server: " +
                     m_serverIp + ":" + std::to_string(m_serverPort));
     }
 }
@@ -1863,107 +1581,14 @@ void ThroughputClientScreen::showResultsAndWait(){//int durationMs) {
     usleep(Config::DISPLAY_CMD_DELAY);
 
     // Wait for specified duration
-    //Logger::debug("ThroughputClientScreen: Showing results for " + std::to_string(durationMs) + "ms");
+    //LOG_DEBUG("ThroughputClientScreen: Showing results for " + std::to_string(durationMs) + "ms");
 
     // Sleep for the requested duration
     //usleep(durationMs * 1000);
 
-    Logger::debug("ThroughputClientScreen: Done showing results");
+    LOG_DEBUG("ThroughputClientScreen: Done showing results");
 }
 
-UDPTestResult ThroughputClientScreen::parseUDPTestResults(const std::string& output) {
-    UDPTestResult result;
-
-    try {
-        // Look for the UDP metrics in the end->sum section
-        size_t endPos = output.find("\"end\":");
-        if (endPos == std::string::npos) {
-            Logger::warning("ThroughputClientScreen: Cannot find end section in UDP results");
-            return result;
-        }
-
-        size_t sumPos = output.find("\"sum\":", endPos);
-        if (sumPos == std::string::npos) {
-            Logger::warning("ThroughputClientScreen: Cannot find sum section in UDP results");
-            return result;
-        }
-
-        // Extract bandwidth (bits_per_second)
-        size_t bpsPos = output.find("\"bits_per_second\":", sumPos);
-        if (bpsPos != std::string::npos) {
-            size_t valueStart = bpsPos + 18; // Length of "\"bits_per_second\":"
-            size_t valueEnd = output.find(",", valueStart);
-            if (valueEnd != std::string::npos) {
-                std::string bpsStr = output.substr(valueStart, valueEnd - valueStart);
-                // Convert from bits/sec to Mbits/sec
-                double bps = std::stod(bpsStr);
-                result.bandwidth_mbps = bps / 1000000.0;
-                Logger::debug("ThroughputClientScreen: Parsed UDP bandwidth: " +
-                             std::to_string(result.bandwidth_mbps) + " Mbps");
-            }
-        }
-
-        // Extract jitter
-        size_t jitterPos = output.find("\"jitter_ms\":", sumPos);
-        if (jitterPos != std::string::npos) {
-            size_t valueStart = jitterPos + 12; // Length of "\"jitter_ms\":"
-            size_t valueEnd = output.find(",", valueStart);
-            if (valueEnd != std::string::npos) {
-                std::string jitterStr = output.substr(valueStart, valueEnd - valueStart);
-                result.jitter_ms = std::stod(jitterStr);
-                Logger::debug("ThroughputClientScreen: Parsed jitter: " +
-                             std::to_string(result.jitter_ms) + " ms");
-            }
-        }
-
-        // Extract lost packets
-        size_t lostPacketsPos = output.find("\"lost_packets\":", sumPos);
-        if (lostPacketsPos != std::string::npos) {
-            size_t valueStart = lostPacketsPos + 15; // Length of "\"lost_packets\":"
-            size_t valueEnd = output.find(",", valueStart);
-            if (valueEnd != std::string::npos) {
-                std::string lostPacketsStr = output.substr(valueStart, valueEnd - valueStart);
-                result.lost_packets = std::stoi(lostPacketsStr);
-                Logger::debug("ThroughputClientScreen: Parsed lost packets: " +
-                             std::to_string(result.lost_packets));
-            }
-        }
-
-        // Extract lost percent
-        size_t lostPercentPos = output.find("\"lost_percent\":", sumPos);
-        if (lostPercentPos != std::string::npos) {
-            size_t valueStart = lostPercentPos + 15; // Length of "\"lost_percent\":"
-            size_t valueEnd = output.find(",", valueStart);
-            if (valueEnd != std::string::npos) {
-                std::string lostPercentStr = output.substr(valueStart, valueEnd - valueStart);
-                result.lost_percent = std::stod(lostPercentStr);
-                Logger::debug("ThroughputClientScreen: Parsed packet loss: " +
-                             std::to_string(result.lost_percent) + "%");
-            }
-        }
-
-        // Extract total packets
-        size_t packetsPos = output.find("\"packets\":", sumPos);
-        if (packetsPos != std::string::npos) {
-            size_t valueStart = packetsPos + 10; // Length of "\"packets\":"
-            size_t valueEnd = output.find(",", valueStart);
-            if (valueEnd != std::string::npos) {
-                std::string packetsStr = output.substr(valueStart, valueEnd - valueStart);
-                result.total_packets = std::stoi(packetsStr);
-                Logger::debug("ThroughputClientScreen: Parsed total packets: " +
-                             std::to_string(result.total_packets));
-            }
-        }
-
-        // Mark as valid if we parsed the essential data
-        result.valid = (result.bandwidth_mbps > 0);
-
-    } catch (const std::exception& e) {
-        Logger::error("ThroughputClientScreen: Exception parsing UDP results: " + std::string(e.what()));
-    }
-
-    return result;
-}
 void ThroughputClientScreen::showResultsScreen() {
     // Draw the results screen
     m_display->clear();
@@ -2021,59 +1646,77 @@ void ThroughputClientScreen::renderTestingScreen() {
     // Clear the screen
     m_display->clear();
     usleep(Config::DISPLAY_CMD_DELAY * 3);
+    for (auto& row : m_testRows) {
+        row.clear();
+    }
 
     // Draw header
-    if (m_reverseMode) {
-        m_display->drawText(0, 0, "  Reverse Test");
-    } else {
-        m_display->drawText(0, 0, "    Testing");
-    }
-    usleep(Config::DISPLAY_CMD_DELAY);
+    drawTestRow(0, m_reverseMode ? "  Reverse Test" : "    Testing");
+    drawTestRow(1, "----------------");
 
-    // Draw separator
-    m_display->drawText(0, 8, "----------------");
-    usleep(Config::DISPLAY_CMD_DELAY);
+    // Show server and test parameters
+    drawTestRow(2, "Srv:" + m_serverIp);
+    drawTestRow(3, m_protocol + " " + std::to_string(m_parallel) + "x" + getBandwidthString(m_bandwidth) +
+                       " " + std::to_string(m_duration) + "s");
 
-    // Show test parameters
-    //m_display->drawText(0, 24, "Protocol:" + m_protocol);
-    //usleep(Config::DISPLAY_CMD_DELAY);
+    drawTestProgress();
 
-    // Show server info
-    m_display->drawText(0, 16, "Srv:" + m_serverIp);
-    usleep(Config::DISPLAY_CMD_DELAY);
-    // Show direction info
-    //if (m_reverseMode) {
-    //    m_display->drawText(0, 32, "Dir: Server->Client");
-    //} else {
-    //    m_display->drawText(0, 32, "Dir: Client->Server");
-    //}
-    //usleep(Config::DISPLAY_CMD_DELAY);
-    m_display->drawText(0, 24, "Proto  :" + m_protocol);
-    usleep(Config::DISPLAY_CMD_DELAY);
-
-    // Show duration
-    m_display->drawText(0, 32, "Dur    :" + std::to_string(m_duration) + "sec");
-    usleep(Config::DISPLAY_CMD_DELAY);
+    LOG_DEBUG("ThroughputClientScreen: Showing testing screen");
+}
 
-    // Show other parameters
-    //if (m_protocol == "UDP" && m_bandwidth > 0) {
-    if (m_bandwidth > 0) {
-        m_display->drawText(0, 40, "Rate   :" + std::to_string(m_bandwidth) + "Mbps");
-        usleep(Config::DISPLAY_CMD_DELAY);
-    //} else if (m_protocol == "UDP") {
+void ThroughputClientScreen::drawTestProgress() {
+    if (m_intervalRates.empty()) {
+        drawTestRow(4, "Connecting...");
+        drawTestRow(5, "");
+        drawTestRow(6, "");
     } else {
-        m_display->drawText(0, 40, "Rate   :Auto");
-        usleep(Config::DISPLAY_CMD_DELAY);
+        drawTestRow(4, "Now " + formatBandwidth(m_liveBandwidth));
+
+        // Newest interval on the right, scaled to the fastest one shown so a collapse stands out
+        double peak = *std::max_element(m_intervalRates.begin(), m_intervalRates.end());
+        std::string graph(s_graphColumns - m_intervalRates.size(), ' ');
+        for (double rate : m_intervalRates) {
+            int level = 0;
+            if (rate > 0) {
+                level = 1 + static_cast<int>(rate / peak * (s_graphLevelCount - 2) + 0.5);
+                level = std::min(level, s_graphLevelCount - 1);
+            }
+            graph += s_graphLevels[level];
+        }
+        drawTestRow(5, graph);
+
+        // What this end can tell while the test runs: a TCP sender its retransmits,
+        // a UDP receiver loss and jitter, the other two only what they moved
+        char text[32];
+        if (m_lastInterval.retransmits >= 0) {
+            snprintf(text, sizeof(text), "Retr %d (+%d)", m_liveRetransmits, m_lastInterval.retransmits);
+        } else if (m_lastInterval.jitterMs >= 0) {
+            // m_livePackets counts what arrived, so the datagrams sent are that plus the lost ones
+            double lostCount = static_cast<double>(std::max<int64_t>(m_liveLost, 0));
+            double expected = m_livePackets + lostCount;
+            double lost = expected > 0 ? 100.0 * lostCount / expected : 0.0;
+            snprintf(text, sizeof(text), "L %.1f%% J %.2fms", lost, m_lastInterval.jitterMs);
+        } else if (m_protocol == "UDP") {
+            snprintf(text, sizeof(text), "Sent %llu pkts", static_cast<unsigned long long>(m_livePackets));
+        } else {
+            snprintf(text, sizeof(text), "Peak %s", formatBandwidth(peak).c_str());
+        }
+        drawTestRow(6, text);
     }
 
-    //if (m_parallel > 1) {
-        m_display->drawText(0, 48, "Streams:" + std::to_string(m_parallel));
-        usleep(Config::DISPLAY_CMD_DELAY);
-    //}
+    if (!m_testCancellationPrompt) {
+        drawTestRow(7, std::to_string(static_cast<int>(m_lastInterval.endSec + 0.5)) + "s of " +
+                           std::to_string(m_duration) + "s");
+    }
+}
 
-    // Show progress message
-    m_display->drawText(0, 56, "Please wait...");
+void ThroughputClientScreen::drawTestRow(int row, const std::string& text) {
+    std::string fitted = text.substr(0, 16);
+    if (fitted == m_testRows[row]) {
+        return;
+    }
+    m_display->drawText(0, row * 8, std::string(m_testRows[row].size(), ' '));
+    m_display->drawText(0, row * 8, fitted);
     usleep(Config::DISPLAY_CMD_DELAY);
-
-    Logger::debug("ThroughputClientScreen: Showing testing screen");
+    m_testRows[row] = fitted;
 }
@@ -4,6 +4,7 @@
 #include "Config.h"
 #include "Logger.h"
 #include "ModuleDependency.h"
+#include "MulticastDns.h"
 #include <iostream>
 #include <unistd.h>
 #include <cstdlib>   // For std::exit
@@ -14,8 +15,6 @@
 #include <cstring>
 #include <signal.h>
 #include <sys/types.h>
-#include <sys/wait.h>
-#include <thread>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -23,41 +22,39 @@ ThroughputServerScreen::ThroughputServerScreen(std::shared_ptr<Display> display,
     : ScreenModule(display, input),
       m_selectedOption(0),
       m_port(5201),  // Default port
-      m_localIp(""),
-      m_serverPid(-1),
-      m_serverThread()
+      m_localIp("")
 {
     // Initialize configuration
     auto& dependencies = ModuleDependency::getInstance();
 
     // First try to get port from the server-specific config
-    Logger::debug("ThroughputServerScreen: Attempting to read port from 'throughputserver/default_port'");
+    LOG_DEBUG("ThroughputServerScreen: Attempting to read port from 'throughputserver/default_port'");
     std::string portStr = dependencies.getDependencyPath("throughputserver", "default_port");
-    Logger::debug("ThroughputServerScreen: Got value: '" + portStr + "'");
+    LOG_DEBUG("ThroughputServerScreen: Got value: '" + portStr + "'");
 
     // If not found, try the general throughput config
     if (portStr.empty()) {
-        Logger::debug("ThroughputServerScreen: Falling back to 'throughputtest/default_port'");
+        LOG_DEBUG("ThroughputServerScreen: Falling back to 'throughputtest/default_port'");
         portStr = dependencies.getDependencyPath("throughputtest", "default_port");
-        Logger::debug("ThroughputServerScreen: Got value: '" + portStr + "'");
+        LOG_DEBUG("ThroughputServerScreen: Got value: '" + portStr + "'");
     }
 
     // Parse port value
     if (!portStr.empty()) {
         try {
-            Logger::debug("ThroughputServerScreen: Converting port string '" + portStr + "' to integer");
+            LOG_DEBUG("ThroughputServerScreen: Converting port string '" + portStr + "' to integer");
             int portValue = std::stoi(portStr);
 
             // Only update m_port if a valid value was found
             if (portValue > 0 && portValue < 65536) {
                 m_port = portValue;
-                Logger::info("ThroughputServerScreen: Using configured port: " + std::to_string(m_port));
+                LOG_INFO("ThroughputServerScreen: Using configured port: " + std::to_string(m_port));
             } else {
-                Logger::warning("ThroughputServerScreen: Invalid port value: " + std::to_string(portValue) +
+                LOG_WARNING("ThroughputServerScreen: Invalid port value: " + std::to_string(portValue) +
                                ", using default 5201");
             }
         } catch (const std::exception& e) {
-            Logger::warning("ThroughputServerScreen: Failed to parse port value '" + portStr +
+            LOG_WARNING("ThroughputServerScreen: Failed to parse port value '" + portStr +
                            "', using default 5201. Error: " + std::string(e.what()));
         }
     } else {
@@ -65,29 +62,19 @@ ThroughputServerScreen::ThroughputServerScreen(std::shared_ptr<Display> display,
     }
 
     // Print the final port value being used
-    Logger::info("ThroughputServerScreen: Final configured port is: " + std::to_string(m_port));
+    LOG_INFO("ThroughputServerScreen: Final configured port is: " + std::to_string(m_port));
 
     // Get local IP address
     getLocalIpAddress();
 }
 
 ThroughputServerScreen::~ThroughputServerScreen() {
-    // Ensure server is stopped if running
+    // Ensure server and announcement are stopped if running
     stopServer();
-
-    // Make sure the thread has joined
-    if (m_serverThread.joinable()) {
-        m_serverThread.join();
-    }
-    // Make sure Avahi is stopped (in case stopServer wasn't called)
-    if (m_avahiPid > 0) {
-        kill(m_avahiPid, SIGKILL);
-        m_avahiPid = -1;
-    }
 }
 
 void ThroughputServerScreen::enter() {
-    Logger::debug("ThroughputServerScreen: Entered");
+    LOG_DEBUG("ThroughputServerScreen: Entered");
     m_running = true;
     refreshSettings();
     // Reset selection
@@ -117,7 +104,7 @@ void ThroughputServerScreen::update() {
 }
 
 void ThroughputServerScreen::exit() {
-    Logger::debug("ThroughputServerScreen: Exiting");
+    LOG_DEBUG("ThroughputServerScreen: Exiting");
 
     // Note: We deliberately do NOT stop the server here
     // to allow it to continue running in the background
@@ -159,7 +146,7 @@ bool ThroughputServerScreen::handleInput() {
                 // Handle button press
                 buttonPressed = true;
                 m_display->updateActivityTimestamp();
-                Logger::debug("ThroughputServerScreen: Button pressed");
+                LOG_DEBUG("ThroughputServerScreen: Button pressed");
             }
         );
 
@@ -246,27 +233,6 @@ void ThroughputServerScreen::renderOptions() {
     usleep(Config::DISPLAY_CMD_DELAY);
 }
 
-std::string ThroughputServerScreen::getIperf3Path() {
-    auto& dependencies = ModuleDependency::getInstance();
-
-    // Debug iperf3 path lookup
-    Logger::debug("ThroughputServerScreen: Looking for iperf3 path");
-
-    // First check server-specific iperf3 path, then fall back to general throughput config
-    std::string path = dependencies.getDependencyPath("throughputserver", "iperf3_path");
-    Logger::debug("ThroughputServerScreen: 'throughputserver/iperf3_path' value: '" + path + "'");
-
-    if (path.empty()) {
-        Logger::debug("ThroughputServerScreen: Falling back to 'throughputtest'");
-        path = dependencies.getDependencyPath("throughputtest", "iperf3_path");
-        Logger::debug("ThroughputServerScreen: 'throughputtest/iperf3_path' value: '" + path + "'");
-    }
-    if (path.empty()) {
-        return "/usr/bin/iperf3";
-    }
-    return path;
-}
-
 void ThroughputServerScreen::getLocalIpAddress() {
     struct ifaddrs *ifaddr, *ifa;
     int family;
@@ -297,7 +263,7 @@ void ThroughputServerScreen::getLocalIpAddress() {
             }
 
             m_localIp = host;
-            Logger::debug("ThroughputServerScreen: Local IP address: " + m_localIp);
+            LOG_DEBUG("ThroughputServerScreen: Local IP address: " + m_localIp);
             break;
         }
     }
@@ -311,192 +277,58 @@ void ThroughputServerScreen::getLocalIpAddress() {
 }
 
 void ThroughputServerScreen::startServer() {
-    // Check if iperf3 is available
-    std::string iperf3Path = getIperf3Path();
-    if (access(iperf3Path.c_str(), X_OK) != 0) {
-        Logger::error("ThroughputServerScreen: iperf3 not found at: " + iperf3Path);
-        return;
-    }
-
     // First make sure any existing server is stopped
     stopServer();
 
-    // Wait for thread to complete if any
-    if (m_serverThread.joinable()) {
-        m_serverThread.join();
-    }
-
     // Log configured port explicitly
-    Logger::info("ThroughputServerScreen: Starting server on port: " + std::to_string(m_port));
-
-    // Capture port value for the thread
-    int serverPort = m_port;
-
-    // Start iperf3 server in a separate thread to avoid blocking UI
-    m_serverThread = std::thread([this, iperf3Path, serverPort]() {
-        // Create the port string in this scope
-        std::string portStr = std::to_string(serverPort);
-        Logger::debug("ThroughputServerScreen: Thread using port: " + portStr);
-
-        // Fork a child process to run iperf3
-        pid_t pid = fork();
-
-        if (pid == 0) {
-            // We are in the child process
-            // Open /dev/null for redirecting stdout and stderr
-            int devNull = open("/dev/null", O_WRONLY);
-            if (devNull == -1) {
-                Logger::error("ThroughputServerScreen: Failed to open /dev/null");
-                std::exit(1);
-            }
-
-            // Redirect stdout to /dev/null
-            if (dup2(devNull, STDOUT_FILENO) == -1) {
-                Logger::error("ThroughputServerScreen: Failed to redirect stdout");
-                close(devNull);
-                std::exit(1);
-            }
-
-            // Redirect stderr to /dev/null
-            if (dup2(devNull, STDERR_FILENO) == -1) {
-                Logger::error("ThroughputServerScreen: Failed to redirect stderr");
-                close(devNull);
-                std::exit(1);
-            }
-
-            // Close the file descriptor as it's no longer needed
-            close(devNull);
-
-            // Execute iperf3 with the port string from this scope
-            execl(iperf3Path.c_str(), "iperf3", "-s", "-p", portStr.c_str(), "--udp-counters-64bit", NULL);
-
-            // If execl returns, it failed
-            std::exit(1);
-        } else if (pid > 0) {
-            // We are in the parent process
-            m_serverPid = pid;
-            Logger::info("ThroughputServerScreen: iperf3 server started on port " + portStr +
-                         " with PID " + std::to_string(pid));
-
-            // Wait for child process to exit (will only happen when killed or on error)
-            int status;
-            waitpid(pid, &status, 0);
-
-            // Check exit status
-            if (WIFEXITED(status)) {
-                Logger::debug("ThroughputServerScreen: iperf3 server exited with status " +
-                              std::to_string(WEXITSTATUS(status)));
-            } else if (WIFSIGNALED(status)) {
-                Logger::debug("ThroughputServerScreen: iperf3 server terminated by signal " +
-                              std::to_string(WTERMSIG(status)));
-            }
+    LOG_INFO("ThroughputServerScreen: Starting server on port: " + std::to_string(m_port));
 
-            // Reset PID
-            m_serverPid = -1;
-        } else {
-            // Fork failed
-            Logger::error("ThroughputServerScreen: Failed to fork process for iperf3 server");
-        }
-    });
-
-    // Detach thread to let it run independently
-    m_serverThread.detach();
-
-    // Give it a moment to start up to ensure iperf3 is listening
-    usleep(100000); // 100ms
-
-    // Start Avahi service announcement after iperf3 is running
-    if (isAvahiAvailable()) {
-        // Fork process to run avahi-publish
-        pid_t avahi_pid = fork();
-
-        if (avahi_pid == 0) {
-            // Child process - run avahi-publish
-            // Create service name with IP and port for easier identification
-            std::string serviceName = "MicroPanel iperf3 " + m_localIp;
-
-            // Execute avahi-publish with the current port
-            execl("/usr/bin/avahi-publish", "avahi-publish",
-                  "-s", serviceName.c_str(),
-                  "_iperf3._tcp", std::to_string(m_port).c_str(),
-                  NULL);
-
-            // If execl returns, it failed
-            Logger::error("ThroughputServerScreen: Failed to start avahi-publish");
-            std::exit(1);
-        } else if (avahi_pid > 0) {
-            // Parent process
-            m_avahiPid = avahi_pid;
-            Logger::info("ThroughputServerScreen: Announced service via Avahi with PID " +
-                        std::to_string(avahi_pid));
-        } else {
-            // Fork failed
-            Logger::warning("ThroughputServerScreen: Failed to fork for avahi-publish");
-        }
+    // The built-in engine answers iperf3 clients; it is listening once this returns
+    std::string portStr = std::to_string(m_port);
+    if (!m_server.startServer(m_port)) {
+        LOG_ERROR("ThroughputServerScreen: Failed to start server: " + m_server.getError());
+        return;
+    }
+    LOG_INFO("ThroughputServerScreen: Throughput server started on port " + portStr);
+
+    // Announce the server over mDNS once it is listening, with the IP for easier identification
+    MulticastDns::Service service;
+    service.instance = "MicroPanel iperf3 " + m_localIp;
+    service.type = m_serviceType;
+    service.port = m_port;
+    if (MulticastDns::getInstance().announce(service)) {
+        m_announcedName = service.instance;
+        m_announcedType = service.type;
     } else {
-        Logger::warning("ThroughputServerScreen: Avahi not available, service will not be discoverable");
+        Logger::warning("ThroughputServerScreen: mDNS announcement failed, service will not be discoverable");
     }
 }
 
 void ThroughputServerScreen::stopServer() {
-    // First, stop the Avahi announcement
-    if (m_avahiPid > 0) {
-        Logger::debug("ThroughputServerScreen: Stopping Avahi announcement with PID " +
-                     std::to_string(m_avahiPid));
-        // Send SIGTERM to the process
-        if (kill(m_avahiPid, SIGTERM) == 0) {
-            Logger::info("ThroughputServerScreen: Stopped Avahi announcement");
-        } else {
-            Logger::warning("ThroughputServerScreen: Failed to stop Avahi announcement, error: " +
-                           std::string(strerror(errno)));
-
-            // Try with SIGKILL if SIGTERM failed
-            if (kill(m_avahiPid, SIGKILL) == 0) {
-                Logger::info("ThroughputServerScreen: Forcefully terminated Avahi announcement");
-            }
-        }
-        // Reset PID
-        m_avahiPid = -1;
+    // First, withdraw the announcement so browsers drop the server
+    if (!m_announcedName.empty()) {
+        MulticastDns::getInstance().withdraw(m_announcedName, m_announcedType);
+        m_announcedName.clear();
     }
 
-    // Kill the server process if it's running
-    if (m_serverPid > 0) {
-        Logger::debug("ThroughputServerScreen: Stopping iperf3 server with PID " + std::to_string(m_serverPid));
-
-        // Send SIGTERM to the process
-        if (kill(m_serverPid, SIGTERM) == 0) {
-            Logger::info("ThroughputServerScreen: Stopped iperf3 server");
-        } else {
-            Logger::warning("ThroughputServerScreen: Failed to stop iperf3 server, error: " +
-                           std::string(strerror(errno)));
-
-            // Try with SIGKILL if SIGTERM failed
-            if (kill(m_serverPid, SIGKILL) == 0) {
-                Logger::info("ThroughputServerScreen: Forcefully terminated iperf3 server");
-            } else {
-                Logger::error("ThroughputServerScreen: Failed to forcefully terminate iperf3 server, error: " +
-                             std::string(strerror(errno)));
-            }
-        }
-
-        // Reset PID
-        m_serverPid = -1;
+    // Stop the server, a test in progress is cut off
+    if (m_server.isRunning()) {
+        m_server.stop();
+        Logger::info("ThroughputServerScreen: Stopped throughput server");
     }
 }
 
-bool ThroughputServerScreen::isServerRunning() const {
-    if (m_serverPid <= 0) {
-        return false;
+bool ThroughputServerScreen::isServerRunning() {
+    // Collects the worker if the server has stopped on its own, which also ends the announcement
+    std::vector<ThroughputEngine::Interval> intervals;
+    bool running = m_server.poll(intervals);
+    if (!running && !m_announcedName.empty()) {
+        MulticastDns::getInstance().withdraw(m_announcedName, m_announcedType);
+        m_announcedName.clear();
     }
-
-    // Check if process exists
-    if (kill(m_serverPid, 0) == 0) {
-        return true;
-    }
-
-    // Process doesn't exist anymore
-    return false;
+    return running;
 }
+
 void ThroughputServerScreen::refreshSettings() {
     auto& dependencies = ModuleDependency::getInstance();
 
@@ -512,13 +344,17 @@ void ThroughputServerScreen::refreshSettings() {
             int portValue = std::stoi(portStr);
             if (portValue > 0 && portValue < 65536) {
                 if (m_port != portValue) {
-                    Logger::info("ThroughputServerScreen: Updating port from " +
+                    LOG_INFO("ThroughputServerScreen: Updating port from " +
                                 std::to_string(m_port) + " to " + std::to_string(portValue));
                     m_port = portValue;
                 }
             }
         } catch (...) {
-            Logger::warning("ThroughputServerScreen: Failed to parse port value: " + portStr);
+            LOG_WARNING("ThroughputServerScreen: Failed to parse port value: " + portStr);
         }
     }
+
+    // Service type announced over mDNS
+    std::string serviceType = dependencies.getDependencyPath("throughputserver", "mdns_service");
+    m_serviceType = serviceType.empty() ? Config::MDNS_IPERF3_SERVICE : serviceType;
 }
@@ -0,0 +1,211 @@
+#include "ScreenModules.h"
+#include "MenuSystem.h"
+#include "DeviceInterfaces.h"
+#include "ModuleDependency.h"
+#include "Config.h"
+#include "Logger.h"
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+
+// Ink density ramp, one character per sample; the font has no block glyphs
+const char s_sparkLevels[] = " .:-=+*#";
+const int s_sparkLevelCount = sizeof(s_sparkLevels) - 1;
+
+// Below this a quiet link would show its noise at full height
+const float s_sparkFloorBitsPerSec = 8000.0f;
+
+} // namespace
+
+TrafficMonitorScreen::TrafficMonitorScreen(std::shared_ptr<Display> display, std::shared_ptr<InputDevice> input)
+    : ScreenModule(display, input)
+{
+}
+
+void TrafficMonitorScreen::enter()
+{
+    LOG_DEBUG("TrafficMonitorScreen: Entered");
+
+    m_display->clear();
+    usleep(Config::DISPLAY_CMD_DELAY * 3);
+
+    for (auto& row : m_rows) {
+        row.clear();
+    }
+    m_display->drawText(0, 8, "----------------");
+    usleep(Config::DISPLAY_CMD_DELAY);
+    m_rows[1] = "----------------";
+
+    // Sampling interval
+    std::string interval = ModuleDependency::getInstance().getDependencyPath("traffic", "interval_ms");
+    m_intervalMs = interval.empty() ? Config::TRAFFIC_SAMPLE_MS : atoi(interval.c_str());
+    m_intervalMs = std::max(m_intervalMs, Config::TRAFFIC_MIN_SAMPLE_MS);
+
+    // The first sample only sets the baseline, rates follow with the second
+    if (m_sampler.open()) {
+        m_sampler.sample();
+    }
+    m_sampledAt = std::chrono::steady_clock::now();
+    render();
+}
+
+void TrafficMonitorScreen::update()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_sampledAt < std::chrono::milliseconds(m_intervalMs)) {
+        return;
+    }
+
+    m_sampledAt = now;
+    m_sampler.sample();
+    render();
+}
+
+void TrafficMonitorScreen::exit()
+{
+    LOG_DEBUG("TrafficMonitorScreen: Exiting");
+
+    m_sampler.close();
+    m_display->clear();
+    usleep(Config::DISPLAY_CMD_DELAY * 3);
+}
+
+bool TrafficMonitorScreen::handleInput()
+{
+    if (m_input->waitForEvents(100) > 0) {
+        bool buttonPressed = false;
+        int rotation = 0;
+
+        m_input->processEvents(
+            [&rotation, this](int direction) {
+                rotation += direction > 0 ? 1 : -1;
+                m_display->updateActivityTimestamp();
+            },
+            [&buttonPressed, this]() {
+                buttonPressed = true;
+                m_display->updateActivityTimestamp();
+            }
+        );
+
+        if (buttonPressed) {
+            return false; // Exit module
+        }
+
+        // Rotation steps through the interfaces
+        int count = static_cast<int>(m_sampler.getInterfaces().size());
+        if (rotation != 0 && count > 0) {
+            m_selected = ((m_selected + rotation) % count + count) % count;
+            m_selectedName = m_sampler.getInterfaces()[m_selected].name;
+            render();
+        }
+    }
+
+    return true; // Continue running
+}
+
+void TrafficMonitorScreen::render()
+{
+    const auto& interfaces = m_sampler.getInterfaces();
+    if (interfaces.empty()) {
+        drawRow(0, " Traffic");
+        drawRow(3, "No interfaces");
+        return;
+    }
+
+    // Follow the selected interface by name, its position moves when others come and go
+    auto found = std::find_if(interfaces.begin(), interfaces.end(), [this](const TrafficSampler::Interface& entry) {
+        return entry.name == m_selectedName;
+    });
+    if (found != interfaces.end()) {
+        m_selected = static_cast<int>(found - interfaces.begin());
+    } else {
+        m_selected = std::min(m_selected, static_cast<int>(interfaces.size()) - 1);
+        m_selectedName = interfaces[m_selected].name;
+    }
+    const TrafficSampler::Interface& interface = interfaces[m_selected];
+
+    char text[48];
+    std::string position = std::to_string(m_selected + 1) + "/" + std::to_string(interfaces.size());
+    snprintf(text, sizeof(text), "%-*.*s%s", 16 - static_cast<int>(position.size()),
+             15 - static_cast<int>(position.size()), interface.name.c_str(), position.c_str());
+    drawRow(0, text);
+
+    // Both sparklines share one scale so their heights compare
+    float peak = std::max(std::max(interface.rxHistory.peak(), interface.txHistory.peak()), s_sparkFloorBitsPerSec);
+
+    drawRow(2, "RX " + formatRate(interface.rates.rxBitsPerSec));
+    drawRow(3, sparkline(interface.rxHistory, peak));
+    drawRow(4, "TX " + formatRate(interface.rates.txBitsPerSec));
+    drawRow(5, sparkline(interface.txHistory, peak));
+
+    snprintf(text, sizeof(text), "Pk/s %s/%s", formatCount(interface.rates.rxPacketsPerSec).c_str(),
+             formatCount(interface.rates.txPacketsPerSec).c_str());
+    drawRow(6, text);
+
+    const TrafficSampler::Counters& counters = interface.counters;
+    snprintf(text, sizeof(text), "E%s/%s D%s/%s",
+             formatCount(static_cast<double>(counters.rxErrors)).c_str(),
+             formatCount(static_cast<double>(counters.txErrors)).c_str(),
+             formatCount(static_cast<double>(counters.rxDrops)).c_str(),
+             formatCount(static_cast<double>(counters.txDrops)).c_str());
+    drawRow(7, text);
+}
+
+void TrafficMonitorScreen::drawRow(int row, const std::string& text)
+{
+    std::string fitted = text.substr(0, 16);
+    if (fitted == m_rows[row]) {
+        return;
+    }
+    m_display->drawText(0, row * 8, std::string(m_rows[row].size(), ' '));
+    m_display->drawText(0, row * 8, fitted);
+    usleep(Config::DISPLAY_CMD_DELAY);
+    m_rows[row] = fitted;
+}
+
+std::string TrafficMonitorScreen::formatRate(double bitsPerSec)
+{
+    char text[16];
+    if (bitsPerSec >= 1e9) {
+        snprintf(text, sizeof(text), "%6.2f Gb/s", bitsPerSec / 1e9);
+    } else if (bitsPerSec >= 1e6) {
+        snprintf(text, sizeof(text), "%6.1f Mb/s", bitsPerSec / 1e6);
+    } else if (bitsPerSec >= 1e3) {
+        snprintf(text, sizeof(text), "%6.1f Kb/s", bitsPerSec / 1e3);
+    } else {
+        snprintf(text, sizeof(text), "%6.0f b/s", bitsPerSec);
+    }
+    return text;
+}
+
+std::string TrafficMonitorScreen::formatCount(double count)
+{
+    char text[16];
+    if (count >= 1e6) {
+        snprintf(text, sizeof(text), "%.1fM", count / 1e6);
+    } else if (count >= 1e4) {
+        snprintf(text, sizeof(text), "%.0fK", count / 1e3);
+    } else {
+        snprintf(text, sizeof(text), "%.0f", count);
+    }
+    return text;
+}
+
+std::string TrafficMonitorScreen::sparkline(const TrafficSampler::History& history, float peak)
+{
+    // Newest sample on the right, the line fills up from the left edge while history builds
+    std::string line(TrafficSampler::HISTORY - history.size(), ' ');
+    for (int i = 0; i < history.size(); i++) {
+        float value = history.at(i);
+        int level = 0;
+        if (value > 0) {
+            level = 1 + static_cast<int>(value / peak * (s_sparkLevelCount - 2) + 0.5f);
+            level = std::min(level, s_sparkLevelCount - 1);
+        }
+        line += s_sparkLevels[level];
+    }
+    return line;
+}
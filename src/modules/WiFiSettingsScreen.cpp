@@ -2,6 +2,7 @@
 #include "MenuSystem.h"
 #include "DeviceInterfaces.h"
 #include "Config.h"
+#include "Logger.h"
 #include <iostream>
 #include <unistd.h>
 
@@ -152,7 +153,7 @@ void WiFiSettingsScreen::setWiFiStatus(bool enabled)
     
     if (enabled != wifiState) {
         wifiState = enabled;
-        std::cout << "WiFi state changed to " << (enabled ? "ON" : "OFF") << std::endl;
+        LOG_INFO(std::string("WiFi state changed to ") + (enabled ? "ON" : "OFF"));
         
         // In a real implementation, you would control the WiFi hardware here:
         // Example: